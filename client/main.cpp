@@ -48,6 +48,7 @@ std::vector<Eng::Node*> disks_b;
 std::vector<Eng::Node*> disks_c;
 std::vector<std::vector<Eng::Node*>> m;
 bool isWireFrameMode = false;
+bool showFrameStats = false;
 bool gameWin = false;
 int move_selector = 0;
 int move = 0;
@@ -385,6 +386,10 @@ static void onTextDrawCallback(Eng::GUIObjects gui) {
 
     gui.drawText(glm::vec2(1.0f, 2.0f), (unsigned char*)text, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
 
+    if (showFrameStats) {
+        gui.drawFrameStats(glm::vec2(1.0f, (float)gui.getHeight() - 15.0f), Eng::Base::getInstance().getFrameStats(), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    }
+
     if (gameWin) {
         drawWinScreen(&gui);
     }
@@ -497,6 +502,10 @@ static void onKeyboardPressedCallback(unsigned char key, int mouseX, int mouseY)
         resetGame();
     }
 
+    if (key == 'f') {
+        showFrameStats = !showFrameStats;
+    }
+
     if (key == 'a') {
         mainCamera->setMatrix(glm::rotate(glm::mat4(1.0f), glm::radians(-1.0f), glm::vec3(0.0f, 1.0f, 0.0f)) * mainCamera->getMatrix());
     } else if (key == 'd') {
@@ -590,6 +599,9 @@ int main(int argc, char* argv[]) {
     Eng::Base& eng = Eng::Base::getInstance();
     eng.setActiveCamera(mainCamera);
     eng.init(&argc, argv, "CG Project");
+
+    // The disk moves are computed for parents that only pass their translation on
+    Eng::Node::setParentTranslationOnly(true);
     root = eng.loadScene("./res/hanoitower.ovo");
 
     // Initialize scene [START]
@@ -21,6 +21,7 @@ namespace Eng
                    const glm::mat4 &matrix)
         : Node(name, matrix)
     {
+        setKind(Kind::CAMERA);
     }
 
     Camera::~Camera()
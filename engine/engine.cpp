@@ -55,6 +55,8 @@ void (*onEngineMouseCallback)(int buttonId, int buttonState, int mouseX, int mou
 void (*onEngineIdleCallback)();
 void (*onEngineCloseCallback)();
 void (*onEngineDrawTextCallback)(Eng::GUIObjects gui);
+void (*onEngineSceneProgressCallback)(float progress);
+void (*onEngineSceneLoadedCallback)(Eng::Node* root);
 
 /////////////////
 // GL CALLBACK //
@@ -146,11 +148,24 @@ static void EngineTimerCallback(int value) {
 struct Eng::Base::Reserved {
     // Flags:
     bool initFlag;
+    bool sceneCacheFlag;
+    bool sceneLoadedFlag;
 
     // Scene components:
     List* sceneList;
     Node* rootNode;
 
+    // Per-frame statistics:
+    FrameStats frameStats;
+
+    // Threads of the scene pass (created by init):
+    JobSystem* jobSystem;
+    unsigned int workerThreads;
+
+    // Asynchronous loading:
+    OvoReader* asyncReader;
+    std::string asyncPath;
+
     int width;
     int height;
 
@@ -158,10 +173,16 @@ struct Eng::Base::Reserved {
      * Constructor.
      */
     Reserved() : initFlag(false),
+                 sceneCacheFlag(false),
+                 sceneLoadedFlag(false),
                  sceneList(new List()),
                  rootNode(nullptr),
+                 jobSystem(nullptr),
+                 workerThreads(0),
+                 asyncReader(nullptr),
                  width(800),
                  height(600) {
+        sceneList->setFrameStats(&frameStats);
     }
 };
 
@@ -217,6 +238,10 @@ bool ENG_API Eng::Base::init(int* argc, char* argv[], const char* winName, int w
     // Here you can initialize most of the graphics engine's dependencies and default settings...
     initEngine(argc, argv, winName, width, height);
 
+    // Workers for the scene pass:
+    reserved->jobSystem = new JobSystem(reserved->workerThreads);
+    reserved->sceneList->setJobSystem(reserved->jobSystem);
+
     // Done:
     std::cout << "[>] " << LIB_NAME << " initialized" << std::endl;
     reserved->initFlag = true;
@@ -298,6 +323,14 @@ bool ENG_API Eng::Base::free() {
     }
 
     // Here you can properly dispose of any allocated resource (including third-party dependencies)...
+    if (reserved->asyncReader) {
+        // Waits for the loading thread:
+        delete reserved->asyncReader;
+        reserved->asyncReader = nullptr;
+    }
+    reserved->sceneList->setJobSystem(nullptr);
+    delete reserved->jobSystem;
+    reserved->jobSystem = nullptr;
     FreeImage_DeInitialise();
 
     // Done:
@@ -318,10 +351,20 @@ bool ENG_API Eng::Base::start(void (*callback)(Node* root)) {
     std::cout << "[>] engine started" << std::endl;
     runningFlag = true;
 
+    FrameStats& stats = reserved->frameStats;
+
     /* Enter the main FreeGLUT processing loop : */
     while (runningFlag) {
+        stats.beginFrame();
+        Mesh::resetDrawStats();
+
+        stats.beginPhase(FrameStats::Phase::EVENTS);
         glutMainLoopEvent();
 
+        // Safe point for streamed scene parts:
+        updateSceneLoading();
+        stats.endPhase();
+
         // Clear buffers:
         glClearColor(0.75f, 0.75f, 0.75f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -331,12 +374,22 @@ bool ENG_API Eng::Base::start(void (*callback)(Node* root)) {
         glMatrixMode(GL_MODELVIEW);
 
         // Here you can render the scene...
+        stats.beginPhase(FrameStats::Phase::UPDATE);
         callback(reserved->rootNode);
+        stats.endPhase();
 
+        stats.beginPhase(FrameStats::Phase::PASS);
         reserved->sceneList->pass(reserved->rootNode, glm::mat4(1.0f));
+        stats.endPhase();
 
         // Render
+        stats.beginPhase(FrameStats::Phase::RENDER);
         reserved->sceneList->render();
+        stats.endPhase();
+
+        Material::StateCacheStats stateChanges = Material::getStateCacheStats();
+        stats.addCounter(FrameStats::Counter::STATE_CHANGES, stateChanges.materialChanges + stateChanges.textureChanges);
+        stats.addCounter(FrameStats::Counter::NODES, reserved->sceneList->getNumberOfTraversedNodes());
 
         reserved->sceneList->clear();
 
@@ -345,16 +398,27 @@ bool ENG_API Eng::Base::start(void (*callback)(Node* root)) {
         }
 
         // GUI 2D objects:
+        stats.beginPhase(FrameStats::Phase::GUI);
         GUIObjects guiObjects;
 
         guiObjects.start(guiOrtho);
         onEngineDrawTextCallback(guiObjects);
         guiObjects.stop();
+        stats.endPhase();
 
         frames++;
 
+        // Draws of the whole frame:
+        Mesh::DrawStats draws = Mesh::getDrawStats();
+        stats.addCounter(FrameStats::Counter::DRAW_CALLS, draws.drawCalls);
+        stats.addCounter(FrameStats::Counter::TRIANGLES, draws.triangles);
+
         // Swap buffers:
+        stats.beginPhase(FrameStats::Phase::SWAP);
         glutSwapBuffers();
+        stats.endPhase();
+
+        stats.endFrame();
     }
 
     return true;
@@ -369,6 +433,16 @@ ENG_API Eng::Node* Eng::Base::loadScene(std::string path) {
     // Here you can load a scene from a file...
     // Done:
     std::cout << "[>] scene loaded from: " << path << std::endl;
+
+    // Up-to-date cache first:
+    if (reserved->sceneCacheFlag) {
+        reserved->rootNode = OvoCache::load(path);
+        if (reserved->rootNode) {
+            std::cout << "[>] scene cache hit: " << OvoCache::getCachePath(path) << std::endl;
+            return reserved->rootNode;
+        }
+    }
+
     OvoReader* reader = new OvoReader();
     reserved->rootNode = reader->load(path);
 
@@ -380,9 +454,96 @@ ENG_API Eng::Node* Eng::Base::loadScene(std::string path) {
     }
 
     delete reader;
+
+    if (reserved->sceneCacheFlag)
+        OvoCache::save(path, reserved->rootNode);
+
+    return reserved->rootNode;
+}
+
+void ENG_API Eng::Base::setSceneCacheEnabled(bool enabled) {
+    reserved->sceneCacheFlag = enabled;
+}
+
+bool ENG_API Eng::Base::isSceneCacheEnabled() const {
+    return reserved->sceneCacheFlag;
+}
+
+ENG_API Eng::Node* Eng::Base::loadSceneAsync(std::string path) {
+    // Not initialized?
+    if (!reserved->initFlag) {
+        std::cout << "ERROR: engine not initialized" << std::endl;
+        return nullptr;
+    }
+    if (reserved->asyncReader) {
+        std::cerr << "ERROR: scene " << reserved->asyncPath << " is still loading" << std::endl;
+        return nullptr;
+    }
+
+    std::cout << "[>] scene streaming from: " << path << std::endl;
+
+    // A cache is fast enough to load right away:
+    if (reserved->sceneCacheFlag) {
+        reserved->rootNode = OvoCache::load(path);
+        if (reserved->rootNode) {
+            std::cout << "[>] scene cache hit: " << OvoCache::getCachePath(path) << std::endl;
+            reserved->sceneLoadedFlag = true;
+            return reserved->rootNode;
+        }
+    }
+
+    reserved->rootNode = new Node(path);
+    reserved->asyncReader = new OvoReader();
+    reserved->asyncPath = path;
+    reserved->asyncReader->loadAsync(path, reserved->rootNode);
     return reserved->rootNode;
 }
 
+bool ENG_API Eng::Base::isSceneLoading() const {
+    return reserved->asyncReader != nullptr;
+}
+
+void ENG_API Eng::Base::updateSceneLoading() {
+    if (reserved->asyncReader) {
+        bool finished = reserved->asyncReader->update();
+
+        if (onEngineSceneProgressCallback) {
+            onEngineSceneProgressCallback(reserved->asyncReader->getProgress());
+        }
+
+        if (!finished) {
+            return;
+        }
+
+        bool succeeded = reserved->asyncReader->hasAsyncSucceeded();
+        delete reserved->asyncReader;
+        reserved->asyncReader = nullptr;
+
+        if (succeeded && reserved->sceneCacheFlag) {
+            OvoCache::save(reserved->asyncPath, reserved->rootNode);
+        }
+        if (!succeeded) {
+            std::cerr << "ERROR: Could not load scene from file " << reserved->asyncPath << std::endl;
+        }
+
+        if (onEngineSceneLoadedCallback) {
+            onEngineSceneLoadedCallback(succeeded ? reserved->rootNode : nullptr);
+        }
+        return;
+    }
+
+    // Cache hit: completion is still reported from the loop
+    if (reserved->sceneLoadedFlag) {
+        reserved->sceneLoadedFlag = false;
+        if (onEngineSceneProgressCallback) {
+            onEngineSceneProgressCallback(1.0f);
+        }
+        if (onEngineSceneLoadedCallback) {
+            onEngineSceneLoadedCallback(reserved->rootNode);
+        }
+    }
+}
+
 ///////////////////
 // Engine Camera //
 ///////////////////
@@ -397,10 +558,12 @@ void Eng::Base::fixCameraViewport(Camera* camera, int width, int height) {
     if (!camera)
         return;
 
-    if (Eng::PerspectiveCamera* pCam = dynamic_cast<Eng::PerspectiveCamera*>(currentActiveCamera); pCam != nullptr) {
+    if (currentActiveCamera->getKind() == Node::Kind::PERSPECTIVE_CAMERA) {
+        Eng::PerspectiveCamera* pCam = static_cast<Eng::PerspectiveCamera*>(currentActiveCamera);
         float ratio = (float)width / (float)height;
         pCam->setCameraParams(pCam->getFOV(), ratio, pCam->getNearPlane(), pCam->getFarPlane());
-    } else if (Eng::OrthoCamera* oCam = dynamic_cast<Eng::OrthoCamera*>(currentActiveCamera); oCam != nullptr) {
+    } else if (currentActiveCamera->getKind() == Node::Kind::ORTHO_CAMERA) {
+        Eng::OrthoCamera* oCam = static_cast<Eng::OrthoCamera*>(currentActiveCamera);
         float targetHeight = std::max(1.0f, (-oCam->getBottom()) + oCam->getTop());
         float aspectRatio = (float)width / (float)height;
 
@@ -422,6 +585,10 @@ int Eng::Base::getCurrentFPS() {
     return fps;
 }
 
+Eng::FrameStats& Eng::Base::getFrameStats() {
+    return reserved->frameStats;
+}
+
 void Eng::Base::changeWireFrame(bool isWireFrame) {
     if (isWireFrame) {
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -438,6 +605,30 @@ void Eng::Base::setShadowRender(bool shadowRender_) {
     shadowRender = shadowRender_;
 }
 
+void Eng::Base::setShadowTechnique(List::ShadowTechnique technique) {
+    reserved->sceneList->setShadowTechnique(technique);
+}
+
+Eng::List::ShadowTechnique Eng::Base::getShadowTechnique() const {
+    return reserved->sceneList->getShadowTechnique();
+}
+
+void Eng::Base::setWorkerThreads(unsigned int count) {
+    reserved->workerThreads = count;
+    if (!reserved->initFlag)
+        return;
+
+    // The pool is replaced between frames, never during a pass
+    reserved->sceneList->setJobSystem(nullptr);
+    delete reserved->jobSystem;
+    reserved->jobSystem = new JobSystem(count);
+    reserved->sceneList->setJobSystem(reserved->jobSystem);
+}
+
+unsigned int Eng::Base::getWorkerThreads() const {
+    return reserved->jobSystem ? reserved->jobSystem->getNumberOfThreads() : reserved->workerThreads;
+}
+
 /////////////////////
 // Engine Callback //
 /////////////////////
@@ -469,3 +660,11 @@ void Eng::Base::setOnCloseCallback(void (*callback)()) {
 void Eng::Base::setOnTextDrawCallback(void (*callback)(GUIObjects gui)) {
     onEngineDrawTextCallback = callback;
 }
+
+void Eng::Base::setOnSceneProgressCallback(void (*callback)(float progress)) {
+    onEngineSceneProgressCallback = callback;
+}
+
+void Eng::Base::setOnSceneLoadedCallback(void (*callback)(Node* root)) {
+    onEngineSceneLoadedCallback = callback;
+}
@@ -94,16 +94,22 @@ namespace Eng
 #include "definitions.h"
 
 #include "object.h"
+#include "framestats.h"
 #include "guiobjects.h"
 
 #include "node.h"
+#include "transformstore.h"
 #include "texture.h"
+#include "texturecache.h"
 #include "material.h"
 
 // Scene objesct
 #include "camera.h"
+#include "meshgeometry.h"
 #include "mesh.h"
 #include "light.h"
+#include "shadowmap.h"
+#include "jobsystem.h"
 #include "list.h"
 
 // Cameras
@@ -116,7 +122,10 @@ namespace Eng
 #include "spotlight.h"
 
 // Ovoreader
+#include "loadprofiler.h"
+#include "vertexunpack.h"
 #include "ovoreader.h"
+#include "ovocache.h"
 
 	///////////////////////
 	// MAIN ENGINE CLASS //
@@ -196,6 +205,38 @@ namespace Eng
 		 */
 		Eng::Node *loadScene(std::string path);
 
+		/**
+		 * @brief Enables or disables the binary scene cache (.ovoc) used by \c loadScene (disabled by default).
+		 *
+		 * When enabled, \c loadScene reuses an up-to-date cache next to the scene file and writes one after parsing the scene,
+		 * so the directory of the scene must be writable; a cache that can't be written only costs the parse next time.
+		 * @param enabled The new state of the scene cache.
+		 */
+		void setSceneCacheEnabled(bool enabled);
+
+		/**
+		 * @brief Tells whether \c loadScene uses the binary scene cache.
+		 * @return \c true if the scene cache is enabled.
+		 */
+		bool isSceneCacheEnabled() const;
+
+		/**
+		 * @brief Starts loading a scene in the background and returns its root node right away.
+		 *
+		 * File reading and mesh decoding run on a background thread. Nodes, materials and textures are created
+		 * at the start of every frame of the \c start loop, and each child subtree of the scene root is attached
+		 * to the returned node as soon as it is decoded. An up-to-date scene cache is loaded synchronously instead.
+		 * @param path The file path to the scene definition.
+		 * @return The root Node the scene streams into, or \c nullptr if the engine is not initialized or a scene is already loading.
+		 */
+		Eng::Node *loadSceneAsync(std::string path);
+
+		/**
+		 * @brief Tells whether a scene started with \c loadSceneAsync is still streaming in.
+		 * @return \c true while the scene is loading.
+		 */
+		bool isSceneLoading() const;
+
 		// Camera management
 		/**
 		 * @brief Sets the currently active camera for rendering.
@@ -218,6 +259,12 @@ namespace Eng
 		 */
 		int getCurrentFPS();
 
+		/**
+		 * @brief Gets the per-frame CPU timings and counters of the \c start loop.
+		 * @return The frame statistics; the window size can be changed through it.
+		 */
+		FrameStats &getFrameStats();
+
 		// Engine external callbacks:
 		/**
 		 * @brief Sets the callback function executed when the rendering window is resized.
@@ -261,6 +308,18 @@ namespace Eng
 		 */
 		void setOnTextDrawCallback(void (*callback)(GUIObjects gui));
 
+		/**
+		 * @brief Sets the callback function executed every frame while a scene loads asynchronously.
+		 * @param callback The function pointer: \c void \c (*)(float \c progress), with progress from 0 to 1.
+		 */
+		void setOnSceneProgressCallback(void (*callback)(float progress));
+
+		/**
+		 * @brief Sets the callback function executed once an asynchronous scene load is over.
+		 * @param callback The function pointer: \c void \c (*)(Node \c *root), called with \c nullptr if loading failed.
+		 */
+		void setOnSceneLoadedCallback(void (*callback)(Node *root));
+
 		/**
 		 * @brief Toggles the rendering mode between solid and wireframe.
 		 * @param isWireFrame If \c true, switch to wireframe mode; otherwise, switch to solid mode.
@@ -279,6 +338,30 @@ namespace Eng
 		 */
 		void setShadowRender(bool shadowRender_);
 
+		/**
+		 * @brief Picks how the scene list draws shadows.
+		 * @param technique Planar projection shadows (the default), shadow maps or none.
+		 */
+		void setShadowTechnique(List::ShadowTechnique technique);
+
+		/**
+		 * @brief Gets how the scene list draws shadows.
+		 * @return The current shadow technique.
+		 */
+		List::ShadowTechnique getShadowTechnique() const;
+
+		/**
+		 * @brief Sets how many threads split the scene pass of large scene graphs.
+		 * @param count Number of threads, the main one included; \c 0 for one per hardware thread (the default), \c 1 for serial passes.
+		 */
+		void setWorkerThreads(unsigned int count);
+
+		/**
+		 * @brief Gets the number of threads splitting the scene pass.
+		 * @return The number of threads, or the configured count before \c init.
+		 */
+		unsigned int getWorkerThreads() const;
+
 	private:
 		// Reserved:
 		/**
@@ -316,6 +399,12 @@ namespace Eng
 		 * @private
 		 */
 		void initEngine(int *argc, char *argv[], const char *winName, int width = 1600, int height = 600);
+
+		/**
+		 * @brief Attaches the parts of an asynchronously loading scene decoded since the last frame and fires the loading callbacks.
+		 * @private
+		 */
+		void updateSceneLoading();
 	};
 
 }; // end of namespace Eng::
@@ -0,0 +1,199 @@
+/**
+ * @file    framestats.cpp
+ * @brief   FrameStats class implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#include "engine.h"
+
+// C/C++:
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+/**
+ * @brief Reads a monotonic clock.
+ * @return The time in seconds from an arbitrary origin.
+ */
+static double Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Reads the time of a phase out of a frame.
+ * @param frame The frame.
+ * @param index The phase.
+ * @return The time in milliseconds.
+ */
+static float PhaseTime(const Eng::FrameStats::Frame &frame, int index)
+{
+    return frame.phaseTimes[index];
+}
+
+/**
+ * @brief Reads a counter out of a frame.
+ * @param frame The frame.
+ * @param index The counter.
+ * @return The counter value.
+ */
+static float CounterValue(const Eng::FrameStats::Frame &frame, int index)
+{
+    return (float)frame.counters[index];
+}
+
+/**
+ * @brief Reads the frame time out of a frame.
+ * @param frame The frame.
+ * @return The time in milliseconds.
+ */
+static float FrameTime(const Eng::FrameStats::Frame &frame, int)
+{
+    return frame.frameTime;
+}
+
+namespace Eng
+{
+
+    //////////////////////
+    // FrameStats CLASS //
+    //////////////////////
+
+    FrameStats::FrameStats(unsigned int window)
+        : nextFrame(0),
+          numberOfFrames(0),
+          current{},
+          last{},
+          frameStart(0.0),
+          phaseDepth(0),
+          phaseStart(0.0)
+    {
+        setWindow(window);
+    }
+
+    void FrameStats::setWindow(unsigned int window)
+    {
+        frames.assign(std::max(window, 1u), Frame{});
+        scratch.reserve(frames.size());
+        nextFrame = 0;
+        numberOfFrames = 0;
+    }
+
+    unsigned int FrameStats::getWindow() const
+    {
+        return (unsigned int)frames.size();
+    }
+
+    void FrameStats::beginFrame()
+    {
+        current = {};
+        phaseDepth = 0;
+        frameStart = Now();
+    }
+
+    void FrameStats::endFrame()
+    {
+        while (phaseDepth > 0)
+            endPhase();
+        current.frameTime = (float)((Now() - frameStart) * 1000.0);
+
+        last = current;
+        frames[nextFrame] = current;
+        nextFrame = (nextFrame + 1) % frames.size();
+        numberOfFrames = std::min(numberOfFrames + 1, (unsigned int)frames.size());
+    }
+
+    void FrameStats::beginPhase(Phase phase)
+    {
+        double now = Now();
+        if (phaseDepth > 0)
+            current.phaseTimes[(int)phaseStack[phaseDepth - 1]] += (float)((now - phaseStart) * 1000.0);
+
+        if (phaseDepth == MAX_NESTING)
+        {
+            std::cerr << "ERROR: Too many nested frame phases" << std::endl;
+            phaseDepth--;
+        }
+        phaseStack[phaseDepth++] = phase;
+        phaseStart = now;
+    }
+
+    void FrameStats::endPhase()
+    {
+        if (phaseDepth == 0)
+            return;
+
+        // The interrupted phase resumes from now
+        double now = Now();
+        current.phaseTimes[(int)phaseStack[--phaseDepth]] += (float)((now - phaseStart) * 1000.0);
+        phaseStart = now;
+    }
+
+    void FrameStats::addCounter(Counter counter, unsigned int value)
+    {
+        current.counters[(int)counter] += value;
+    }
+
+    unsigned int FrameStats::getNumberOfFrames() const
+    {
+        return numberOfFrames;
+    }
+
+    const FrameStats::Frame &FrameStats::getLastFrame() const
+    {
+        return last;
+    }
+
+    FrameStats::Summary FrameStats::getSummary(Phase phase) const
+    {
+        return summarize(PhaseTime, (int)phase);
+    }
+
+    FrameStats::Summary FrameStats::getSummary(Counter counter) const
+    {
+        return summarize(CounterValue, (int)counter);
+    }
+
+    FrameStats::Summary FrameStats::getFrameTimeSummary() const
+    {
+        return summarize(FrameTime, 0);
+    }
+
+    FrameStats::Summary FrameStats::summarize(float (*value)(const Frame &, int), int index) const
+    {
+        Summary summary = {};
+        if (numberOfFrames == 0)
+            return summary;
+
+        // Slots past numberOfFrames are not filled yet, the order of the others does not matter
+        scratch.clear();
+        double sum = 0.0;
+        for (unsigned int f = 0; f < numberOfFrames; f++)
+        {
+            scratch.push_back(value(frames[f], index));
+            sum += scratch.back();
+        }
+
+        size_t rank = (size_t)std::ceil(0.99 * scratch.size()) - 1;
+        std::nth_element(scratch.begin(), scratch.begin() + rank, scratch.end());
+        summary.p99 = scratch[rank];
+        summary.min = *std::min_element(scratch.begin(), scratch.end());
+        summary.average = (float)(sum / scratch.size());
+        return summary;
+    }
+
+    const char *FrameStats::getName(Phase phase)
+    {
+        static const char *names[(int)Phase::COUNT] = {"Events", "Update", "Pass", "Render", "Shadows", "GUI", "Swap"};
+        return phase < Phase::COUNT ? names[(int)phase] : "";
+    }
+
+    const char *FrameStats::getName(Counter counter)
+    {
+        static const char *names[(int)Counter::COUNT] = {"Draw calls", "Triangles", "State changes", "Nodes"};
+        return counter < Counter::COUNT ? names[(int)counter] : "";
+    }
+
+}; // end of namespace Eng::
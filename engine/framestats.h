@@ -0,0 +1,181 @@
+/**
+ * @file    framestats.h
+ * @brief   FrameStats class
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief CPU time and submission counters of the last frames.
+ *
+ * The main loop marks every frame with \c beginFrame and \c endFrame and every part of it with
+ * \c beginPhase and \c endPhase. Phases may nest: the time of an inner phase (the shadows within
+ * the list rendering) is not counted in the outer one, so the phases of a frame add up to its time.
+ * The last \c getWindow frames are kept to report their minimum, average and 99th percentile.
+ */
+class ENG_API FrameStats final
+{
+public:
+    /** @brief The parts a frame is split into. */
+    enum class Phase : int
+    {
+        EVENTS = 0, ///< Window events and streamed scene parts.
+        UPDATE,     ///< The user update callback.
+        PASS,       ///< Scene graph traversal into the render list.
+        RENDER,     ///< Render list drawing, shadows excluded.
+        SHADOWS,    ///< Planar shadows or shadow maps.
+        GUI,        ///< 2D overlay.
+        SWAP,       ///< Buffer swap.
+        COUNT       ///< Number of phases.
+    };
+
+    /** @brief The work a frame submitted. */
+    enum class Counter : int
+    {
+        DRAW_CALLS = 0, ///< Draw calls, an instanced draw counting once.
+        TRIANGLES,      ///< Triangles submitted, every instance counting.
+        STATE_CHANGES,  ///< Material and texture changes sent to OpenGL.
+        NODES,          ///< Scene graph nodes traversed.
+        COUNT           ///< Number of counters.
+    };
+
+    /** @brief Timings and counters of one frame. */
+    struct Frame
+    {
+        float phaseTimes[(int)Phase::COUNT];     ///< CPU time of every phase, in milliseconds.
+        float frameTime;                         ///< CPU time from \c beginFrame to \c endFrame, in milliseconds.
+        unsigned int counters[(int)Counter::COUNT]; ///< Value of every counter.
+    };
+
+    /** @brief Minimum, average and 99th percentile of a value over the kept frames. */
+    struct Summary
+    {
+        float min;     ///< Smallest value.
+        float average; ///< Mean value.
+        float p99;     ///< Value 99% of the frames do not exceed.
+    };
+
+    /**
+     * @brief Constructor.
+     * @param window The number of frames summaries are computed over.
+     */
+    FrameStats(unsigned int window = 120);
+
+    /**
+     * @brief Sets the number of frames summaries are computed over; the kept frames are discarded.
+     * @param window The number of frames (at least 1).
+     */
+    void setWindow(unsigned int window);
+
+    /**
+     * @brief Gets the number of frames summaries are computed over.
+     * @return The window size.
+     */
+    unsigned int getWindow() const;
+
+    /** @brief Starts a new frame, clearing its timings and counters. */
+    void beginFrame();
+
+    /** @brief Closes the current frame and adds it to the kept frames. */
+    void endFrame();
+
+    /**
+     * @brief Starts timing a phase, pausing the running one until the matching \c endPhase.
+     * @param phase The phase.
+     */
+    void beginPhase(Phase phase);
+
+    /** @brief Stops timing the innermost running phase and resumes the one it interrupted. */
+    void endPhase();
+
+    /**
+     * @brief Adds to a counter of the current frame.
+     * @param counter The counter.
+     * @param value The amount to add.
+     */
+    void addCounter(Counter counter, unsigned int value);
+
+    /**
+     * @brief Gets the number of kept frames.
+     * @return Up to \c getWindow frames.
+     */
+    unsigned int getNumberOfFrames() const;
+
+    /**
+     * @brief Gets the last completed frame.
+     * @return The frame, all zeros if none was completed yet.
+     */
+    const Frame& getLastFrame() const;
+
+    /**
+     * @brief Summarizes the time of a phase over the kept frames.
+     * @param phase The phase.
+     * @return The summary, in milliseconds.
+     */
+    Summary getSummary(Phase phase) const;
+
+    /**
+     * @brief Summarizes a counter over the kept frames.
+     * @param counter The counter.
+     * @return The summary.
+     */
+    Summary getSummary(Counter counter) const;
+
+    /**
+     * @brief Summarizes the frame time over the kept frames.
+     * @return The summary, in milliseconds.
+     */
+    Summary getFrameTimeSummary() const;
+
+    /**
+     * @brief Gets the display name of a phase.
+     * @param phase The phase.
+     * @return A constant string.
+     */
+    static const char* getName(Phase phase);
+
+    /**
+     * @brief Gets the display name of a counter.
+     * @param counter The counter.
+     * @return A constant string.
+     */
+    static const char* getName(Counter counter);
+
+private:
+    /** @brief Maximum depth of nested phases. */
+    static constexpr int MAX_NESTING = 8;
+
+    /** @brief Ring buffer of the kept frames. */
+    std::vector<Frame> frames;
+    /** @brief Slot of the next completed frame in \c frames. */
+    unsigned int nextFrame;
+    /** @brief Number of valid entries of \c frames. */
+    unsigned int numberOfFrames;
+    /** @brief Frame being measured. */
+    Frame current;
+    /** @brief Last completed frame. */
+    Frame last;
+    /** @brief Start time of the current frame, in seconds. */
+    double frameStart;
+
+    /** @brief Running phases, innermost last. */
+    Phase phaseStack[MAX_NESTING];
+    /** @brief Number of running phases. */
+    int phaseDepth;
+    /** @brief Time the innermost running phase was started or resumed, in seconds. */
+    double phaseStart;
+
+    /** @brief Sorting scratch of the summaries, kept to avoid per call allocations. */
+    mutable std::vector<float> scratch;
+
+    /**
+     * @brief Summarizes one value of the kept frames.
+     * @param value Reads the value out of a frame.
+     * @param index The phase or counter passed to \c value.
+     * @return The summary.
+     * @private
+     */
+    Summary summarize(float (*value)(const Frame&, int), int index) const;
+};
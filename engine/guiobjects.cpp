@@ -5,6 +5,9 @@
 // GLM:
 #include <glm/gtc/type_ptr.hpp>
 
+// C/C++:
+#include <cstdio>
+
 // FreeGlut:
 #include "GL/freeglut.h"
 #include "guiobjects.h"
@@ -59,6 +62,37 @@ void Eng::GUIObjects::drawRect(glm::vec2 pos, float width, float height, const g
 	glEnd();
 }
 
+void Eng::GUIObjects::drawFrameStats(glm::vec2 pos, const FrameStats &stats, glm::vec4 color)
+{
+	const float lineHeight = 15.0f;
+	char text[96];
+
+	snprintf(text, sizeof(text), "%-14s %9s %9s %9s", "", "min", "avg", "p99");
+	drawText(pos, (unsigned char *)text, color);
+	pos.y -= lineHeight;
+
+	FrameStats::Summary summary = stats.getFrameTimeSummary();
+	snprintf(text, sizeof(text), "%-14s %9.2f %9.2f %9.2f ms", "Frame", summary.min, summary.average, summary.p99);
+	drawText(pos, (unsigned char *)text, color);
+	pos.y -= lineHeight;
+
+	for (int p = 0; p < (int)FrameStats::Phase::COUNT; p++)
+	{
+		summary = stats.getSummary((FrameStats::Phase)p);
+		snprintf(text, sizeof(text), "%-14s %9.2f %9.2f %9.2f ms", FrameStats::getName((FrameStats::Phase)p), summary.min, summary.average, summary.p99);
+		drawText(pos, (unsigned char *)text, color);
+		pos.y -= lineHeight;
+	}
+
+	for (int c = 0; c < (int)FrameStats::Counter::COUNT; c++)
+	{
+		summary = stats.getSummary((FrameStats::Counter)c);
+		snprintf(text, sizeof(text), "%-14s %9.0f %9.0f %9.0f", FrameStats::getName((FrameStats::Counter)c), summary.min, summary.average, summary.p99);
+		drawText(pos, (unsigned char *)text, color);
+		pos.y -= lineHeight;
+	}
+}
+
 int Eng::GUIObjects::getWidth()
 {
 	float matrix_0_0 = drawingView[0][0]; // M[column][row]
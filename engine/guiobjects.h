@@ -59,6 +59,16 @@ public:
 	 */
 	void drawRect(glm::vec2 pos, float width, float height, const glm::vec4 color);
 
+	/**
+	 * @brief Draws a table of frame statistics: min, average and 99th percentile of the frame time,
+	 * of every phase and of every counter, one line each.
+	 *
+	 * @param pos The 2D screen coordinate (x, y) of the first line; the next lines go downwards.
+	 * @param stats The frame statistics to draw.
+	 * @param color The \c glm::vec4 color (R, G, B, A) of the text.
+	 */
+	void drawFrameStats(glm::vec2 pos, const FrameStats& stats, glm::vec4 color);
+
 	/////////////////////
 	// Drawing windows //
 	/////////////////////
@@ -21,6 +21,7 @@ namespace Eng
     InfiniteLight::InfiniteLight(std::string name, glm::mat4 matrix)
         : Light(name, matrix)
     {
+        setKind(Kind::INFINITE_LIGHT);
     }
 
     InfiniteLight::~InfiniteLight()
@@ -0,0 +1,218 @@
+/**
+ * @file    jobsystem.cpp
+ * @brief   JobSystem class implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#include "engine.h"
+
+// C/C++:
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/////////////////////////
+// RESERVED STRUCTURES //
+/////////////////////////
+
+/**
+ * @brief Job indices waiting on one thread.
+ */
+struct JobQueue
+{
+    /** @brief Protects \c jobs. */
+    std::mutex mutex;
+    /** @brief Job indices; the owner pops from the back, thieves from the front. */
+    std::deque<unsigned int> jobs;
+};
+
+/**
+ * @brief JobSystem class reserved structure.
+ */
+struct Eng::JobSystem::Reserved
+{
+    /** @brief Worker threads (the calling thread is not here). */
+    std::vector<std::thread> threads;
+    /** @brief One queue per thread, the calling one first. */
+    std::vector<JobQueue> queues;
+
+    /** @brief Protects \c generation and \c quit. */
+    std::mutex mutex;
+    /** @brief Wakes the workers when a batch starts or the pool stops. */
+    std::condition_variable wake;
+    /** @brief Wakes the calling thread when the last job is done. */
+    std::condition_variable done;
+    /** @brief Incremented for every batch. */
+    unsigned int generation = 0;
+    /** @brief Whether the workers must exit. */
+    bool quit = false;
+
+    /** @brief Function of the current batch. */
+    Job job = nullptr;
+    /** @brief Context of the current batch. */
+    void *context = nullptr;
+    /** @brief Jobs of the current batch not finished yet. */
+    std::atomic<unsigned int> remaining{0};
+    /** @brief Jobs stolen since the construction. */
+    std::atomic<unsigned int> stolen{0};
+
+    /**
+     * @brief Constructor.
+     * @param threads The number of queues.
+     */
+    Reserved(unsigned int threads) : queues(threads)
+    {
+    }
+};
+
+namespace Eng
+{
+
+    /////////////////////
+    // JobSystem CLASS //
+    /////////////////////
+
+    JobSystem::JobSystem(unsigned int threads)
+    {
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        reserved = std::make_unique<Reserved>(threads);
+        for (unsigned int t = 1; t < threads; t++)
+        {
+            reserved->threads.emplace_back(&JobSystem::workerLoop, this, t);
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(reserved->mutex);
+            reserved->quit = true;
+        }
+        reserved->wake.notify_all();
+        for (std::thread &thread : reserved->threads)
+        {
+            thread.join();
+        }
+    }
+
+    unsigned int JobSystem::getNumberOfThreads() const
+    {
+        return (unsigned int)reserved->queues.size();
+    }
+
+    unsigned int JobSystem::getNumberOfStolenJobs() const
+    {
+        return reserved->stolen.load(std::memory_order_relaxed);
+    }
+
+    void JobSystem::run(unsigned int count, Job job, void *context)
+    {
+        if (count == 0)
+            return;
+
+        // A single thread needs no queues
+        unsigned int threads = (unsigned int)reserved->queues.size();
+        if (threads == 1)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                job(context, i);
+            return;
+        }
+
+        reserved->job = job;
+        reserved->context = context;
+        reserved->remaining.store(count);
+
+        // Contiguous blocks: neighbouring jobs often touch neighbouring data
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            JobQueue &queue = reserved->queues[t];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            for (unsigned int i = count * t / threads; i < count * (t + 1) / threads; i++)
+                queue.jobs.push_back(i);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(reserved->mutex);
+            reserved->generation++;
+        }
+        reserved->wake.notify_all();
+
+        work(0);
+
+        std::unique_lock<std::mutex> lock(reserved->mutex);
+        reserved->done.wait(lock, [this]()
+                            { return reserved->remaining.load() == 0; });
+    }
+
+    void JobSystem::work(unsigned int thread)
+    {
+        unsigned int threads = (unsigned int)reserved->queues.size();
+        while (reserved->remaining.load() > 0)
+        {
+            unsigned int index = 0;
+            bool found = false;
+
+            // Own queue from the back
+            {
+                JobQueue &queue = reserved->queues[thread];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.jobs.empty())
+                {
+                    index = queue.jobs.back();
+                    queue.jobs.pop_back();
+                    found = true;
+                }
+            }
+
+            // Then the others from the front, starting with the next thread
+            for (unsigned int t = 1; t < threads && !found; t++)
+            {
+                JobQueue &queue = reserved->queues[(thread + t) % threads];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.jobs.empty())
+                {
+                    index = queue.jobs.front();
+                    queue.jobs.pop_front();
+                    found = true;
+                    reserved->stolen.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            // Whatever is left is already running elsewhere
+            if (!found)
+                return;
+
+            reserved->job(reserved->context, index);
+            if (reserved->remaining.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> lock(reserved->mutex);
+                reserved->done.notify_all();
+            }
+        }
+    }
+
+    void JobSystem::workerLoop(unsigned int thread)
+    {
+        unsigned int seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(reserved->mutex);
+                reserved->wake.wait(lock, [&]()
+                                    { return reserved->quit || reserved->generation != seen; });
+                if (reserved->quit)
+                    return;
+                seen = reserved->generation;
+            }
+            work(thread);
+        }
+    }
+
+}; // end of namespace Eng::
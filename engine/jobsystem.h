@@ -0,0 +1,93 @@
+/**
+ * @file    jobsystem.h
+ * @brief   JobSystem class
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief Pool of worker threads running batches of independent jobs.
+ *
+ * \c run spreads the job indices over one queue per thread in contiguous blocks. Every thread
+ * takes jobs from the back of its own queue and, once it is empty, steals from the front of the
+ * others, so uneven jobs still keep every thread busy. The calling thread works as thread 0 and
+ * \c run returns when every job is done. Batches must be started from one thread at a time.
+ */
+class ENG_API JobSystem final
+{
+public:
+    /**
+     * @brief Job entry point.
+     * @param context The pointer passed to \c run.
+     * @param index The index of the job, from 0 to the job count - 1.
+     */
+    typedef void (*Job)(void* context, unsigned int index);
+
+    /**
+     * @brief Constructor; starts the worker threads.
+     * @param threads The number of threads, the calling one included (0 for one per hardware thread).
+     */
+    JobSystem(unsigned int threads = 0);
+
+    /** @brief Destructor; stops and joins the worker threads. */
+    ~JobSystem();
+
+    /**
+     * @brief Deleted copy constructor.
+     * @param JobSystem const & prevents sharing of the worker threads.
+     */
+    JobSystem(JobSystem const&) = delete;
+
+    /**
+     * @brief Deleted assignment operator.
+     * @param JobSystem const & prevents sharing of the worker threads.
+     */
+    void operator=(JobSystem const&) = delete;
+
+    /**
+     * @brief Gets the number of threads running jobs, the calling one included.
+     * @return The number of threads (at least 1).
+     */
+    unsigned int getNumberOfThreads() const;
+
+    /**
+     * @brief Runs a batch of jobs and waits for all of them.
+     * @param count The number of jobs.
+     * @param job The function called once per job index, from any thread.
+     * @param context The pointer passed to every call.
+     */
+    void run(unsigned int count, Job job, void* context);
+
+    /**
+     * @brief Gets the number of jobs taken from another thread's queue since the construction.
+     * @return The number of stolen jobs.
+     */
+    unsigned int getNumberOfStolenJobs() const;
+
+private:
+    // Reserved:
+    /**
+     * @brief Forward declaration of an internal structure holding the threads and queues (PIMPL idiom).
+     * @internal
+     */
+    struct Reserved;
+
+    /** @brief Unique pointer to the internal reserved structure. */
+    std::unique_ptr<Reserved> reserved;
+
+    /**
+     * @brief Runs jobs until no queue has any left.
+     * @param thread The index of the running thread.
+     * @private
+     */
+    void work(unsigned int thread);
+
+    /**
+     * @brief Waits for batches and works on them; body of the worker threads.
+     * @param thread The index of the worker thread (from 1).
+     * @private
+     */
+    void workerLoop(unsigned int thread);
+};
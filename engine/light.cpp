@@ -26,7 +26,9 @@ Light::Light(std::string name, glm::mat4 matrix, glm::vec4 position)
       ambient(1.0f),
       diffuse(1.0f),
       specular(1.0f),
-      position(position) {
+      position(position),
+      influenceRadius(0.0f) {
+    setKind(Kind::LIGHT);
     if (ligthCounter > 6) {
         return;
     }
@@ -68,6 +70,10 @@ glm::vec4 Light::getSpecular() {
     return specular;
 }
 
+float Light::getInfluenceRadius() const {
+    return influenceRadius;
+}
+
 void Light::setAmbient(glm::vec4 v) {
     ambient = v;
 }
@@ -84,4 +90,8 @@ void Light::setAttenuaton(float constant, float linear, float quadratic) {
     attenuation = glm::vec3(constant, linear, quadratic);
 }
 
+void Light::setInfluenceRadius(float radius) {
+    influenceRadius = radius > 0.0f ? radius : 0.0f;
+}
+
 };  // namespace Eng
@@ -38,6 +38,9 @@ class ENG_API Light : public Eng::Node
     /** @brief The light source's position in homogeneous coordinates (\c x, \c y, \c z, \c w). W=1 for point lights, W=0 for directional lights. */
     glm::vec4 position;
 
+    /** @brief Distance beyond which the light has no effect, 0 for an unlimited reach. */
+    float influenceRadius;
+
 public:
     /**
      * @brief Constructor for the Light base class.
@@ -86,6 +89,12 @@ public:
      */
     glm::vec4 getSpecular();
 
+    /**
+     * @brief Retrieves the distance beyond which the light has no effect.
+     * @return The influence radius, 0 if the reach is unlimited.
+     */
+    float getInfluenceRadius() const;
+
     /////////////
     // Setters //
     /////////////
@@ -115,4 +124,10 @@ public:
      * @param quadratic The quadratic attenuation factor (default 0).
      */
     void setAttenuaton(float constant = 1, float linear = 0, float quadratic = 0);
+
+    /**
+     * @brief Sets the distance beyond which the light has no effect (used to select shadow casters).
+     * @param radius The influence radius, 0 for an unlimited reach (default).
+     */
+    void setInfluenceRadius(float radius = 0.0f);
 };
\ No newline at end of file
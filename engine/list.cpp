@@ -11,10 +11,82 @@
 #include <GL/freeglut.h>
 
 // GLM:
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 #include <iostream>
 
+/**
+ * @brief Packs integer grid coordinates into a key, z in the lowest bits so cells along z are contiguous.
+ * @param cell The grid coordinates (21 bits each, signed).
+ * @return The cell key.
+ */
+static unsigned long long GridCell(const glm::ivec3 &cell)
+{
+    const long long bias = 1 << 20;
+    return ((unsigned long long)((cell.x + bias) & 0x1FFFFF) << 42) |
+           ((unsigned long long)((cell.y + bias) & 0x1FFFFF) << 21) |
+           (unsigned long long)((cell.z + bias) & 0x1FFFFF);
+}
+
+/**
+ * @brief Extracts the planes of the volume a view-projection matrix maps to clip space (Gribb-Hartmann).
+ * @param viewProjection The view-projection matrix.
+ * @param planes Receives six world space planes, normals (xyz) pointing inside and normalized.
+ */
+static void FrustumPlanes(const glm::mat4 &viewProjection, glm::vec4 planes[6])
+{
+    // Each plane is the last row of the view-projection plus or minus another row
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+    for (int p = 0; p < 6; p++)
+    {
+        glm::vec4 plane = (p & 1) ? rows[3] - rows[p / 2] : rows[3] + rows[p / 2];
+        planes[p] = plane / glm::length(glm::vec3(plane));
+    }
+}
+
+/**
+ * @brief Tests a sphere against the planes of \c FrustumPlanes.
+ * @param sphere The sphere (center xyz, radius w).
+ * @param planes The six planes.
+ * @return \c false if the sphere is entirely outside one of the planes.
+ */
+static bool SphereInPlanes(const glm::vec4 &sphere, const glm::vec4 planes[6])
+{
+    for (int p = 0; p < 6; p++)
+    {
+        if (glm::dot(glm::vec3(planes[p]), glm::vec3(sphere)) + planes[p].w < -sphere.w)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the near and far plane distances back from a perspective or orthographic projection.
+ * @param projection The projection matrix.
+ * @param nearPlane Receives the near plane distance.
+ * @param farPlane Receives the far plane distance.
+ */
+static void DepthRange(const glm::mat4 &projection, float &nearPlane, float &farPlane)
+{
+    if (projection[2][3] != 0.0f)
+    {
+        nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+        farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+    }
+    else
+    {
+        nearPlane = (projection[3][2] + 1.0f) / projection[2][2];
+        farPlane = (projection[3][2] - 1.0f) / projection[2][2];
+    }
+}
+
 namespace Eng
 {
 
@@ -24,7 +96,25 @@ namespace Eng
 
     ENG_API List::List(std::string name)
         : Object(name),
-          camera(nullptr)
+          jobSystem(nullptr),
+          numberOfPassSegments(0),
+          passMatrix(1.0f),
+          lastPassJobs(0),
+          camera(nullptr),
+          frustumCulling(true),
+          frustumValid(false),
+          frustumPlanes{},
+          visibleMeshes(0),
+          culledMeshes(0),
+          traversedNodes(0),
+          shadowCasters(0),
+          culledShadowCasters(0),
+          shadowPlanes{glm::vec4(0.0f, 1.0f, 0.0f, 0.0f)},
+          maxShadowLights(1),
+          shadowTechnique(ShadowTechnique::PLANAR),
+          frameStats(nullptr),
+          lodThresholds{0.3f, 0.12f, 0.05f, 0.02f},
+          lodHysteresis(0.15f)
     {
     }
 
@@ -63,48 +153,344 @@ namespace Eng
         return shadowMat;
     }
 
-    void List::renderShadows(const glm::vec4 &planeEquation)
+    bool List::castsVisibleShadow(const DrawRecord &record, const glm::mat4 &shadowMatrix, const glm::vec4 &planeEquation, float lightSide) const
+    {
+        glm::vec3 boxMin, boxMax;
+        record.mesh->getBoundingBox(record.worldMatrix, boxMin, boxMax);
+
+        bool casting = false, bounded = true;
+        glm::vec3 shadowMin(FLT_MAX), shadowMax(-FLT_MAX);
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec4 corner((c & 1) ? boxMax.x : boxMin.x, (c & 2) ? boxMax.y : boxMin.y, (c & 4) ? boxMax.z : boxMin.z, 1.0f);
+
+            // Only the part on the light's side of the plane casts a shadow onto it
+            if (glm::dot(planeEquation, corner) * lightSide > 0.0f)
+                casting = true;
+
+            // Corners as far from the plane as the light project to infinity: the shadow is unbounded
+            glm::vec4 projected = shadowMatrix * corner;
+            if (projected.w * lightSide <= 0.0f)
+            {
+                bounded = false;
+                continue;
+            }
+            glm::vec3 point = glm::vec3(projected) / projected.w;
+            shadowMin = glm::min(shadowMin, point);
+            shadowMax = glm::max(shadowMax, point);
+        }
+
+        if (!casting)
+            return false;
+        if (!bounded || !frustumCulling || camera == nullptr)
+            return true;
+        return isBoxInFrustum(shadowMin, shadowMax);
+    }
+
+    void List::buildShadowGrid(float cellSize)
     {
-        if (lightList.empty() || meshList.empty())
+        shadowGrid.clear();
+        largeCasters.clear();
+        casterSpheres.resize(casterOrder.size());
+
+        for (unsigned int order = 0; order < casterOrder.size(); order++)
+        {
+            const DrawRecord &record = casterList[casterOrder[order]];
+            glm::vec4 sphere = record.mesh->getBoundingSphere(record.worldMatrix);
+            casterSpheres[order] = sphere;
+
+            if (sphere.w > cellSize)
+                largeCasters.push_back(order);
+            else
+                shadowGrid.push_back({GridCell(glm::ivec3(glm::floor(glm::vec3(sphere) / cellSize))), order});
+        }
+
+        std::sort(shadowGrid.begin(), shadowGrid.end(), [](const GridEntry &a, const GridEntry &b)
+                  { return a.cell < b.cell || (a.cell == b.cell && a.order < b.order); });
+    }
+
+    void List::gatherShadowCasters(const glm::vec3 &lightPosition, float radius, float cellSize)
+    {
+        lightCasters.clear();
+        if (radius <= 0.0f)
+        {
+            for (unsigned int order = 0; order < casterOrder.size(); order++)
+                lightCasters.push_back(order);
             return;
+        }
 
-        // Usa la prima luce trovata
-        Instance lightInst = lightList.front();
-        glm::vec4 lightPos = glm::vec4(lightInst.nodeWorldMatrix[3]);
+        auto reaches = [&](unsigned int order)
+        {
+            const glm::vec4 &sphere = casterSpheres[order];
+            float reach = radius + sphere.w;
+            glm::vec3 offset = glm::vec3(sphere) - lightPosition;
+            return glm::dot(offset, offset) <= reach * reach;
+        };
 
-        // Crea matrice ombra
-        glm::mat4 shadowMatrix = createShadowMatrix(lightPos, planeEquation);
+        // Grid casters are at most one cell wide, so their centers lie within radius + cellSize
+        glm::ivec3 first(glm::floor((lightPosition - (radius + cellSize)) / cellSize));
+        glm::ivec3 last(glm::floor((lightPosition + (radius + cellSize)) / cellSize));
+        for (int x = first.x; x <= last.x; x++)
+        {
+            for (int y = first.y; y <= last.y; y++)
+            {
+                // Cells along z are contiguous in the sorted grid
+                auto cell = std::lower_bound(shadowGrid.begin(), shadowGrid.end(), GridCell(glm::ivec3(x, y, first.z)),
+                                             [](const GridEntry &entry, unsigned long long key)
+                                             { return entry.cell < key; });
+                unsigned long long end = GridCell(glm::ivec3(x, y, last.z));
+                for (; cell != shadowGrid.end() && cell->cell <= end; ++cell)
+                {
+                    if (reaches(cell->order))
+                        lightCasters.push_back(cell->order);
+                }
+            }
+        }
 
-        // Setup rendering ombre
-        glDisable(GL_LIGHTING);
-        glDisable(GL_TEXTURE_2D);
-        glDepthMask(GL_FALSE);
-        // glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glColor4f(0.65f, 0.65f, 0.65f, 0.1f);
+        for (unsigned int order : largeCasters)
+        {
+            if (reaches(order))
+                lightCasters.push_back(order);
+        }
 
-        glm::mat4 viewMatrix = camera->getViewMatrix();
+        // Back to caster order, so copies of the same geometry are adjacent again
+        std::sort(lightCasters.begin(), lightCasters.end());
+    }
 
-        // Renderizza ombre per ogni mesh
-        for (auto &inst : meshList)
+    void List::renderPlaneShadows(const glm::vec4 &lightPos, const glm::vec4 &planeEquation, const glm::mat4 &viewMatrix)
+    {
+        float lightSide = glm::dot(planeEquation, lightPos) < 0.0f ? -1.0f : 1.0f;
+
+        // Crea matrice ombra, sollevata lungo la normale del piano per evitare z-fighting
+        glm::vec3 lift = glm::normalize(glm::vec3(planeEquation)) * (0.01f * lightSide);
+        glm::mat4 shadowMatrix = glm::translate(glm::mat4(1.0f), lift) * createShadowMatrix(lightPos, planeEquation);
+
+        // Copies of the same geometry and level of detail are adjacent in the caster order
+        Mesh *batch = nullptr;
+        for (unsigned int order : lightCasters)
         {
+            const DrawRecord &record = casterList[casterOrder[order]];
+            if (!castsVisibleShadow(record, shadowMatrix, planeEquation, lightSide))
+            {
+                culledShadowCasters++;
+                continue;
+            }
+            shadowCasters++;
+            queueGeometry(batch, record.mesh, viewMatrix * shadowMatrix * record.worldMatrix);
+        }
+        flushGeometry(batch);
+    }
+
+    void List::queueGeometry(Mesh *&batch, Mesh *mesh, const glm::mat4 &modelview)
+    {
+        if (batch && (!mesh->sharesGeometry(batch) || mesh->getCurrentLod() != batch->getCurrentLod()))
+            flushGeometry(batch);
+        batch = mesh;
+        instanceMatrices.push_back(modelview);
+    }
 
-            glm::mat4 modelViewShadow = viewMatrix * shadowMatrix * inst.nodeWorldMatrix;
+    void List::flushGeometry(Mesh *&batch)
+    {
+        if (batch)
+            batch->renderGeometry(instanceMatrices.data(), (unsigned int)instanceMatrices.size(), 0);
+        instanceMatrices.clear();
+        batch = nullptr;
+    }
+
+    void List::getShadowBounds(glm::vec4 &sceneSphere, glm::vec4 &casterSphere) const
+    {
+        glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+        for (const DrawRecord &record : meshList)
+        {
+            glm::vec4 sphere = record.mesh->getBoundingSphere(record.worldMatrix);
+            sceneMin = glm::min(sceneMin, glm::vec3(sphere) - sphere.w);
+            sceneMax = glm::max(sceneMax, glm::vec3(sphere) + sphere.w);
+        }
+        sceneSphere = glm::vec4((sceneMin + sceneMax) * 0.5f, glm::length(sceneMax - sceneMin) * 0.5f);
 
-            glPushMatrix();
-            glLoadMatrixf(glm::value_ptr(modelViewShadow));
-            glTranslatef(0.0f, 0.01f, 0.0f); // Offset per evitare z-fighting
+        glm::vec3 casterMin(FLT_MAX), casterMax(-FLT_MAX);
+        for (const DrawRecord &record : casterList)
+        {
+            glm::vec4 sphere = record.mesh->getBoundingSphere(record.worldMatrix);
+            casterMin = glm::min(casterMin, glm::vec3(sphere) - sphere.w);
+            casterMax = glm::max(casterMax, glm::vec3(sphere) + sphere.w);
+        }
+        casterSphere = glm::vec4((casterMin + casterMax) * 0.5f, glm::length(casterMax - casterMin) * 0.5f);
+    }
 
-            Mesh *mesh = dynamic_cast<Mesh *>(inst.node);
-            if (mesh)
+    bool List::setupShadowMap(const Instance &lightInst, const glm::mat4 &viewMatrix, const glm::vec4 &sceneSphere, const glm::vec4 &casterSphere)
+    {
+        Light *light = static_cast<Light *>(lightInst.node);
+
+        // A single map can't cover every direction: omni lights get planar shadows instead (see renderShadows)
+        if (light->getKind() == Node::Kind::OMNI_LIGHT)
+            return false;
+
+        // Lights point down their local Y axis, as SpotLight does
+        glm::vec3 position(lightInst.nodeWorldMatrix[3]);
+        glm::vec3 direction = -glm::vec3(lightInst.nodeWorldMatrix[1]);
+        if (glm::length(direction) == 0.0f)
+            return false;
+
+        if (light->getKind() == Node::Kind::INFINITE_LIGHT)
+        {
+            glm::mat4 projection = camera->getProjectionMatrix();
+            float nearPlane, farPlane;
+            DepthRange(projection, nearPlane, farPlane);
+            shadowMap.setupDirectional(direction, viewMatrix, projection, nearPlane, farPlane, sceneSphere, casterSphere);
+        }
+        else
+        {
+            SpotLight *spot = light->getKind() == Node::Kind::SPOT_LIGHT ? static_cast<SpotLight *>(light) : nullptr;
+            float fieldOfView = spot ? 2.0f * spot->getCutoff() + 10.0f : 150.0f;
+            float reach = light->getInfluenceRadius() > 0.0f ? light->getInfluenceRadius()
+                                                             : glm::distance(position, glm::vec3(casterSphere)) + casterSphere.w;
+            shadowMap.setupPerspective(position, direction, fieldOfView, reach);
+        }
+        return true;
+    }
+
+    bool List::renderShadowCasters(unsigned int map)
+    {
+        if (!shadowMap.beginDepthPass(map))
+            return false;
+
+        // Every caster inside the volume of the map, whether the camera sees it or not
+        glm::vec4 planes[6];
+        FrustumPlanes(shadowMap.getMatrix(map), planes);
+        Mesh *batch = nullptr;
+        for (unsigned int index : casterOrder)
+        {
+            const DrawRecord &record = casterList[index];
+            if (SphereInPlanes(record.mesh->getBoundingSphere(record.worldMatrix), planes))
+                queueGeometry(batch, record.mesh, record.worldMatrix);
+        }
+        flushGeometry(batch);
+        shadowMap.endDepthPass();
+        return true;
+    }
+
+    bool List::beginShadowMapPass(const glm::mat4 &viewMatrix)
+    {
+        if (lightList.empty() || meshList.empty() || casterList.empty() || maxShadowLights == 0 || !ShadowMap::isMainPassSupported())
+            return false;
+
+        // A single map only: further lights and cascades are left to the receiver passes
+        const Instance &lightInst = lightList[0];
+        if ((maxShadowLights > 1 && lightList.size() > 1) ||
+            (lightInst.node->getKind() == Node::Kind::INFINITE_LIGHT && shadowMap.getNumberOfCascades() > 1))
+            return false;
+
+        glm::vec4 sceneSphere, casterSphere;
+        getShadowBounds(sceneSphere, casterSphere);
+        if (!setupShadowMap(lightInst, viewMatrix, sceneSphere, casterSphere))
+            return false;
+
+        glDisable(GL_LIGHTING);
+        bool rendered = renderShadowCasters(0);
+        glEnable(GL_LIGHTING);
+        return rendered && shadowMap.beginMainPass(0, viewMatrix);
+    }
+
+    void List::renderShadowMaps(const glm::mat4 &viewMatrix)
+    {
+        if (lightList.empty() || meshList.empty() || casterList.empty() || maxShadowLights == 0 || !ShadowMap::isSupported())
+            return;
+
+        // Bounds of the visible meshes, for the depth covered by the cascades, and of every caster,
+        // for the depth range of the maps: an occluder outside the view can still shadow inside it
+        glm::vec4 sceneSphere, casterSphere;
+        getShadowBounds(sceneSphere, casterSphere);
+
+        // The receiver pass relies on texture coordinate generation, which the instancing shader ignores
+        bool instancing = Mesh::isInstancingEnabled();
+        Mesh::setInstancingEnabled(false);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+
+        size_t numberOfLights = std::min((size_t)maxShadowLights, lightList.size());
+        for (size_t l = 0; l < numberOfLights; l++)
+        {
+            if (!setupShadowMap(lightList[l], viewMatrix, sceneSphere, casterSphere))
+                continue;
+
+            for (unsigned int map = 0; map < shadowMap.getNumberOfMaps(); map++)
             {
-                // set global bool to remove gltexture on material rendering
-                Eng::Base::getInstance().setShadowRender(true);
-                mesh->render(modelViewShadow);
-                Eng::Base::getInstance().setShadowRender(false);
+                if (!renderShadowCasters(map))
+                    break;
+
+                // Receivers: every visible mesh within the depth range of the map, darkened where it is shadowed
+                float nearDepth, farDepth;
+                shadowMap.getDepthRange(map, nearDepth, farDepth);
+                shadowMap.beginReceiverPass(map, viewMatrix);
+                glDepthFunc(GL_LEQUAL);
+                glDepthMask(GL_FALSE);
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+                glEnable(GL_POLYGON_OFFSET_FILL);
+                glPolygonOffset(-1.0f, -1.0f);
+                Mesh *batch = nullptr;
+                for (const SortEntry &entry : drawOrder)
+                {
+                    const DrawRecord &record = meshList[entry.index];
+                    glm::vec4 sphere = record.mesh->getBoundingSphere(record.worldMatrix);
+                    float depth = -(viewMatrix * glm::vec4(glm::vec3(sphere), 1.0f)).z;
+                    if (depth + sphere.w >= nearDepth && depth - sphere.w <= farDepth)
+                        queueGeometry(batch, record.mesh, viewMatrix * record.worldMatrix);
+                }
+                flushGeometry(batch);
+                glDisable(GL_POLYGON_OFFSET_FILL);
+                glDisable(GL_BLEND);
+                glDepthMask(GL_TRUE);
+                glDepthFunc(GL_LESS);
+                shadowMap.endReceiverPass();
             }
+        }
+
+        Mesh::setInstancingEnabled(instancing);
+        glEnable(GL_LIGHTING);
+    }
+
+    void List::renderShadows(const glm::mat4 &viewMatrix, bool omniLightsOnly)
+    {
+        shadowCasters = 0;
+        culledShadowCasters = 0;
+        if (lightList.empty() || casterList.empty() || shadowPlanes.empty() || maxShadowLights == 0)
+            return;
 
-            glPopMatrix();
+        // Le prime luci trovate; la cella della griglia segue il raggio d'influenza piu' grande
+        size_t numberOfLights = std::min((size_t)maxShadowLights, lightList.size());
+        size_t numberOfCasting = 0;
+        float cellSize = 0.0f;
+        for (size_t l = 0; l < numberOfLights; l++)
+        {
+            if (omniLightsOnly && lightList[l].node->getKind() != Node::Kind::OMNI_LIGHT)
+                continue;
+            cellSize = std::max(cellSize, static_cast<Light *>(lightList[l].node)->getInfluenceRadius());
+            numberOfCasting++;
+        }
+        if (numberOfCasting == 0)
+            return;
+        buildShadowGrid(cellSize > 0.0f ? cellSize : FLT_MAX);
+
+        // Setup rendering ombre, una volta per tutte le luci e le mesh
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+        glDepthMask(GL_FALSE);
+        // glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glColor4f(0.65f, 0.65f, 0.65f, 0.1f);
+
+        for (size_t l = 0; l < numberOfLights; l++)
+        {
+            const Instance &lightInst = lightList[l];
+            if (omniLightsOnly && lightInst.node->getKind() != Node::Kind::OMNI_LIGHT)
+                continue;
+            glm::vec4 lightPos = glm::vec4(lightInst.nodeWorldMatrix[3]);
+            gatherShadowCasters(glm::vec3(lightPos), static_cast<Light *>(lightInst.node)->getInfluenceRadius(), cellSize);
+
+            for (const glm::vec4 &plane : shadowPlanes)
+                renderPlaneShadows(lightPos, plane, viewMatrix);
         }
 
         // Ripristina stato
@@ -124,44 +510,549 @@ namespace Eng
         glMatrixMode(GL_MODELVIEW);
         glm::mat4 viewMatrix = camera->getViewMatrix();
 
-        // Renderizza prima le ombre
-        glm::vec4 groundPlane(0.0f, 1.0f, 0.0f, 0.0f); // Piano y=0
-        renderShadows(groundPlane);
+        updateLods(viewMatrix);
+        sortMeshes(viewMatrix);
+        sortCasters();
+
+        // Renderizza prima le ombre (o le shadow map applicate durante il passo principale)
+        if (frameStats)
+            frameStats->beginPhase(FrameStats::Phase::SHADOWS);
+        if (shadowTechnique != ShadowTechnique::NONE)
+            renderShadows(viewMatrix, shadowTechnique == ShadowTechnique::SHADOW_MAP);
+        bool shadowsInMainPass = shadowTechnique == ShadowTechnique::SHADOW_MAP && beginShadowMapPass(viewMatrix);
+        if (frameStats)
+            frameStats->endPhase();
+
+        // The shadow map is compared by the fixed pipeline only
+        bool instancing = Mesh::isInstancingEnabled();
+        if (shadowsInMainPass)
+            Mesh::setInstancingEnabled(false);
 
         // Poi renderizza normalmente
-        for (auto inst : list)
+        for (auto &inst : lightList)
         {
             glm::mat4 modelViewModel = viewMatrix * inst.nodeWorldMatrix;
             inst.node->render(modelViewModel);
         }
+        // Read back from OpenGL once, and only for the first batch drawn by the instancing shader
+        unsigned int lightingState = Mesh::QUERY_LIGHTING_STATE;
+
+        // Sorted by state, skipping the material and texture changes already current and
+        // drawing copies of the same mesh together
+        Material::beginStateCache();
+        for (size_t first = 0, last; first < drawOrder.size(); first = last)
+        {
+            const DrawRecord &record = meshList[drawOrder[first].index];
+
+            // Consecutive draws of the same geometry, level of detail and material form one batch
+            for (last = first + 1; last < drawOrder.size(); last++)
+            {
+                const DrawRecord &next = meshList[drawOrder[last].index];
+                if (next.material != record.material || !next.mesh->sharesGeometry(record.mesh) ||
+                    next.mesh->getCurrentLod() != record.mesh->getCurrentLod())
+                    break;
+            }
+
+            if (last - first == 1)
+            {
+                glm::mat4 modelViewModel = viewMatrix * record.worldMatrix;
+                record.mesh->render(modelViewModel);
+                continue;
+            }
+
+            if (lightingState == Mesh::QUERY_LIGHTING_STATE && Mesh::isInstancingEnabled())
+                lightingState = Mesh::getLightingState();
+            instanceMatrices.clear();
+            for (size_t i = first; i < last; i++)
+                instanceMatrices.push_back(viewMatrix * meshList[drawOrder[i].index].worldMatrix);
+            record.mesh->renderInstances(instanceMatrices.data(), (unsigned int)instanceMatrices.size(), lightingState);
+        }
+        Material::endStateCache();
+
+        if (shadowsInMainPass)
+        {
+            shadowMap.endMainPass();
+            Mesh::setInstancingEnabled(instancing);
+        }
+
+        // Altrimenti le shadow map scuriscono la scena gia' disegnata
+        else if (shadowTechnique == ShadowTechnique::SHADOW_MAP)
+        {
+            if (frameStats)
+                frameStats->beginPhase(FrameStats::Phase::SHADOWS);
+            renderShadowMaps(viewMatrix);
+            if (frameStats)
+                frameStats->endPhase();
+        }
     }
 
     void List::pass(Node *root, glm::mat4 matrix)
     {
-        matrix = matrix * root->getMatrix();
+        if (!frustumValid)
+            updateFrustum();
+
+        // Small scenes cost less than waking the workers; the size is the one of this very graph, first frame included
+        if (jobSystem && jobSystem->getNumberOfThreads() > 1 &&
+            root->getSubtreeSize() >= PARALLEL_PASS_NODES && root->getTransformStore() == nullptr)
+        {
+            passParallel(root, matrix);
+            return;
+        }
+
+        lastPassJobs = 0;
+        PassCounters counters = {};
+        visit(root, matrix, true, lightList, meshList, casterList, counters);
+        visibleMeshes += counters.visibleMeshes;
+        culledMeshes += counters.culledMeshes;
+        traversedNodes += counters.traversedNodes;
+    }
+
+    void List::visit(Node *node, const glm::mat4 &matrix, bool recursive, std::vector<Instance> &lights, std::vector<DrawRecord> &meshes,
+                     std::vector<DrawRecord> &casters, PassCounters &counters)
+    {
+        counters.traversedNodes++;
 
         Instance inst;
-        inst.node = root;
+        inst.node = node;
         inst.node->calculateMove();
-        inst.nodeWorldMatrix = root->getWorldCoordinateMatrix();
 
-        if (dynamic_cast<Light *>(inst.node) != nullptr)
+        // Parents are visited first, so only this node's cached world matrix may need an update
+        inst.nodeWorldMatrix = matrix * node->getWorldCoordinateMatrix();
+
+        // Kind tags instead of dynamic_cast: no RTTI walk per node
+        if (node->isLight())
         {
-            this->list.push_front(inst);
-            this->lightList.push_back(inst);
+            lights.push_back(inst);
         }
-        else if (dynamic_cast<Mesh *>(inst.node) != nullptr)
+        else if (node->getKind() == Node::Kind::MESH)
         {
-            this->list.push_back(inst);
-            this->meshList.push_back(inst);
+            Mesh *mesh = static_cast<Mesh *>(node);
+            DrawRecord record = {mesh, mesh->getMaterial(), inst.nodeWorldMatrix, 0};
+            if (isInFrustum(mesh, inst.nodeWorldMatrix))
+            {
+                meshes.push_back(record);
+                counters.visibleMeshes++;
+            }
+            else
+            {
+                counters.culledMeshes++;
+            }
+
+            // Off-screen meshes may still cast shadows into the view
+            if (shadowTechnique != ShadowTechnique::NONE)
+                casters.push_back(record);
+        }
+
+        if (!recursive)
+            return;
+        for (Node *child : node->getChildren())
+        {
+            visit(child, matrix, true, lights, meshes, casters, counters);
+        }
+    }
+
+    void List::passParallel(Node *root, const glm::mat4 &matrix)
+    {
+        // Opens subtrees level by level, in scene graph order, until there are enough jobs to balance;
+        // a stored subtree shares its arrays, so it stays in a single job
+        const unsigned int targetJobs = jobSystem->getNumberOfThreads() * 4;
+        const int maxLevels = 8;
+        std::vector<std::pair<Node *, bool>> *current = &passSplit[0];
+        std::vector<std::pair<Node *, bool>> *next = &passSplit[1];
+        current->clear();
+        current->push_back({root, true});
+        unsigned int jobs = 1;
+        for (int level = 0; level < maxLevels && jobs < targetJobs; level++)
+        {
+            next->clear();
+            unsigned int nextJobs = 0;
+            bool opened = false;
+            for (const auto &[node, subtree] : *current)
+            {
+                if (!subtree || node->getTransformStore())
+                {
+                    next->push_back({node, subtree});
+                    nextJobs += subtree;
+                    continue;
+                }
+                // Leaves are not worth a job, they are visited with the opened nodes
+                next->push_back({node, false});
+                for (Node *child : node->getChildren())
+                {
+                    bool childSubtree = !child->getChildren().empty();
+                    next->push_back({child, childSubtree});
+                    nextJobs += childSubtree;
+                }
+                opened = true;
+            }
+            if (!opened)
+                break;
+            std::swap(current, next);
+            jobs = nextJobs;
+        }
+
+        // Segments keep their queues from frame to frame
+        numberOfPassSegments = (unsigned int)current->size();
+        if (passSegments.size() < numberOfPassSegments)
+            passSegments.resize(numberOfPassSegments);
+        passJobs.clear();
+        passMatrix = matrix;
+        for (unsigned int s = 0; s < numberOfPassSegments; s++)
+        {
+            PassSegment &segment = passSegments[s];
+            segment.node = (*current)[s].first;
+            segment.subtree = (*current)[s].second;
+            segment.lights.clear();
+            segment.meshes.clear();
+            segment.casters.clear();
+            segment.counters = {};
+
+            // The opened nodes are ancestors of the jobs: their world matrices must be ready first
+            if (segment.subtree)
+                passJobs.push_back(s);
+            else
+                visit(segment.node, matrix, false, segment.lights, segment.meshes, segment.casters, segment.counters);
+        }
+
+        jobSystem->run((unsigned int)passJobs.size(), runPassJob, this);
+        lastPassJobs = (unsigned int)passJobs.size();
+
+        // Appending in segment order gives the lists of a serial pass
+        for (unsigned int s = 0; s < numberOfPassSegments; s++)
+        {
+            const PassSegment &segment = passSegments[s];
+            lightList.insert(lightList.end(), segment.lights.begin(), segment.lights.end());
+            meshList.insert(meshList.end(), segment.meshes.begin(), segment.meshes.end());
+            casterList.insert(casterList.end(), segment.casters.begin(), segment.casters.end());
+            visibleMeshes += segment.counters.visibleMeshes;
+            culledMeshes += segment.counters.culledMeshes;
+            traversedNodes += segment.counters.traversedNodes;
+        }
+    }
+
+    void List::runPassJob(void *context, unsigned int index)
+    {
+        List *list = static_cast<List *>(context);
+        PassSegment &segment = list->passSegments[list->passJobs[index]];
+        list->visit(segment.node, list->passMatrix, true, segment.lights, segment.meshes, segment.casters, segment.counters);
+    }
+
+    unsigned long long List::makeSortKey(unsigned int pass, bool transparent, unsigned int texture, unsigned int material, unsigned int geometry, float depth)
+    {
+        // Non-negative floats order like their bit patterns: the top 24 bits are a monotonic depth
+        float distance = std::max(depth, 0.0f);
+        unsigned int bits;
+        std::memcpy(&bits, &distance, sizeof(float));
+        unsigned long long depthBits = bits >> 8;
+
+        unsigned long long key = (unsigned long long)(pass & 0x3) << 62;
+        if (transparent)
+        {
+            key |= 1ull << 61;
+            key |= (0xFFFFFFull - depthBits) << 37;
+            key |= (unsigned long long)(texture & 0xFFF) << 25;
+            key |= (unsigned long long)(material & 0xFFF) << 13;
+            key |= (unsigned long long)(geometry & 0xFFF) << 1;
+        }
+        else
+        {
+            key |= (unsigned long long)(texture & 0xFFF) << 49;
+            key |= (unsigned long long)(material & 0xFFF) << 37;
+            key |= (unsigned long long)(geometry & 0xFFF) << 25;
+            key |= depthBits << 1;
+        }
+        return key;
+    }
+
+    void List::resetSlots(SlotTable &table, size_t count)
+    {
+        size_t capacity = 16;
+        while (capacity < count * 2)
+            capacity *= 2;
+        table.entries.assign(capacity, {0, 0});
+        table.used = 0;
+    }
+
+    unsigned int List::getSlot(SlotTable &table, unsigned int id)
+    {
+        // Linear probing; the table is at most half full
+        size_t mask = table.entries.size() - 1;
+        for (size_t e = (id * 2654435761u) & mask;; e = (e + 1) & mask)
+        {
+            std::pair<unsigned int, unsigned int> &entry = table.entries[e];
+            if (entry.second == 0)
+                entry = {id, std::min(++table.used, 0xFFFu)};
+            if (entry.first == id)
+                return entry.second;
+        }
+    }
+
+    void List::sortMeshes(const glm::mat4 &viewMatrix)
+    {
+        drawOrder.resize(meshList.size());
+        sortScratch.resize(meshList.size());
+        resetSlots(textureSlots, meshList.size());
+        resetSlots(materialSlots, meshList.size());
+        resetSlots(geometrySlots, meshList.size());
+
+        for (unsigned int i = 0; i < meshList.size(); i++)
+        {
+            DrawRecord &record = meshList[i];
+            Texture *texture = record.material ? record.material->getTexture() : nullptr;
+            bool transparent = record.material && record.material->getDiffuse().a < 1.0f;
+            float depth = -(viewMatrix * record.worldMatrix[3]).z;
+
+            record.sortKey = makeSortKey(0, transparent,
+                                         texture ? getSlot(textureSlots, texture->getId()) : 0,
+                                         record.material ? getSlot(materialSlots, record.material->getId()) : 0,
+                                         getSlot(geometrySlots, record.mesh->getGeometryId()),
+                                         depth);
+            drawOrder[i] = {record.sortKey, i};
+        }
+
+        // LSD radix sort, one byte per pass; passes where every key has the same byte are skipped
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            unsigned int offsets[256] = {};
+            for (const SortEntry &entry : drawOrder)
+                offsets[(entry.key >> shift) & 0xFF]++;
+
+            if (offsets[(drawOrder.empty() ? 0 : drawOrder[0].key >> shift) & 0xFF] == drawOrder.size())
+                continue;
+
+            unsigned int sum = 0;
+            for (unsigned int &offset : offsets)
+            {
+                unsigned int count = offset;
+                offset = sum;
+                sum += count;
+            }
+            for (const SortEntry &entry : drawOrder)
+                sortScratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+
+            drawOrder.swap(sortScratch);
+        }
+    }
+
+    void List::sortCasters()
+    {
+        casterOrder.resize(casterList.size());
+        for (unsigned int i = 0; i < casterOrder.size(); i++)
+            casterOrder[i] = i;
+
+        // Scene graph order within a group keeps the result deterministic
+        std::sort(casterOrder.begin(), casterOrder.end(), [this](unsigned int a, unsigned int b)
+                  {
+                      const Mesh *meshA = casterList[a].mesh;
+                      const Mesh *meshB = casterList[b].mesh;
+                      if (meshA->getGeometryId() != meshB->getGeometryId())
+                          return meshA->getGeometryId() < meshB->getGeometryId();
+                      if (meshA->getCurrentLod() != meshB->getCurrentLod())
+                          return meshA->getCurrentLod() < meshB->getCurrentLod();
+                      return a < b; });
+    }
+
+    void List::updateFrustum()
+    {
+        frustumValid = true;
+        visibleMeshes = 0;
+        culledMeshes = 0;
+        traversedNodes = 0;
+
+        if (camera == nullptr)
+            return;
+
+        FrustumPlanes(camera->getProjectionMatrix() * camera->getViewMatrix(), frustumPlanes);
+    }
+
+    bool List::isInFrustum(const Mesh *mesh, const glm::mat4 &worldMatrix) const
+    {
+        if (!frustumCulling || camera == nullptr)
+            return true;
+
+        // Cheap sphere test first, the tighter box only for spheres crossing a plane
+        glm::vec4 sphere = mesh->getBoundingSphere(worldMatrix);
+        bool crossing = false;
+        for (const glm::vec4 &plane : frustumPlanes)
+        {
+            float distance = glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w;
+            if (distance < -sphere.w)
+                return false;
+            if (distance < sphere.w)
+                crossing = true;
+        }
+        if (!crossing)
+            return true;
+
+        glm::vec3 boxMin, boxMax;
+        mesh->getBoundingBox(worldMatrix, boxMin, boxMax);
+        return isBoxInFrustum(boxMin, boxMax);
+    }
+
+    bool List::isBoxInFrustum(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+    {
+        for (const glm::vec4 &plane : frustumPlanes)
+        {
+            // Corner furthest along the plane normal
+            glm::vec3 corner(plane.x >= 0.0f ? boxMax.x : boxMin.x,
+                             plane.y >= 0.0f ? boxMax.y : boxMin.y,
+                             plane.z >= 0.0f ? boxMax.z : boxMin.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
         }
+        return true;
+    }
+
+    void List::setFrustumCulling(bool enabled)
+    {
+        frustumCulling = enabled;
+    }
+
+    bool List::isFrustumCullingEnabled() const
+    {
+        return frustumCulling;
+    }
+
+    unsigned int List::getNumberOfVisibleMeshes() const
+    {
+        return visibleMeshes;
+    }
+
+    unsigned int List::getNumberOfCulledMeshes() const
+    {
+        return culledMeshes;
+    }
+
+    unsigned int List::getNumberOfTraversedNodes() const
+    {
+        return traversedNodes;
+    }
+
+    void List::setFrameStats(FrameStats *stats)
+    {
+        frameStats = stats;
+    }
+
+    void List::setJobSystem(JobSystem *jobs)
+    {
+        jobSystem = jobs;
+    }
+
+    unsigned int List::getNumberOfPassJobs() const
+    {
+        return lastPassJobs;
+    }
+
+    unsigned int List::getNumberOfShadowCasters() const
+    {
+        return shadowCasters;
+    }
+
+    unsigned int List::getNumberOfCulledShadowCasters() const
+    {
+        return culledShadowCasters;
+    }
+
+    void List::setShadowPlanes(const std::vector<glm::vec4> &planes)
+    {
+        shadowPlanes = planes;
+    }
+
+    const std::vector<glm::vec4> &List::getShadowPlanes() const
+    {
+        return shadowPlanes;
+    }
+
+    void List::setMaxShadowLights(unsigned int count)
+    {
+        maxShadowLights = count;
+    }
+
+    unsigned int List::getMaxShadowLights() const
+    {
+        return maxShadowLights;
+    }
+
+    void List::setShadowTechnique(ShadowTechnique technique)
+    {
+        shadowTechnique = technique;
+    }
+
+    List::ShadowTechnique List::getShadowTechnique() const
+    {
+        return shadowTechnique;
+    }
 
-        for (Node *child : root->getChildren())
+    ShadowMap &List::getShadowMap()
+    {
+        return shadowMap;
+    }
+
+    void List::updateLods(const glm::mat4 &viewMatrix)
+    {
+        glm::mat4 projection = camera->getProjectionMatrix();
+        bool perspective = projection[2][3] != 0.0f;
+
+        for (auto &record : meshList)
         {
-            this->pass(child, matrix);
+            Mesh *mesh = record.mesh;
+            if (mesh->getNumberOfLods() < 2)
+                continue;
+
+            glm::vec4 sphere = mesh->getBoundingSphere(record.worldMatrix);
+            float radius = sphere.w;
+
+            float coverage;
+            if (perspective)
+            {
+                float depth = -(viewMatrix * glm::vec4(glm::vec3(sphere), 1.0f)).z;
+                coverage = depth > radius ? radius * projection[1][1] / depth : 1.0f;
+            }
+            else
+            {
+                coverage = radius * projection[1][1];
+            }
+
+            mesh->setCurrentLod(selectLod(coverage, mesh->getCurrentLod(), mesh->getNumberOfLods()));
         }
     }
 
+    unsigned int List::selectLod(float coverage, unsigned int currentLod, unsigned int numberOfLods) const
+    {
+        unsigned int levels = std::min(numberOfLods, (unsigned int)lodThresholds.size() + 1);
+        unsigned int level = std::min(currentLod, levels - 1);
+
+        // Finer while clearly above the threshold that led to the current level
+        while (level > 0 && coverage > lodThresholds[level - 1] * (1.0f + lodHysteresis))
+            level--;
+
+        // Coarser while clearly below the threshold of the next level
+        while (level + 1 < levels && coverage < lodThresholds[level] * (1.0f - lodHysteresis))
+            level++;
+
+        return level;
+    }
+
+    void List::setLodThresholds(const std::vector<float> &thresholds)
+    {
+        lodThresholds = thresholds;
+    }
+
+    const std::vector<float> &List::getLodThresholds() const
+    {
+        return lodThresholds;
+    }
+
+    void List::setLodHysteresis(float hysteresis)
+    {
+        lodHysteresis = hysteresis;
+    }
+
+    float List::getLodHysteresis() const
+    {
+        return lodHysteresis;
+    }
+
     void List::setCamera(Eng::Camera *camera)
     {
         if (camera == nullptr)
@@ -171,6 +1062,7 @@ namespace Eng
         }
 
         this->camera = camera;
+        frustumValid = false;
 
         glMatrixMode(GL_PROJECTION);
         glLoadMatrixf(glm::value_ptr(this->camera->getProjectionMatrix()));
@@ -178,9 +1070,10 @@ namespace Eng
 
     void List::clear()
     {
-        list.clear();
         meshList.clear();
+        casterList.clear();
         lightList.clear();
+        frustumValid = false;
     }
 
 }; // end of namespace Eng::
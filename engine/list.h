@@ -16,6 +16,17 @@
  */
 class ENG_API List : public Eng::Object
 {
+public:
+    /**
+     * @brief Ways of drawing shadows, to pick the cheaper one for a scene.
+     */
+    enum class ShadowTechnique : int
+    {
+        NONE = 0,       ///< No shadows.
+        PLANAR,         ///< Casters flattened onto the shadow planes (see \c setShadowPlanes).
+        SHADOW_MAP,     ///< Depth maps rendered from the lights (see \c getShadowMap); omni lights keep planar shadows.
+    };
+
 private:
     /**
      * @brief Structure representing a single instance of a scene object for the list.
@@ -30,16 +41,385 @@ private:
         glm::mat4 nodeWorldMatrix;
     };
 
-    /** @brief The general list of all scene objects considered for processing. */
-    std::list<Instance> list;
-    /** @brief A sub-list containing only light sources for easy access during shading. */
-    std::list<Instance> lightList;
-    /** @brief A sub-list containing only renderable meshes. */
-    std::list<Instance> meshList;
+    /**
+     * @brief Compact record of one mesh to draw in the current frame.
+     */
+    struct DrawRecord
+    {
+        /** @brief The mesh to draw. */
+        Eng::Mesh* mesh;
+        /** @brief The material of the mesh, read once per frame. */
+        Eng::Material* material;
+        /** @brief The mesh's world coordinate matrix. */
+        glm::mat4 worldMatrix;
+        /** @brief Key the records are drawn in, lowest first (see \c makeSortKey). */
+        unsigned long long sortKey;
+    };
+
+    /**
+     * @brief Light sources of the current frame, rendered before the meshes.
+     *
+     * The queues are cleared but never shrunk, so once they reached the size of the scene
+     * building a frame does not allocate.
+     */
+    std::vector<Instance> lightList;
+    /** @brief Renderable meshes of the current frame. */
+    std::vector<DrawRecord> meshList;
+
+    /**
+     * @brief Every mesh of the current frame, inside the view frustum or not, for the shadow passes.
+     *
+     * A caster outside the view can still shadow what is inside it, so the shadow passes cull
+     * these against the shadows or the maps instead of the camera. Empty when no shadows are drawn.
+     */
+    std::vector<DrawRecord> casterList;
+
+    /** @brief Positions in \c casterList grouped by geometry and level of detail, so copies are drawn together. */
+    std::vector<unsigned int> casterOrder;
+
+    /**
+     * @brief Fills \c casterOrder from \c casterList.
+     * @private
+     */
+    void sortCasters();
+
+    /**
+     * @brief Mesh counters of one traversal.
+     */
+    struct PassCounters
+    {
+        unsigned int visibleMeshes;  ///< Meshes accepted.
+        unsigned int culledMeshes;   ///< Meshes outside the frustum.
+        unsigned int traversedNodes; ///< Nodes visited.
+    };
+
+    /**
+     * @brief Part of a parallel pass: a node visited alone or a whole subtree, with its own queues.
+     */
+    struct PassSegment
+    {
+        /** @brief The node, or the root of the subtree. */
+        Eng::Node* node;
+        /** @brief Whether the descendants of \c node belong to this segment. */
+        bool subtree;
+        /** @brief Lights found by the segment. */
+        std::vector<Instance> lights;
+        /** @brief Meshes accepted by the segment. */
+        std::vector<DrawRecord> meshes;
+        /** @brief Shadow casters found by the segment. */
+        std::vector<DrawRecord> casters;
+        /** @brief Counters of the segment. */
+        PassCounters counters;
+    };
+
+    /**
+     * @brief Number of nodes the graph passed to \c pass must hold for a parallel pass.
+     *
+     * An estimate of where the jobs start to pay for waking the workers, not a measured break-even point.
+     */
+    static constexpr unsigned int PARALLEL_PASS_NODES = 512;
+
+    /** @brief Threads the passes are split across, \c nullptr for serial passes. */
+    Eng::JobSystem* jobSystem;
+
+    /**
+     * @brief Segments of the last parallel pass, in scene graph order.
+     *
+     * Only \c numberOfPassSegments are in use; the vector never shrinks, so the segment queues keep their capacity.
+     */
+    std::vector<PassSegment> passSegments;
+
+    /** @brief Number of entries of \c passSegments used by the last parallel pass. */
+    unsigned int numberOfPassSegments;
+
+    /** @brief Split of the scene graph being refined by \c passParallel (node, whole subtree). */
+    std::vector<std::pair<Eng::Node*, bool>> passSplit[2];
+
+    /** @brief Index in \c passSegments of every job of the current parallel pass. */
+    std::vector<unsigned int> passJobs;
+
+    /** @brief Matrix of the current parallel pass, read by the jobs. */
+    glm::mat4 passMatrix;
+
+    /** @brief Number of jobs the last pass was split into, 0 if it ran serially. */
+    unsigned int lastPassJobs;
+
+    /**
+     * @brief Visits a node, and optionally its subtree, adding lights and visible meshes to the given queues.
+     * @param node The node.
+     * @param matrix A transformation applied on top of every world matrix.
+     * @param recursive Whether to visit the descendants too.
+     * @param lights Receives the lights.
+     * @param meshes Receives the visible meshes.
+     * @param casters Receives every mesh when shadows are drawn.
+     * @param counters Receives the counts.
+     * @private
+     */
+    void visit(Eng::Node* node, const glm::mat4& matrix, bool recursive, std::vector<Instance>& lights, std::vector<DrawRecord>& meshes,
+               std::vector<DrawRecord>& casters, PassCounters& counters);
+
+    /**
+     * @brief Splits the traversal of a scene graph into jobs and merges their queues in scene graph order.
+     * @param root The root node.
+     * @param matrix A transformation applied on top of every world matrix.
+     * @private
+     */
+    void passParallel(Eng::Node* root, const glm::mat4& matrix);
+
+    /**
+     * @brief Job of \c passParallel: visits one subtree segment.
+     * @param context The list.
+     * @param index The index of the job in \c passJobs.
+     * @private
+     */
+    static void runPassJob(void* context, unsigned int index);
+
+    /**
+     * @brief Sort key and position in \c meshList of one draw.
+     */
+    struct SortEntry
+    {
+        /** @brief Copy of \c DrawRecord::sortKey. */
+        unsigned long long key;
+        /** @brief Index of the record in \c meshList. */
+        unsigned int index;
+    };
+
+    /** @brief Draw order of \c meshList, sorted by key every frame. */
+    std::vector<SortEntry> drawOrder;
+
+    /** @brief Scratch buffer of the radix sort. */
+    std::vector<SortEntry> sortScratch;
+
+    /**
+     * @brief Open addressing table numbering the objects met while sorting one frame.
+     *
+     * Object identifiers are global and grow without bound, so the sort key holds these small
+     * slots instead: consecutive from 1, in the order the objects are first met.
+     */
+    struct SlotTable
+    {
+        /** @brief Object identifier and slot of every entry, slot 0 marking a free entry. */
+        std::vector<std::pair<unsigned int, unsigned int>> entries;
+        /** @brief Number of slots handed out this frame. */
+        unsigned int used;
+    };
+
+    /** @brief Per-frame slots of the textures, materials and geometries in \c meshList. */
+    SlotTable textureSlots, materialSlots, geometrySlots;
+
+    /**
+     * @brief Empties a slot table, sizing it for up to \c count distinct objects.
+     * @param table The table.
+     * @param count The number of objects that may be numbered.
+     * @private
+     */
+    static void resetSlots(SlotTable& table, size_t count);
+
+    /**
+     * @brief Gets the slot of an object in this frame, handing out the next one on first use.
+     * @param table The table.
+     * @param id The object identifier.
+     * @return The slot, saturated at 0xFFF once the sort key runs out of bits.
+     * @private
+     */
+    static unsigned int getSlot(SlotTable& table, unsigned int id);
+
+    /** @brief Model-View matrices of the batch of instances being drawn. */
+    std::vector<glm::mat4> instanceMatrices;
+
+    /**
+     * @brief Computes the sort key of every mesh and radix sorts \c drawOrder.
+     * @param viewMatrix The view matrix of the active camera.
+     */
+    void sortMeshes(const glm::mat4& viewMatrix);
 
     /** @brief A pointer to the currently active camera, needed for culling and view-dependent rendering. */
     Eng::Camera* camera;
 
+    /** @brief Whether meshes outside the view frustum of the camera are left out of the lists. */
+    bool frustumCulling;
+
+    /** @brief Whether \c frustumPlanes belong to the current frame (reset by \c clear). */
+    bool frustumValid;
+
+    /** @brief World space planes (normal xyz pointing inside, distance w) of the camera frustum. */
+    glm::vec4 frustumPlanes[6];
+
+    /** @brief Number of meshes accepted by the last frame's passes. */
+    unsigned int visibleMeshes;
+
+    /** @brief Number of meshes culled by the last frame's passes. */
+    unsigned int culledMeshes;
+
+    /** @brief Number of nodes visited by the last frame's passes. */
+    unsigned int traversedNodes;
+
+    /**
+     * @brief Extracts the frustum planes from the camera matrices and resets the counters.
+     * @private
+     */
+    void updateFrustum();
+
+    /** @brief Number of projected shadows drawn in the last frame (one per light, plane and caster). */
+    unsigned int shadowCasters;
+
+    /** @brief Number of projected shadows skipped in the last frame. */
+    unsigned int culledShadowCasters;
+
+    /** @brief Planes (normal xyz, distance w) receiving the projected shadows. */
+    std::vector<glm::vec4> shadowPlanes;
+
+    /** @brief Maximum number of lights casting shadows, the first ones in the scene graph. */
+    unsigned int maxShadowLights;
+
+    /**
+     * @brief Uniform grid cell of a shadow caster.
+     */
+    struct GridEntry
+    {
+        /** @brief Packed cell coordinates of the caster's bounding sphere center. */
+        unsigned long long cell;
+        /** @brief Position of the caster in \c casterOrder. */
+        unsigned int order;
+    };
+
+    /** @brief Casters small enough for the grid, sorted by cell. */
+    std::vector<GridEntry> shadowGrid;
+
+    /** @brief Casters larger than a grid cell, tested by every light (positions in \c casterOrder). */
+    std::vector<unsigned int> largeCasters;
+
+    /** @brief World bounding spheres of the casters, by position in \c casterOrder. */
+    std::vector<glm::vec4> casterSpheres;
+
+    /** @brief Casters within the influence of the light being processed, in \c casterOrder order. */
+    std::vector<unsigned int> lightCasters;
+
+    /** @brief How shadows are drawn. */
+    ShadowTechnique shadowTechnique;
+
+    /** @brief Depth maps of the \c SHADOW_MAP technique. */
+    Eng::ShadowMap shadowMap;
+
+    /** @brief Statistics the shadow phase is timed into, \c nullptr to skip timing. */
+    Eng::FrameStats* frameStats;
+
+    /**
+     * @brief Adds a copy to the batch of geometry being drawn, drawing the batch first if the copy does not share it.
+     * @param batch The mesh of the current batch, \c nullptr if empty.
+     * @param mesh The mesh to draw.
+     * @param modelview The Model-View matrix of the copy.
+     * @private
+     */
+    void queueGeometry(Eng::Mesh*& batch, Eng::Mesh* mesh, const glm::mat4& modelview);
+
+    /**
+     * @brief Draws the batch of geometry collected by \c queueGeometry and empties it.
+     *
+     * Only shadow passes use it, and they all draw with lighting disabled.
+     * @param batch The mesh of the current batch, reset to \c nullptr.
+     * @private
+     */
+    void flushGeometry(Eng::Mesh*& batch);
+
+    /**
+     * @brief Computes the bounds the shadow maps are fitted to.
+     * @param sceneSphere Receives the world bounding sphere of the visible meshes, for the depth covered by the cascades.
+     * @param casterSphere Receives the world bounding sphere of every caster, for the depth range of the maps:
+     *        an occluder outside the view can still shadow inside it.
+     * @private
+     */
+    void getShadowBounds(glm::vec4& sceneSphere, glm::vec4& casterSphere) const;
+
+    /**
+     * @brief Prepares the shadow maps of a light.
+     * @param lightInst The light.
+     * @param viewMatrix The view matrix of the active camera.
+     * @param sceneSphere The bounds of the visible meshes.
+     * @param casterSphere The bounds of every caster.
+     * @return \c false if the light has no direction or is an omni light, which \c renderShadows covers with planar shadows.
+     * @private
+     */
+    bool setupShadowMap(const Instance& lightInst, const glm::mat4& viewMatrix, const glm::vec4& sceneSphere, const glm::vec4& casterSphere);
+
+    /**
+     * @brief Renders the depth of a map from the unculled casters that fall inside its volume, so occluders outside the view still shadow it.
+     * @param map The map index.
+     * @return \c false if the map could not be rendered.
+     * @private
+     */
+    bool renderShadowCasters(unsigned int map);
+
+    /**
+     * @brief Renders the shadow map of the first light and binds it so that the main pass is darkened where it is shadowed.
+     *
+     * Runs before the main pass, and only when the shadows take a single map: one casting light
+     * (\c setMaxShadowLights of 1, or a single light in the scene) that is not a directional light
+     * with several cascades. The meshes are then drawn once, as without shadows.
+     * @param viewMatrix The view matrix of the active camera.
+     * @return \c true if the map is bound and must be released with \c ShadowMap::endMainPass after the main pass;
+     *         \c false if \c renderShadowMaps must draw the shadows.
+     * @private
+     */
+    bool beginShadowMapPass(const glm::mat4& viewMatrix);
+
+    /**
+     * @brief Renders the depth maps of the first \c maxShadowLights lights and darkens what they shadow.
+     *
+     * Runs after the main pass, when \c beginShadowMapPass could not take the shadows: every visible
+     * mesh is drawn again, once per map, with the depth comparison of the map deciding which fragments
+     * are darkened and clip planes limiting each cascade to its depth slice.
+     * @param viewMatrix The view matrix of the active camera.
+     */
+    void renderShadowMaps(const glm::mat4& viewMatrix);
+
+    /**
+     * @brief Sorts the casters into a uniform grid, once per frame.
+     * @param cellSize The size of a grid cell.
+     * @private
+     */
+    void buildShadowGrid(float cellSize);
+
+    /**
+     * @brief Fills \c lightCasters with the casters whose bounds reach the influence sphere of a light.
+     * @param lightPosition The world position of the light.
+     * @param radius The influence radius, 0 to take every caster.
+     * @param cellSize The size of a cell of \c shadowGrid.
+     * @private
+     */
+    void gatherShadowCasters(const glm::vec3& lightPosition, float radius, float cellSize);
+
+    /**
+     * @brief Tests a world space axis aligned box against the frustum planes.
+     * @param boxMin The minimum corner of the box.
+     * @param boxMax The maximum corner of the box.
+     * @return \c false if the box is entirely outside the frustum.
+     * @private
+     */
+    bool isBoxInFrustum(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+    /**
+     * @brief Tests the bounds of a mesh against the frustum planes.
+     * @param mesh The mesh.
+     * @param worldMatrix The world matrix of the mesh.
+     * @return \c false if the mesh is entirely outside the frustum.
+     * @private
+     */
+    bool isInFrustum(const Eng::Mesh* mesh, const glm::mat4& worldMatrix) const;
+
+    /** @brief Screen coverage below which each level of detail switches to the next coarser one. */
+    std::vector<float> lodThresholds;
+
+    /** @brief Relative margin around the thresholds that a mesh must cross before its level of detail changes. */
+    float lodHysteresis;
+
+    /**
+     * @brief Selects the level of detail of every mesh in \c meshList from its projected size.
+     * @param viewMatrix The view matrix of the active camera.
+     */
+    void updateLods(const glm::mat4& viewMatrix);
+
     /**
      * @brief Creates a shadow projection matrix based on a light position and a planar surface.
      *
@@ -51,12 +431,38 @@ private:
     glm::mat4 createShadowMatrix(const glm::vec4& lightPos, const glm::vec4& planeEquation);
     
     /**
-     * @brief Renders shadows onto a specified plane using the calculated shadow matrices.
+     * @brief Tells whether the projected shadow of a mesh may be visible.
+     * @param record The draw record of the mesh.
+     * @param shadowMatrix The shadow projection matrix.
+     * @param planeEquation The plane receiving the shadow.
+     * @param lightSide The sign of the light's distance from the plane.
+     * @return \c false if the mesh lies beyond the plane or its shadow is outside the frustum,
+     * wherever the mesh itself is.
+     * @private
+     */
+    bool castsVisibleShadow(const DrawRecord& record, const glm::mat4& shadowMatrix, const glm::vec4& planeEquation, float lightSide) const;
+
+    /**
+     * @brief Projects the casters in \c lightCasters onto one plane.
      *
-     * This method iterates through the \c meshList and applies the shadow projection.
+     * Casters are drawn in the order of \c casterOrder from their buffer objects, copies of the
+     * same geometry in one batch. They come from \c casterList, so meshes outside the view still
+     * cast; only meshes beyond the plane or whose shadow falls outside the frustum are skipped.
+     * @param lightPos The position of the light source in world space (homogeneous coordinates).
      * @param planeEquation The coefficients of the plane where shadows should be drawn.
+     * @param viewMatrix The view matrix of the active camera.
+     */
+    void renderPlaneShadows(const glm::vec4& lightPos, const glm::vec4& planeEquation, const glm::mat4& viewMatrix);
+
+    /**
+     * @brief Renders the shadows of the first \c maxShadowLights lights onto every shadow plane.
+     *
+     * The render state is set once for the whole pass. Each light only projects the casters
+     * within its influence radius, found through a uniform grid built once per frame.
+     * @param viewMatrix The view matrix of the active camera.
+     * @param omniLightsOnly Skips every light but the omni ones, which the shadow maps leave out.
      */
-    void renderShadows(const glm::vec4& planeEquation);
+    void renderShadows(const glm::mat4& viewMatrix, bool omniLightsOnly = false);
 
 public:
     /**
@@ -71,8 +477,10 @@ public:
     /**
      * @brief Executes the rendering loop for all objects currently in the list.
      *
-     * This method typically iterates through the \c lightList (setting up light states)
-     * and the \c meshList (drawing the geometry).
+     * This method iterates through the \c lightList (setting up light states)
+     * and then the \c meshList (drawing the geometry), drawing consecutive instances of
+     * the same geometry and material with one \c Eng::Mesh::renderInstances call.
+     * Planar shadows are drawn before the meshes, shadow maps after them.
      * @param modelview The current modelview matrix (usually the camera's view matrix).
      */
     void render(glm::mat4 modelview = glm::mat4(1.0f)) override;
@@ -80,10 +488,20 @@ public:
     /**
      * @brief Traverses the scene graph starting from a root node and populates the internal lists.
      *
-     * This process typically involves calculating world matrices, culling non-visible objects,
-     * and categorizing objects into \c lightList and \c meshList.
+     * This process calculates world matrices, categorizes objects into \c lightList and \c meshList
+     * and, when a camera is set, leaves out meshes whose bounds are outside its view frustum.
+     * Lights are never culled, since they may light visible meshes, and when shadows are drawn
+     * every mesh is also kept as a shadow caster, since it may shadow visible ones.
+     * World matrices are taken from the nodes' caches, which are refreshed top-down during the
+     * traversal only for nodes that moved or whose ancestors moved.
+     *
+     * With a job system set (see \c setJobSystem) and a \c root whose subtree holds at least
+     * \c PARALLEL_PASS_NODES nodes (see \c Node::getSubtreeSize, so the first frame is decided
+     * like the others), the top of the graph is visited serially and the subtrees below run as
+     * parallel jobs; their queues are merged in scene graph order, so the lists are the same
+     * as with a serial pass. A subtree held by a \c TransformStore is always visited by a single thread.
      * @param root The root node of the scene graph to begin traversal.
-     * @param matrix The initial world matrix (usually identity).
+     * @param matrix A transformation applied on top of every world matrix (usually identity).
      */
     void pass(Eng::Node* root, glm::mat4 matrix);
 
@@ -95,6 +513,167 @@ public:
 
     /**
      * @brief Clears all internal lists, removing all references to nodes and instances.
+     *
+     * Their capacity is kept for the next frame.
      */
     void clear();
+
+    /**
+     * @brief Builds the 64 bit key meshes are drawn in, lowest first.
+     *
+     * From the most significant bit: pass (2 bits), transparency (1 bit), then for opaque meshes
+     * texture, material and geometry (12 bits each) and depth front to back (24 bits), so meshes
+     * sharing state are drawn together and instances of the same geometry end up adjacent; for
+     * transparent meshes depth back to front comes before the rest, as blending requires.
+     * @param pass The render pass (0 to 3).
+     * @param transparent Whether the mesh is blended.
+     * @param texture Texture slot (only the low 12 bits are used, 0 for none).
+     * @param material Material slot (only the low 12 bits are used, 0 for none).
+     * @param geometry Geometry slot of the mesh (only the low 12 bits are used).
+     * @param depth View space distance from the camera.
+     * @return The sort key.
+     */
+    static unsigned long long makeSortKey(unsigned int pass, bool transparent, unsigned int texture, unsigned int material, unsigned int geometry, float depth);
+
+    /**
+     * @brief Enables or disables view frustum culling of meshes (enabled by default).
+     * @param enabled \c false to keep every mesh in the lists.
+     */
+    void setFrustumCulling(bool enabled);
+
+    /**
+     * @brief Tells whether view frustum culling is enabled.
+     * @return \c true if meshes outside the frustum are culled.
+     */
+    bool isFrustumCullingEnabled() const;
+
+    /**
+     * @brief Gets the number of meshes inside the frustum in the last frame (kept after \c clear).
+     * @return The number of visible meshes.
+     */
+    unsigned int getNumberOfVisibleMeshes() const;
+
+    /**
+     * @brief Gets the number of meshes culled in the last frame (kept after \c clear).
+     * @return The number of culled meshes.
+     */
+    unsigned int getNumberOfCulledMeshes() const;
+
+    /**
+     * @brief Gets the number of scene graph nodes visited by the passes of the last frame (kept after \c clear).
+     * @return The number of traversed nodes.
+     */
+    unsigned int getNumberOfTraversedNodes() const;
+
+    /**
+     * @brief Sets the statistics \c render times the shadows into, as the \c SHADOWS phase.
+     * @param stats The frame statistics, \c nullptr to stop timing.
+     */
+    void setFrameStats(Eng::FrameStats* stats);
+
+    /**
+     * @brief Sets the threads \c pass splits large scene graphs across.
+     * @param jobs The job system, \c nullptr for serial passes.
+     */
+    void setJobSystem(Eng::JobSystem* jobs);
+
+    /**
+     * @brief Gets the number of jobs the last \c pass was split into.
+     * @return The number of jobs, 0 if the pass ran serially.
+     */
+    unsigned int getNumberOfPassJobs() const;
+
+    /**
+     * @brief Gets the number of planar shadows drawn in the last rendered frame.
+     *
+     * Every light, receiver plane and caster within the light's influence counts once.
+     * @return The number of shadows drawn.
+     */
+    unsigned int getNumberOfShadowCasters() const;
+
+    /**
+     * @brief Gets the number of planar shadows skipped in the last rendered frame.
+     *
+     * Only casters within the light's influence are counted, whether they are in view or not.
+     * @return The number of shadows culled.
+     */
+    unsigned int getNumberOfCulledShadowCasters() const;
+
+    /**
+     * @brief Sets the planes receiving projected shadows (the ground plane y = 0 by default).
+     * @param planes Plane equations (normal xyz, distance w); an empty list disables the shadows.
+     */
+    void setShadowPlanes(const std::vector<glm::vec4>& planes);
+
+    /**
+     * @brief Gets the planes receiving projected shadows.
+     * @return A constant reference to the plane equations.
+     */
+    const std::vector<glm::vec4>& getShadowPlanes() const;
+
+    /**
+     * @brief Picks how shadows are drawn.
+     * @param technique Planar projection shadows (the default), shadow maps or none.
+     */
+    void setShadowTechnique(ShadowTechnique technique);
+
+    /**
+     * @brief Gets how shadows are drawn.
+     * @return The current shadow technique.
+     */
+    ShadowTechnique getShadowTechnique() const;
+
+    /**
+     * @brief Gets the depth maps of the \c SHADOW_MAP technique, to set their resolution and cascades.
+     * @return A reference to the shadow maps.
+     */
+    Eng::ShadowMap& getShadowMap();
+
+    /**
+     * @brief Sets how many lights cast shadows, taken in scene graph order (1 by default).
+     * @param count The maximum number of shadow casting lights.
+     */
+    void setMaxShadowLights(unsigned int count);
+
+    /**
+     * @brief Gets how many lights cast shadows.
+     * @return The maximum number of shadow casting lights.
+     */
+    unsigned int getMaxShadowLights() const;
+
+    /**
+     * @brief Sets the screen coverage thresholds of the levels of detail.
+     *
+     * The coverage of a mesh is the height of its projected bounding sphere as a fraction of the
+     * viewport height. A mesh uses level \c i+1 once its coverage drops below \c thresholds[i].
+     * @param thresholds Decreasing coverage values, one per level transition.
+     */
+    void setLodThresholds(const std::vector<float>& thresholds);
+
+    /**
+     * @brief Gets the screen coverage thresholds of the levels of detail.
+     * @return A constant reference to the thresholds.
+     */
+    const std::vector<float>& getLodThresholds() const;
+
+    /**
+     * @brief Sets the hysteresis of the level of detail selection, to avoid flickering between levels.
+     * @param hysteresis Relative margin, e.g. 0.15 requires the coverage to be 15% past a threshold.
+     */
+    void setLodHysteresis(float hysteresis);
+
+    /**
+     * @brief Gets the hysteresis of the level of detail selection.
+     * @return The relative margin.
+     */
+    float getLodHysteresis() const;
+
+    /**
+     * @brief Picks the level of detail for a given screen coverage, starting from the level used so far.
+     * @param coverage The projected height of the mesh as a fraction of the viewport height.
+     * @param currentLod The level used in the previous frame.
+     * @param numberOfLods The number of levels available.
+     * @return The level to use.
+     */
+    unsigned int selectLod(float coverage, unsigned int currentLod, unsigned int numberOfLods) const;
 };
@@ -0,0 +1,271 @@
+/**
+ * @file    loadprofiler.cpp
+ * @brief   LoadProfiler class implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+//////////////
+// #INCLUDE //
+//////////////
+
+// Main include:
+#include "engine.h"
+
+// C/C++:
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+/////////////
+// GLOBALS //
+/////////////
+
+/** @brief Innermost running scope of the current thread. */
+static thread_local Eng::LoadProfiler::Scope* currentScope = nullptr;
+
+/////////////////////////
+// RESERVED STRUCTURES //
+/////////////////////////
+
+/**
+ * @brief LoadProfiler reserved structure.
+ */
+struct Eng::LoadProfiler::Reserved
+{
+    struct Event
+    {
+        const char* name;
+        Phase phase;
+        long long start;
+        long long duration;
+        unsigned int thread;
+    };
+
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point origin;
+    long long total;
+    bool running;
+
+    CategoryStats categories[(int)Category::COUNT];
+    long long categoryTime[(int)Category::COUNT];
+    long long phaseTime[(int)Phase::COUNT];
+
+    std::vector<Event> events;
+    std::vector<std::thread::id> threads;
+
+    Reserved() : origin(std::chrono::steady_clock::now()), total(0), running(false), categories{}, categoryTime{}, phaseTime{}
+    {
+    }
+
+    unsigned int threadIndex(std::thread::id id)
+    {
+        for (size_t t = 0; t < threads.size(); ++t)
+        {
+            if (threads[t] == id)
+                return (unsigned int)t;
+        }
+        threads.push_back(id);
+        return (unsigned int)threads.size() - 1;
+    }
+};
+
+namespace Eng
+{
+
+    ////////////////////////
+    // LoadProfiler CLASS //
+    ////////////////////////
+
+    LoadProfiler::Scope::Scope(LoadProfiler *profiler, Category category, Phase phase, const char *name)
+        : profiler(profiler),
+          category(category),
+          phase(phase),
+          name(name),
+          start(0),
+          childTime(0),
+          parent(nullptr)
+    {
+        if (profiler)
+        {
+            parent = currentScope;
+            currentScope = this;
+            start = profiler->now();
+        }
+    }
+
+    LoadProfiler::Scope::~Scope()
+    {
+        if (!profiler)
+            return;
+
+        long long duration = profiler->now() - start;
+        if (parent)
+        {
+            parent->childTime += duration;
+        }
+        currentScope = parent;
+
+        profiler->record(*this, duration, duration - childTime);
+    }
+
+    void LoadProfiler::Scope::setCategory(Category category)
+    {
+        this->category = category;
+    }
+
+    LoadProfiler::LoadProfiler() : reserved(std::make_unique<Reserved>())
+    {
+    }
+
+    LoadProfiler::~LoadProfiler()
+    {
+    }
+
+    void LoadProfiler::reset()
+    {
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+        reserved->origin = std::chrono::steady_clock::now();
+        reserved->total = 0;
+        reserved->running = true;
+        for (int c = 0; c < (int)Category::COUNT; ++c)
+        {
+            reserved->categories[c] = {};
+            reserved->categoryTime[c] = 0;
+        }
+        for (int p = 0; p < (int)Phase::COUNT; ++p)
+        {
+            reserved->phaseTime[p] = 0;
+        }
+        reserved->events.clear();
+        reserved->threads.clear();
+    }
+
+    void LoadProfiler::stop()
+    {
+        long long time = now();
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+        if (reserved->running)
+        {
+            reserved->total = time;
+            reserved->running = false;
+        }
+    }
+
+    long long LoadProfiler::now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - reserved->origin).count();
+    }
+
+    void LoadProfiler::record(const Scope &scope, long long duration, long long self)
+    {
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+        reserved->categoryTime[(int)scope.category] += self;
+        reserved->phaseTime[(int)scope.phase] += self;
+        reserved->events.push_back({scope.name, scope.phase, scope.start, duration, reserved->threadIndex(std::this_thread::get_id())});
+    }
+
+    void LoadProfiler::addChunk(Category category, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+        reserved->categories[(int)category].chunks++;
+        reserved->categories[(int)category].bytes += bytes;
+    }
+
+    LoadProfiler::CategoryStats LoadProfiler::getCategoryStats(Category category) const
+    {
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+        CategoryStats stats = reserved->categories[(int)category];
+        stats.milliseconds = reserved->categoryTime[(int)category] / 1.0e6;
+        return stats;
+    }
+
+    double LoadProfiler::getPhaseTime(Phase phase) const
+    {
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+        return reserved->phaseTime[(int)phase] / 1.0e6;
+    }
+
+    double LoadProfiler::getTotalTime() const
+    {
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+        return (reserved->running ? now() : reserved->total) / 1.0e6;
+    }
+
+    size_t LoadProfiler::getNumberOfEvents() const
+    {
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+        return reserved->events.size();
+    }
+
+    const char *LoadProfiler::getCategoryName(Category category)
+    {
+        static const char *names[] = {"OBJECT", "NODE", "MESH", "LIGHT", "MATERIAL", "TEXTURE", "OTHER"};
+        return (int)category < (int)Category::COUNT ? names[(int)category] : "?";
+    }
+
+    const char *LoadProfiler::getPhaseName(Phase phase)
+    {
+        static const char *names[] = {"IO", "PARSE", "DECODE", "TEXTURE"};
+        return (int)phase < (int)Phase::COUNT ? names[(int)phase] : "?";
+    }
+
+    void LoadProfiler::printSummary(const std::string &title) const
+    {
+        double total = getTotalTime();
+
+        std::ios_base::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision();
+        std::cout << std::fixed << std::setprecision(2);
+
+        std::cout << "[load profile] " << title << ": " << total << " ms" << std::endl;
+        std::cout << "  " << std::left << std::setw(10) << "chunk" << std::right << std::setw(10) << "count" << std::setw(14) << "bytes" << std::setw(12) << "ms" << std::endl;
+        for (int c = 0; c < (int)Category::COUNT; ++c)
+        {
+            CategoryStats stats = getCategoryStats((Category)c);
+            if (stats.chunks == 0 && stats.milliseconds == 0.0)
+                continue;
+            std::cout << "  " << std::left << std::setw(10) << getCategoryName((Category)c) << std::right << std::setw(10) << stats.chunks << std::setw(14) << stats.bytes << std::setw(12) << stats.milliseconds << std::endl;
+        }
+
+        std::cout << "  " << std::left << std::setw(10) << "phase" << std::right << std::setw(36) << "ms" << std::endl;
+        for (int p = 0; p < (int)Phase::COUNT; ++p)
+        {
+            std::cout << "  " << std::left << std::setw(10) << getPhaseName((Phase)p) << std::right << std::setw(36) << getPhaseTime((Phase)p) << std::endl;
+        }
+
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+    }
+
+    bool LoadProfiler::writeTrace(const std::string &path) const
+    {
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cerr << "ERROR: Could not write load trace " << path << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(reserved->mutex);
+
+        // Complete ("X") events, timestamps in microseconds
+        fprintf(file, "{\"traceEvents\":[\n");
+        for (size_t e = 0; e < reserved->events.size(); ++e)
+        {
+            const Reserved::Event &event = reserved->events[e];
+            fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}%s\n",
+                    event.name, getPhaseName(event.phase), event.start / 1000.0, event.duration / 1000.0, event.thread,
+                    e + 1 < reserved->events.size() ? "," : "");
+        }
+        fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+        bool written = !ferror(file);
+        fclose(file);
+        return written;
+    }
+
+}; // end of namespace Eng::
@@ -0,0 +1,214 @@
+/**
+ * @file    loadprofiler.h
+ * @brief   LoadProfiler class
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief Collects timings and byte counts while a scene file is loaded.
+ *
+ * Time is measured with nested \c Scope objects and reported as exclusive time (time spent in
+ * nested scopes is only counted once, by the innermost one), both per chunk type and per phase.
+ * Every scope is also kept as an event so the whole load can be inspected as a Chrome trace
+ * (chrome://tracing or https://ui.perfetto.dev). Scopes may be opened from any thread.
+ */
+class ENG_API LoadProfiler final
+{
+public:
+    /**
+     * @brief Chunk types reported by the profiler.
+     */
+    enum class Category : int
+    {
+        OBJECT = 0,     ///< File header chunk.
+        NODE,           ///< Plain scene graph nodes.
+        MESH,           ///< Mesh nodes and their geometry.
+        LIGHT,          ///< Light nodes.
+        MATERIAL,       ///< Materials.
+        TEXTURE,        ///< Textures referenced by materials.
+        OTHER,          ///< Chunks the loader skips.
+        COUNT,          ///< Number of categories.
+    };
+
+    /**
+     * @brief Loading phases reported by the profiler.
+     */
+    enum class Phase : int
+    {
+        IO = 0,         ///< Reading or mapping the file.
+        PARSE,          ///< Parsing chunk headers and strings, creating engine objects.
+        DECODE,         ///< Decoding packed vertex attributes.
+        TEXTURE,        ///< Loading and uploading texture images.
+        COUNT,          ///< Number of phases.
+    };
+
+    /**
+     * @brief Accumulated figures of one chunk type.
+     */
+    struct CategoryStats
+    {
+        unsigned int chunks;    ///< Number of chunks read.
+        size_t bytes;           ///< Payload bytes read.
+        double milliseconds;    ///< Exclusive time spent on them.
+    };
+
+    /**
+     * @brief Measures the time spent until it goes out of scope.
+     */
+    class ENG_API Scope final
+    {
+    public:
+        /**
+         * @brief Starts measuring.
+         * @param profiler The profiler receiving the measure, or \c nullptr to measure nothing.
+         * @param category The chunk type the time belongs to.
+         * @param phase The phase the time belongs to.
+         * @param name The event name shown in the trace (must outlive the profiler, e.g. a literal).
+         */
+        Scope(LoadProfiler* profiler, Category category, Phase phase, const char* name);
+
+        /** @brief Stops measuring and records the event. */
+        ~Scope();
+
+        /**
+         * @brief Deleted copy constructor.
+         * @param Scope const & prevents copying of a running measure.
+         */
+        Scope(Scope const&) = delete;
+
+        /**
+         * @brief Deleted assignment operator.
+         * @param Scope const & prevents assignment of a running measure.
+         */
+        void operator=(Scope const&) = delete;
+
+        /**
+         * @brief Changes the chunk type of the measure, for scopes opened before the type is known.
+         * @param category The chunk type the time belongs to.
+         */
+        void setCategory(Category category);
+
+    private:
+        friend class LoadProfiler;
+
+        /** @brief Target profiler, \c nullptr when disabled. */
+        LoadProfiler* profiler;
+        /** @brief Chunk type of the measure. */
+        Category category;
+        /** @brief Phase of the measure. */
+        Phase phase;
+        /** @brief Trace event name. */
+        const char* name;
+        /** @brief Start time in nanoseconds since the profiler was reset. */
+        long long start;
+        /** @brief Time spent in nested scopes, in nanoseconds. */
+        long long childTime;
+        /** @brief Enclosing scope on the same thread. */
+        Scope* parent;
+    };
+
+    /** @brief Constructor. */
+    LoadProfiler();
+
+    /** @brief Destructor. */
+    ~LoadProfiler();
+
+    /**
+     * @brief Clears every measure and restarts the clock; the load is timed until \c stop.
+     */
+    void reset();
+
+    /**
+     * @brief Stops the total load timer.
+     */
+    void stop();
+
+    /**
+     * @brief Counts a chunk read from the file.
+     * @param category The chunk type.
+     * @param bytes The chunk payload size.
+     */
+    void addChunk(Category category, size_t bytes);
+
+    /**
+     * @brief Gets the figures of a chunk type.
+     * @param category The chunk type.
+     * @return The accumulated \c CategoryStats.
+     */
+    CategoryStats getCategoryStats(Category category) const;
+
+    /**
+     * @brief Gets the exclusive time spent in a phase.
+     * @param phase The phase.
+     * @return The time in milliseconds.
+     */
+    double getPhaseTime(Phase phase) const;
+
+    /**
+     * @brief Gets the wall-clock time between \c reset and \c stop.
+     * @return The time in milliseconds.
+     */
+    double getTotalTime() const;
+
+    /**
+     * @brief Gets the number of recorded trace events.
+     * @return The number of events.
+     */
+    size_t getNumberOfEvents() const;
+
+    /**
+     * @brief Prints the per chunk type and per phase summary table to the standard output.
+     * @param title The title of the table (usually the scene file name).
+     */
+    void printSummary(const std::string& title) const;
+
+    /**
+     * @brief Writes the recorded events in the Chrome trace event JSON format.
+     * @param path The output file path.
+     * @return \c true if the file was written.
+     */
+    bool writeTrace(const std::string& path) const;
+
+    /**
+     * @brief Gets the display name of a chunk type.
+     * @param category The chunk type.
+     * @return A static string such as "MESH".
+     */
+    static const char* getCategoryName(Category category);
+
+    /**
+     * @brief Gets the display name of a phase.
+     * @param phase The phase.
+     * @return A static string such as "DECODE".
+     */
+    static const char* getPhaseName(Phase phase);
+
+private:
+    /**
+     * @brief Forward declaration of the internal structure holding the measures (PIMPL idiom).
+     * @internal
+     */
+    struct Reserved;
+
+    /** @brief Unique pointer to the internal measures. */
+    std::unique_ptr<Reserved> reserved;
+
+    /**
+     * @brief Gets the current time.
+     * @return Nanoseconds since the last \c reset.
+     * @private
+     */
+    long long now() const;
+
+    /**
+     * @brief Stores a finished scope.
+     * @param scope The finished scope.
+     * @param duration Its total duration in nanoseconds.
+     * @param self Its exclusive duration in nanoseconds.
+     * @private
+     */
+    void record(const Scope& scope, long long duration, long long self);
+};
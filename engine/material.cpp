@@ -28,14 +28,66 @@ namespace Eng
     {
     }
 
+    bool Material::stateCacheEnabled = false;
+    const Material *Material::currentMaterial = nullptr;
+    const Texture *Material::currentTexture = nullptr;
+    int Material::currentTextureEnabled = -1;
+    Material::StateCacheStats Material::stateCacheStats = {};
+
     Material::~Material()
     {
-        delete texture;
+        if (currentMaterial == this)
+        {
+            currentMaterial = nullptr;
+        }
+
+        // Textures may be shared with other materials
+        if (texture)
+        {
+            texture->release();
+        }
     }
 
     void Material::render(glm::mat4 modelview)
     {
-        if (texture)
+        if (stateCacheEnabled)
+        {
+            if (currentMaterial == this)
+            {
+                stateCacheStats.materialChangesSaved++;
+                return;
+            }
+            currentMaterial = this;
+            stateCacheStats.materialChanges++;
+
+            // Same texture as the previous material: neither the bind nor the toggle are needed
+            int textureEnabled = texture ? 1 : 0;
+            if (currentTextureEnabled != textureEnabled)
+            {
+                if (textureEnabled)
+                    glEnable(GL_TEXTURE_2D);
+                else
+                    glDisable(GL_TEXTURE_2D);
+                currentTextureEnabled = textureEnabled;
+                stateCacheStats.textureChanges++;
+            }
+            else
+            {
+                stateCacheStats.textureChangesSaved++;
+            }
+
+            if (texture && currentTexture != texture)
+            {
+                texture->render(modelview);
+                currentTexture = texture;
+                stateCacheStats.textureChanges++;
+            }
+            else if (texture)
+            {
+                stateCacheStats.textureChangesSaved++;
+            }
+        }
+        else if (texture)
         {
             if (!Eng::Base::getInstance().getShadowRender())
             {
@@ -56,6 +108,28 @@ namespace Eng
         glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, shininess);
     }
 
+    void Material::beginStateCache()
+    {
+        stateCacheEnabled = true;
+        currentMaterial = nullptr;
+        currentTexture = nullptr;
+        currentTextureEnabled = -1;
+        stateCacheStats = {};
+    }
+
+    void Material::endStateCache()
+    {
+        stateCacheEnabled = false;
+        currentMaterial = nullptr;
+        currentTexture = nullptr;
+        currentTextureEnabled = -1;
+    }
+
+    Material::StateCacheStats Material::getStateCacheStats()
+    {
+        return stateCacheStats;
+    }
+
     glm::vec4 Material::getEmission() const
     {
         return emission;
@@ -89,31 +163,63 @@ namespace Eng
     void Material::setEmission(const glm::vec4& emission_)
     {
         emission = emission_;
+        if (currentMaterial == this)
+        {
+            currentMaterial = nullptr;
+        }
     }
 
     void Material::setAmbient(const glm::vec4& ambient_)
     {
         ambient = ambient_;
+        if (currentMaterial == this)
+        {
+            currentMaterial = nullptr;
+        }
     }
 
     void Material::setDiffuse(const glm::vec4& diffuse_)
     {
         diffuse = diffuse_;
+        if (currentMaterial == this)
+        {
+            currentMaterial = nullptr;
+        }
     }
 
     void Material::setSpecular(const glm::vec4& specular_)
     {
         specular = specular_;
+        if (currentMaterial == this)
+        {
+            currentMaterial = nullptr;
+        }
     }
 
     void Material::setShininess(float shininess_)
     {
         shininess = shininess_;
+        if (currentMaterial == this)
+        {
+            currentMaterial = nullptr;
+        }
     }
 
     void Material::setTexture(Eng::Texture* texture_)
     {
+        if (texture_)
+        {
+            texture_->retain();
+        }
+        if (texture)
+        {
+            texture->release();
+        }
         texture = texture_;
+        if (currentMaterial == this)
+        {
+            currentMaterial = nullptr;
+        }
     }
 
 }; // end of namespace Eng::
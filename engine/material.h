@@ -34,6 +34,34 @@ class ENG_API Material : public Eng::Object
     /** @brief The exponent controlling the sharpness of specular highlights (controls reflection falloff). */
     float shininess;
 
+public:
+    /**
+     * @brief Counters of the state changes issued and skipped while the state cache is enabled.
+     */
+    struct StateCacheStats
+    {
+        unsigned int materialChanges;       ///< Materials whose colors were sent to OpenGL.
+        unsigned int materialChangesSaved;  ///< Materials skipped because they were already current.
+        unsigned int textureChanges;        ///< Texture binds and \c GL_TEXTURE_2D toggles issued.
+        unsigned int textureChangesSaved;   ///< Texture binds and toggles skipped.
+    };
+
+private:
+    /** @brief Whether \c render skips state that is already current. */
+    static bool stateCacheEnabled;
+
+    /** @brief Material whose colors are current, \c nullptr if unknown. */
+    static const Material* currentMaterial;
+
+    /** @brief Texture currently bound, \c nullptr if unknown. */
+    static const Eng::Texture* currentTexture;
+
+    /** @brief Current \c GL_TEXTURE_2D state: -1 unknown, 0 disabled, 1 enabled. */
+    static int currentTextureEnabled;
+
+    /** @brief Counters since the state cache was last enabled. */
+    static StateCacheStats stateCacheStats;
+
 public:
     /**
      * @brief Constructor for the Material class.
@@ -59,6 +87,25 @@ public:
      */
     virtual void render(glm::mat4 modelview = glm::mat4(1.0f)) override;
 
+    /**
+     * @brief Enables the state cache and clears its counters.
+     *
+     * While enabled, \c render assumes nobody else changes the material colors, the bound texture or
+     * \c GL_TEXTURE_2D, and skips what is already current. Used by \c Eng::List around the mesh draws.
+     */
+    static void beginStateCache();
+
+    /**
+     * @brief Disables the state cache; \c render sets every state again.
+     */
+    static void endStateCache();
+
+    /**
+     * @brief Gets the state change counters collected since the last \c beginStateCache.
+     * @return The \c StateCacheStats.
+     */
+    static StateCacheStats getStateCacheStats();
+
     /////////////
     // Getters //
     /////////////
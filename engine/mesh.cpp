@@ -10,6 +10,361 @@
 // Freeglut:
 #include <GL/freeglut.h>
 
+#ifndef _WIN32
+#include <GL/glx.h>
+#endif
+
+// C/C++:
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+/////////////
+// #DEFINE //
+/////////////
+
+// Buffer object and shader enums (OpenGL 1.5 and 2.0), missing from the Windows 1.1 headers:
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER 0x8B31
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+
+/** @brief First generic attribute of the per-instance Model-View matrix (uses four locations). */
+#define INSTANCE_MATRIX_ATTRIBUTE 4
+
+/////////////
+// GLOBALS //
+/////////////
+
+typedef void(APIENTRY *GenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void(APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+typedef void(APIENTRY *BufferDataProc)(GLenum target, std::ptrdiff_t size, const void *data, GLenum usage);
+typedef void(APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+
+typedef GLuint(APIENTRY *CreateShaderProc)(GLenum type);
+typedef void(APIENTRY *ShaderSourceProc)(GLuint shader, GLsizei count, const char *const *string, const GLint *length);
+typedef void(APIENTRY *CompileShaderProc)(GLuint shader);
+typedef void(APIENTRY *GetShaderivProc)(GLuint shader, GLenum name, GLint *params);
+typedef void(APIENTRY *GetShaderInfoLogProc)(GLuint shader, GLsizei size, GLsizei *length, char *log);
+typedef void(APIENTRY *DeleteShaderProc)(GLuint shader);
+typedef GLuint(APIENTRY *CreateProgramProc)(void);
+typedef void(APIENTRY *AttachShaderProc)(GLuint program, GLuint shader);
+typedef void(APIENTRY *BindAttribLocationProc)(GLuint program, GLuint index, const char *name);
+typedef void(APIENTRY *LinkProgramProc)(GLuint program);
+typedef void(APIENTRY *GetProgramivProc)(GLuint program, GLenum name, GLint *params);
+typedef void(APIENTRY *UseProgramProc)(GLuint program);
+typedef GLint(APIENTRY *GetUniformLocationProc)(GLuint program, const char *name);
+typedef void(APIENTRY *Uniform1iProc)(GLint location, GLint value);
+typedef void(APIENTRY *EnableVertexAttribArrayProc)(GLuint index);
+typedef void(APIENTRY *DisableVertexAttribArrayProc)(GLuint index);
+typedef void(APIENTRY *VertexAttribPointerProc)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+typedef void(APIENTRY *VertexAttribDivisorProc)(GLuint index, GLuint divisor);
+typedef void(APIENTRY *DrawElementsInstancedProc)(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instances);
+
+/** @brief OpenGL entry points above version 1.1, loaded at run time. */
+static struct
+{
+    GenBuffersProc genBuffers;
+    BindBufferProc bindBuffer;
+    BufferDataProc bufferData;
+    DeleteBuffersProc deleteBuffers;
+
+    CreateShaderProc createShader;
+    ShaderSourceProc shaderSource;
+    CompileShaderProc compileShader;
+    GetShaderivProc getShaderiv;
+    GetShaderInfoLogProc getShaderInfoLog;
+    DeleteShaderProc deleteShader;
+    CreateProgramProc createProgram;
+    AttachShaderProc attachShader;
+    BindAttribLocationProc bindAttribLocation;
+    LinkProgramProc linkProgram;
+    GetProgramivProc getProgramiv;
+    UseProgramProc useProgram;
+    GetUniformLocationProc getUniformLocation;
+    Uniform1iProc uniform1i;
+    EnableVertexAttribArrayProc enableVertexAttribArray;
+    DisableVertexAttribArrayProc disableVertexAttribArray;
+    VertexAttribPointerProc vertexAttribPointer;
+    VertexAttribDivisorProc vertexAttribDivisor;
+    DrawElementsInstancedProc drawElementsInstanced;
+} gl = {};
+
+/** @brief Instancing shader built for one lighting state. */
+struct InstancingProgram
+{
+    GLuint program;
+    GLint textureEnabledLocation;
+};
+
+/** @brief Instancing programs by lighting state (bit 16: lighting, two bits per light), 0 if they failed to build. */
+static std::map<unsigned int, InstancingProgram> instancingPrograms;
+
+/** @brief Buffer streaming the instance matrices. */
+static GLuint instanceMatrixBuffer = 0;
+
+/**
+ * @brief Vertex shader of the instanced draws: per-vertex lighting with the fixed pipeline equations,
+ * reading lights and material from the compatibility built-in state. \c LIGHTING and \c LIGHT_TYPES
+ * (two bits per light: 0 disabled, 1 directional, 2 point, 3 spot) are defined per program, so the
+ * light loop is specialized at compile time like the driver does for the fixed pipeline.
+ */
+static const char *instancingVertexShader = R"(
+in mat4 instanceModelView;
+
+out vec2 textureCoordinate;
+
+void main()
+{
+    vec4 position = instanceModelView * gl_Vertex;
+    gl_Position = gl_ProjectionMatrix * position;
+    textureCoordinate = gl_MultiTexCoord0.xy;
+
+#if !LIGHTING
+    gl_FrontColor = gl_Color;
+#else
+    // Cofactor matrix: the inverse transpose up to a scale, removed by the normalization
+    mat3 m = mat3(instanceModelView);
+    vec3 N = normalize(mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1])) * gl_Normal);
+
+    vec4 color = gl_FrontLightModelProduct.sceneColor;
+    for (int i = 0; i < 8; i++)
+    {
+        int type = (LIGHT_TYPES >> (2 * i)) & 3;
+        if (type == 0)
+            continue;
+
+        vec3 L, H;
+        float attenuation = 1.0;
+        if (type == 1)
+        {
+            L = normalize(gl_LightSource[i].position.xyz);
+            H = gl_LightSource[i].halfVector.xyz;
+        }
+        else
+        {
+            vec3 toLight = gl_LightSource[i].position.xyz / gl_LightSource[i].position.w - position.xyz / position.w;
+            float distance = length(toLight);
+            L = toLight / distance;
+            H = normalize(L + vec3(0.0, 0.0, 1.0));
+            attenuation = 1.0 / (gl_LightSource[i].constantAttenuation +
+                                 gl_LightSource[i].linearAttenuation * distance +
+                                 gl_LightSource[i].quadraticAttenuation * distance * distance);
+            if (type == 3)
+            {
+                float spot = dot(-L, normalize(gl_LightSource[i].spotDirection));
+                attenuation *= spot < gl_LightSource[i].spotCosCutoff ? 0.0 : pow(max(spot, 0.0), gl_LightSource[i].spotExponent);
+            }
+        }
+
+        float diffuse = max(dot(N, L), 0.0);
+        vec4 lit = gl_FrontLightProduct[i].ambient + diffuse * gl_FrontLightProduct[i].diffuse;
+        if (diffuse > 0.0)
+            lit += pow(max(dot(N, H), 0.0), gl_FrontMaterial.shininess) * gl_FrontLightProduct[i].specular;
+        color += attenuation * lit;
+    }
+    color.a = gl_FrontMaterial.diffuse.a;
+    gl_FrontColor = clamp(color, 0.0, 1.0);
+#endif
+}
+)";
+
+/** @brief Fragment shader of the instanced draws: modulates the lit color by the texture. */
+static const char *instancingFragmentShader = R"(
+uniform bool textureEnabled;
+uniform sampler2D colorTexture;
+
+in vec2 textureCoordinate;
+
+void main()
+{
+    gl_FragColor = textureEnabled ? gl_Color * texture(colorTexture, textureCoordinate) : gl_Color;
+}
+)";
+
+/**
+ * @brief Gets the address of an OpenGL entry point.
+ * @param name The function name.
+ * @return The function address, or \c nullptr if not available.
+ */
+static void *GetGLProcAddress(const char *name)
+{
+#ifdef _WIN32
+    return (void *)wglGetProcAddress(name);
+#else
+    return (void *)glXGetProcAddressARB((const GLubyte *)name);
+#endif
+}
+
+/**
+ * @brief Loads the buffer object functions once; requires a current OpenGL context.
+ * @return \c true if buffer objects are supported.
+ */
+static bool LoadBufferFunctions()
+{
+    static bool loaded = false;
+    static bool supported = false;
+    if (loaded)
+        return supported;
+
+    gl.genBuffers = (GenBuffersProc)GetGLProcAddress("glGenBuffers");
+    gl.bindBuffer = (BindBufferProc)GetGLProcAddress("glBindBuffer");
+    gl.bufferData = (BufferDataProc)GetGLProcAddress("glBufferData");
+    gl.deleteBuffers = (DeleteBuffersProc)GetGLProcAddress("glDeleteBuffers");
+
+    loaded = true;
+    supported = gl.genBuffers && gl.bindBuffer && gl.bufferData && gl.deleteBuffers;
+#if defined(DEBUG) || defined(_DEBUG)
+    if (!supported)
+        std::cout << "Buffer objects not supported, meshes are drawn in immediate mode" << std::endl;
+#endif
+    return supported;
+}
+
+/**
+ * @brief Compiles one stage of the instancing shader.
+ * @param type The shader type.
+ * @param prelude The version and defines put before the source.
+ * @param source The GLSL source.
+ * @return The shader, or 0 if it did not compile.
+ */
+static GLuint CompileShader(GLenum type, const char *prelude, const char *source)
+{
+    const char *sources[] = {prelude, source};
+    GLuint shader = gl.createShader(type);
+    gl.shaderSource(shader, 2, sources, nullptr);
+    gl.compileShader(shader);
+
+    GLint compiled = 0;
+    gl.getShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled)
+    {
+        char log[1024] = {};
+        gl.getShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << "ERROR: Instancing shader not compiled: " << log << std::endl;
+        gl.deleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+/**
+ * @brief Loads the instancing functions once; requires a current OpenGL 3.3 context
+ * (instanced arrays and GLSL 1.50 with the compatibility built-ins).
+ * @return \c true if instanced draws are supported.
+ */
+static bool LoadInstancing()
+{
+    static bool loaded = false;
+    static bool supported = false;
+    if (loaded)
+        return supported;
+    loaded = true;
+
+    int major = 0, minor = 0;
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if (!LoadBufferFunctions() || !version || sscanf(version, "%d.%d", &major, &minor) != 2 || major * 10 + minor < 33)
+        return false;
+
+    gl.createShader = (CreateShaderProc)GetGLProcAddress("glCreateShader");
+    gl.shaderSource = (ShaderSourceProc)GetGLProcAddress("glShaderSource");
+    gl.compileShader = (CompileShaderProc)GetGLProcAddress("glCompileShader");
+    gl.getShaderiv = (GetShaderivProc)GetGLProcAddress("glGetShaderiv");
+    gl.getShaderInfoLog = (GetShaderInfoLogProc)GetGLProcAddress("glGetShaderInfoLog");
+    gl.deleteShader = (DeleteShaderProc)GetGLProcAddress("glDeleteShader");
+    gl.createProgram = (CreateProgramProc)GetGLProcAddress("glCreateProgram");
+    gl.attachShader = (AttachShaderProc)GetGLProcAddress("glAttachShader");
+    gl.bindAttribLocation = (BindAttribLocationProc)GetGLProcAddress("glBindAttribLocation");
+    gl.linkProgram = (LinkProgramProc)GetGLProcAddress("glLinkProgram");
+    gl.getProgramiv = (GetProgramivProc)GetGLProcAddress("glGetProgramiv");
+    gl.useProgram = (UseProgramProc)GetGLProcAddress("glUseProgram");
+    gl.getUniformLocation = (GetUniformLocationProc)GetGLProcAddress("glGetUniformLocation");
+    gl.uniform1i = (Uniform1iProc)GetGLProcAddress("glUniform1i");
+    gl.enableVertexAttribArray = (EnableVertexAttribArrayProc)GetGLProcAddress("glEnableVertexAttribArray");
+    gl.disableVertexAttribArray = (DisableVertexAttribArrayProc)GetGLProcAddress("glDisableVertexAttribArray");
+    gl.vertexAttribPointer = (VertexAttribPointerProc)GetGLProcAddress("glVertexAttribPointer");
+    gl.vertexAttribDivisor = (VertexAttribDivisorProc)GetGLProcAddress("glVertexAttribDivisor");
+    gl.drawElementsInstanced = (DrawElementsInstancedProc)GetGLProcAddress("glDrawElementsInstanced");
+
+    if (!gl.createShader || !gl.shaderSource || !gl.compileShader || !gl.getShaderiv || !gl.getShaderInfoLog ||
+        !gl.deleteShader || !gl.createProgram || !gl.attachShader || !gl.bindAttribLocation || !gl.linkProgram ||
+        !gl.getProgramiv || !gl.useProgram || !gl.getUniformLocation || !gl.uniform1i ||
+        !gl.enableVertexAttribArray || !gl.disableVertexAttribArray || !gl.vertexAttribPointer ||
+        !gl.vertexAttribDivisor || !gl.drawElementsInstanced)
+        return false;
+
+    gl.genBuffers(1, &instanceMatrixBuffer);
+    supported = true;
+    return supported;
+}
+
+/**
+ * @brief Gets the instancing program matching a lighting state, building it on first use.
+ * @param state The lighting state, as returned by \c Mesh::getLightingState.
+ * @return The program, or \c nullptr if it could not be built.
+ */
+static const InstancingProgram *GetInstancingProgram(unsigned int state)
+{
+    auto found = instancingPrograms.find(state);
+    if (found != instancingPrograms.end())
+        return found->second.program ? &found->second : nullptr;
+
+    InstancingProgram &built = instancingPrograms[state];
+    built = {};
+
+    char prelude[96];
+    snprintf(prelude, sizeof(prelude), "#version 150 compatibility\n#define LIGHTING %u\n#define LIGHT_TYPES %u\n", state >> 16, state & 0xFFFF);
+    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, prelude, instancingVertexShader);
+    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, prelude, instancingFragmentShader);
+    if (!vertexShader || !fragmentShader)
+        return nullptr;
+
+    GLuint program = gl.createProgram();
+    gl.attachShader(program, vertexShader);
+    gl.attachShader(program, fragmentShader);
+    gl.bindAttribLocation(program, INSTANCE_MATRIX_ATTRIBUTE, "instanceModelView");
+    gl.linkProgram(program);
+    gl.deleteShader(vertexShader);
+    gl.deleteShader(fragmentShader);
+
+    GLint linked = 0;
+    gl.getProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        std::cerr << "ERROR: Instancing shader not linked" << std::endl;
+        return nullptr;
+    }
+
+    built.program = program;
+    built.textureEnabledLocation = gl.getUniformLocation(program, "textureEnabled");
+    return &built;
+}
+
 namespace Eng
 {
 
@@ -17,23 +372,107 @@ namespace Eng
     // MESH CLASS //
     /////////////////
 
+    Mesh::SharedGeometry::SharedGeometry()
+        : boundingRadius{0.0f},
+          boundingBoxMin{0.0f},
+          boundingBoxMax{0.0f},
+          boundsValid{false}
+    {
+        // Meshes are also built by the loader threads
+        static std::atomic<unsigned int> nextId{1};
+        id = nextId.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Mesh::SharedGeometry::~SharedGeometry()
+    {
+        if (!gl.deleteBuffers)
+            return;
+
+        for (VertexBuffers &buffer : buffers)
+        {
+            if (buffer.vertexBuffer)
+                gl.deleteBuffers(1, &buffer.vertexBuffer);
+            if (buffer.indexBuffer)
+                gl.deleteBuffers(1, &buffer.indexBuffer);
+        }
+    }
+
     Mesh::Mesh(const std::string &name, const glm::mat4 &matrix,
                std::vector<glm::vec3> vertexes,
                std::vector<glm::uvec3> faces,
                std::vector<glm::vec4> normals,
-               std::vector<glm::vec2> textureCoordinates)
+               std::vector<glm::vec2> textureCoordinates,
+               std::vector<glm::vec4> tangents)
         : Node(name, matrix),
-          vertexes{vertexes},
-          faces{faces},
-          normals{normals},
-          textureCoordinates{textureCoordinates},
+          shared(std::make_shared<SharedGeometry>()),
+          currentLod{0},
           material{nullptr}
     {
+        setKind(Kind::MESH);
+        shared->lods.resize(1);
+        shared->lods[0].vertexes = std::move(vertexes);
+        shared->lods[0].faces = std::move(faces);
+        shared->lods[0].normals = std::move(normals);
+        shared->lods[0].textureCoordinates = std::move(textureCoordinates);
+        shared->lods[0].tangents = std::move(tangents);
     }
 
+    Mesh::Mesh(const std::string &name, const glm::mat4 &matrix, MeshGeometry &&geometry)
+        : Node(name, matrix),
+          shared(std::make_shared<SharedGeometry>()),
+          currentLod{0},
+          material{nullptr}
+    {
+        setKind(Kind::MESH);
+        shared->lods.push_back(std::move(geometry));
+    }
+
+    Mesh::Mesh(const std::string &name, const glm::mat4 &matrix, std::shared_ptr<const void> storage, const PackedLod *lods, unsigned int numberOfLods)
+        : Node(name, matrix),
+          shared(std::make_shared<SharedGeometry>()),
+          currentLod{0},
+          material{nullptr}
+    {
+        setKind(Kind::MESH);
+        shared->lods.resize(std::max(numberOfLods, 1u));
+        shared->packed.assign(lods, lods + numberOfLods);
+        shared->unpacked.assign(numberOfLods, 0);
+        shared->packedStorage = std::move(storage);
+    }
+
+    Mesh::Mesh(const std::string &name, const glm::mat4 &matrix, std::shared_ptr<SharedGeometry> geometry)
+        : Node(name, matrix),
+          shared(std::move(geometry)),
+          currentLod{0},
+          material{nullptr}
+    {
+        setKind(Kind::MESH);
+    }
+
+    bool Mesh::vertexBuffersEnabled = true;
+    bool Mesh::instancingEnabled = false;
+    Mesh::DrawStats Mesh::drawStats = {};
+
     Mesh::~Mesh()
     {
-        // todo
+    }
+
+    Mesh *Mesh::createInstance(const std::string &name, const glm::mat4 &matrix) const
+    {
+        Mesh *instance = new Mesh(name, matrix, shared);
+        instance->currentLod = currentLod;
+        instance->material = material;
+        return instance;
+    }
+
+    bool Mesh::sharesGeometry(const Mesh *other) const
+    {
+        return other && other->shared == shared;
+    }
+
+    unsigned int Mesh::getGeometryId() const
+    {
+        return shared->id;
     }
 
     void Mesh::render(glm::mat4 modelview)
@@ -41,7 +480,7 @@ namespace Eng
 
         glLoadMatrixf(glm::value_ptr(modelview));
 
-        if (vertexes.empty())
+        if (getNumberOfVertexes(currentLod) == 0)
             return;
 
         if (material)
@@ -50,8 +489,153 @@ namespace Eng
             material->render();
         }
 
+        unsigned int numberOfFaces = getNumberOfFaces(currentLod);
+        drawStats.drawCalls++;
+        drawStats.triangles += numberOfFaces;
+
+        if (bindBuffers(currentLod))
+        {
+            glDrawElements(GL_TRIANGLES, (GLsizei)numberOfFaces * 3, GL_UNSIGNED_INT, nullptr);
+            unbindBuffers();
+            return;
+        }
+
+        drawImmediate(unpackedLod(currentLod));
+    }
+
+    unsigned int Mesh::getLightingState()
+    {
+        unsigned int state = 0;
+        if (glIsEnabled(GL_LIGHTING))
+        {
+            state = 1u << 16;
+            for (unsigned int l = 0; l < 8; l++)
+            {
+                if (!glIsEnabled(GL_LIGHT0 + l))
+                    continue;
+
+                GLfloat position[4], cutoff;
+                glGetLightfv(GL_LIGHT0 + l, GL_POSITION, position);
+                glGetLightfv(GL_LIGHT0 + l, GL_SPOT_CUTOFF, &cutoff);
+                unsigned int type = position[3] == 0.0f ? 1 : (cutoff == 180.0f ? 2 : 3);
+                state |= type << (2 * l);
+            }
+        }
+        return state;
+    }
+
+    void Mesh::renderInstances(const glm::mat4 *modelviews, unsigned int count, unsigned int lightingState)
+    {
+        if (getNumberOfVertexes(currentLod) == 0 || count == 0)
+            return;
+
+        if (material)
+        {
+            material->render();
+        }
+
+        renderGeometry(modelviews, count, lightingState);
+    }
+
+    void Mesh::renderGeometry(const glm::mat4 *modelviews, unsigned int count, unsigned int lightingState)
+    {
+        if (getNumberOfVertexes(currentLod) == 0 || count == 0)
+            return;
+
+        unsigned int numberOfFaces = getNumberOfFaces(currentLod);
+        drawStats.triangles += numberOfFaces * count;
+
+        if (!bindBuffers(currentLod))
+        {
+            const MeshGeometry &geometry = unpackedLod(currentLod);
+            drawStats.drawCalls += count;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                glLoadMatrixf(glm::value_ptr(modelviews[i]));
+                drawImmediate(geometry);
+            }
+            return;
+        }
+
+        GLsizei numberOfIndexes = (GLsizei)numberOfFaces * 3;
+        const InstancingProgram *program = nullptr;
+        if (instancingEnabled && LoadInstancing())
+            program = GetInstancingProgram(lightingState == QUERY_LIGHTING_STATE ? getLightingState() : lightingState);
+        if (!program)
+        {
+            // One draw per copy, but the buffers and the material are set once
+            drawStats.drawCalls += count;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                glLoadMatrixf(glm::value_ptr(modelviews[i]));
+                glDrawElements(GL_TRIANGLES, numberOfIndexes, GL_UNSIGNED_INT, nullptr);
+            }
+            unbindBuffers();
+            return;
+        }
+
+        gl.useProgram(program->program);
+        gl.uniform1i(program->textureEnabledLocation, glIsEnabled(GL_TEXTURE_2D));
+
+        // The matrices are streamed every frame, orphaning the previous storage
+        gl.bindBuffer(GL_ARRAY_BUFFER, instanceMatrixBuffer);
+        gl.bufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), modelviews, GL_STREAM_DRAW);
+        for (GLuint column = 0; column < 4; column++)
+        {
+            GLuint attribute = INSTANCE_MATRIX_ATTRIBUTE + column;
+            gl.enableVertexAttribArray(attribute);
+            gl.vertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (const void *)(column * sizeof(glm::vec4)));
+            gl.vertexAttribDivisor(attribute, 1);
+        }
+
+        gl.drawElementsInstanced(GL_TRIANGLES, numberOfIndexes, GL_UNSIGNED_INT, nullptr, count);
+        drawStats.drawCalls++;
+
+        for (GLuint column = 0; column < 4; column++)
+        {
+            gl.vertexAttribDivisor(INSTANCE_MATRIX_ATTRIBUTE + column, 0);
+            gl.disableVertexAttribArray(INSTANCE_MATRIX_ATTRIBUTE + column);
+        }
+        gl.useProgram(0);
+        unbindBuffers();
+    }
+
+    bool Mesh::bindBuffers(unsigned int level)
+    {
+        if (!vertexBuffersEnabled || !uploadBuffers(level))
+            return false;
+
+        const VertexBuffers &buffer = shared->buffers[level];
+        gl.bindBuffer(GL_ARRAY_BUFFER, buffer.vertexBuffer);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.indexBuffer);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glVertexPointer(3, GL_FLOAT, sizeof(PackedVertex), (const void *)offsetof(PackedVertex, position));
+        glNormalPointer(GL_FLOAT, sizeof(PackedVertex), (const void *)offsetof(PackedVertex, normal));
+        glTexCoordPointer(2, GL_FLOAT, sizeof(PackedVertex), (const void *)offsetof(PackedVertex, textureCoordinate));
+        return true;
+    }
+
+    void Mesh::unbindBuffers()
+    {
+        // Leave the fixed pipeline as immediate mode code expects it
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void Mesh::drawImmediate(const MeshGeometry &geometry)
+    {
+        const std::vector<glm::vec3> &vertexes = geometry.vertexes;
+        const std::vector<glm::vec4> &normals = geometry.normals;
+        const std::vector<glm::vec2> &textureCoordinates = geometry.textureCoordinates;
+
         glBegin(GL_TRIANGLES);
-        for (auto f : faces)
+        for (auto f : geometry.faces)
         {
             glm::vec3 normal = normals[f.x];
             glm::vec2 texture = textureCoordinates[f.x];
@@ -89,4 +673,317 @@ namespace Eng
     {
         return this->material;
     }
+
+    bool Mesh::uploadBuffers(unsigned int level)
+    {
+        if (!LoadBufferFunctions())
+            return false;
+
+        std::vector<VertexBuffers> &buffers = shared->buffers;
+        if (buffers.size() != shared->lods.size())
+            buffers.resize(shared->lods.size(), VertexBuffers{0, 0, true});
+
+        VertexBuffers &buffer = buffers[level];
+        if (buffer.vertexBuffer && !buffer.dirty)
+            return true;
+
+        // Packed levels are uploaded as loaded, the others are interleaved here
+        PackedLod source;
+        std::vector<PackedVertex> packed;
+        if (hasPackedLod(level))
+            source = shared->packed[level];
+        else
+        {
+            const MeshGeometry &geometry = shared->lods[level];
+            size_t numberOfVertexes = geometry.vertexes.size();
+            bool hasNormals = geometry.normals.size() >= numberOfVertexes;
+            bool hasTextureCoordinates = geometry.textureCoordinates.size() >= numberOfVertexes;
+
+            packed.resize(numberOfVertexes);
+            for (size_t v = 0; v < numberOfVertexes; ++v)
+            {
+                packed[v].position = geometry.vertexes[v];
+                packed[v].normal = hasNormals ? glm::vec3(geometry.normals[v]) : glm::vec3(0.0f, 0.0f, 1.0f);
+                packed[v].textureCoordinate = hasTextureCoordinates ? geometry.textureCoordinates[v] : glm::vec2(0.0f);
+            }
+            source = PackedLod{packed.data(), nullptr, geometry.faces.data(), (unsigned int)numberOfVertexes, (unsigned int)geometry.faces.size()};
+        }
+
+        if (!buffer.vertexBuffer)
+        {
+            gl.genBuffers(1, &buffer.vertexBuffer);
+            gl.genBuffers(1, &buffer.indexBuffer);
+        }
+
+        gl.bindBuffer(GL_ARRAY_BUFFER, buffer.vertexBuffer);
+        gl.bufferData(GL_ARRAY_BUFFER, source.numberOfVertexes * sizeof(PackedVertex), source.vertexes, GL_STATIC_DRAW);
+        gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // glm::uvec3 is three tightly packed GLuint, so the faces are uploaded as they are
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.indexBuffer);
+        gl.bufferData(GL_ELEMENT_ARRAY_BUFFER, source.numberOfFaces * sizeof(glm::uvec3), source.faces, GL_STATIC_DRAW);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        buffer.dirty = false;
+        return buffer.vertexBuffer != 0;
+    }
+
+    void Mesh::addLod(MeshGeometry &&geometry)
+    {
+        shared->lods.push_back(std::move(geometry));
+        if (!shared->packed.empty())
+        {
+            shared->packed.push_back(PackedLod{});
+            shared->unpacked.push_back(0);
+        }
+    }
+
+    void Mesh::setLod(unsigned int level, MeshGeometry &&geometry)
+    {
+        level = std::min(level, (unsigned int)shared->lods.size() - 1);
+        shared->lods[level] = std::move(geometry);
+
+        if (hasPackedLod(level))
+        {
+            shared->packed[level] = PackedLod{};
+
+            // Let the loader's storage go once no level points to it
+            if (std::none_of(shared->packed.begin(), shared->packed.end(), [](const PackedLod &lod) { return lod.vertexes != nullptr; }))
+            {
+                shared->packed.clear();
+                shared->unpacked.clear();
+                shared->packedStorage.reset();
+            }
+        }
+
+        if (level < shared->buffers.size())
+            shared->buffers[level].dirty = true;
+        if (level == 0)
+            invalidateBounds();
+    }
+
+    bool Mesh::isUploaded(unsigned int level) const
+    {
+        const std::vector<VertexBuffers> &buffers = shared->buffers;
+        return level < buffers.size() && buffers[level].vertexBuffer && !buffers[level].dirty;
+    }
+
+    bool Mesh::isPacked(unsigned int level) const
+    {
+        return hasPackedLod(level) && !std::atomic_ref<char>(shared->unpacked[level]).load(std::memory_order_acquire);
+    }
+
+    bool Mesh::hasPackedLod(unsigned int level) const
+    {
+        return level < shared->packed.size() && shared->packed[level].vertexes;
+    }
+
+    const MeshGeometry &Mesh::unpackedLod(unsigned int level) const
+    {
+        // Parallel passes may reach instances of the same geometry from several threads
+        SharedGeometry &geometry = *shared;
+        if (!isPacked(level))
+            return geometry.lods[level];
+
+        static std::mutex unpackMutex;
+        std::lock_guard<std::mutex> lock(unpackMutex);
+        if (geometry.unpacked[level])
+            return geometry.lods[level];
+
+        const PackedLod &packed = geometry.packed[level];
+        MeshGeometry &lod = geometry.lods[level];
+        lod.allocate(packed.numberOfVertexes, packed.numberOfFaces, packed.tangents != nullptr);
+        for (unsigned int v = 0; v < packed.numberOfVertexes; ++v)
+        {
+            lod.vertexes[v] = packed.vertexes[v].position;
+            lod.normals[v] = glm::vec4(packed.vertexes[v].normal, 0.0f);
+            lod.textureCoordinates[v] = packed.vertexes[v].textureCoordinate;
+        }
+        if (packed.tangents)
+            std::copy(packed.tangents, packed.tangents + packed.numberOfVertexes, lod.tangents.begin());
+        std::copy(packed.faces, packed.faces + packed.numberOfFaces, lod.faces.begin());
+
+        std::atomic_ref<char>(geometry.unpacked[level]).store(1, std::memory_order_release);
+        return lod;
+    }
+
+    unsigned int Mesh::getNumberOfVertexes(unsigned int level) const
+    {
+        return hasPackedLod(level) ? shared->packed[level].numberOfVertexes : (unsigned int)shared->lods[level].vertexes.size();
+    }
+
+    unsigned int Mesh::getNumberOfFaces(unsigned int level) const
+    {
+        return hasPackedLod(level) ? shared->packed[level].numberOfFaces : (unsigned int)shared->lods[level].faces.size();
+    }
+
+    void Mesh::setVertexBuffersEnabled(bool enabled)
+    {
+        vertexBuffersEnabled = enabled;
+    }
+
+    bool Mesh::areVertexBuffersEnabled()
+    {
+        return vertexBuffersEnabled;
+    }
+
+    void Mesh::setInstancingEnabled(bool enabled)
+    {
+        instancingEnabled = enabled;
+    }
+
+    bool Mesh::isInstancingEnabled()
+    {
+        return instancingEnabled;
+    }
+
+    bool Mesh::isInstancingSupported()
+    {
+        return LoadInstancing();
+    }
+
+    void Mesh::resetDrawStats()
+    {
+        drawStats = {};
+    }
+
+    Mesh::DrawStats Mesh::getDrawStats()
+    {
+        return drawStats;
+    }
+
+    unsigned int Mesh::getNumberOfLods() const
+    {
+        return (unsigned int)shared->lods.size();
+    }
+
+    const MeshGeometry &Mesh::getLod(unsigned int level) const
+    {
+        return unpackedLod(std::min(level, (unsigned int)shared->lods.size() - 1));
+    }
+
+    void Mesh::setCurrentLod(unsigned int level)
+    {
+        currentLod = std::min(level, (unsigned int)shared->lods.size() - 1);
+    }
+
+    unsigned int Mesh::getCurrentLod() const
+    {
+        return currentLod;
+    }
+
+    void Mesh::setBounds(float radius, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        shared->boundingRadius = radius;
+        shared->boundingBoxMin = boxMin;
+        shared->boundingBoxMax = boxMax;
+        shared->boundsValid = true;
+    }
+
+    void Mesh::invalidateBounds()
+    {
+        shared->boundsValid = false;
+    }
+
+    void Mesh::updateBounds() const
+    {
+        // Parallel passes may reach instances of the same geometry from several threads
+        SharedGeometry &bounds = *shared;
+        if (std::atomic_ref<bool>(bounds.boundsValid).load(std::memory_order_acquire))
+            return;
+
+        static std::mutex boundsMutex;
+        std::lock_guard<std::mutex> lock(boundsMutex);
+        if (bounds.boundsValid)
+            return;
+
+        const std::vector<glm::vec3> &vertexes = unpackedLod(0).vertexes;
+        bounds.boundingBoxMin = vertexes.empty() ? glm::vec3(0.0f) : vertexes[0];
+        bounds.boundingBoxMax = bounds.boundingBoxMin;
+
+        // Sphere around the local origin, as in OVO files
+        float radiusSquared = 0.0f;
+        for (const glm::vec3 &vertex : vertexes)
+        {
+            bounds.boundingBoxMin = glm::min(bounds.boundingBoxMin, vertex);
+            bounds.boundingBoxMax = glm::max(bounds.boundingBoxMax, vertex);
+            radiusSquared = std::max(radiusSquared, glm::dot(vertex, vertex));
+        }
+        bounds.boundingRadius = std::sqrt(radiusSquared);
+        std::atomic_ref<bool>(bounds.boundsValid).store(true, std::memory_order_release);
+    }
+
+    float Mesh::getBoundingRadius() const
+    {
+        updateBounds();
+        return shared->boundingRadius;
+    }
+
+    glm::vec3 Mesh::getBoundingBoxMin() const
+    {
+        updateBounds();
+        return shared->boundingBoxMin;
+    }
+
+    glm::vec3 Mesh::getBoundingBoxMax() const
+    {
+        updateBounds();
+        return shared->boundingBoxMax;
+    }
+
+    glm::vec4 Mesh::getBoundingSphere(const glm::mat4 &matrix) const
+    {
+        updateBounds();
+
+        glm::mat3 basis(matrix);
+        float scale = std::max(glm::length(basis[0]), std::max(glm::length(basis[1]), glm::length(basis[2])));
+        return glm::vec4(glm::vec3(matrix[3]), shared->boundingRadius * scale);
+    }
+
+    void Mesh::getBoundingBox(const glm::mat4 &matrix, glm::vec3 &boxMin, glm::vec3 &boxMax) const
+    {
+        updateBounds();
+
+        // Transform centre and extents instead of the eight corners
+        glm::vec3 center = (shared->boundingBoxMin + shared->boundingBoxMax) * 0.5f;
+        glm::vec3 extents = (shared->boundingBoxMax - shared->boundingBoxMin) * 0.5f;
+
+        glm::vec3 worldCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+        glm::vec3 worldExtents = glm::abs(glm::vec3(matrix[0])) * extents.x +
+                                 glm::abs(glm::vec3(matrix[1])) * extents.y +
+                                 glm::abs(glm::vec3(matrix[2])) * extents.z;
+
+        boxMin = worldCenter - worldExtents;
+        boxMax = worldCenter + worldExtents;
+    }
+
+    const std::vector<glm::vec3> &Mesh::getVertexes() const
+    {
+        return unpackedLod(0).vertexes;
+    }
+
+    const std::vector<glm::uvec3> &Mesh::getFaces() const
+    {
+        return unpackedLod(0).faces;
+    }
+
+    const std::vector<glm::vec4> &Mesh::getNormals() const
+    {
+        return unpackedLod(0).normals;
+    }
+
+    const std::vector<glm::vec2> &Mesh::getTextureCoordinates() const
+    {
+        return unpackedLod(0).textureCoordinates;
+    }
+
+    const std::vector<glm::vec4> &Mesh::getTangents() const
+    {
+        return unpackedLod(0).tangents;
+    }
+
+    const MeshGeometry &Mesh::getGeometry() const
+    {
+        return unpackedLod(0);
+    }
 }; // end of namespace Eng::
\ No newline at end of file
@@ -16,19 +16,178 @@
   */
 class ENG_API Mesh : public Eng::Node
 {
+public:
+    /**
+     * @brief Counters of the draws issued by every mesh since the last \c resetDrawStats.
+     */
+    struct DrawStats
+    {
+        unsigned int drawCalls; ///< Draw calls, an instanced draw counting once.
+        unsigned int triangles; ///< Triangles submitted, every copy counting.
+    };
+
+    /**
+     * @brief Interleaved vertex layout of the vertex buffers (32 bytes).
+     *
+     * Loaders storing vertexes in this layout (\c Eng::OvoCache) hand them to the mesh as they are,
+     * so they are uploaded without being repacked.
+     */
+    struct PackedVertex
+    {
+        glm::vec3 position;             ///< Vertex position.
+        glm::vec3 normal;               ///< Vertex normal.
+        glm::vec2 textureCoordinate;    ///< Texture coordinates.
+    };
+
+    /**
+     * @brief One level of detail already in the layout of the buffer objects, owned by the loader's storage.
+     */
+    struct PackedLod
+    {
+        const PackedVertex* vertexes;   ///< Interleaved vertexes.
+        const glm::vec4* tangents;      ///< Vertex tangents, not part of the vertex buffers (may be null).
+        const glm::uvec3* faces;        ///< Triangle indexes, uploaded as they are.
+        unsigned int numberOfVertexes;  ///< Number of vertexes.
+        unsigned int numberOfFaces;     ///< Number of triangles.
+    };
+
 private:
-    /** @brief Vector containing the 3D position coordinates for all vertices of the mesh. */
-    std::vector<glm::vec3> vertexes;
-    /** @brief Vector containing the indices that define the faces (triangles) of the mesh (e.g., triplets of vertex indices). */
-    std::vector<glm::uvec3> faces;
-    /** @brief Vector containing the 4D normal vectors (often w=0 or w=1 for homogeneous coordinates) for each vertex, used for lighting calculations. */
-    std::vector<glm::vec4> normals;
-    /** @brief Vector containing the 2D texture coordinates (UVs) for each vertex, used to map textures onto the mesh. */
-    std::vector<glm::vec2> textureCoordinates;
+    /**
+     * @brief OpenGL buffer objects holding one level of detail.
+     */
+    struct VertexBuffers
+    {
+        unsigned int vertexBuffer;  ///< Interleaved position, normal and texture coordinate buffer (0 if not created yet).
+        unsigned int indexBuffer;   ///< Triangle index buffer (0 if not created yet).
+        bool dirty;                 ///< Whether the geometry changed since the last upload.
+    };
+
+    /**
+     * @brief Geometry, bounds and buffer objects, shared by a mesh and every instance created from it.
+     */
+    struct SharedGeometry
+    {
+        /** @brief Geometry of every level of detail, from the full detail one (index 0) to the coarsest. */
+        std::vector<Eng::MeshGeometry> lods;
+        /** @brief Levels still in the loader's packed layout (empty, or one per level with null vertexes once replaced). */
+        std::vector<PackedLod> packed;
+        /** @brief Whether each packed level was also unpacked into \c lods. */
+        std::vector<char> unpacked;
+        /** @brief Keeps the memory the packed levels point to alive. */
+        std::shared_ptr<const void> packedStorage;
+        /** @brief Buffer objects of every level of detail, created on first render. */
+        std::vector<VertexBuffers> buffers;
+        /** @brief Radius of the bounding sphere centred on the local origin. */
+        float boundingRadius;
+        /** @brief Minimum corner of the local axis-aligned bounding box. */
+        glm::vec3 boundingBoxMin;
+        /** @brief Maximum corner of the local axis-aligned bounding box. */
+        glm::vec3 boundingBoxMax;
+        /** @brief Whether the bounds are up to date (set by a loader or computed from the vertexes). */
+        bool boundsValid;
+        /** @brief Unique identifier, used to group instances when sorting draws. */
+        unsigned int id;
+
+        /** @brief Creates an empty geometry with a new identifier. */
+        SharedGeometry();
+        /** @brief Deletes the buffer objects. */
+        ~SharedGeometry();
+    };
+
+    /** @brief The geometry drawn by this mesh, possibly shared with other instances. */
+    std::shared_ptr<SharedGeometry> shared;
+
+    /** @brief Level of detail currently rendered. */
+    unsigned int currentLod;
+
+    /**
+     * @brief Computes the bounds from the full detail vertexes if no one provided them.
+     * @private
+     */
+    void updateBounds() const;
+
+    /**
+     * @brief Tells whether a level of detail is stored in the packed layout.
+     * @param level The level.
+     * @return \c true if the level is drawn from a \c PackedLod.
+     * @private
+     */
+    bool hasPackedLod(unsigned int level) const;
+
+    /**
+     * @brief Gets the geometry of a level of detail, unpacking it first if it only exists in the packed layout.
+     * @param level The level.
+     * @return A constant reference to the \c Eng::MeshGeometry of the level.
+     * @private
+     */
+    const Eng::MeshGeometry& unpackedLod(unsigned int level) const;
+
+    /**
+     * @brief Gets the number of vertexes of a level of detail without unpacking it.
+     * @param level The level.
+     * @return The number of vertexes.
+     * @private
+     */
+    unsigned int getNumberOfVertexes(unsigned int level) const;
+
+    /**
+     * @brief Gets the number of triangles of a level of detail without unpacking it.
+     * @param level The level.
+     * @return The number of triangles.
+     * @private
+     */
+    unsigned int getNumberOfFaces(unsigned int level) const;
+
+    /** @brief Whether meshes are drawn from buffer objects when the driver supports them. */
+    static bool vertexBuffersEnabled;
+
+    /** @brief Whether \c renderInstances uses instanced draws when the driver supports them. */
+    static bool instancingEnabled;
+
+    /** @brief Counters since the last \c resetDrawStats. */
+    static DrawStats drawStats;
+
+    /**
+     * @brief Uploads a level of detail into its buffer objects if it is missing or dirty.
+     * @param level The level to upload.
+     * @return \c true if the level can be drawn from buffer objects.
+     * @private
+     */
+    bool uploadBuffers(unsigned int level);
+
+    /**
+     * @brief Binds the buffer objects of a level of detail and points the vertex arrays to them.
+     * @param level The level to bind.
+     * @return \c false if the level must be drawn in immediate mode.
+     * @private
+     */
+    bool bindBuffers(unsigned int level);
+
+    /**
+     * @brief Disables the vertex arrays and unbinds the buffer objects set by \c bindBuffers.
+     * @private
+     */
+    static void unbindBuffers();
+
+    /**
+     * @brief Draws a level of detail in immediate mode.
+     * @param geometry The geometry to draw.
+     * @private
+     */
+    static void drawImmediate(const Eng::MeshGeometry& geometry);
 
     /** @brief Pointer to the material object that defines the mesh's appearance (color, textures, shaders). */
     Eng::Material* material;
 
+    /**
+     * @brief Creates a mesh drawing an existing geometry, for \c createInstance.
+     * @param name The name of the mesh.
+     * @param matrix The local transformation matrix.
+     * @param geometry The geometry to share.
+     * @private
+     */
+    Mesh(const std::string& name, const glm::mat4& matrix, std::shared_ptr<SharedGeometry> geometry);
+
 public:
     /**
      * @brief Constructor for the Mesh class.
@@ -40,25 +199,110 @@ public:
      * @param faces The initial array of face indices.
      * @param normals The initial array of vertex normals.
      * @param textureCoordinates The initial array of texture coordinates.
+     * @param tangents The initial array of vertex tangents.
      */
     Mesh(const std::string& name = "", const glm::mat4& matrix = glm::mat4(1.0f),
         std::vector<glm::vec3> vertexes = std::vector<glm::vec3>(),
         std::vector<glm::uvec3> faces = std::vector<glm::uvec3>(),
         std::vector<glm::vec4> normals = std::vector<glm::vec4>(),
-        std::vector<glm::vec2> textureCoordinates = std::vector<glm::vec2>()
+        std::vector<glm::vec2> textureCoordinates = std::vector<glm::vec2>(),
+        std::vector<glm::vec4> tangents = std::vector<glm::vec4>()
     );
 
+    /**
+     * @brief Constructor taking ownership of already built geometry buffers, without copying them.
+     * @param name The name of the mesh (passed to Node).
+     * @param matrix The initial local transformation matrix (passed to Node).
+     * @param geometry The geometry moved into the mesh.
+     */
+    Mesh(const std::string& name, const glm::mat4& matrix, Eng::MeshGeometry&& geometry);
+
+    /**
+     * @brief Constructor drawing levels of detail already stored in the layout of the buffer objects.
+     *
+     * The levels are uploaded straight from \c storage; the vertex arrays returned by \c getLod and
+     * the other accessors are only unpacked from them the first time they are asked for.
+     * @param name The name of the mesh (passed to Node).
+     * @param matrix The initial local transformation matrix (passed to Node).
+     * @param storage The memory the levels point to, kept alive as long as the geometry.
+     * @param lods The levels of detail, from the full detail one to the coarsest.
+     * @param numberOfLods The number of levels (at least one).
+     */
+    Mesh(const std::string& name, const glm::mat4& matrix, std::shared_ptr<const void> storage, const PackedLod* lods, unsigned int numberOfLods);
+
     /** @brief Virtual destructor for the Mesh class. */
     virtual ~Mesh();
 
     /**
-     * @brief Renders the mesh geometry using the associated material and the accumulated modelview matrix.
+     * @brief Creates another mesh drawing the same geometry, e.g. to place many copies of an object.
+     *
+     * The instance shares the levels of detail, bounds and buffer objects of this mesh, so editing the
+     * geometry of one changes all of them; it starts with the same material, which can be changed.
+     * Instances sharing geometry and material are drawn together by \c Eng::List.
+     * @param name The name of the new mesh.
+     * @param matrix The local transformation matrix of the new mesh.
+     * @return The new mesh, not attached to any parent.
+     */
+    Mesh* createInstance(const std::string& name, const glm::mat4& matrix) const;
+
+    /**
+     * @brief Tells whether another mesh draws the same geometry.
+     * @param other The other mesh.
+     * @return \c true if both were created from the same geometry with \c createInstance, or were
+     *         given the same geometry by a loader (\c Eng::OvoReader, \c Eng::OvoCache).
+     */
+    bool sharesGeometry(const Mesh* other) const;
+
+    /**
+     * @brief Gets the identifier of the geometry, equal for all instances sharing it.
+     * @return The geometry identifier.
+     */
+    unsigned int getGeometryId() const;
+
+    /**
+     * @brief Renders the current level of detail using the associated material and the accumulated modelview matrix.
      *
-     * This method typically binds the material, sets up OpenGL buffers, and issues a draw call.
+     * The geometry is uploaded into buffer objects on first use and drawn with a single
+     * \c glDrawElements call; immediate mode is used when buffer objects are disabled or unsupported.
      * @param modelview The combined Model-View matrix accumulated from the scene graph.
      */
     void render(glm::mat4 modelview = glm::mat4(1.0f)) override;
 
+    /**
+     * @brief Draws the current level of detail several times with the material set once.
+     *
+     * With OpenGL 3.3 and instancing enabled the copies are drawn by a single instanced draw, reading
+     * the matrices from a buffer and lighting them in a shader that reproduces the fixed pipeline;
+     * otherwise each copy is drawn with its own \c glDrawElements call from the same bound buffers.
+     * @param modelviews The Model-View matrix of every copy.
+     * @param count The number of copies.
+     * @param lightingState The current \c getLightingState, or \c QUERY_LIGHTING_STATE to read it here.
+     */
+    void renderInstances(const glm::mat4* modelviews, unsigned int count, unsigned int lightingState = QUERY_LIGHTING_STATE);
+
+    /**
+     * @brief Draws the current level of detail several times without setting the material.
+     *
+     * Same as \c renderInstances, but colors and textures are left as the caller set them, e.g. to
+     * draw flat projected shadows of many meshes with one render state.
+     * @param modelviews The Model-View matrix of every copy.
+     * @param count The number of copies.
+     * @param lightingState The current \c getLightingState, or \c QUERY_LIGHTING_STATE to read it here.
+     */
+    void renderGeometry(const glm::mat4* modelviews, unsigned int count, unsigned int lightingState = QUERY_LIGHTING_STATE);
+
+    /** @brief Lighting state asking \c renderInstances and \c renderGeometry to read it from OpenGL. */
+    static constexpr unsigned int QUERY_LIGHTING_STATE = 0xFFFFFFFFu;
+
+    /**
+     * @brief Reads the lighting state reproduced by the instancing shader: whether lighting is on and the type of every enabled light.
+     *
+     * Reading it takes up to 25 OpenGL queries, so \c Eng::List reads it once per frame, after setting
+     * the lights, and passes it to every batch.
+     * @return The state; 0 when lighting is disabled.
+     */
+    static unsigned int getLightingState();
+
     /**
      * @brief Sets the material that controls the appearance of the mesh.
      * @param materialPtr A pointer to the Eng::Material object.
@@ -70,4 +314,180 @@ public:
      * @return A pointer to the Eng::Material object.
      */
     Eng::Material* getMaterial();
+
+    /**
+     * @brief Appends a coarser level of detail.
+     * @param geometry The geometry moved into the mesh.
+     */
+    void addLod(Eng::MeshGeometry&& geometry);
+
+    /**
+     * @brief Replaces the geometry of a level of detail; it is uploaded again on next render.
+     * @param level The level to replace, clamped to the coarsest available one.
+     * @param geometry The geometry moved into the mesh.
+     */
+    void setLod(unsigned int level, Eng::MeshGeometry&& geometry);
+
+    /**
+     * @brief Tells whether a level of detail currently lives in up to date buffer objects.
+     * @param level The level.
+     * @return \c true if the level was uploaded and has not changed since.
+     */
+    bool isUploaded(unsigned int level) const;
+
+    /**
+     * @brief Tells whether a level of detail still only exists in the packed layout it was loaded with.
+     * @param level The level.
+     * @return \c true if its vertex arrays have not been unpacked yet.
+     */
+    bool isPacked(unsigned int level) const;
+
+    /**
+     * @brief Enables or disables drawing from buffer objects for every mesh (enabled by default).
+     * @param enabled \c false to draw in immediate mode, e.g. to compare both paths.
+     */
+    static void setVertexBuffersEnabled(bool enabled);
+
+    /**
+     * @brief Tells whether meshes are drawn from buffer objects when supported.
+     * @return \c true if buffer objects are enabled.
+     */
+    static bool areVertexBuffersEnabled();
+
+    /**
+     * @brief Enables or disables instanced draws in \c renderInstances (disabled by default).
+     *
+     * The shader lighting the instances costs more per vertex than the fixed pipeline, so lit
+     * batches may draw faster one copy at a time; enable it where measures show it pays off.
+     * @param enabled \c true to draw each batch with one instanced draw, \c false to draw every copy separately.
+     */
+    static void setInstancingEnabled(bool enabled);
+
+    /**
+     * @brief Tells whether instanced draws are enabled.
+     * @return \c true if enabled.
+     */
+    static bool isInstancingEnabled();
+
+    /**
+     * @brief Tells whether the current OpenGL context can draw instances (requires a current context).
+     * @return \c true if the instancing shader is available.
+     */
+    static bool isInstancingSupported();
+
+    /** @brief Clears the draw counters. */
+    static void resetDrawStats();
+
+    /**
+     * @brief Gets the draw counters collected since the last \c resetDrawStats.
+     * @return The \c DrawStats.
+     */
+    static DrawStats getDrawStats();
+
+    /**
+     * @brief Gets the number of levels of detail (at least one).
+     * @return The number of levels of detail.
+     */
+    unsigned int getNumberOfLods() const;
+
+    /**
+     * @brief Gets the geometry of a level of detail.
+     * @param level The level, 0 being the full detail one.
+     * @return A constant reference to the \c Eng::MeshGeometry of the level.
+     */
+    const Eng::MeshGeometry& getLod(unsigned int level) const;
+
+    /**
+     * @brief Selects the level of detail drawn by \c render (usually done by \c Eng::List).
+     * @param level The level, clamped to the coarsest available one.
+     */
+    void setCurrentLod(unsigned int level);
+
+    /**
+     * @brief Gets the level of detail drawn by \c render.
+     * @return The current level.
+     */
+    unsigned int getCurrentLod() const;
+
+    /**
+     * @brief Sets precomputed bounds (e.g. read from a scene file), so they are never computed from the vertexes.
+     * @param radius Radius of the bounding sphere centred on the local origin.
+     * @param boxMin Minimum corner of the local axis-aligned bounding box.
+     * @param boxMax Maximum corner of the local axis-aligned bounding box.
+     */
+    void setBounds(float radius, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+    /**
+     * @brief Recomputes the bounds from the full detail vertexes on next use, e.g. after editing the geometry.
+     */
+    void invalidateBounds();
+
+    /**
+     * @brief Gets the radius of the bounding sphere centred on the local origin.
+     * @return The radius in local units.
+     */
+    float getBoundingRadius() const;
+
+    /**
+     * @brief Gets the minimum corner of the local axis-aligned bounding box.
+     * @return The corner in local coordinates.
+     */
+    glm::vec3 getBoundingBoxMin() const;
+
+    /**
+     * @brief Gets the maximum corner of the local axis-aligned bounding box.
+     * @return The corner in local coordinates.
+     */
+    glm::vec3 getBoundingBoxMax() const;
+
+    /**
+     * @brief Gets the bounding sphere transformed by a matrix.
+     * @param matrix The transformation, usually the world matrix of the mesh.
+     * @return The sphere centre (xyz) and radius (w), scaled by the largest axis scale of \c matrix.
+     */
+    glm::vec4 getBoundingSphere(const glm::mat4& matrix) const;
+
+    /**
+     * @brief Gets the axis-aligned box enclosing the bounding box transformed by a matrix.
+     * @param matrix The transformation, usually the world matrix of the mesh.
+     * @param boxMin Receives the minimum corner.
+     * @param boxMax Receives the maximum corner.
+     */
+    void getBoundingBox(const glm::mat4& matrix, glm::vec3& boxMin, glm::vec3& boxMax) const;
+
+    /**
+     * @brief Gets the vertex positions of the mesh.
+     * @return A constant reference to the vertex position array.
+     */
+    const std::vector<glm::vec3>& getVertexes() const;
+
+    /**
+     * @brief Gets the face indices of the mesh.
+     * @return A constant reference to the face array.
+     */
+    const std::vector<glm::uvec3>& getFaces() const;
+
+    /**
+     * @brief Gets the vertex normals of the mesh.
+     * @return A constant reference to the normal array.
+     */
+    const std::vector<glm::vec4>& getNormals() const;
+
+    /**
+     * @brief Gets the texture coordinates of the mesh.
+     * @return A constant reference to the texture coordinate array.
+     */
+    const std::vector<glm::vec2>& getTextureCoordinates() const;
+
+    /**
+     * @brief Gets the vertex tangents of the mesh (empty if the mesh was built without them).
+     * @return A constant reference to the tangent array.
+     */
+    const std::vector<glm::vec4>& getTangents() const;
+
+    /**
+     * @brief Gets all the geometry buffers of the full detail level.
+     * @return A constant reference to the \c Eng::MeshGeometry.
+     */
+    const Eng::MeshGeometry& getGeometry() const;
 };
@@ -0,0 +1,27 @@
+/**
+ * @file    meshgeometry.cpp
+ * @brief   MeshGeometry structure implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#include "engine.h"
+
+namespace Eng
+{
+
+    ////////////////////////////
+    // MeshGeometry STRUCTURE //
+    ////////////////////////////
+
+    void MeshGeometry::allocate(unsigned int numberOfVertexes, unsigned int numberOfFaces, bool withTangents)
+    {
+        // Sized construction allocates the exact capacity, nothing grows later
+        vertexes = std::vector<glm::vec3>(numberOfVertexes);
+        faces = std::vector<glm::uvec3>(numberOfFaces);
+        normals = std::vector<glm::vec4>(numberOfVertexes);
+        textureCoordinates = std::vector<glm::vec2>(numberOfVertexes);
+        tangents = std::vector<glm::vec4>(withTangents ? numberOfVertexes : 0);
+    }
+
+}; // end of namespace Eng::
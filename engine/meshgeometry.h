@@ -0,0 +1,64 @@
+/**
+ * @file    meshgeometry.h
+ * @brief   MeshGeometry structure
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief Move-only vertex and face buffers of a mesh.
+ *
+ * Loaders size the buffers once with \c allocate, fill them in place and move the whole
+ * geometry into an \c Eng::Mesh, so building a mesh never reallocates or copies vertex data.
+ */
+struct ENG_API MeshGeometry final
+{
+    /** @brief Vertex positions. */
+    std::vector<glm::vec3> vertexes;
+    /** @brief Triangle vertex indices. */
+    std::vector<glm::uvec3> faces;
+    /** @brief Vertex normals. */
+    std::vector<glm::vec4> normals;
+    /** @brief Vertex texture coordinates. */
+    std::vector<glm::vec2> textureCoordinates;
+    /** @brief Vertex tangents (xyz) and bitangent handedness sign (w); may be empty. */
+    std::vector<glm::vec4> tangents;
+
+    /** @brief Creates an empty geometry. */
+    MeshGeometry() = default;
+
+    /**
+     * @brief Move constructor; steals the buffers of \c other.
+     * @param other The geometry to move from.
+     */
+    MeshGeometry(MeshGeometry&& other) noexcept = default;
+
+    /**
+     * @brief Move assignment; steals the buffers of \c other.
+     * @param other The geometry to move from.
+     * @return A reference to this geometry.
+     */
+    MeshGeometry& operator=(MeshGeometry&& other) noexcept = default;
+
+    /**
+     * @brief Deleted copy constructor.
+     * @param MeshGeometry const & prevents accidental copies of vertex data.
+     */
+    MeshGeometry(MeshGeometry const&) = delete;
+
+    /**
+     * @brief Deleted assignment operator.
+     * @param MeshGeometry const & prevents accidental copies of vertex data.
+     */
+    MeshGeometry& operator=(MeshGeometry const&) = delete;
+
+    /**
+     * @brief Sizes every buffer to its exact final length with one allocation each.
+     * @param numberOfVertexes Number of vertexes.
+     * @param numberOfFaces Number of triangles.
+     * @param withTangents \c false to leave the tangent buffer empty.
+     */
+    void allocate(unsigned int numberOfVertexes, unsigned int numberOfFaces, bool withTangents = true);
+};
@@ -6,7 +6,93 @@
  */
 
 #include "engine.h"
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
+
+/**
+ * @brief Name to node map of a scene graph.
+ */
+struct Eng::Node::NameIndex
+{
+    /** @brief Every node of the scene graph under its name, in no particular order. */
+    std::unordered_map<std::string, std::vector<Eng::Node *>> nodes;
+
+    /**
+     * @brief Forgets a node.
+     * @param name The name the node was indexed under.
+     * @param node The node.
+     */
+    void remove(const std::string &name, Eng::Node *node)
+    {
+        auto it = nodes.find(name);
+        if (it == nodes.end())
+            return;
+
+        // Order does not matter: swap with the last one
+        std::vector<Eng::Node *> &named = it->second;
+        auto found = std::find(named.begin(), named.end(), node);
+        if (found != named.end())
+        {
+            *found = named.back();
+            named.pop_back();
+        }
+        if (named.empty())
+            nodes.erase(it);
+    }
+};
+
+/**
+ * @brief Finds the position of a node among the children of its parent.
+ * @param node The node, with a parent.
+ * @return The index of the node in the children of its parent.
+ */
+static unsigned int ChildPosition(const Eng::Node *node)
+{
+    const std::vector<Eng::Node *> &siblings = node->getParent()->getChildren();
+    for (unsigned int i = 0; i < siblings.size(); i++)
+    {
+        if (siblings[i] == node)
+            return i;
+    }
+    return (unsigned int)siblings.size();
+}
+
+/**
+ * @brief Collects the child positions leading from an ancestor down to a node.
+ * @param ancestor The ancestor.
+ * @param node The node, a descendant of \c ancestor.
+ * @param positions Receives the positions, the one below \c ancestor first.
+ */
+static void SearchPath(const Eng::Node *ancestor, const Eng::Node *node, std::vector<unsigned int> &positions)
+{
+    positions.clear();
+    for (; node != ancestor; node = node->getParent())
+        positions.push_back(ChildPosition(node));
+    std::reverse(positions.begin(), positions.end());
+}
+
+/**
+ * @brief Tells which of two matches the recursive name search meets first.
+ *
+ * At every level the search checks the direct children before descending into them in order,
+ * so a shallower match wins over the subtrees of its siblings.
+ * @param a The child positions leading to the first match.
+ * @param b The child positions leading to the second match (another node).
+ * @return \c true if \c a is found first.
+ */
+static bool SearchPrecedes(const std::vector<unsigned int> &a, const std::vector<unsigned int> &b)
+{
+    for (size_t i = 0;; i++)
+    {
+        bool aHere = i + 1 == a.size();
+        bool bHere = i + 1 == b.size();
+        if (aHere || bHere)
+            return aHere && (!bHere || a[i] < b[i]);
+        if (a[i] != b[i])
+            return a[i] < b[i];
+    }
+}
 
 namespace Eng
 {
@@ -17,8 +103,16 @@ namespace Eng
 
     Node::Node(const std::string &name, const glm::mat4 &matrix)
         : Object(name),
+          m_kind{Kind::NODE},
           m_parent{nullptr},
+          m_subtreeSize{1},
           m_matrix{matrix},
+          m_worldMatrix{matrix},
+          m_worldDirty{true},
+          m_worldVersion{0},
+          m_store{nullptr},
+          m_storeIndex{0},
+          m_nameIndex{nullptr},
           m_isMoving(false),
           anchor{nullptr}
 
@@ -26,13 +120,32 @@ namespace Eng
         m_destinationMatrix = matrix;
     }
 
+    bool Node::parentTranslationOnly = false;
+    unsigned int Node::worldRuleVersion = 0;
+
     Node::~Node()
     {
+        // The descendants deleted below find no index through this root
+        if (m_nameIndex)
+        {
+            delete m_nameIndex;
+            m_nameIndex = nullptr;
+        }
+        else if (NameIndex *index = findNameIndex())
+        {
+            index->remove(getName(), this);
+        }
+
         for (int i = 0; i < m_children.size(); i++)
         {
             delete m_children[i];
         }
 
+        if (m_store)
+        {
+            m_store->forget(m_storeIndex);
+        }
+
         m_parent = nullptr; // useless but useful for mind
     }
 
@@ -42,20 +155,108 @@ namespace Eng
 
     glm::mat4 Node::getWorldCoordinateMatrix() const
     {
+        if (m_store)
+        {
+            // The update may release a node moved out of the stored subtree
+            m_store->update();
+            if (m_store)
+            {
+                return m_store->worldMatrices[m_storeIndex];
+            }
+        }
+
+        if (!m_worldDirty && m_worldVersion == worldRuleVersion)
+        {
+            return m_worldMatrix;
+        }
+
         if (m_parent == nullptr)
         {
-            return getMatrix();
+            m_worldMatrix = m_matrix;
+        }
+        else if (parentTranslationOnly)
+        {
+            glm::vec3 parentTranslation = glm::vec3(m_parent->getWorldCoordinateMatrix()[3]);
+
+            glm::mat4 parentTranslationMatrix = glm::translate(glm::mat4(1.0f), parentTranslation);
+
+            m_worldMatrix = parentTranslationMatrix * m_matrix;
+        }
+        else
+        {
+            m_worldMatrix = m_parent->getWorldCoordinateMatrix() * m_matrix;
+        }
+        m_worldDirty = false;
+        m_worldVersion = worldRuleVersion;
+        return m_worldMatrix;
+    }
+
+    bool Node::isWorldMatrixDirty() const
+    {
+        if (m_store)
+        {
+            return m_store->layoutDirty || m_store->isWorldMatrixDirty(m_storeIndex);
+        }
+        return m_worldDirty || m_worldVersion != worldRuleVersion;
+    }
+
+    void Node::setParentTranslationOnly(bool enabled)
+    {
+        if (parentTranslationOnly != enabled)
+        {
+            parentTranslationOnly = enabled;
+            worldRuleVersion++;
+        }
+    }
+
+    bool Node::isParentTranslationOnly()
+    {
+        return parentTranslationOnly;
+    }
+
+    TransformStore *Node::getTransformStore() const
+    {
+        return m_store;
+    }
+
+    void Node::invalidateStoreLayout(const Node *other) const
+    {
+        if (m_store)
+        {
+            m_store->layoutDirty = true;
+        }
+        if (other && other->m_store)
+        {
+            other->m_store->layoutDirty = true;
+        }
+    }
+
+    void Node::markWorldDirty()
+    {
+        // The store sweep refreshes the stored descendants
+        if (m_store)
+        {
+            m_store->markDirty(m_storeIndex);
+            return;
         }
-        glm::vec3 parentTranslation = glm::vec3(m_parent->getWorldCoordinateMatrix()[3]);
 
-        glm::mat4 parentTranslationMatrix = glm::translate(glm::mat4(1.0f), parentTranslation);
+        if (m_worldDirty)
+        {
+            return;
+        }
 
-        return parentTranslationMatrix * m_matrix;
+        m_worldDirty = true;
+        for (Node *child : m_children)
+        {
+            child->markWorldDirty();
+        }
     }
 
     void Node::setParent(Node *newParent)
     {
+        invalidateStoreLayout(newParent);
         m_parent = newParent;
+        markWorldDirty();
     }
 
     bool Node::addChild(Node *child)
@@ -76,8 +277,20 @@ namespace Eng
             child->getParent()->removeChild(child);
         }
 
+        // The child was a root: its nodes move to the index of this scene graph
+        delete child->m_nameIndex;
+        child->m_nameIndex = nullptr;
+
         m_children.push_back(child);
         child->setParent(this);
+        for (Node *ancestor = this; ancestor; ancestor = ancestor->m_parent)
+        {
+            ancestor->m_subtreeSize += child->m_subtreeSize;
+        }
+        if (NameIndex *index = findNameIndex())
+        {
+            child->indexSubtree(*index);
+        }
 
         return true;
     }
@@ -89,11 +302,21 @@ namespace Eng
             return false;
         }
 
+        if (NameIndex *index = findNameIndex())
+        {
+            m_children[n]->unindexSubtree(*index);
+        }
+        invalidateStoreLayout(m_children[n]);
+
         if (m_children[n]->getParent() == this)
         {
             m_children[n]->setParent(nullptr);
         }
 
+        for (Node *ancestor = this; ancestor; ancestor = ancestor->m_parent)
+        {
+            ancestor->m_subtreeSize -= m_children[n]->m_subtreeSize;
+        }
         m_children.erase(m_children.begin() + n);
         return true;
     }
@@ -104,8 +327,7 @@ namespace Eng
         {
             if (m_children[i] == child)
             {
-                m_children.erase(m_children.begin() + i);
-                return true;
+                return removeChild((unsigned int)i);
             }
         }
         return false;
@@ -113,12 +335,22 @@ namespace Eng
 
     const glm::mat4 Node::getMatrix() const
     {
+        if (m_store)
+        {
+            return m_store->localMatrices[m_storeIndex];
+        }
         return m_matrix;
     }
 
     void Node::setMatrix(const glm::mat4& matrix)
     {
+        if (m_store)
+        {
+            m_store->setLocalMatrix(m_storeIndex, matrix);
+            return;
+        }
         m_matrix = matrix;
+        markWorldDirty();
     }
 
     void Node::resetMove()
@@ -214,31 +446,158 @@ namespace Eng
         return m_children[n];
     }
 
-    Node *Node::getChild(std::string name) const
+    Node *Node::getChild(const std::string &name) const
     {
+        NameIndex &index = getNameIndex();
+        auto it = index.nodes.find(name);
+        if (it == index.nodes.end())
+        {
+            return nullptr;
+        }
 
-        for (int i = 0; i < m_children.size(); i++)
+        // Queries on the root see the whole graph, others only the nodes below them
+        bool root = m_parent == nullptr;
+        Node *found = nullptr;
+        std::vector<unsigned int> foundPath, path;
+        for (Node *node : it->second)
         {
+            if (node == this)
+            {
+                continue;
+            }
+            if (!root)
+            {
+                const Node *ancestor = node->m_parent;
+                while (ancestor && ancestor != this)
+                    ancestor = ancestor->m_parent;
+                if (ancestor == nullptr)
+                    continue;
+            }
 
-            if (m_children[i]->getName() == name)
+            // Duplicate names: the match the recursive search would meet first
+            if (found == nullptr)
+            {
+                found = node;
+                continue;
+            }
+            if (foundPath.empty())
+            {
+                SearchPath(this, found, foundPath);
+            }
+            SearchPath(this, node, path);
+            if (SearchPrecedes(path, foundPath))
             {
-                return m_children[i];
+                found = node;
+                foundPath.swap(path);
             }
         }
+        return found;
+    }
 
-        for (int i = 0; i < m_children.size(); i++)
+    Node *Node::getChildByPath(const std::string &path) const
+    {
+        NameIndex &index = getNameIndex();
+        const Node *current = this;
+        size_t start = 0;
+        while (start < path.size())
         {
-            Node *rec = m_children[i]->getChild(name);
-            if (rec != nullptr)
+            size_t end = std::min(path.find('/', start), path.size());
+            if (end > start)
             {
-                return rec;
+                auto it = index.nodes.find(path.substr(start, end - start));
+                if (it == index.nodes.end())
+                {
+                    return nullptr;
+                }
+
+                // Only direct children of the previous node; the first one if the name repeats
+                Node *next = nullptr;
+                for (Node *node : it->second)
+                {
+                    if (node->m_parent == current && (next == nullptr || ChildPosition(node) < ChildPosition(next)))
+                        next = node;
+                }
+                if (next == nullptr)
+                {
+                    return nullptr;
+                }
+                current = next;
             }
+            start = end + 1;
+        }
+        return current == this ? nullptr : const_cast<Node *>(current);
+    }
+
+    std::string Node::getPath() const
+    {
+        if (m_parent == nullptr)
+        {
+            return "";
+        }
+
+        std::string path = getName();
+        for (const Node *node = m_parent; node->m_parent; node = node->m_parent)
+        {
+            path = node->getName() + "/" + path;
+        }
+        return path;
+    }
+
+    void Node::setName(const std::string &newName)
+    {
+        NameIndex *index = findNameIndex();
+        if (index)
+        {
+            index->remove(getName(), this);
+        }
+        Object::setName(newName);
+        if (index)
+        {
+            index->nodes[newName].push_back(this);
+        }
+    }
+
+    Node::NameIndex &Node::getNameIndex() const
+    {
+        const Node *root = this;
+        while (root->m_parent)
+            root = root->m_parent;
+
+        if (root->m_nameIndex == nullptr)
+        {
+            root->m_nameIndex = new NameIndex();
+            const_cast<Node *>(root)->indexSubtree(*root->m_nameIndex);
         }
+        return *root->m_nameIndex;
+    }
 
-        return nullptr;
+    Node::NameIndex *Node::findNameIndex() const
+    {
+        const Node *root = this;
+        while (root->m_parent)
+            root = root->m_parent;
+        return root->m_nameIndex;
     }
 
-    std::vector<Node *> Node::getChildren() const
+    void Node::indexSubtree(NameIndex &index)
+    {
+        index.nodes[getName()].push_back(this);
+        for (Node *child : m_children)
+        {
+            child->indexSubtree(index);
+        }
+    }
+
+    void Node::unindexSubtree(NameIndex &index)
+    {
+        index.remove(getName(), this);
+        for (Node *child : m_children)
+        {
+            child->unindexSubtree(index);
+        }
+    }
+
+    const std::vector<Node *> &Node::getChildren() const
     {
         return m_children;
     }
@@ -248,4 +607,9 @@ namespace Eng
         return m_children.size();
     }
 
+    unsigned int Node::getSubtreeSize() const
+    {
+        return m_subtreeSize;
+    }
+
 }; // end of namespace Eng::
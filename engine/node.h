@@ -7,6 +7,8 @@
 
 #pragma once
 
+class TransformStore;
+
  /**
   * @brief Represents a single element in the hierarchical Scene Graph.
   *
@@ -17,15 +19,115 @@
   */
 class ENG_API Node : public Eng::Object
 {
+public:
+    /**
+     * @brief Concrete type of a node, set by the constructors so hot loops can dispatch without \c dynamic_cast.
+     *
+     * Light and camera kinds are contiguous, see \c isLight and \c isCamera. Classes derived outside
+     * the engine keep the kind of their engine base class.
+     */
+    enum class Kind : unsigned char
+    {
+        NODE,               ///< Plain \c Eng::Node (or a class without a kind of its own).
+        MESH,               ///< \c Eng::Mesh.
+        LIGHT,              ///< \c Eng::Light subclass without a kind of its own.
+        OMNI_LIGHT,         ///< \c Eng::OmniLight.
+        SPOT_LIGHT,         ///< \c Eng::SpotLight.
+        INFINITE_LIGHT,     ///< \c Eng::InfiniteLight.
+        CAMERA,             ///< \c Eng::Camera subclass without a kind of its own.
+        PERSPECTIVE_CAMERA, ///< \c Eng::PerspectiveCamera.
+        ORTHO_CAMERA        ///< \c Eng::OrthoCamera.
+    };
+
+private:
+    /** @brief Concrete type of the node. */
+    Kind m_kind;
+
     /** @brief Pointer to the parent node in the scene graph. Null if this is the root node. */
     Eng::Node* m_parent;
 
     /** @brief A collection of child nodes, establishing the hierarchy. */
     std::vector<Eng::Node*> m_children;
 
+    /** @brief Number of nodes in the subtree of this node, itself included; kept up to date by \c addChild and \c removeChild. */
+    unsigned int m_subtreeSize;
+
     /** @brief Local transformation matrix (position, rotation, scale) relative to the parent node. */
     glm::mat4 m_matrix;
 
+    /** @brief Cached world transformation, valid while \c m_worldDirty is \c false. */
+    mutable glm::mat4 m_worldMatrix;
+
+    /** @brief Whether the node or one of its ancestors changed since \c m_worldMatrix was computed. */
+    mutable bool m_worldDirty;
+
+    /** @brief Value of \c worldRuleVersion when \c m_worldMatrix was computed. */
+    mutable unsigned int m_worldVersion;
+
+    /** @brief Whether parents only contribute their translation to the world matrix of their children. */
+    static bool parentTranslationOnly;
+
+    /** @brief Incremented when \c parentTranslationOnly changes, so every cached world matrix goes out of date. */
+    static unsigned int worldRuleVersion;
+
+    /**
+     * @brief Invalidates the cached world matrix of the node and of its whole subtree.
+     *
+     * A dirty node only has dirty descendants, so the walk stops at the first node already dirty.
+     */
+    void markWorldDirty();
+
+    /** @brief Store holding the transforms of this node, \c nullptr for a standalone node. */
+    Eng::TransformStore* m_store;
+
+    /** @brief Index of this node in \c m_store. */
+    unsigned int m_storeIndex;
+
+    /**
+     * @brief Flags the layout of the store holding this node or its new parent as out of date.
+     * @param other A node whose store must be flagged too, may be \c nullptr.
+     */
+    void invalidateStoreLayout(const Node* other) const;
+
+    friend class Eng::TransformStore;
+
+    /**
+     * @brief Name to node map of a whole scene graph, owned by its root (defined in node.cpp).
+     * @internal
+     */
+    struct NameIndex;
+
+    /** @brief Index of the scene graph this node is the root of, built by the first name query. */
+    mutable NameIndex* m_nameIndex;
+
+    /**
+     * @brief Gets the index of the scene graph holding this node, building it if needed.
+     * @return The index of the root.
+     * @private
+     */
+    NameIndex& getNameIndex() const;
+
+    /**
+     * @brief Gets the index of the scene graph holding this node, if one was built.
+     * @return The index of the root, \c nullptr if none was built.
+     * @private
+     */
+    NameIndex* findNameIndex() const;
+
+    /**
+     * @brief Adds this node and its subtree to an index.
+     * @param index The index.
+     * @private
+     */
+    void indexSubtree(NameIndex& index);
+
+    /**
+     * @brief Removes this node and its subtree from an index.
+     * @param index The index.
+     * @private
+     */
+    void unindexSubtree(NameIndex& index);
+
     ////////////////
     // Animations //
     ////////////////
@@ -96,11 +198,38 @@ public:
     bool addChild(Node* child);
 
     /**
-     * @brief Searches for a direct child node by its name.
-     * @param name The name of the child node to find.
-     * @return A pointer to the matching child Node, or \c nullptr if not found.
+     * @brief Searches the subtree for a node by its name.
+     *
+     * Direct children are preferred, then the subtrees of the children in order, recursively.
+     * Names are looked up in an index of the whole scene graph, built by the first query and kept
+     * up to date by \c addChild, \c removeChild and \c setName, so only duplicate names cost more
+     * than a hash lookup.
+     * @param name The name of the node to find.
+     * @return A pointer to the matching Node, or \c nullptr if not found.
+     */
+    Eng::Node* getChild(const std::string& name) const;
+
+    /**
+     * @brief Finds a descendant by the names of the nodes leading to it, such as \c "Table/Stick1/Disk3".
+     *
+     * Every name matches a direct child of the node matched by the previous one (the first child
+     * in order if several share it); empty names are skipped.
+     * @param path The names, separated by \c '/'.
+     * @return A pointer to the node, or \c nullptr if a name does not match or the path is empty.
+     */
+    Eng::Node* getChildByPath(const std::string& path) const;
+
+    /**
+     * @brief Gets the path of the node from the root of its scene graph, as \c getChildByPath reads it.
+     * @return The names below the root separated by \c '/', empty for the root.
      */
-    Eng::Node* getChild(std::string name) const;
+    std::string getPath() const;
+
+    /**
+     * @brief Renames the node, keeping the name index of its scene graph up to date.
+     * @param newName The new name.
+     */
+    void setName(const std::string& newName) override;
 
     /**
      * @brief Retrieves a direct child node by its index in the children vector.
@@ -111,9 +240,9 @@ public:
 
     /**
      * @brief Gets a list of all direct children of this node.
-     * @return A vector of pointers to all child nodes.
+     * @return A constant reference to the vector of pointers to all child nodes.
      */
-    std::vector<Eng::Node*> getChildren() const;
+    const std::vector<Eng::Node*>& getChildren() const;
 
     /**
      * @brief Gets the total number of direct child nodes.
@@ -121,6 +250,12 @@ public:
      */
     unsigned int getNumberOfChildren() const;
 
+    /**
+     * @brief Gets the number of nodes in the subtree of this node, without visiting it.
+     * @return The count of descendants plus one.
+     */
+    unsigned int getSubtreeSize() const;
+
     /**
      * @brief Removes a child node at a specific index.
      * @param n The index of the child to remove.
@@ -129,7 +264,7 @@ public:
     bool removeChild(unsigned int n);
 
     /**
-     * @brief Removes a specific child node by pointer reference.
+     * @brief Removes a specific child node by pointer reference; the child becomes a root.
      * @param child A pointer to the child Node to remove.
      * @return \c true if the child was found and removed, \c false otherwise.
      */
@@ -191,8 +326,66 @@ public:
     /**
      * @brief Calculates and retrieves the node's final world coordinate transformation matrix.
      *
-     * This involves recursively concatenating the local matrix with all parent matrices up to the root.
+     * The world matrix is the parent's world matrix times the local matrix. It is cached and only
+     * recomputed after \c setMatrix or a reparenting changed the node or one of its ancestors, so
+     * repeated queries are O(1) and a top-down traversal computes each node once.
      * @return The world transformation matrix (\c glm::mat4).
      */
     glm::mat4 getWorldCoordinateMatrix() const;
+
+    /**
+     * @brief Tells whether the world matrix must be recomputed on the next \c getWorldCoordinateMatrix.
+     * @return \c true if the cached world matrix is out of date.
+     */
+    bool isWorldMatrixDirty() const;
+
+    /**
+     * @brief Compatibility switch: parents only pass their translation on to their children (disabled by default).
+     *
+     * Before the full parent transform was used, the rotation and scale of the parents were dropped;
+     * scenes built around that can enable this. Every cached world matrix is invalidated on a change.
+     * @param enabled \c true for translation only parents.
+     */
+    static void setParentTranslationOnly(bool enabled);
+
+    /**
+     * @brief Tells whether parents only pass their translation on to their children.
+     * @return \c true if the compatibility behaviour is enabled.
+     */
+    static bool isParentTranslationOnly();
+
+    /**
+     * @brief Gets the flattened store holding the transforms of this node.
+     * @return The store, \c nullptr if the node keeps its own matrices.
+     */
+    Eng::TransformStore* getTransformStore() const;
+
+    // -------------------------------------------------------------------------
+    // NODE KIND
+    // -------------------------------------------------------------------------
+
+    /**
+     * @brief Gets the concrete type of the node; a matching kind makes a \c static_cast to that class safe.
+     * @return The kind.
+     */
+    Kind getKind() const { return m_kind; }
+
+    /**
+     * @brief Tells whether the node is a light (\c Eng::Light or a subclass).
+     * @return \c true for every light kind.
+     */
+    bool isLight() const { return m_kind >= Kind::LIGHT && m_kind <= Kind::INFINITE_LIGHT; }
+
+    /**
+     * @brief Tells whether the node is a camera (\c Eng::Camera or a subclass).
+     * @return \c true for every camera kind.
+     */
+    bool isCamera() const { return m_kind >= Kind::CAMERA && m_kind <= Kind::ORTHO_CAMERA; }
+
+protected:
+    /**
+     * @brief Sets the kind of the node; called by the constructors of the derived classes.
+     * @param kind The kind.
+     */
+    void setKind(Kind kind) { m_kind = kind; }
 };
\ No newline at end of file
@@ -79,5 +79,5 @@ public:
      * @brief Sets a new name for the object.
      * @param newName The new string name for the object.
      */
-    void setName(const std::string& newName);
+    virtual void setName(const std::string& newName);
 };
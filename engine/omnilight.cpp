@@ -20,6 +20,7 @@ namespace Eng
     OmniLight::OmniLight(std::string name, glm::mat4 matrix)
         : Light(name, matrix), cutoff(180.0f)
     {
+        setKind(Kind::OMNI_LIGHT);
     }
 
     OmniLight::~OmniLight()
@@ -18,6 +18,7 @@ namespace Eng
                              const glm::mat4 &matrix)
         : Camera(name, matrix)
     {
+        setKind(Kind::ORTHO_CAMERA);
     }
 
     OrthoCamera::~OrthoCamera()
@@ -0,0 +1,572 @@
+/**
+ * @file    ovocache.cpp
+ * @brief   OvoCache class implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+//////////////
+// #INCLUDE //
+//////////////
+
+// Main include:
+#include "engine.h"
+
+// C/C++:
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <typeinfo>
+
+////////////
+// LAYOUT //
+////////////
+
+// File layout: header | materials | nodes | lods | strings | vertexes | tangents | indexes
+// Every section starts on a 16 byte boundary. Vertexes and indexes are stored as the vertex and
+// index buffers of Eng::Mesh expect them, so meshes upload them without repacking.
+
+static_assert(sizeof(Eng::Mesh::PackedVertex) == 32, "Vertex records must match the vertex buffer layout");
+static_assert(sizeof(glm::uvec3) == 3 * sizeof(uint32_t), "Indexes are drawn as GL_UNSIGNED_INT");
+
+/** @brief "OVOC" */
+#define OVOC_MAGIC 0x434F564F
+/** @brief Marks a missing string or material. */
+#define OVOC_NONE 0xFFFFFFFF
+
+struct CacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t fileSize;
+    uint32_t materialCount;
+    uint32_t nodeCount;
+    uint32_t lodCount;
+    uint32_t reserved;
+    uint64_t materialOffset;
+    uint64_t nodeOffset;
+    uint64_t lodOffset;
+    uint64_t stringOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t tangentOffset;
+};
+
+struct CacheMaterial
+{
+    uint32_t name;
+    uint32_t textureName;
+    uint32_t texturePath;
+    float shininess;
+    glm::vec4 emission;
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+};
+
+enum class CacheNodeKind : uint32_t
+{
+    NODE = 0,
+    MESH,
+    OMNI_LIGHT,
+    INFINITE_LIGHT,
+    SPOT_LIGHT,
+};
+
+struct CacheNode
+{
+    CacheNodeKind kind;
+    uint32_t name;
+    uint32_t numberOfChildren;
+    uint32_t material;
+    glm::mat4 matrix;
+    uint32_t firstLod;
+    uint32_t numberOfLods;
+    float cutoff;
+    float radius;
+    glm::vec4 boxMin;
+    glm::vec4 boxMax;
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+};
+
+struct CacheLod
+{
+    uint64_t firstVertex;
+    uint64_t firstFace;
+    uint32_t numberOfVertexes;
+    uint32_t numberOfFaces;
+};
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+    return (offset + 15) & ~(uint64_t)15;
+}
+
+static uint32_t AddString(std::string& strings, const std::string& value)
+{
+    uint32_t offset = (uint32_t)strings.size();
+    strings.append(value);
+    strings.push_back('\0');
+    return offset;
+}
+
+static bool FlattenNode(Eng::Node* node, std::vector<CacheNode>& nodes, std::vector<Eng::Material*>& materials, std::vector<CacheLod>& lods,
+                        std::map<unsigned int, uint32_t>& geometries, std::string& strings, std::vector<Eng::Mesh::PackedVertex>& vertexes,
+                        std::vector<glm::vec4>& tangents, std::vector<glm::uvec3>& faces)
+{
+    CacheNode record = {};
+    record.name = AddString(strings, node->getName());
+    record.numberOfChildren = node->getNumberOfChildren();
+    record.material = OVOC_NONE;
+    record.matrix = node->getMatrix();
+
+    if (Eng::Mesh* mesh = dynamic_cast<Eng::Mesh*>(node))
+    {
+        record.kind = CacheNodeKind::MESH;
+
+        if (Eng::Material* material = mesh->getMaterial())
+        {
+            auto it = std::find(materials.begin(), materials.end(), material);
+            record.material = (uint32_t)(it - materials.begin());
+            if (it == materials.end())
+                materials.push_back(material);
+        }
+
+        record.radius = mesh->getBoundingRadius();
+        record.boxMin = glm::vec4(mesh->getBoundingBoxMin(), 0.0f);
+        record.boxMax = glm::vec4(mesh->getBoundingBoxMax(), 0.0f);
+        record.numberOfLods = mesh->getNumberOfLods();
+
+        // Instances of a geometry already written point to its LODs
+        auto written = geometries.emplace(mesh->getGeometryId(), (uint32_t)lods.size());
+        record.firstLod = written.first->second;
+
+        for (unsigned int l = 0; written.second && l < mesh->getNumberOfLods(); ++l)
+        {
+            const Eng::MeshGeometry& geometry = mesh->getLod(l);
+
+            CacheLod lod;
+            lod.firstVertex = vertexes.size();
+            lod.numberOfVertexes = (uint32_t)geometry.vertexes.size();
+            for (size_t v = 0; v < geometry.vertexes.size(); ++v)
+            {
+                // Meshes built in code may lack some attributes: filled in as Eng::Mesh does when uploading them
+                Eng::Mesh::PackedVertex vertex;
+                vertex.position = geometry.vertexes[v];
+                vertex.normal = v < geometry.normals.size() ? glm::vec3(geometry.normals[v]) : glm::vec3(0.0f, 0.0f, 1.0f);
+                vertex.textureCoordinate = v < geometry.textureCoordinates.size() ? geometry.textureCoordinates[v] : glm::vec2(0.0f);
+                vertexes.push_back(vertex);
+                tangents.push_back(v < geometry.tangents.size() ? geometry.tangents[v] : glm::vec4(0.0f));
+            }
+
+            lod.firstFace = faces.size();
+            lod.numberOfFaces = (uint32_t)geometry.faces.size();
+            faces.insert(faces.end(), geometry.faces.begin(), geometry.faces.end());
+            lods.push_back(lod);
+        }
+    }
+    else if (Eng::Light* light = dynamic_cast<Eng::Light*>(node))
+    {
+        if (Eng::SpotLight* spotLight = dynamic_cast<Eng::SpotLight*>(light))
+        {
+            record.kind = CacheNodeKind::SPOT_LIGHT;
+            record.cutoff = spotLight->getCutoff();
+        }
+        else if (dynamic_cast<Eng::OmniLight*>(light))
+            record.kind = CacheNodeKind::OMNI_LIGHT;
+        else if (dynamic_cast<Eng::InfiniteLight*>(light))
+            record.kind = CacheNodeKind::INFINITE_LIGHT;
+        else
+            return false;
+
+        record.ambient = light->getAmbient();
+        record.diffuse = light->getDiffuse();
+        record.specular = light->getSpecular();
+        record.radius = light->getInfluenceRadius();
+    }
+    else if (typeid(*node) == typeid(Eng::Node))
+    {
+        record.kind = CacheNodeKind::NODE;
+    }
+    else
+    {
+        // Cameras and user types are not part of OVO scenes
+        return false;
+    }
+
+    nodes.push_back(record);
+
+    for (unsigned int i = 0; i < node->getNumberOfChildren(); ++i)
+    {
+        if (!FlattenNode(node->getChild(i), nodes, materials, lods, geometries, strings, vertexes, tangents, faces))
+            return false;
+    }
+    return true;
+}
+
+struct CacheView
+{
+    const CacheHeader* header;
+    const CacheNode* nodes;
+    const CacheLod* lods;
+    const char* strings;
+    const Eng::Mesh::PackedVertex* vertexes;
+    const glm::vec4* tangents;
+    const glm::uvec3* faces;
+    std::shared_ptr<const char[]> storage;
+    std::vector<Eng::Material*> materials;
+    std::map<uint32_t, Eng::Mesh*> geometries;
+};
+
+static Eng::Node* BuildNode(CacheView& view, uint32_t& index)
+{
+    const CacheNode& record = view.nodes[index++];
+    std::string name(view.strings + record.name);
+
+    Eng::Node* node;
+    switch (record.kind)
+    {
+    case CacheNodeKind::MESH:
+    {
+        // Meshes pointing to the same LODs share their geometry, as they did when the cache was written
+        auto shared = view.geometries.find(record.firstLod);
+        if (record.numberOfLods && shared != view.geometries.end() && shared->second->getNumberOfLods() == record.numberOfLods)
+        {
+            Eng::Mesh* mesh = shared->second->createInstance(name, record.matrix);
+            mesh->setMaterial(record.material != OVOC_NONE ? view.materials[record.material] : nullptr);
+            node = mesh;
+            break;
+        }
+
+        // The LODs point into the loaded file, which the mesh keeps alive
+        std::vector<Eng::Mesh::PackedLod> lods(record.numberOfLods);
+        for (uint32_t l = 0; l < record.numberOfLods; ++l)
+        {
+            const CacheLod& lod = view.lods[record.firstLod + l];
+            lods[l].vertexes = view.vertexes + lod.firstVertex;
+            lods[l].tangents = view.tangents + lod.firstVertex;
+            lods[l].faces = view.faces + lod.firstFace;
+            lods[l].numberOfVertexes = lod.numberOfVertexes;
+            lods[l].numberOfFaces = lod.numberOfFaces;
+        }
+        Eng::Mesh* mesh = new Eng::Mesh(name, record.matrix, view.storage, lods.data(), record.numberOfLods);
+
+        mesh->setBounds(record.radius, glm::vec3(record.boxMin), glm::vec3(record.boxMax));
+        if (record.material != OVOC_NONE)
+            mesh->setMaterial(view.materials[record.material]);
+        if (record.numberOfLods)
+            view.geometries.emplace(record.firstLod, mesh);
+        node = mesh;
+        break;
+    }
+    case CacheNodeKind::OMNI_LIGHT:
+    case CacheNodeKind::INFINITE_LIGHT:
+    case CacheNodeKind::SPOT_LIGHT:
+    {
+        Eng::Light* light;
+        if (record.kind == CacheNodeKind::OMNI_LIGHT)
+            light = new Eng::OmniLight(name, record.matrix);
+        else if (record.kind == CacheNodeKind::INFINITE_LIGHT)
+            light = new Eng::InfiniteLight(name, record.matrix);
+        else
+            light = new Eng::SpotLight(name, record.matrix, record.cutoff);
+
+        light->setAmbient(record.ambient);
+        light->setDiffuse(record.diffuse);
+        light->setSpecular(record.specular);
+        light->setInfluenceRadius(record.radius);
+        node = light;
+        break;
+    }
+    default:
+        node = new Eng::Node(name, record.matrix);
+        break;
+    }
+
+    for (uint32_t i = 0; i < record.numberOfChildren; ++i)
+        node->addChild(BuildNode(view, index));
+
+    return node;
+}
+
+namespace Eng
+{
+
+    ////////////////////
+    // OvoCache CLASS //
+    ////////////////////
+
+    std::string OvoCache::getCachePath(const std::string &sourcePath)
+    {
+        return sourcePath + "c";
+    }
+
+    bool OvoCache::getSourceStamp(const std::string &sourcePath, unsigned long long &size, long long &time)
+    {
+        std::error_code error;
+        size = std::filesystem::file_size(sourcePath, error);
+        if (error)
+            return false;
+
+        auto writeTime = std::filesystem::last_write_time(sourcePath, error);
+        if (error)
+            return false;
+
+        time = (long long)writeTime.time_since_epoch().count();
+        return true;
+    }
+
+    Node *OvoCache::load(const std::string &sourcePath)
+    {
+        unsigned long long sourceSize;
+        long long sourceTime;
+        if (!getSourceStamp(sourcePath, sourceSize, sourceTime))
+            return nullptr;
+
+        std::string cachePath = getCachePath(sourcePath);
+        std::error_code error;
+        uint64_t fileSize = std::filesystem::file_size(cachePath, error);
+        if (error || fileSize < sizeof(CacheHeader))
+            return nullptr;
+
+        FILE *file = fopen(cachePath.c_str(), "rb");
+        if (!file)
+            return nullptr;
+
+        // One read for the whole scene (new[] storage is suitably aligned for the tables), shared by the meshes drawing from it
+        std::shared_ptr<char[]> data(new char[fileSize]);
+        size_t read = fread(data.get(), 1, fileSize, file);
+        fclose(file);
+        if (read != fileSize)
+            return nullptr;
+
+        // Validate before creating anything:
+        const CacheHeader *header = reinterpret_cast<const CacheHeader *>(data.get());
+        if (header->magic != OVOC_MAGIC || header->version != VERSION || header->fileSize != fileSize)
+            return nullptr;
+
+        if (header->sourceSize != sourceSize || header->sourceTime != sourceTime)
+        {
+#if defined(DEBUG) || defined(_DEBUG)
+            std::cout << "Scene cache " << cachePath << " is out of date" << std::endl;
+#endif
+            return nullptr;
+        }
+
+        if (header->nodeCount == 0 ||
+            header->materialOffset + (uint64_t)header->materialCount * sizeof(CacheMaterial) > header->nodeOffset ||
+            header->nodeOffset + (uint64_t)header->nodeCount * sizeof(CacheNode) > header->lodOffset ||
+            header->lodOffset + (uint64_t)header->lodCount * sizeof(CacheLod) > header->stringOffset ||
+            header->stringOffset >= header->vertexOffset || header->vertexOffset > header->tangentOffset ||
+            header->tangentOffset > header->indexOffset || header->indexOffset > fileSize || data[header->vertexOffset - 1] != '\0')
+        {
+            std::cerr << "ERROR: Corrupted scene cache " << cachePath << std::endl;
+            return nullptr;
+        }
+
+        // Pointer fix-up:
+        CacheView view;
+        view.header = header;
+        view.nodes = reinterpret_cast<const CacheNode *>(data.get() + header->nodeOffset);
+        view.lods = reinterpret_cast<const CacheLod *>(data.get() + header->lodOffset);
+        view.strings = data.get() + header->stringOffset;
+        view.vertexes = reinterpret_cast<const Mesh::PackedVertex *>(data.get() + header->vertexOffset);
+        view.tangents = reinterpret_cast<const glm::vec4 *>(data.get() + header->tangentOffset);
+        view.faces = reinterpret_cast<const glm::uvec3 *>(data.get() + header->indexOffset);
+        view.storage = data;
+        const CacheMaterial *materials = reinterpret_cast<const CacheMaterial *>(data.get() + header->materialOffset);
+
+        uint64_t stringSize = header->vertexOffset - header->stringOffset;
+        uint64_t vertexCount = std::min((header->tangentOffset - header->vertexOffset) / sizeof(Mesh::PackedVertex),
+                                        (header->indexOffset - header->tangentOffset) / sizeof(glm::vec4));
+        uint64_t faceCount = (fileSize - header->indexOffset) / sizeof(glm::uvec3);
+
+        for (uint32_t l = 0; l < header->lodCount; ++l)
+        {
+            const CacheLod &lod = view.lods[l];
+            if (lod.firstVertex + lod.numberOfVertexes > vertexCount || lod.firstFace + lod.numberOfFaces > faceCount)
+            {
+                std::cerr << "ERROR: Corrupted scene cache " << cachePath << std::endl;
+                return nullptr;
+            }
+
+            // Indexes go straight to glDrawElements: every one must name a vertex of its LOD
+            unsigned int largestIndex = 0;
+            const glm::uvec3 *faces = view.faces + lod.firstFace;
+            for (uint32_t f = 0; f < lod.numberOfFaces; ++f)
+                largestIndex = std::max(largestIndex, std::max(faces[f].x, std::max(faces[f].y, faces[f].z)));
+            if (lod.numberOfFaces && largestIndex >= lod.numberOfVertexes)
+            {
+                std::cerr << "ERROR: Corrupted scene cache " << cachePath << std::endl;
+                return nullptr;
+            }
+        }
+
+        uint64_t pending = 1;
+        for (uint32_t n = 0; n < header->nodeCount; ++n)
+        {
+            const CacheNode &record = view.nodes[n];
+            if (pending == 0 || record.name >= stringSize ||
+                (record.kind == CacheNodeKind::MESH && ((uint64_t)record.firstLod + record.numberOfLods > header->lodCount ||
+                                                        (record.material != OVOC_NONE && record.material >= header->materialCount))))
+            {
+                std::cerr << "ERROR: Corrupted scene cache " << cachePath << std::endl;
+                return nullptr;
+            }
+            pending = pending - 1 + record.numberOfChildren;
+        }
+        if (pending != 0)
+        {
+            std::cerr << "ERROR: Corrupted scene cache " << cachePath << std::endl;
+            return nullptr;
+        }
+        for (uint32_t m = 0; m < header->materialCount; ++m)
+        {
+            const CacheMaterial &record = materials[m];
+            if (record.name >= stringSize ||
+                (record.texturePath != OVOC_NONE && (record.texturePath >= stringSize || record.textureName >= stringSize)))
+            {
+                std::cerr << "ERROR: Corrupted scene cache " << cachePath << std::endl;
+                return nullptr;
+            }
+        }
+
+        for (uint32_t m = 0; m < header->materialCount; ++m)
+        {
+            const CacheMaterial &record = materials[m];
+            Material *material = new Material(std::string(view.strings + record.name), record.emission, record.ambient, record.diffuse, record.specular, record.shininess);
+            if (record.texturePath != OVOC_NONE)
+            {
+                Texture *texture = TextureCache::getInstance().acquire(std::string(view.strings + record.textureName), std::string(view.strings + record.texturePath));
+                material->setTexture(texture);
+                texture->release();
+            }
+            view.materials.push_back(material);
+        }
+
+        uint32_t index = 0;
+        Node *root = BuildNode(view, index);
+
+#if defined(DEBUG) || defined(_DEBUG)
+        std::cout << "Loaded " << header->nodeCount << " nodes from scene cache " << cachePath << std::endl;
+#endif
+        return root;
+    }
+
+    bool OvoCache::save(const std::string &sourcePath, Node *root)
+    {
+        if (!root)
+            return false;
+
+        unsigned long long sourceSize;
+        long long sourceTime;
+        if (!getSourceStamp(sourcePath, sourceSize, sourceTime))
+            return false;
+
+        std::vector<CacheNode> nodes;
+        std::vector<Material *> materials;
+        std::vector<CacheLod> lods;
+        std::map<unsigned int, uint32_t> geometries;
+        std::string strings;
+        std::vector<Mesh::PackedVertex> vertexes;
+        std::vector<glm::vec4> tangents;
+        std::vector<glm::uvec3> faces;
+
+        if (!FlattenNode(root, nodes, materials, lods, geometries, strings, vertexes, tangents, faces))
+        {
+#if defined(DEBUG) || defined(_DEBUG)
+            std::cout << "Scene contains nodes that can't be cached" << std::endl;
+#endif
+            return false;
+        }
+
+        std::vector<CacheMaterial> materialTable;
+        for (Material *material : materials)
+        {
+            CacheMaterial record = {};
+            record.name = AddString(strings, material->getName());
+            record.textureName = OVOC_NONE;
+            record.texturePath = OVOC_NONE;
+            record.shininess = material->getShininess();
+            record.emission = material->getEmission();
+            record.ambient = material->getAmbient();
+            record.diffuse = material->getDiffuse();
+            record.specular = material->getSpecular();
+
+            Texture *texture = material->getTexture();
+            if (texture && !texture->getFilePath().empty())
+            {
+                record.textureName = AddString(strings, texture->getName());
+                record.texturePath = AddString(strings, texture->getFilePath());
+            }
+            materialTable.push_back(record);
+        }
+
+        CacheHeader header = {};
+        header.magic = OVOC_MAGIC;
+        header.version = VERSION;
+        header.sourceSize = sourceSize;
+        header.sourceTime = sourceTime;
+        header.materialCount = (uint32_t)materialTable.size();
+        header.nodeCount = (uint32_t)nodes.size();
+        header.lodCount = (uint32_t)lods.size();
+        header.materialOffset = AlignOffset(sizeof(CacheHeader));
+        header.nodeOffset = AlignOffset(header.materialOffset + materialTable.size() * sizeof(CacheMaterial));
+        header.lodOffset = AlignOffset(header.nodeOffset + nodes.size() * sizeof(CacheNode));
+        header.stringOffset = AlignOffset(header.lodOffset + lods.size() * sizeof(CacheLod));
+        header.vertexOffset = AlignOffset(header.stringOffset + strings.size());
+        header.tangentOffset = AlignOffset(header.vertexOffset + vertexes.size() * sizeof(Mesh::PackedVertex));
+        header.indexOffset = AlignOffset(header.tangentOffset + tangents.size() * sizeof(glm::vec4));
+        header.fileSize = header.indexOffset + faces.size() * sizeof(glm::uvec3);
+
+        // Write next to the final file and swap it in, so a crash never leaves a half-written cache
+        std::string cachePath = getCachePath(sourcePath);
+        std::string tempPath = cachePath + ".tmp";
+        FILE *file = fopen(tempPath.c_str(), "wb");
+        if (!file)
+            return false;
+
+        const char padding[16] = {};
+        uint64_t position = 0;
+        auto write = [&](uint64_t offset, const void *bytes, size_t size)
+        {
+            fwrite(padding, 1, offset - position, file);
+            fwrite(bytes, 1, size, file);
+            position = offset + size;
+        };
+
+        write(0, &header, sizeof(CacheHeader));
+        write(header.materialOffset, materialTable.data(), materialTable.size() * sizeof(CacheMaterial));
+        write(header.nodeOffset, nodes.data(), nodes.size() * sizeof(CacheNode));
+        write(header.lodOffset, lods.data(), lods.size() * sizeof(CacheLod));
+        write(header.stringOffset, strings.data(), strings.size());
+        write(header.vertexOffset, vertexes.data(), vertexes.size() * sizeof(Mesh::PackedVertex));
+        write(header.tangentOffset, tangents.data(), tangents.size() * sizeof(glm::vec4));
+        write(header.indexOffset, faces.data(), faces.size() * sizeof(glm::uvec3));
+
+        bool written = !ferror(file);
+        fclose(file);
+
+        std::error_code error;
+        if (written)
+            std::filesystem::rename(tempPath, cachePath, error);
+        if (!written || error)
+        {
+            std::cerr << "ERROR: Could not write scene cache " << cachePath << std::endl;
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+
+#if defined(DEBUG) || defined(_DEBUG)
+        std::cout << "Wrote scene cache " << cachePath << " (" << header.fileSize << " bytes)" << std::endl;
+#endif
+        return true;
+    }
+
+}; // end of namespace Eng::
@@ -0,0 +1,63 @@
+/**
+ * @file    ovocache.h
+ * @brief   OvoCache class
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief Binary scene cache (.ovoc) written next to an OVO file after its first load.
+ *
+ * The cache stores the scene already decoded: a flattened pre-order node table, the material table,
+ * vertexes in the \c Eng::Mesh::PackedVertex layout and 32-bit index buffers. Loading it is a single
+ * file read followed by an offset-to-pointer fix-up: meshes upload their buffer objects straight from
+ * the loaded file and only unpack vertex arrays if asked for them. Normals are stored as three
+ * components, so their unused \c w is read back as 0. A cache is only used while the size and the
+ * modification time of its source file match the ones recorded when it was written.
+ */
+class ENG_API OvoCache final
+{
+public:
+    /** @brief Format version, bumped whenever the on-disk layout changes. */
+    static constexpr unsigned int VERSION = 5;
+
+    /**
+     * @brief Gets the path of the cache file associated with a scene file.
+     * @param sourcePath The path of the .ovo scene file.
+     * @return The path of the matching .ovoc file.
+     */
+    static std::string getCachePath(const std::string& sourcePath);
+
+    /**
+     * @brief Loads a scene from the cache of the given scene file.
+     *
+     * Meshes that shared their geometry when the cache was saved share it again; the geometry is
+     * stored only once.
+     * @param sourcePath The path of the .ovo scene file.
+     * @return The root \c Eng::Node of the scene, or \c nullptr if there is no valid, up-to-date cache.
+     */
+    static Eng::Node* load(const std::string& sourcePath);
+
+    /**
+     * @brief Writes the cache of a scene loaded from the given scene file.
+     *
+     * Only scenes made of the node types created by \c OvoReader can be cached.
+     * @param sourcePath The path of the .ovo scene file the scene was loaded from.
+     * @param root The root node of the loaded scene.
+     * @return \c true if the cache was written.
+     */
+    static bool save(const std::string& sourcePath, Eng::Node* root);
+
+private:
+    /**
+     * @brief Reads the size and modification time of a scene file.
+     * @param sourcePath The path of the scene file.
+     * @param size Receives the file size in bytes.
+     * @param time Receives the modification time, in file clock ticks.
+     * @return \c false if the file can't be inspected.
+     * @private
+     */
+    static bool getSourceStamp(const std::string& sourcePath, unsigned long long& size, long long& time);
+};
@@ -1,72 +1,225 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "engine.h"
 
-#include <glm/gtc/packing.hpp>
-
 #include <limits.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <thread>
 #include <vector>
 #include <iomanip>
 #include <iostream>
 
-Eng::OvoReader::OvoReader() : file(nullptr)
+/**
+ * @brief State shared between \c OvoReader::loadAsync, its loading thread and \c OvoReader::update.
+ */
+struct Eng::OvoReader::AsyncState
+{
+	std::thread thread;
+	std::string filename;
+	Eng::Node* root = nullptr;
+
+	// Written by the loading thread before "indexed" is published:
+	std::vector<const char*> materialChunks;
+	std::vector<NodeRecord> records;
+	std::vector<GeometryRecord> geometries;
+	std::vector<Eng::MeshGeometry> meshes;
+	std::vector<size_t> subtreeBegins;			///< First record of every subtree attached to the root, plus the end.
+	std::vector<unsigned int> subtreeMeshEnds;	///< LOD geometries that must be decoded before each subtree can be built.
+	bool rootMerged = false;
+
+	std::atomic<bool> indexed{ false };
+	std::atomic<bool> finished{ false };
+	std::atomic<unsigned int> decodedMeshes{ 0 };
+
+	// Rendering thread only:
+	bool started = false;
+	size_t nextSubtree = 0;
+	size_t attachedRecords = 0;
+	bool done = false;
+	bool succeeded = false;
+};
+
+/**
+ * @brief Worker threads decoding mesh payloads, kept from one load to the next, and the batch they work on.
+ */
+struct Eng::OvoReader::DecodePool
+{
+	std::mutex mutex;							///< One batch at a time: \c load and the \c loadAsync thread may both decode.
+	std::unique_ptr<Eng::JobSystem> jobs;		///< Created by the first parallel decode, again if \c workerThreads changes.
+
+	// Current batch:
+	const std::vector<GeometryRecord>* geometries = nullptr;
+	std::vector<Eng::MeshGeometry>* meshes = nullptr;
+	unsigned int first = 0;
+};
+
+/**
+ * @brief Hashes every buffer of a run of LOD geometries, to find meshes that can share them.
+ */
+static size_t GeometryHash(const Eng::MeshGeometry* lods, unsigned int numberOfLods)
+{
+	size_t hash = numberOfLods;
+	auto combine = [&hash](const void* bytes, size_t size)
+	{
+		size_t value = std::hash<std::string_view>()(std::string_view(static_cast<const char*>(bytes), size));
+		hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	};
+
+	for (unsigned int l = 0; l < numberOfLods; ++l)
+	{
+		const Eng::MeshGeometry& lod = lods[l];
+		combine(lod.vertexes.data(), lod.vertexes.size() * sizeof(glm::vec3));
+		combine(lod.faces.data(), lod.faces.size() * sizeof(glm::uvec3));
+		combine(lod.normals.data(), lod.normals.size() * sizeof(glm::vec4));
+		combine(lod.textureCoordinates.data(), lod.textureCoordinates.size() * sizeof(glm::vec2));
+		combine(lod.tangents.data(), lod.tangents.size() * sizeof(glm::vec4));
+	}
+	return hash;
+}
+
+/**
+ * @brief Tells whether a mesh chunk can hold its LOD count, every LOD taking at least its vertex and face counts.
+ */
+static bool LodCountFits(unsigned int numberOfLods, unsigned int offset, unsigned int chunkSize)
+{
+	return offset <= chunkSize && numberOfLods <= (chunkSize - offset) / (sizeof(unsigned int) * 2);
+}
+
+/**
+ * @brief Finds the end of a mesh LOD from its vertex and face counts.
+ * @return The offset past the LOD, or \c UINT_MAX if it runs past the end of the chunk.
+ */
+static unsigned int LodEnd(const char* data, unsigned int offset, unsigned int chunkSize)
+{
+	if (offset > chunkSize || chunkSize - offset < sizeof(unsigned int) * 2)
+		return UINT_MAX;
+
+	unsigned int numberOfVertexes;
+	unsigned int numberOfFaces;
+	memcpy(&numberOfVertexes, data + offset, sizeof(unsigned int));
+	memcpy(&numberOfFaces, data + offset + sizeof(unsigned int), sizeof(unsigned int));
+
+	// 64 bits: the counts of a corrupted chunk must not wrap around
+	unsigned long long end = (unsigned long long)offset + sizeof(unsigned int) * 2 +
+		(unsigned long long)numberOfVertexes * Eng::VertexUnpack::RECORD_SIZE + (unsigned long long)numberOfFaces * sizeof(glm::uvec3);
+	return end <= chunkSize ? (unsigned int)end : UINT_MAX;
+}
+
+/**
+ * @brief Tells whether a mesh already holds exactly the given LOD geometries.
+ */
+static bool SameGeometry(const Eng::Mesh* mesh, const Eng::MeshGeometry* lods, unsigned int numberOfLods)
 {
+	if (mesh->getNumberOfLods() != std::max(numberOfLods, 1u))
+		return false;
+
+	for (unsigned int l = 0; l < numberOfLods; ++l)
+	{
+		const Eng::MeshGeometry& lod = mesh->getLod(l);
+		if (lod.vertexes != lods[l].vertexes || lod.faces != lods[l].faces || lod.normals != lods[l].normals ||
+			lod.textureCoordinates != lods[l].textureCoordinates || lod.tangents != lods[l].tangents)
+			return false;
+	}
+	return true;
+}
+
+Eng::OvoReader::OvoReader() : file(nullptr),
+	mappedData(nullptr),
+	mappedSize(0),
+	mappedPosition(0),
+	loadMode(LoadMode::MEMORY_MAPPED),
+	lastLoadMapped(false),
+	workerThreads(std::thread::hardware_concurrency()),
+	geometrySharing(false),
+	profilingEnabled(false),
+	decodePool(std::make_unique<DecodePool>())
+{
+	// ENG_LOAD_PROFILE=1 profiles every load, ENG_LOAD_PROFILE=path.json also picks the trace file
+	const char* profile = getenv("ENG_LOAD_PROFILE");
+	if (profile && *profile && strcmp(profile, "0"))
+	{
+		std::string value(profile);
+		setProfilingEnabled(true, value.size() > 5 && value.compare(value.size() - 5, 5, ".json") == 0 ? value : "");
+	}
 }
 
 Eng::OvoReader::~OvoReader()
 {
+	if (async)
+	{
+		finishAsync();
+	}
 	if (file)
 	{
 		fclose(file);
 	}
+	unmapFile();
 }
 
 Eng::Node* Eng::OvoReader::load(const std::string& filename)
 {
-	file = fopen(filename.c_str(), "rb");
+	lastLoadMapped = false;
+	loadedGeometries.clear();
+
+	if (profilingEnabled)
+	{
+		profiler.reset();
+	}
 
-	if (!file)
+	// Memory-mapped mode falls back to the stream path when the file can't be mapped:
+	bool opened;
+	{
+		Eng::LoadProfiler::Scope scope(activeProfiler(), Eng::LoadProfiler::Category::OTHER, Eng::LoadProfiler::Phase::IO, "open");
+		opened = (loadMode == LoadMode::MEMORY_MAPPED && mapFile(filename)) || (file = fopen(filename.c_str(), "rb")) != nullptr;
+	}
+
+	if (!opened)
 	{
 		std::cerr << "ERROR: Could not open file " << filename << std::endl;
+		profiler.stop();
 		return nullptr;
 	}
 
+#if defined(DEBUG) || defined(_DEBUG)
+	if (lastLoadMapped)
+	{
+		std::cout << "Memory-mapped " << mappedSize << " bytes from " << filename << std::endl;
+	}
+#endif
+
 	unsigned int chunkId;
 	unsigned int chunkSize;
+	const char* chunkData;
 
 	Eng::Node* rootNode = nullptr;
 
-	size_t lastSlash = filename.find_last_of("/\\");
-	if (lastSlash != std::string::npos) {
-		basePath = filename.substr(0, lastSlash + 1);
-	}
-	else {
-		basePath = "./";
-	}
+	setBasePath(filename);
 
 	// Configure stream:
 	std::cout.precision(2);
 	std::cout << std::fixed;
 
-	while (true)
+	while (nextChunk(chunkId, chunkSize, chunkData))
 	{
-		fread(&chunkId, sizeof(unsigned int), 1, file);
-		if (feof(file))
-			break;
-		fread(&chunkSize, sizeof(unsigned int), 1, file);
-
 #if defined(DEBUG) || defined(_DEBUG)
 		std::cout << "Processing chunk (" << chunkId << "; " << chunkSize << " bytes)" << std::endl;
 #endif
 
-		char* chunkData = new char[chunkSize];
-		if (fread(chunkData, sizeof(char), chunkSize, file) != chunkSize)
-		{
-			std::cerr << "ERROR: Could not read chunk data from file" << std::endl;
-			delete[] chunkData;
-			break;
-		}
-
 		unsigned int position = 0;
 		Type type = (Type)chunkId;
 
@@ -88,7 +241,7 @@ Eng::Node* Eng::OvoReader::load(const std::string& filename)
 			// Process NODE / LIGHT / MESH chunk
 			if (!rootNode)
 			{
-				rootNode = processNodeChunk(chunkData, position, type);
+				rootNode = workerThreads > 1 ? loadHierarchy(chunkData, chunkSize, type) : processNodeChunk(chunkData, chunkSize, position, type);
 			}
 			else
 			{
@@ -98,7 +251,7 @@ Eng::Node* Eng::OvoReader::load(const std::string& filename)
 		default:
 			break;
 		}
-		delete[] chunkData;
+		releaseChunk(chunkData);
 	}
 
 	if (!rootNode)
@@ -106,34 +259,518 @@ Eng::Node* Eng::OvoReader::load(const std::string& filename)
 		std::cerr << "ERROR: Could not load scene from file " << filename << std::endl;
 	}
 
-	fclose(file);
-	file = nullptr;
+	if (file)
+	{
+		fclose(file);
+		file = nullptr;
+	}
+	unmapFile();
+	loadedGeometries.clear();
+
+	if (profilingEnabled)
+	{
+		reportProfile(filename);
+	}
 	return rootNode;
 }
 
-// Loaders
+void Eng::OvoReader::setBasePath(const std::string& filename)
+{
+	size_t lastSlash = filename.find_last_of("/\\");
+	if (lastSlash != std::string::npos) {
+		basePath = filename.substr(0, lastSlash + 1);
+	}
+	else {
+		basePath = "./";
+	}
+}
 
-Eng::Node* Eng::OvoReader::loadNextNode()
+void Eng::OvoReader::setLoadMode(LoadMode mode)
+{
+	loadMode = mode;
+}
+
+Eng::OvoReader::LoadMode Eng::OvoReader::getLoadMode() const
+{
+	return loadMode;
+}
+
+bool Eng::OvoReader::wasMemoryMapped() const
+{
+	return lastLoadMapped;
+}
+
+void Eng::OvoReader::setWorkerThreads(unsigned int count)
+{
+	workerThreads = count;
+}
+
+unsigned int Eng::OvoReader::getWorkerThreads() const
+{
+	return workerThreads;
+}
+
+void Eng::OvoReader::setGeometrySharing(bool enabled)
+{
+	geometrySharing = enabled;
+}
+
+bool Eng::OvoReader::isGeometrySharingEnabled() const
+{
+	return geometrySharing;
+}
+
+// Profiling
+
+void Eng::OvoReader::setProfilingEnabled(bool enabled, const std::string& tracePath)
+{
+	profilingEnabled = enabled;
+	this->tracePath = tracePath;
+}
+
+bool Eng::OvoReader::isProfilingEnabled() const
+{
+	return profilingEnabled;
+}
+
+const Eng::LoadProfiler& Eng::OvoReader::getProfiler() const
+{
+	return profiler;
+}
+
+Eng::LoadProfiler* Eng::OvoReader::activeProfiler()
+{
+	return profilingEnabled ? &profiler : nullptr;
+}
+
+void Eng::OvoReader::reportProfile(const std::string& filename)
+{
+	profiler.stop();
+	profiler.printSummary(filename);
+
+	std::string path = tracePath.empty() ? filename + ".trace.json" : tracePath;
+	if (profiler.writeTrace(path))
+	{
+		std::cout << "[load profile] trace written to " << path << std::endl;
+	}
+}
+
+Eng::LoadProfiler::Category Eng::OvoReader::getProfileCategory(Type type)
+{
+	switch (type)
+	{
+	case Type::OBJECT:		return Eng::LoadProfiler::Category::OBJECT;
+	case Type::NODE:		return Eng::LoadProfiler::Category::NODE;
+	case Type::MESH:		return Eng::LoadProfiler::Category::MESH;
+	case Type::LIGHT:		return Eng::LoadProfiler::Category::LIGHT;
+	case Type::MATERIAL:	return Eng::LoadProfiler::Category::MATERIAL;
+	case Type::TEXTURE:		return Eng::LoadProfiler::Category::TEXTURE;
+	default:				return Eng::LoadProfiler::Category::OTHER;
+	}
+}
+
+// Asynchronous loading
+
+bool Eng::OvoReader::loadAsync(const std::string& filename, Eng::Node* root)
 {
+	if (async && !async->done)
+	{
+		std::cerr << "ERROR: Scene " << async->filename << " is still loading" << std::endl;
+		return false;
+	}
+
+	async = std::make_unique<AsyncState>();
+	async->filename = filename;
+	async->root = root;
+	loadedGeometries.clear();
+
+	lastLoadMapped = false;
+	setBasePath(filename);
+
+	if (profilingEnabled)
+	{
+		profiler.reset();
+	}
+
+	async->thread = std::thread(&Eng::OvoReader::runAsync, this);
+	return true;
+}
+
+void Eng::OvoReader::runAsync()
+{
+	AsyncState& state = *async;
+
+	bool opened;
+	{
+		Eng::LoadProfiler::Scope scope(activeProfiler(), Eng::LoadProfiler::Category::OTHER, Eng::LoadProfiler::Phase::IO, "open");
+		opened = (loadMode == LoadMode::MEMORY_MAPPED && mapFile(state.filename)) || (file = fopen(state.filename.c_str(), "rb")) != nullptr;
+	}
+
+	if (!opened)
+	{
+		std::cerr << "ERROR: Could not open file " << state.filename << std::endl;
+		state.finished.store(true, std::memory_order_release);
+		return;
+	}
+
+	// Materials are kept for the rendering thread, the first node chunk starts the hierarchy
 	unsigned int chunkId;
 	unsigned int chunkSize;
+	const char* chunkData;
+
+	while (nextChunk(chunkId, chunkSize, chunkData))
+	{
+		unsigned int position = 0;
+		Type type = (Type)chunkId;
+
+		if (type == Type::MATERIAL)
+		{
+			state.materialChunks.push_back(chunkData);
+			continue;
+		}
+
+		if (type == Type::NODE || type == Type::LIGHT || type == Type::MESH)
+		{
+			indexHierarchy(chunkData, chunkSize, type, state.records, state.geometries);
+			break;
+		}
+
+		if (type == Type::OBJECT)
+		{
+			processObjectChunk(chunkData, position);
+		}
+		releaseChunk(chunkData);
+	}
+
+	if (state.records.empty())
+	{
+		state.finished.store(true, std::memory_order_release);
+		return;
+	}
+
+	state.meshes.resize(state.geometries.size());
+
+	// Split the hierarchy into the subtrees streamed into the root
+	const NodeRecord& rootRecord = state.records.front();
+	state.rootMerged = rootRecord.type == Type::NODE;
+
+	size_t index = state.rootMerged ? 1 : 0;
+	unsigned int numberOfSubtrees = state.rootMerged ? rootRecord.numberOfChildren : 1;
+	unsigned int meshEnd = 0;
+
+	for (unsigned int s = 0; s < numberOfSubtrees && index < state.records.size(); ++s)
+	{
+		state.subtreeBegins.push_back(index);
+
+		size_t pending = 1;
+		while (pending > 0 && index < state.records.size())
+		{
+			const NodeRecord& record = state.records[index++];
+			pending = pending - 1 + record.numberOfChildren;
+			if (record.mesh >= 0)
+				meshEnd = (unsigned int)record.mesh + record.numberOfLods;
+		}
+		state.subtreeMeshEnds.push_back(meshEnd);
+	}
+	state.subtreeBegins.push_back(index);
+
+	state.indexed.store(true, std::memory_order_release);
+
+	// Decode subtree by subtree so the first ones can be attached early
+	unsigned int first = 0;
+	for (unsigned int last : state.subtreeMeshEnds)
+	{
+		if (last > first)
+		{
+			decodeMeshes(state.geometries, state.meshes, first, last);
+			state.decodedMeshes.store(last, std::memory_order_release);
+			first = last;
+		}
+	}
+
+	state.finished.store(true, std::memory_order_release);
+}
+
+bool Eng::OvoReader::update()
+{
+	if (!async || async->done)
+		return true;
+
+	AsyncState& state = *async;
+
+	if (!state.indexed.load(std::memory_order_acquire))
+	{
+		if (!state.finished.load(std::memory_order_acquire))
+			return false;
+
+		std::cerr << "ERROR: Could not load scene from file " << state.filename << std::endl;
+		finishAsync();
+		state.done = true;
+		if (profilingEnabled)
+		{
+			reportProfile(state.filename);
+		}
+		return true;
+	}
+
+	if (!state.started)
+	{
+		for (const char* chunk : state.materialChunks)
+		{
+			unsigned int position = 0;
+			processMaterialChunk(chunk, position);
+		}
+
+		// A plain root node becomes the node handed out by the caller
+		if (state.rootMerged)
+		{
+			const char* data = state.records.front().data;
+			size_t nameLength = strlen(data);
+
+			glm::mat4 matrix;
+			memcpy(&matrix, data + nameLength + 1, sizeof(glm::mat4));
+
+			state.root->setName(std::string(data, nameLength));
+			state.root->setMatrix(matrix);
+			state.attachedRecords = 1;
+		}
+		state.started = true;
+	}
+
+	unsigned int decoded = state.decodedMeshes.load(std::memory_order_acquire);
+	while (state.nextSubtree < state.subtreeMeshEnds.size() && state.subtreeMeshEnds[state.nextSubtree] <= decoded)
+	{
+		size_t index = state.subtreeBegins[state.nextSubtree];
+		size_t end = state.subtreeBegins[state.nextSubtree + 1];
+		while (index < end)
+		{
+			Eng::Node* node = buildNode(state.records, state.meshes, index);
+			if (node)
+			{
+				state.root->addChild(node);
+			}
+		}
+
+		state.attachedRecords = end;
+		++state.nextSubtree;
+	}
+
+	if (state.nextSubtree < state.subtreeMeshEnds.size())
+		return false;
+
+	finishAsync();
+	state.succeeded = true;
+	state.done = true;
+	if (profilingEnabled)
+	{
+		reportProfile(state.filename);
+	}
+	return true;
+}
+
+float Eng::OvoReader::getProgress() const
+{
+	if (!async)
+		return 0.0f;
+	if (async->done)
+		return 1.0f;
+	if (!async->started)
+		return 0.0f;
+	return (float)async->attachedRecords / (float)async->records.size();
+}
+
+bool Eng::OvoReader::hasAsyncSucceeded() const
+{
+	return async && async->succeeded;
+}
+
+void Eng::OvoReader::finishAsync()
+{
+	AsyncState& state = *async;
+	if (state.thread.joinable())
+	{
+		state.thread.join();
+	}
+
+	// Chunks must go back before the mapping does
+	for (const char* chunk : state.materialChunks)
+	{
+		releaseChunk(chunk);
+	}
+	for (const NodeRecord& record : state.records)
+	{
+		if (record.data)
+			releaseChunk(record.data);
+	}
+	state.materialChunks.clear();
+	state.records.clear();
+	state.geometries.clear();
+	state.meshes.clear();
+	loadedGeometries.clear();
+
+	if (file)
+	{
+		fclose(file);
+		file = nullptr;
+	}
+	unmapFile();
+}
+
+// File access
+
+bool Eng::OvoReader::mapFile(const std::string& filename)
+{
+	unmapFile();
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(fileHandle);
+	if (!mappingHandle)
+		return false;
+
+	// The view keeps the mapping alive once both handles are closed:
+	void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mappingHandle);
+	if (!view)
+		return false;
+
+	mappedData = static_cast<const char*>(view);
+	mappedSize = (size_t)fileSize.QuadPart;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// The mapping stays valid after the descriptor is closed:
+	void* view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	madvise(view, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+
+	mappedData = static_cast<const char*>(view);
+	mappedSize = (size_t)fileStat.st_size;
+#endif
+
+	mappedPosition = 0;
+	lastLoadMapped = true;
+	return true;
+}
+
+void Eng::OvoReader::unmapFile()
+{
+	if (!mappedData)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(mappedData);
+#else
+	munmap(const_cast<char*>(mappedData), mappedSize);
+#endif
+
+	mappedData = nullptr;
+	mappedSize = 0;
+	mappedPosition = 0;
+}
+
+bool Eng::OvoReader::nextChunk(unsigned int& chunkId, unsigned int& chunkSize, const char*& chunkData)
+{
+	// The chunk type is only known once its header is read
+	Eng::LoadProfiler::Scope scope(activeProfiler(), Eng::LoadProfiler::Category::OTHER, Eng::LoadProfiler::Phase::IO, "read chunk");
+
+	if (mappedData)
+	{
+		// Zero-copy: hand out a pointer straight into the mapped file
+		if (mappedSize - mappedPosition < sizeof(unsigned int) * 2)
+			return false;
+
+		memcpy(&chunkId, mappedData + mappedPosition, sizeof(unsigned int));
+		mappedPosition += sizeof(unsigned int);
+		memcpy(&chunkSize, mappedData + mappedPosition, sizeof(unsigned int));
+		mappedPosition += sizeof(unsigned int);
+
+		if (chunkSize > mappedSize - mappedPosition)
+		{
+			std::cerr << "ERROR: Could not read chunk data from file" << std::endl;
+			return false;
+		}
+
+		chunkData = mappedData + mappedPosition;
+		mappedPosition += chunkSize;
+
+		if (profilingEnabled)
+		{
+			scope.setCategory(getProfileCategory((Type)chunkId));
+			profiler.addChunk(getProfileCategory((Type)chunkId), chunkSize);
+		}
+		return true;
+	}
 
 	fread(&chunkId, sizeof(unsigned int), 1, file);
 	if (feof(file))
-		return nullptr;
+		return false;
 	fread(&chunkSize, sizeof(unsigned int), 1, file);
 
-#if defined(DEBUG) || defined(_DEBUG)
-	std::cout << "Processing NODE chunk (" << chunkId << "; " << chunkSize << " bytes)" << std::endl;
-#endif
-
-	char* chunkData = new char[chunkSize];
-	if (fread(chunkData, sizeof(char), chunkSize, file) != chunkSize)
+	char* buffer = new char[chunkSize];
+	if (fread(buffer, sizeof(char), chunkSize, file) != chunkSize)
 	{
 		std::cerr << "ERROR: Could not read chunk data from file" << std::endl;
+		delete[] buffer;
+		return false;
+	}
+
+	chunkData = buffer;
+
+	if (profilingEnabled)
+	{
+		scope.setCategory(getProfileCategory((Type)chunkId));
+		profiler.addChunk(getProfileCategory((Type)chunkId), chunkSize);
+	}
+	return true;
+}
+
+void Eng::OvoReader::releaseChunk(const char* chunkData)
+{
+	// Only the stream path owns its chunk buffers
+	if (!mappedData)
+	{
 		delete[] chunkData;
-		return nullptr;
 	}
+}
+
+// Loaders
+
+Eng::Node* Eng::OvoReader::loadNextNode()
+{
+	unsigned int chunkId;
+	unsigned int chunkSize;
+	const char* chunkData;
+
+	if (!nextChunk(chunkId, chunkSize, chunkData))
+		return nullptr;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	std::cout << "Processing NODE chunk (" << chunkId << "; " << chunkSize << " bytes)" << std::endl;
+#endif
 
 	unsigned int position = 0;
 	Type type = (Type)chunkId;
@@ -141,22 +778,179 @@ Eng::Node* Eng::OvoReader::loadNextNode()
 	if (type == Type::NODE || type == Type::LIGHT || type == Type::MESH)
 	{
 		// Process NODE chunk
-		Eng::Node* node = processNodeChunk(chunkData, position, type);
-		delete[] chunkData;
+		Eng::Node* node = processNodeChunk(chunkData, chunkSize, position, type);
+		releaseChunk(chunkData);
 		return node;
 	}
 	else
 	{
 		std::cerr << "ERROR: Unexpected chunk type " << (int)chunkId << " while loading node" << std::endl;
-		delete[] chunkData;
+		releaseChunk(chunkData);
 		return nullptr;
 	}
 }
 
+void Eng::OvoReader::indexHierarchy(const char* data, unsigned int size, Type type, std::vector<NodeRecord>& records, std::vector<GeometryRecord>& geometries)
+{
+	Eng::LoadProfiler::Scope scope(activeProfiler(), Eng::LoadProfiler::Category::OTHER, Eng::LoadProfiler::Phase::PARSE, "index");
+
+	unsigned int chunkId = (unsigned int)type;
+	unsigned int chunkSize = size;
+	const char* chunkData = data;
+	unsigned int pending = 1;
+
+	while (pending > 0)
+	{
+		if (!records.empty() && !nextChunk(chunkId, chunkSize, chunkData))
+			break;
+
+		--pending;
+		Type chunkType = (Type)chunkId;
+
+		if (chunkType != Type::NODE && chunkType != Type::LIGHT && chunkType != Type::MESH)
+		{
+			// Keep an empty slot so the child still counts, as the serial loader does
+			std::cerr << "ERROR: Unexpected chunk type " << (int)chunkId << " while loading node" << std::endl;
+			releaseChunk(chunkData);
+			records.push_back({ chunkType, nullptr, 0, 0, 0, -1 });
+			continue;
+		}
+
+		NodeRecord record = { chunkType, chunkData, chunkSize, 0, 0, -1 };
+
+		unsigned int position = (unsigned int)strlen(chunkData) + 1;
+		position += sizeof(glm::mat4);
+		memcpy(&record.numberOfChildren, chunkData + position, sizeof(unsigned int));
+		position += sizeof(unsigned int);
+
+		if (chunkType == Type::MESH)
+		{
+			position += (unsigned int)strlen(chunkData + position) + 1;	// target name
+			position += sizeof(unsigned char);								// subtype
+			position += (unsigned int)strlen(chunkData + position) + 1;	// material name
+			position += sizeof(float) + sizeof(glm::vec3) * 2;				// radius, bounding box
+			position += sizeof(char);										// physics
+
+			memcpy(&record.numberOfLods, chunkData + position, sizeof(unsigned int));
+			position += sizeof(unsigned int);
+			if (!LodCountFits(record.numberOfLods, position, chunkSize))
+				record.numberOfLods = 0;	// Reported by processMeshChunk
+
+			// Every LOD becomes a decoding job; its size follows from its vertex and face counts,
+			// and a LOD running past the chunk leaves the next ones at the end of it, as decodeMeshGeometry does
+			record.mesh = record.numberOfLods ? (int)geometries.size() : -1;
+			for (unsigned int l = 0; l < record.numberOfLods; ++l)
+			{
+				geometries.push_back({ chunkData, position, chunkSize });
+				unsigned int end = LodEnd(chunkData, position, chunkSize);
+				position = end != UINT_MAX ? end : chunkSize;
+			}
+		}
+
+		records.push_back(record);
+		pending += record.numberOfChildren;
+	}
+}
+
+Eng::Node* Eng::OvoReader::loadHierarchy(const char* data, unsigned int size, Type type)
+{
+	// Phase one: index the subtree chunks (pre-order) without building anything
+	std::vector<NodeRecord> records;
+	std::vector<GeometryRecord> geometries;
+	indexHierarchy(data, size, type, records, geometries);
+
+#if defined(DEBUG) || defined(_DEBUG)
+	std::cout << "Indexed " << records.size() << " nodes (" << geometries.size() << " mesh LODs)" << std::endl;
+#endif
+
+	// Phase two: decode mesh payloads on the worker threads
+	std::vector<Eng::MeshGeometry> meshes(geometries.size());
+	decodeMeshes(geometries, meshes, 0, (unsigned int)geometries.size());
+
+	// Phase three: build the nodes serially, in file order, so the graph matches the serial loader
+	size_t index = 0;
+	Eng::Node* rootNode = buildNode(records, meshes, index);
+
+	// The root chunk belongs to the caller
+	for (size_t r = 1; r < records.size(); ++r)
+	{
+		if (records[r].data)
+			releaseChunk(records[r].data);
+	}
+
+	return rootNode;
+}
+
+void Eng::OvoReader::decodeMeshes(const std::vector<GeometryRecord>& geometries, std::vector<Eng::MeshGeometry>& meshes, unsigned int first, unsigned int last)
+{
+	std::lock_guard<std::mutex> lock(decodePool->mutex);
+	decodePool->geometries = &geometries;
+	decodePool->meshes = &meshes;
+	decodePool->first = first;
+
+	if (workerThreads < 2 || last - first < 2)
+	{
+		for (unsigned int m = first; m < last; ++m)
+		{
+			runDecodeJob(this, m - first);
+		}
+		return;
+	}
+
+	// The threads outlive the call, so each subtree and each load only hands them a batch
+	if (!decodePool->jobs || decodePool->jobs->getNumberOfThreads() != workerThreads)
+	{
+		decodePool->jobs = std::make_unique<Eng::JobSystem>(workerThreads);
+	}
+	decodePool->jobs->run(last - first, runDecodeJob, this);
+}
+
+void Eng::OvoReader::runDecodeJob(void* context, unsigned int index)
+{
+	Eng::OvoReader* reader = static_cast<Eng::OvoReader*>(context);
+	const DecodePool& pool = *reader->decodePool;
+	unsigned int m = pool.first + index;
+
+	Eng::LoadProfiler::Scope scope(reader->activeProfiler(), Eng::LoadProfiler::Category::MESH, Eng::LoadProfiler::Phase::DECODE, "decode");
+	unsigned int position = (*pool.geometries)[m].offset;
+	reader->decodeMeshGeometry((*pool.geometries)[m].data, (*pool.geometries)[m].size, position, (*pool.meshes)[m]);
+}
+
+Eng::Node* Eng::OvoReader::buildNode(const std::vector<NodeRecord>& records, std::vector<Eng::MeshGeometry>& meshes, size_t& index)
+{
+	const NodeRecord& record = records[index++];
+	if (!record.data)
+	{
+		return nullptr;
+	}
+
+	unsigned int position = 0;
+	unsigned int numberOfChildren;
+	Eng::Node* node = createNode(record.data, record.size, position, record.type, numberOfChildren, record.mesh >= 0 ? &meshes[record.mesh] : nullptr);
+
+	if (!node)
+	{
+		return nullptr;
+	}
+
+	for (unsigned int i = 0; i < numberOfChildren && index < records.size(); ++i)
+	{
+		Eng::Node* childNode = buildNode(records, meshes, index);
+		if (childNode)
+		{
+			node->addChild(childNode);
+		}
+	}
+
+	return node;
+}
+
 // Processors for different chunk types
 
-void Eng::OvoReader::processObjectChunk(char* data, unsigned int& size)
+void Eng::OvoReader::processObjectChunk(const char* data, unsigned int& size)
 {
+	Eng::LoadProfiler::Scope scope(activeProfiler(), Eng::LoadProfiler::Category::OBJECT, Eng::LoadProfiler::Phase::PARSE, "OBJECT");
+
 	unsigned int versionId;
 	memcpy(&versionId, data + size, sizeof(unsigned int));
 	std::cout << "Version:  " << versionId << std::endl;
@@ -165,8 +959,10 @@ void Eng::OvoReader::processObjectChunk(char* data, unsigned int& size)
 
 // Material and Texture processors
 
-Eng::Texture* Eng::OvoReader::processTextureChunk(char* data, unsigned int& size)
+Eng::Texture* Eng::OvoReader::processTextureChunk(const char* data, unsigned int& size)
 {
+	unsigned int start = size;
+
 	char textureName[FILENAME_MAX];
 	strcpy(textureName, data + size);
 	size += (unsigned int)strlen(textureName) + 1;
@@ -201,14 +997,21 @@ Eng::Texture* Eng::OvoReader::processTextureChunk(char* data, unsigned int& size
 	std::cout << "- metalness map: " << metalnessMapName << std::endl;
 #endif
 
-	// Create texture
+	if (profilingEnabled)
+	{
+		profiler.addChunk(Eng::LoadProfiler::Category::TEXTURE, size - start);
+	}
+
+	// Shared with every material (and scene) using the same image; image decoding happens here on a cache miss
+	Eng::LoadProfiler::Scope scope(activeProfiler(), Eng::LoadProfiler::Category::TEXTURE, Eng::LoadProfiler::Phase::TEXTURE, "TEXTURE");
 	std::string texturePath = basePath + std::string(textureName);
-	Eng::Texture* texture = new Eng::Texture(textureName, texturePath);
-	return texture;
+	return Eng::TextureCache::getInstance().acquire(textureName, texturePath);
 }
 
-void Eng::OvoReader::processMaterialChunk(char* data, unsigned int& size)
+void Eng::OvoReader::processMaterialChunk(const char* data, unsigned int& size)
 {
+	Eng::LoadProfiler::Scope scope(activeProfiler(), Eng::LoadProfiler::Category::MATERIAL, Eng::LoadProfiler::Phase::PARSE, "MATERIAL");
+
 	// Get material name
 	char materialName[FILENAME_MAX];
 	strcpy(materialName, data + size);
@@ -260,13 +1063,38 @@ void Eng::OvoReader::processMaterialChunk(char* data, unsigned int& size)
 	if (texture)
 	{
 		material->setTexture(texture);
+		texture->release();
 	}
 }
 
 // Nodes processors
 
-Eng::Node* Eng::OvoReader::processNodeChunk(char* data, unsigned int& size, Type type)
+Eng::Node* Eng::OvoReader::processNodeChunk(const char* data, unsigned int chunkSize, unsigned int& size, Type type)
 {
+	unsigned int numberOfChildren;
+	Eng::Node* node = createNode(data, chunkSize, size, type, numberOfChildren, nullptr);
+
+	if (!node)
+	{
+		return nullptr;
+	}
+
+	for (unsigned int i = 0; i < numberOfChildren; ++i)
+	{
+		Eng::Node* childNode = loadNextNode();
+		if (childNode)
+		{
+			node->addChild(childNode);
+		}
+	}
+
+	return node;
+}
+
+Eng::Node* Eng::OvoReader::createNode(const char* data, unsigned int chunkSize, unsigned int& size, Type type, unsigned int& numberOfChildren, Eng::MeshGeometry* decoded)
+{
+	Eng::LoadProfiler::Scope scope(activeProfiler(), getProfileCategory(type), Eng::LoadProfiler::Phase::PARSE, Eng::LoadProfiler::getCategoryName(getProfileCategory(type)));
+
 	// Get node name
 	char nodeName[FILENAME_MAX];
 	strcpy(nodeName, data + size);
@@ -278,7 +1106,6 @@ Eng::Node* Eng::OvoReader::processNodeChunk(char* data, unsigned int& size, Type
 	size += sizeof(glm::mat4);
 
 	// Get number of children
-	unsigned int numberOfChildren;
 	memcpy(&numberOfChildren, data + size, sizeof(unsigned int));
 	size += sizeof(unsigned int);
 
@@ -303,7 +1130,7 @@ Eng::Node* Eng::OvoReader::processNodeChunk(char* data, unsigned int& size, Type
 	else if (type == Type::MESH)
 	{
 		// Process MESH chunk
-		node = processMeshChunk(data, size, nodeName, nodeMatrix);
+		node = processMeshChunk(data, chunkSize, size, nodeName, nodeMatrix, decoded);
 	}
 	else
 	{
@@ -311,24 +1138,10 @@ Eng::Node* Eng::OvoReader::processNodeChunk(char* data, unsigned int& size, Type
 		node = new Eng::Node(std::string(nodeName), nodeMatrix);
 	}
 
-	if (!node)
-	{
-		return nullptr;
-	}
-
-	for (unsigned int i = 0; i < numberOfChildren; ++i)
-	{
-		Eng::Node* childNode = loadNextNode();
-		if (childNode)
-		{
-			node->addChild(childNode);
-		}
-	}
-
 	return node;
 }
 
-Eng::Node* Eng::OvoReader::processLightChunk(char* data, unsigned int& size, char* name, glm::mat4& matrix)
+Eng::Node* Eng::OvoReader::processLightChunk(const char* data, unsigned int& size, char* name, glm::mat4& matrix)
 {
 	// Get light subtype
 	unsigned char lightSubtype;
@@ -388,11 +1201,12 @@ Eng::Node* Eng::OvoReader::processLightChunk(char* data, unsigned int& size, cha
 	light->setAmbient(glm::vec4(color, 1.0f));
 	light->setDiffuse(glm::vec4(color, 1.0f));
 	light->setSpecular(glm::vec4(color, 1.0f));
+	light->setInfluenceRadius(influenceRadius);
 
 	return light;
 }
 
-Eng::Node* Eng::OvoReader::processMeshChunk(char* data, unsigned int& size, char* name, glm::mat4& matrix)
+Eng::Node* Eng::OvoReader::processMeshChunk(const char* data, unsigned int chunkSize, unsigned int& size, char* name, glm::mat4& matrix, Eng::MeshGeometry* decoded)
 {
 	// Get mesh subtype
 	size += sizeof(unsigned char); // Subtype is currently unused
@@ -407,94 +1221,80 @@ Eng::Node* Eng::OvoReader::processMeshChunk(char* data, unsigned int& size, char
 	memcpy(&meshRadius, data + size, sizeof(float));
 	size += sizeof(float);
 
-	// Mesh min & max bounding box [skipped]
-	size += sizeof(glm::vec3); // min
-	size += sizeof(glm::vec3); // max
+	// Mesh min & max bounding box
+	glm::vec3 boundingBoxMin;
+	memcpy(&boundingBoxMin, data + size, sizeof(glm::vec3));
+	size += sizeof(glm::vec3);
+
+	glm::vec3 boundingBoxMax;
+	memcpy(&boundingBoxMax, data + size, sizeof(glm::vec3));
+	size += sizeof(glm::vec3);
 
 	// Phisical properties [skipped]
 	size += sizeof(char); // phisics used
 
 	// Load LODs
-	// unsigned int numberOfLods;
-	// memcpy(&numberOfLods, data + size, sizeof(unsigned int));
-	size += sizeof(unsigned int);
-
-	// Read LODs data: vertex
-	std::vector<glm::vec3> meshVertexList;
-	std::vector<glm::uvec3> meshFaceList;
-	std::vector<glm::vec4> meshNormalList;
-	std::vector<glm::vec2> meshTextureCoordList;
-
-	unsigned int numberOfVertexes;
-	unsigned int numberOfFaces;
-
-	memcpy(&numberOfVertexes, data + size, sizeof(unsigned int));
-	size += sizeof(unsigned int);
-
-	memcpy(&numberOfFaces, data + size, sizeof(unsigned int));
+	unsigned int numberOfLods;
+	memcpy(&numberOfLods, data + size, sizeof(unsigned int));
 	size += sizeof(unsigned int);
-
-#if defined(DEBUG) || defined(_DEBUG)
-	std::cout << "LOD " << ": " << numberOfVertexes << " vertexes, " << numberOfFaces << " faces." << std::endl;
-#endif
-
-	for (int v = 0; v < numberOfVertexes; ++v)
+	if (!LodCountFits(numberOfLods, size, chunkSize))
 	{
-		// Read vertex data
-		glm::vec3 vertex;
-		memcpy(&vertex, data + size, sizeof(glm::vec3));
-		size += sizeof(glm::vec3);
-
-		meshVertexList.push_back(vertex);
-
-		// Vertex normal
-		unsigned int normalData;
-		memcpy(&normalData, data + size, sizeof(unsigned int));
-		size += sizeof(unsigned int);
-		meshNormalList.push_back(glm::unpackSnorm3x10_1x2(normalData));
-
-		// Texture coordinates
-		unsigned int textureData;
-		memcpy(&textureData, data + size, sizeof(unsigned int));
-		size += sizeof(unsigned int);
-		meshTextureCoordList.push_back(glm::unpackHalf2x16(textureData));
-
-		// Tangent vector
-		unsigned int tangentData;
-		memcpy(&tangentData, data + size, sizeof(unsigned int));
-		size += sizeof(unsigned int);
-
-		/*#if defined(DEBUG) || defined(_DEBUG)
-				std::cout << "Vertex data:  v" << v << std::endl;
-				std::cout << " - xyz: " << vertex.x << ", " << vertex.y << ", " << vertex.z << std::endl;
-
-				glm::vec4 normal = glm::unpackSnorm3x10_1x2(normalData);
-				std::cout << " - normal: " << normal.x << ", " << normal.y << ", " << normal.z << std::endl;
-
-				glm::vec2 uv = glm::unpackHalf2x16(textureData);
-				std::cout << " - uv: " << uv.x << ", " << uv.y << std::endl;
-
-				glm::vec4 tangent = glm::unpackSnorm3x10_1x2(tangentData);
-				std::cout << " - tangent: " << tangent.x << ", " << tangent.y << ", " << tangent.z << ", sign: " << tangent.w << std::endl;
-		#endif*/
+		std::cerr << "ERROR: Mesh " << name << " declares " << numberOfLods << " LODs, more than its chunk can hold" << std::endl;
+		numberOfLods = 0;
 	}
 
-	for (int f = 0; f < numberOfFaces; f++)
+	// Decode LOD data here unless a worker already did
+	std::vector<Eng::MeshGeometry> lods;
+	if (!decoded)
 	{
-		unsigned int face[3];
-		memcpy(&face, data + size, sizeof(unsigned int) * 3);
-		size += sizeof(unsigned int) * 3;
-
-		meshFaceList.push_back(glm::uvec3(face[0], face[1], face[2]));
+		lods.resize(numberOfLods);
+		for (unsigned int l = 0; l < numberOfLods; ++l)
+		{
+			Eng::LoadProfiler::Scope scope(activeProfiler(), Eng::LoadProfiler::Category::MESH, Eng::LoadProfiler::Phase::DECODE, "decode");
+			decodeMeshGeometry(data, chunkSize, size, lods[l]);
+		}
+		decoded = lods.data();
+	}
 
-		/*#if defined(DEBUG) || defined(_DEBUG)
-				std::cout << "Face data:  f" << f << std::endl;
-				std::cout << " - v1: " << face[0] << ", v2: " << face[1] << ", v3: " << face[2] << std::endl;
-		#endif*/
+	// Identical geometry met earlier in this load is shared on request, so the copies can be instanced
+	size_t hash = 0;
+	Eng::Mesh* mesh = nullptr;
+	if (geometrySharing)
+	{
+		hash = GeometryHash(decoded, numberOfLods);
+		auto range = loadedGeometries.equal_range(hash);
+		for (auto it = range.first; it != range.second && !mesh; ++it)
+		{
+			if (SameGeometry(it->second, decoded, numberOfLods))
+			{
+				mesh = it->second->createInstance(std::string(name), matrix);
+				mesh->setMaterial(nullptr);
+			}
+		}
 	}
 
-	// Create mesh
-	Eng::Mesh* mesh = new Eng::Mesh(std::string(name), matrix, meshVertexList, meshFaceList, meshNormalList, meshTextureCoordList);
+	if (mesh)
+	{
+		for (unsigned int l = 0; l < numberOfLods; ++l)
+		{
+			decoded[l] = Eng::MeshGeometry();
+		}
+	}
+	else
+	{
+		// Create mesh
+		// The buffers change owner, vertex data is never copied
+		mesh = new Eng::Mesh(std::string(name), matrix, numberOfLods ? std::move(decoded[0]) : Eng::MeshGeometry());
+		for (unsigned int l = 1; l < numberOfLods; ++l)
+		{
+			mesh->addLod(std::move(decoded[l]));
+		}
+		mesh->setBounds(meshRadius, boundingBoxMin, boundingBoxMax);
+		if (geometrySharing)
+		{
+			loadedGeometries.emplace(hash, mesh);
+		}
+	}
 
 #if defined(DEBUG) || defined(_DEBUG)
 	std::cout << name << " Mash has material " << materialName << std::endl;
@@ -519,3 +1319,38 @@ Eng::Node* Eng::OvoReader::processMeshChunk(char* data, unsigned int& size, char
 
 	return mesh;
 }
+
+void Eng::OvoReader::decodeMeshGeometry(const char* data, unsigned int chunkSize, unsigned int& size, Eng::MeshGeometry& mesh)
+{
+	// Counts running past the chunk would read past the end of the file mapping
+	if (LodEnd(data, size, chunkSize) == UINT_MAX)
+	{
+		std::cerr << "ERROR: Mesh LOD at offset " << size << " runs past the end of its " << chunkSize << " byte chunk" << std::endl;
+		size = chunkSize;
+		return;
+	}
+
+	unsigned int numberOfVertexes;
+	unsigned int numberOfFaces;
+
+	memcpy(&numberOfVertexes, data + size, sizeof(unsigned int));
+	size += sizeof(unsigned int);
+
+	memcpy(&numberOfFaces, data + size, sizeof(unsigned int));
+	size += sizeof(unsigned int);
+
+#if defined(DEBUG) || defined(_DEBUG)
+	std::cout << "LOD " << ": " << numberOfVertexes << " vertexes, " << numberOfFaces << " faces." << std::endl;
+#endif
+
+	// Exact-size buffers, then vertex records (position, normal, texture coordinates and tangent) decoded in place in one batch
+	mesh.allocate(numberOfVertexes, numberOfFaces);
+
+	Eng::VertexUnpack::unpack(data + size, numberOfVertexes, mesh.vertexes.data(), mesh.normals.data(), mesh.textureCoordinates.data(), mesh.tangents.data(), Eng::VertexUnpack::getBestPath());
+	size += numberOfVertexes * Eng::VertexUnpack::RECORD_SIZE;
+
+	// Faces are stored as tightly packed index triplets
+	static_assert(sizeof(glm::uvec3) == sizeof(unsigned int) * 3, "glm::uvec3 must be tightly packed");
+	memcpy(mesh.faces.data(), data + size, numberOfFaces * sizeof(glm::uvec3));
+	size += numberOfFaces * sizeof(glm::uvec3);
+}
@@ -29,6 +29,15 @@
 class ENG_API OvoReader final
 {
 public:
+	/**
+	 * @brief Strategy used to read the chunks of an OVO file.
+	 */
+	enum class LoadMode : int
+	{
+		STREAM = 0,		///< Read every chunk with \c fread into a heap buffer.
+		MEMORY_MAPPED,	///< Map the file and parse chunks in place; falls back to \c STREAM if mapping fails.
+	};
+
     /** @brief Default constructor. */
 	OvoReader();
 
@@ -45,18 +54,171 @@ public:
 
 	Eng::Node* load(const std::string& filename);
 
+    /**
+     * @brief Selects how the next \c load call reads the file (default is \c LoadMode::MEMORY_MAPPED).
+     * @param mode The requested \c LoadMode.
+     */
+	void setLoadMode(LoadMode mode);
+
+    /**
+     * @brief Gets the currently requested load mode.
+     * @return The \c LoadMode used by the next \c load call.
+     */
+	LoadMode getLoadMode() const;
+
+    /**
+     * @brief Tells whether the last \c load call actually parsed a memory-mapped file.
+     * @return \c false if the stream path was requested or used as a fallback.
+     */
+	bool wasMemoryMapped() const;
+
+    /**
+     * @brief Sets how many worker threads decode mesh payloads during \c load.
+     *
+     * With more than one worker the scene is loaded in two phases: the node hierarchy is first
+     * indexed by scanning chunk headers, then mesh geometry is decoded in parallel before the
+     * nodes are built in file order. The resulting scene graph is identical to a serial load.
+     * @param count Number of workers; \c 0 or \c 1 keeps the serial loader. Defaults to the hardware concurrency.
+     */
+	void setWorkerThreads(unsigned int count);
+
+    /**
+     * @brief Gets the number of worker threads used to decode mesh payloads.
+     * @return The configured worker count.
+     */
+	unsigned int getWorkerThreads() const;
+
+    /**
+     * @brief Lets meshes with identical geometry share it (disabled by default).
+     *
+     * When enabled, every mesh decoded by \c load or \c loadAsync is hashed and compared with the
+     * meshes built earlier in the same load; a match becomes a copy sharing the geometry, as if made
+     * with \c Eng::Mesh::createInstance, so \c Eng::List can draw them together. Editing the vertexes
+     * of one copy then changes all of them.
+     * @param enabled \c true to share identical geometry.
+     */
+	void setGeometrySharing(bool enabled);
+
+    /**
+     * @brief Tells whether identical geometry is shared between the meshes of a load.
+     * @return \c true if \c setGeometrySharing enabled it.
+     */
+	bool isGeometrySharingEnabled() const;
+
+    /**
+     * @brief Starts loading a scene file on a background thread.
+     *
+     * The background thread only reads the file, indexes the node hierarchy and decodes mesh
+     * payloads; every engine object is created on the calling thread by \c update. The root node of
+     * the file is merged into \c root (name and matrix) and its child subtrees are attached to
+     * \c root one by one as soon as their meshes are decoded.
+     * @param filename The full path to the .ovo scene file.
+     * @param root The node receiving the scene; must stay alive until loading completes.
+     * @return \c false if a load is already in progress.
+     */
+	bool loadAsync(const std::string& filename, Eng::Node* root);
+
+    /**
+     * @brief Creates and attaches everything decoded so far by \c loadAsync. Must be called from the rendering thread.
+     * @return \c true once the asynchronous load is over (successfully or not), \c false while it is still running.
+     */
+	bool update();
+
+    /**
+     * @brief Gets the progress of the current asynchronous load.
+     * @return The fraction of nodes attached to the scene, from 0 to 1.
+     */
+	float getProgress() const;
+
+    /**
+     * @brief Tells whether the last asynchronous load produced a scene.
+     * @return \c false if the file could not be read or contains no nodes.
+     */
+	bool hasAsyncSucceeded() const;
+
+    /**
+     * @brief Enables the load profiler for the next \c load or \c loadAsync calls.
+     *
+     * When enabled, every load prints a per chunk type and per phase summary to the standard output
+     * and writes a Chrome trace JSON file. Profiling is also enabled by setting the \c ENG_LOAD_PROFILE
+     * environment variable to any value but "0"; a value ending in ".json" is used as the trace path.
+     * @param enabled \c true to profile loads.
+     * @param tracePath Trace output path; empty to write "<scene file>.trace.json".
+     */
+	void setProfilingEnabled(bool enabled, const std::string& tracePath = "");
+
+    /**
+     * @brief Tells whether loads are profiled.
+     * @return \c true if the load profiler is enabled.
+     */
+	bool isProfilingEnabled() const;
+
+    /**
+     * @brief Gets the measures of the last profiled load.
+     * @return A reference to the \c LoadProfiler.
+     */
+	const Eng::LoadProfiler& getProfiler() const;
+
 private:
-    /** @brief File pointer used for reading the OVO file. */
+    /** @brief File pointer used for reading the OVO file (stream mode only). */
 	FILE* file;
 
+	/** @brief Start of the read-only file mapping, or \c nullptr when reading through \c file. */
+	const char* mappedData;
+
+	/** @brief Size in bytes of the file mapping. */
+	size_t mappedSize;
+
+	/** @brief Read cursor inside the file mapping. */
+	size_t mappedPosition;
+
+	/** @brief Requested load strategy. */
+	LoadMode loadMode;
+
+	/** @brief Whether the last load went through the memory-mapped path. */
+	bool lastLoadMapped;
+
+	/** @brief Number of threads decoding mesh payloads (serial loader when lower than 2). */
+	unsigned int workerThreads;
+
+	/** @brief Whether meshes with identical geometry share it. */
+	bool geometrySharing;
+
+	/** @brief Whether loads are profiled. */
+	bool profilingEnabled;
+
+	/** @brief Chrome trace output path, empty to derive it from the scene file name. */
+	std::string tracePath;
+
+	/** @brief Measures of the last profiled load. */
+	Eng::LoadProfiler profiler;
+
 	/** @brief The base directory path of the loaded file, used to resolve relative paths for assets (textures). */
 	std::string basePath;
 
+	/**
+	 * @brief Forward declaration of the state shared with the asynchronous loading thread.
+	 * @internal
+	 */
+	struct AsyncState;
+
+	/** @brief State of the current asynchronous load, or \c nullptr. */
+	std::unique_ptr<AsyncState> async;
+
+	/**
+	 * @brief Forward declaration of the worker threads decoding mesh payloads.
+	 * @internal
+	 */
+	struct DecodePool;
+
+	/** @brief Mesh decoders, kept between loads. */
+	std::unique_ptr<DecodePool> decodePool;
+
 	/** @brief Cache for loaded materials to prevent duplicate loading and manage references. */
 	std::map<std::string, Eng::Material*> materials;
 
-	/** @brief Cache for loaded textures to prevent duplicate loading and manage references. */
-	std::map<std::string, Eng::Texture*> textures;
+	/** @brief Meshes built by the current load, by hash of their geometry, so identical geometry is shared instead of duplicated (see \c setGeometrySharing). */
+	std::multimap<size_t, Eng::Mesh*> loadedGeometries;
 
 	/**
 	 * @brief Enumeration of supported object types found within the OVO file format.
@@ -83,6 +245,94 @@ private:
 		SPOT,			///< Spotlight.
 	};
 
+	/**
+	 * @brief Entry of the offset table built while indexing the node hierarchy.
+	 *
+	 * Records are stored in file (pre-order) order, so a node is always followed by its subtree.
+	 */
+	struct NodeRecord
+	{
+		Type type;							///< Chunk type (\c NODE, \c LIGHT or \c MESH).
+		const char* data;					///< Chunk payload.
+		unsigned int size;					///< Chunk payload size in bytes.
+		unsigned int numberOfChildren;		///< Number of direct children following in the table.
+		unsigned int numberOfLods;			///< Number of LODs (meshes only).
+		int mesh;							///< Index of the first decoded LOD geometry, or -1 for non-mesh nodes.
+	};
+
+	/**
+	 * @brief Location of one mesh LOD payload, the unit of work of the parallel decoder.
+	 */
+	struct GeometryRecord
+	{
+		const char* data;					///< Payload of the mesh chunk.
+		unsigned int offset;				///< Offset of the LOD data inside the payload.
+		unsigned int size;					///< Payload size in bytes.
+	};
+
+    /**
+     * @brief Sets the directory used to resolve asset paths from the path of the scene file.
+     * @param filename The path of the scene file.
+     * @private
+     */
+	void setBasePath(const std::string& filename);
+
+    /**
+     * @brief Gets the profiler receiving the measures of the current load.
+     * @return A pointer to \c profiler, or \c nullptr when profiling is disabled.
+     * @private
+     */
+	Eng::LoadProfiler* activeProfiler();
+
+    /**
+     * @brief Stops the profiler, prints its summary and writes the trace of a finished load.
+     * @param filename The path of the scene file.
+     * @private
+     */
+	void reportProfile(const std::string& filename);
+
+    /**
+     * @brief Maps a chunk type to the profiler category it is reported under.
+     * @param type The chunk \c Type.
+     * @return The matching \c LoadProfiler::Category.
+     * @private
+     */
+	static Eng::LoadProfiler::Category getProfileCategory(Type type);
+
+    /**
+     * @brief Maps the whole file read-only into memory.
+     * @param filename The path of the file to map.
+     * @return \c true on success, \c false if the caller should fall back to the stream path.
+     * @private
+     */
+	bool mapFile(const std::string& filename);
+
+    /**
+     * @brief Releases the file mapping, if any.
+     * @private
+     */
+	void unmapFile();
+
+    /**
+     * @brief Reads the next chunk header and gives access to its payload.
+     *
+     * In memory-mapped mode \c chunkData points directly into the mapping; in stream mode
+     * it is a heap buffer that must be handed back through \c releaseChunk.
+     * @param chunkId Receives the chunk type identifier.
+     * @param chunkSize Receives the chunk payload size in bytes.
+     * @param chunkData Receives a pointer to the chunk payload.
+     * @return \c false at the end of the file or on a truncated chunk.
+     * @private
+     */
+	bool nextChunk(unsigned int& chunkId, unsigned int& chunkSize, const char*& chunkData);
+
+    /**
+     * @brief Releases a payload obtained from \c nextChunk (no-op in memory-mapped mode).
+     * @param chunkData The payload pointer returned by \c nextChunk.
+     * @private
+     */
+	void releaseChunk(const char* chunkData);
+
     /**
      * @brief Recursively loads the next node in the scene graph from the file stream.
      * @return A pointer to the loaded \c Eng::Node, or \c nullptr if loading is complete or failed.
@@ -90,22 +340,99 @@ private:
      */
 	Eng::Node* loadNextNode();
 
+    /**
+     * @brief Loads the whole hierarchy rooted at an already read chunk using the two-phase parallel loader.
+     *
+     * Phase one reads the chunks of the subtree into an offset table, phase two decodes all
+     * mesh payloads on \c workerThreads threads, then the nodes are built serially in file order.
+     * @param data Payload of the root chunk.
+     * @param size Size in bytes of the root chunk payload.
+     * @param type The \c Type of the root chunk.
+     * @return A pointer to the root \c Eng::Node, or \c nullptr on failure.
+     * @private
+     */
+	Eng::Node* loadHierarchy(const char* data, unsigned int size, Type type);
+
+    /**
+     * @brief Reads the chunks of the hierarchy rooted at an already read chunk into an offset table.
+     * @param data Payload of the root chunk.
+     * @param size Size in bytes of the root chunk payload.
+     * @param type The \c Type of the root chunk.
+     * @param records Receives the records, in file (pre-order) order.
+     * @param geometries Receives the LOD payloads of the meshes, in file order.
+     * @private
+     */
+	void indexHierarchy(const char* data, unsigned int size, Type type, std::vector<NodeRecord>& records, std::vector<GeometryRecord>& geometries);
+
+    /**
+     * @brief Body of the asynchronous loading thread: reads, indexes and decodes the scene file.
+     * @private
+     */
+	void runAsync();
+
+    /**
+     * @brief Waits for the asynchronous loading thread and releases the file data it read.
+     * @private
+     */
+	void finishAsync();
+
+    /**
+     * @brief Decodes a range of mesh LOD payloads on a pool of \c workerThreads threads, started by the first call.
+     * @param geometries The LOD payloads.
+     * @param meshes Receives the decoded geometry (indexed like \c geometries).
+     * @param first Index of the first LOD to decode.
+     * @param last Index past the last LOD to decode.
+     * @private
+     */
+	void decodeMeshes(const std::vector<GeometryRecord>& geometries, std::vector<Eng::MeshGeometry>& meshes, unsigned int first, unsigned int last);
+
+    /**
+     * @brief Job of \c decodeMeshes: decodes one LOD payload of the current batch.
+     * @param context The reader.
+     * @param index The index of the LOD from the first one of the batch.
+     * @private
+     */
+	static void runDecodeJob(void* context, unsigned int index);
+
+    /**
+     * @brief Builds a node and its subtree from the offset table.
+     * @param records The offset table of the hierarchy.
+     * @param meshes The decoded mesh geometry referenced by the records.
+     * @param index Reference to the index of the next record to consume.
+     * @return A pointer to the created \c Eng::Node, or \c nullptr on failure.
+     * @private
+     */
+	Eng::Node* buildNode(const std::vector<NodeRecord>& records, std::vector<Eng::MeshGeometry>& meshes, size_t& index);
+
+    /**
+     * @brief Decodes the vertex and face data of a mesh LOD. Thread-safe, touches no reader state.
+     *
+     * A LOD whose counts run past the end of the chunk is left empty and moves \c size to the end
+     * of the chunk, so the following LODs are refused too.
+     * @param data Pointer to the chunk data buffer.
+     * @param chunkSize Size in bytes of the chunk data.
+     * @param size Reference to the offset of the LOD data, advanced past it.
+     * @param mesh Receives the decoded geometry.
+     * @private
+     */
+	static void decodeMeshGeometry(const char* data, unsigned int chunkSize, unsigned int& size, Eng::MeshGeometry& mesh);
+
     /**
      * @brief Processes a generic object chunk (currently unused, but represents the base object properties).
      * @param data Pointer to the chunk data buffer.
      * @param size Reference to the size of the chunk data.
      * @private
      */
-	void processObjectChunk(char* data, unsigned int& size);
+	void processObjectChunk(const char* data, unsigned int& size);
 
     /**
-     * @brief Processes a texture chunk, loads the asset, and returns the created \c Eng::Texture object.
+     * @brief Processes a texture chunk and returns the matching \c Eng::Texture from the \c TextureCache.
      * @param data Pointer to the chunk data buffer.
      * @param size Reference to the size of the chunk data.
-     * @return A pointer to the newly created \c Eng::Texture object.
+     * @return A pointer to the shared \c Eng::Texture object, retained for the caller, or \c nullptr if the material has no texture.
      * @private
      */
-	Eng::Texture* processTextureChunk(char* data, unsigned int& size);
+	Eng::Texture* processTextureChunk(const char* data, unsigned int& size);
 
     /**
      * @brief Processes a material chunk and creates a \c Eng::Material object, caching it in the \c materials map.
@@ -113,17 +440,31 @@ private:
      * @param size Reference to the size of the chunk data.
      * @private
      */
-	void processMaterialChunk(char* data, unsigned int& size);
+	void processMaterialChunk(const char* data, unsigned int& size);
 
     /**
      * @brief Processes a general node chunk and constructs the appropriate \c Eng::Node derived object.
      * @param data Pointer to the chunk data buffer.
+     * @param chunkSize Size in bytes of the chunk data.
      * @param size Reference to the size of the chunk data.
      * @param type The specific \c Type of node to be created (e.g., \c NODE, \c MESH, \c LIGHT).
      * @return A pointer to the created \c Eng::Node or derived object.
      * @private
      */
-	Eng::Node* processNodeChunk(char* data, unsigned int& size, Type type);
+	Eng::Node* processNodeChunk(const char* data, unsigned int chunkSize, unsigned int& size, Type type);
+
+    /**
+     * @brief Reads a node header and creates the node, without loading its children.
+     * @param data Pointer to the chunk data buffer.
+     * @param chunkSize Size in bytes of the chunk data.
+     * @param size Reference to the size of the chunk data.
+     * @param type The specific \c Type of node to be created.
+     * @param numberOfChildren Receives the number of children declared by the node.
+     * @param decoded Already decoded LOD geometries (one per LOD of the mesh), or \c nullptr to decode them from \c data.
+     * @return A pointer to the created \c Eng::Node or derived object.
+     * @private
+     */
+	Eng::Node* createNode(const char* data, unsigned int chunkSize, unsigned int& size, Type type, unsigned int& numberOfChildren, Eng::MeshGeometry* decoded);
 	
     /**
      * @brief Processes a light chunk, extracts light-specific properties, and creates the appropriate \c Eng::Light derived object.
@@ -134,16 +475,18 @@ private:
      * @return A pointer to the created \c Eng::Light derived object.
      * @private
      */
-    Eng::Node* processLightChunk(char* data, unsigned int& size, char* name, glm::mat4& matrix);
+    Eng::Node* processLightChunk(const char* data, unsigned int& size, char* name, glm::mat4& matrix);
 	
     /**
      * @brief Processes a mesh chunk, extracts geometry and material references, and creates an \c Eng::Mesh object.
      * @param data Pointer to the chunk data buffer.
+     * @param chunkSize Size in bytes of the chunk data.
      * @param size Reference to the size of the chunk data.
      * @param name Name of the mesh object.
      * @param matrix Local transformation matrix of the mesh.
+     * @param decoded Already decoded LOD geometries (one per LOD of the mesh), or \c nullptr to decode them from \c data.
      * @return A pointer to the created \c Eng::Mesh object.
      * @private
      */
-    Eng::Node* processMeshChunk(char* data, unsigned int& size, char* name, glm::mat4& matrix);
+    Eng::Node* processMeshChunk(const char* data, unsigned int chunkSize, unsigned int& size, char* name, glm::mat4& matrix, Eng::MeshGeometry* decoded);
 };
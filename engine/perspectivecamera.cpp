@@ -15,7 +15,10 @@ namespace Eng
     /////////////////////////////
 
     PerspectiveCamera::PerspectiveCamera(const std::string &name,
-                                         const glm::mat4 &matrix) : Camera(name, matrix) {}
+                                         const glm::mat4 &matrix) : Camera(name, matrix)
+    {
+        setKind(Kind::PERSPECTIVE_CAMERA);
+    }
 
     PerspectiveCamera::~PerspectiveCamera() {}
 
@@ -0,0 +1,658 @@
+/**
+ * @file    shadowmap.cpp
+ * @brief   ShadowMap class implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#include "engine.h"
+
+// Freeglut:
+#include <GL/freeglut.h>
+
+#ifndef _WIN32
+#include <GL/glx.h>
+#endif
+
+// GLM:
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// C/C++:
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+/////////////
+// #DEFINE //
+/////////////
+
+// Depth texture, multitexture and framebuffer enums (OpenGL 1.3, 1.4 and 3.0), missing from the Windows 1.1 headers:
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0 0x84C0
+#endif
+#ifndef GL_TEXTURE1
+#define GL_TEXTURE1 0x84C1
+#endif
+#ifndef GL_TEXTURE2
+#define GL_TEXTURE2 0x84C2
+#endif
+#ifndef GL_TEXTURE3
+#define GL_TEXTURE3 0x84C3
+#endif
+#ifndef GL_MAX_TEXTURE_UNITS
+#define GL_MAX_TEXTURE_UNITS 0x84E2
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_CLAMP_TO_BORDER
+#define GL_CLAMP_TO_BORDER 0x812D
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+#ifndef GL_DEPTH_TEXTURE_MODE
+#define GL_DEPTH_TEXTURE_MODE 0x884B
+#endif
+#ifndef GL_TEXTURE_COMPARE_MODE
+#define GL_TEXTURE_COMPARE_MODE 0x884C
+#endif
+#ifndef GL_TEXTURE_COMPARE_FUNC
+#define GL_TEXTURE_COMPARE_FUNC 0x884D
+#endif
+#ifndef GL_COMPARE_R_TO_TEXTURE
+#define GL_COMPARE_R_TO_TEXTURE 0x884E
+#endif
+#ifndef GL_COMBINE
+#define GL_COMBINE 0x8570
+#endif
+#ifndef GL_COMBINE_RGB
+#define GL_COMBINE_RGB 0x8571
+#endif
+#ifndef GL_COMBINE_ALPHA
+#define GL_COMBINE_ALPHA 0x8572
+#endif
+#ifndef GL_INTERPOLATE
+#define GL_INTERPOLATE 0x8575
+#endif
+#ifndef GL_CONSTANT
+#define GL_CONSTANT 0x8576
+#endif
+#ifndef GL_PRIMARY_COLOR
+#define GL_PRIMARY_COLOR 0x8577
+#endif
+#ifndef GL_PREVIOUS
+#define GL_PREVIOUS 0x8578
+#endif
+#ifndef GL_SOURCE0_RGB
+#define GL_SOURCE0_RGB 0x8580
+#define GL_SOURCE1_RGB 0x8581
+#define GL_SOURCE0_ALPHA 0x8588
+#define GL_SOURCE1_ALPHA 0x8589
+#define GL_SOURCE2_ALPHA 0x858A
+#define GL_OPERAND0_RGB 0x8590
+#define GL_OPERAND1_RGB 0x8591
+#define GL_OPERAND0_ALPHA 0x8598
+#define GL_OPERAND1_ALPHA 0x8599
+#define GL_OPERAND2_ALPHA 0x859A
+#endif
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_FRAMEBUFFER_BINDING
+#define GL_FRAMEBUFFER_BINDING 0x8CA6
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_DEPTH_ATTACHMENT
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#endif
+
+/////////////
+// GLOBALS //
+/////////////
+
+typedef void(APIENTRY *ActiveTextureProc)(GLenum texture);
+typedef void(APIENTRY *GenFramebuffersProc)(GLsizei n, GLuint *framebuffers);
+typedef void(APIENTRY *BindFramebufferProc)(GLenum target, GLuint framebuffer);
+typedef void(APIENTRY *FramebufferTexture2DProc)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+typedef GLenum(APIENTRY *CheckFramebufferStatusProc)(GLenum target);
+typedef void(APIENTRY *DeleteFramebuffersProc)(GLsizei n, const GLuint *framebuffers);
+
+/** @brief OpenGL entry points above version 1.1, loaded at run time. */
+static struct
+{
+    ActiveTextureProc activeTexture;
+    GenFramebuffersProc genFramebuffers;
+    BindFramebufferProc bindFramebuffer;
+    FramebufferTexture2DProc framebufferTexture2D;
+    CheckFramebufferStatusProc checkFramebufferStatus;
+    DeleteFramebuffersProc deleteFramebuffers;
+} gl = {};
+
+/** @brief Share of the light removed from shadowed fragments. */
+static const float shadowStrength = 0.5f;
+
+/**
+ * @brief Gets the address of an OpenGL function; requires a current context.
+ * @param name The function name.
+ * @return The function, or \c nullptr if it is not available.
+ */
+static void *GetGLProcAddress(const char *name)
+{
+#ifdef _WIN32
+    return (void *)wglGetProcAddress(name);
+#else
+    return (void *)glXGetProcAddressARB((const GLubyte *)name);
+#endif
+}
+
+/**
+ * @brief Loads the framebuffer and multitexture functions once; requires a current OpenGL 3.0 context.
+ * @return \c true if shadow maps are supported.
+ */
+static bool LoadShadowFunctions()
+{
+    static bool loaded = false;
+    static bool supported = false;
+    if (loaded)
+        return supported;
+    loaded = true;
+
+    int major = 0, minor = 0;
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if (!version || sscanf(version, "%d.%d", &major, &minor) != 2 || major < 3)
+        return false;
+
+    gl.activeTexture = (ActiveTextureProc)GetGLProcAddress("glActiveTexture");
+    gl.genFramebuffers = (GenFramebuffersProc)GetGLProcAddress("glGenFramebuffers");
+    gl.bindFramebuffer = (BindFramebufferProc)GetGLProcAddress("glBindFramebuffer");
+    gl.framebufferTexture2D = (FramebufferTexture2DProc)GetGLProcAddress("glFramebufferTexture2D");
+    gl.checkFramebufferStatus = (CheckFramebufferStatusProc)GetGLProcAddress("glCheckFramebufferStatus");
+    gl.deleteFramebuffers = (DeleteFramebuffersProc)GetGLProcAddress("glDeleteFramebuffers");
+
+    supported = gl.activeTexture && gl.genFramebuffers && gl.bindFramebuffer && gl.framebufferTexture2D &&
+                gl.checkFramebufferStatus && gl.deleteFramebuffers;
+#if defined(DEBUG) || defined(_DEBUG)
+    if (!supported)
+        std::cout << "Framebuffer objects not supported, no shadow maps" << std::endl;
+#endif
+    return supported;
+}
+
+/**
+ * @brief Gets an up vector that is not parallel to a direction.
+ * @param direction The view direction.
+ * @return The up vector for \c glm::lookAt.
+ */
+static glm::vec3 UpVector(const glm::vec3 &direction)
+{
+    return std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+namespace Eng
+{
+
+    /////////////////////
+    // ShadowMap CLASS //
+    /////////////////////
+
+    ShadowMap::ShadowMap(unsigned int resolution, unsigned int cascades)
+        : resolution(std::max(resolution, 16u)),
+          cascades(std::clamp(cascades, 1u, MAX_CASCADES)),
+          numberOfMaps(0),
+          directional(false),
+          splits{},
+          lightPlane(0.0f),
+          framebuffer(0),
+          depthTextures{},
+          allocatedResolutions{},
+          frontTexture(0),
+          savedViewport{},
+          savedFramebuffer(0)
+    {
+    }
+
+    ShadowMap::~ShadowMap()
+    {
+        release();
+    }
+
+    void ShadowMap::setResolution(unsigned int resolution)
+    {
+        this->resolution = std::max(resolution, 16u);
+    }
+
+    unsigned int ShadowMap::getResolution() const
+    {
+        return resolution;
+    }
+
+    void ShadowMap::setNumberOfCascades(unsigned int cascades)
+    {
+        this->cascades = std::clamp(cascades, 1u, MAX_CASCADES);
+    }
+
+    unsigned int ShadowMap::getNumberOfCascades() const
+    {
+        return cascades;
+    }
+
+    unsigned int ShadowMap::getNumberOfMaps() const
+    {
+        return numberOfMaps;
+    }
+
+    const glm::mat4 &ShadowMap::getMatrix(unsigned int map) const
+    {
+        return matrices[std::min(map, MAX_CASCADES - 1)];
+    }
+
+    void ShadowMap::getDepthRange(unsigned int map, float &nearDepth, float &farDepth) const
+    {
+        map = std::min(map, MAX_CASCADES - 1);
+        nearDepth = splits[map];
+        farDepth = splits[map + 1];
+    }
+
+    void ShadowMap::computeCascadeSplits(float nearPlane, float farPlane, unsigned int cascades, float lambda, float *splits)
+    {
+        // Logarithmic splits keep the texel density even over depth, uniform ones avoid tiny first cascades
+        for (unsigned int c = 0; c <= cascades; c++)
+        {
+            float fraction = (float)c / cascades;
+            float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+            float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+            splits[c] = lambda * logarithmic + (1.0f - lambda) * uniform;
+        }
+        splits[0] = nearPlane;
+        splits[cascades] = farPlane;
+    }
+
+    void ShadowMap::setupPerspective(const glm::vec3 &position, const glm::vec3 &direction, float fieldOfView, float farPlane)
+    {
+        directional = false;
+        numberOfMaps = 1;
+        splits[0] = 0.0f;
+        splits[1] = FLT_MAX;
+
+        glm::vec3 forward = glm::normalize(direction);
+        float nearPlane = std::max(farPlane * 0.002f, 0.01f);
+        glm::mat4 view = glm::lookAt(position, position + forward, UpVector(forward));
+        glm::mat4 projection = glm::perspective(glm::radians(std::clamp(fieldOfView, 1.0f, 170.0f)), 1.0f, nearPlane, farPlane);
+        matrices[0] = projection * view;
+
+        lightPlane = glm::vec4(forward, -glm::dot(forward, position));
+    }
+
+    void ShadowMap::setupDirectional(const glm::vec3 &direction, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix,
+                                     float nearPlane, float farPlane, const glm::vec4 &sceneSphere, const glm::vec4 &casterSphere)
+    {
+        directional = true;
+        numberOfMaps = cascades;
+
+        // Nothing to shadow past the far side of the scene
+        glm::vec3 sceneCenter(sceneSphere);
+        float sceneFar = -(viewMatrix * glm::vec4(sceneCenter, 1.0f)).z + sceneSphere.w;
+        float shadowFar = std::clamp(sceneFar, nearPlane * 1.01f, farPlane);
+        computeCascadeSplits(nearPlane, shadowFar, cascades, 0.75f, splits);
+
+        // Frustum edges from the near to the far plane: view depth is linear along each of them
+        glm::mat4 inverseViewProjection = glm::inverse(projectionMatrix * viewMatrix);
+        glm::vec3 nearCorners[4], farCorners[4];
+        for (int c = 0; c < 4; c++)
+        {
+            float x = (c & 1) ? 1.0f : -1.0f, y = (c & 2) ? 1.0f : -1.0f;
+            glm::vec4 nearCorner = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+            glm::vec4 farCorner = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+            nearCorners[c] = glm::vec3(nearCorner) / nearCorner.w;
+            farCorners[c] = glm::vec3(farCorner) / farCorner.w;
+        }
+
+        glm::vec3 forward = glm::normalize(direction);
+        glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), forward, UpVector(forward));
+        float casterDepth = (lightView * glm::vec4(glm::vec3(casterSphere), 1.0f)).z;
+
+        for (unsigned int map = 0; map < numberOfMaps; map++)
+        {
+            glm::vec2 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+            for (unsigned int end = 0; end < 2; end++)
+            {
+                float t = (splits[map + end] - nearPlane) / (farPlane - nearPlane);
+                for (int c = 0; c < 4; c++)
+                {
+                    glm::vec3 corner = nearCorners[c] + (farCorners[c] - nearCorners[c]) * t;
+                    glm::vec2 light = glm::vec2(lightView * glm::vec4(corner, 1.0f));
+                    boundsMin = glm::min(boundsMin, light);
+                    boundsMax = glm::max(boundsMax, light);
+                }
+            }
+
+            // Square maps moved in whole texels, so shadows do not shimmer while the camera moves
+            float size = std::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y);
+            float texel = size / resolution;
+            glm::vec2 center = (boundsMin + boundsMax) * 0.5f;
+            center = glm::vec2(std::floor(center.x / texel) * texel, std::floor(center.y / texel) * texel);
+            size += 2.0f * texel;
+
+            glm::mat4 projection = glm::ortho(center.x - size * 0.5f, center.x + size * 0.5f, center.y - size * 0.5f, center.y + size * 0.5f,
+                                              -(casterDepth + casterSphere.w), -(casterDepth - casterSphere.w));
+            matrices[map] = projection * lightView;
+        }
+    }
+
+    bool ShadowMap::isSupported()
+    {
+        return LoadShadowFunctions();
+    }
+
+    bool ShadowMap::allocate(unsigned int map)
+    {
+        if (!LoadShadowFunctions())
+            return false;
+
+        if (framebuffer == 0)
+        {
+            GLuint id;
+            gl.genFramebuffers(1, &id);
+            framebuffer = id;
+        }
+
+        if (depthTextures[map] != 0 && allocatedResolutions[map] == resolution)
+            return true;
+
+        if (depthTextures[map] == 0)
+        {
+            GLuint id;
+            glGenTextures(1, &id);
+            depthTextures[map] = id;
+        }
+
+        // Fragments outside the map read the border and stay lit
+        GLfloat border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glBindTexture(GL_TEXTURE_2D, depthTextures[map]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+
+        // The comparison gives 1 where the fragment is farther from the light than the map, in alpha
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_GREATER);
+        glTexParameteri(GL_TEXTURE_2D, GL_DEPTH_TEXTURE_MODE, GL_ALPHA);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        allocatedResolutions[map] = resolution;
+        return true;
+    }
+
+    void ShadowMap::release()
+    {
+        for (unsigned int &texture : depthTextures)
+        {
+            if (texture != 0)
+            {
+                GLuint id = texture;
+                glDeleteTextures(1, &id);
+                texture = 0;
+            }
+        }
+        if (frontTexture != 0)
+        {
+            GLuint id = frontTexture;
+            glDeleteTextures(1, &id);
+            frontTexture = 0;
+        }
+        if (framebuffer != 0 && gl.deleteFramebuffers)
+        {
+            GLuint id = framebuffer;
+            gl.deleteFramebuffers(1, &id);
+        }
+        framebuffer = 0;
+    }
+
+    bool ShadowMap::beginDepthPass(unsigned int map)
+    {
+        if (map >= numberOfMaps || !allocate(map))
+            return false;
+
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFramebuffer);
+
+        gl.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        gl.framebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextures[map], 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (gl.checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "ERROR: Shadow map framebuffer incomplete" << std::endl;
+            gl.bindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+            return false;
+        }
+
+        glViewport(0, 0, resolution, resolution);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        // Pushed back a little, so lit surfaces do not shadow themselves
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadMatrixf(glm::value_ptr(matrices[map]));
+        glMatrixMode(GL_MODELVIEW);
+        return true;
+    }
+
+    void ShadowMap::endDepthPass()
+    {
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        gl.bindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+    }
+
+    void ShadowMap::setTextureGeneration(unsigned int map, const glm::mat4 &viewMatrix)
+    {
+        // From clip space of the light to [0, 1] texture and depth coordinates
+        glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+        glm::mat4 texture = bias * matrices[map];
+
+        // Eye planes are taken through the inverse of the current modelview: with the camera view
+        // loaded they are given in world space
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadMatrixf(glm::value_ptr(viewMatrix));
+
+        const GLenum coordinates[4] = {GL_S, GL_T, GL_R, GL_Q};
+        const GLenum generators[4] = {GL_TEXTURE_GEN_S, GL_TEXTURE_GEN_T, GL_TEXTURE_GEN_R, GL_TEXTURE_GEN_Q};
+        for (int r = 0; r < 4; r++)
+        {
+            GLfloat plane[4] = {texture[0][r], texture[1][r], texture[2][r], texture[3][r]};
+            glTexGeni(coordinates[r], GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
+            glTexGenfv(coordinates[r], GL_EYE_PLANE, plane);
+            glEnable(generators[r]);
+        }
+        glPopMatrix();
+    }
+
+    void ShadowMap::beginReceiverPass(unsigned int map, const glm::mat4 &viewMatrix)
+    {
+        gl.activeTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, depthTextures[map]);
+        glEnable(GL_TEXTURE_2D);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        setTextureGeneration(map, viewMatrix);
+
+        // Clip planes, like eye planes, are given in world space with the camera view loaded
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadMatrixf(glm::value_ptr(viewMatrix));
+
+        if (directional)
+        {
+            // Only the depth slice of this cascade, given in eye space
+            glLoadIdentity();
+            GLdouble nearSlice[4] = {0.0, 0.0, -1.0, -splits[map]};
+            GLdouble farSlice[4] = {0.0, 0.0, 1.0, splits[map + 1]};
+            glClipPlane(GL_CLIP_PLANE0, nearSlice);
+            glClipPlane(GL_CLIP_PLANE1, farSlice);
+            glEnable(GL_CLIP_PLANE0);
+            glEnable(GL_CLIP_PLANE1);
+        }
+        else
+        {
+            GLdouble front[4] = {lightPlane.x, lightPlane.y, lightPlane.z, lightPlane.w};
+            glClipPlane(GL_CLIP_PLANE0, front);
+            glEnable(GL_CLIP_PLANE0);
+        }
+        glPopMatrix();
+
+        // Black, with the comparison result scaled by the strength as alpha
+        glColor4f(0.0f, 0.0f, 0.0f, shadowStrength);
+        gl.activeTexture(GL_TEXTURE0);
+    }
+
+    void ShadowMap::endReceiverPass()
+    {
+        glDisable(GL_CLIP_PLANE0);
+        glDisable(GL_CLIP_PLANE1);
+
+        gl.activeTexture(GL_TEXTURE1);
+        glDisable(GL_TEXTURE_GEN_S);
+        glDisable(GL_TEXTURE_GEN_T);
+        glDisable(GL_TEXTURE_GEN_R);
+        glDisable(GL_TEXTURE_GEN_Q);
+        glDisable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        gl.activeTexture(GL_TEXTURE0);
+    }
+
+    bool ShadowMap::isMainPassSupported()
+    {
+        if (!LoadShadowFunctions())
+            return false;
+
+        GLint units = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_UNITS, &units);
+        return units >= 4;
+    }
+
+    bool ShadowMap::beginMainPass(unsigned int map, const glm::mat4 &viewMatrix)
+    {
+        if (map >= numberOfMaps || depthTextures[map] == 0 || !isMainPassSupported())
+            return false;
+
+        if (frontTexture == 0)
+        {
+            // Alpha 0 below s = 0.5, 1 above
+            const GLubyte texels[2] = {0, 255};
+            GLuint id;
+            glGenTextures(1, &id);
+            frontTexture = id;
+            glBindTexture(GL_TEXTURE_1D, frontTexture);
+            glTexImage1D(GL_TEXTURE_1D, 0, GL_ALPHA, 2, 0, GL_ALPHA, GL_UNSIGNED_BYTE, texels);
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_1D, 0);
+        }
+
+        // The color passes through units 1 and 2 untouched, while their alpha builds the shading factor
+        // (texture stages can't scale a color by anything but a single source, so unit 3 applies it)
+
+        // Unit 1: alpha 1 - strength in front of the light, 1 behind it (what the clip plane of the receiver pass leaves out)
+        gl.activeTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, frontTexture);
+        glEnable(GL_TEXTURE_1D);
+        glm::vec4 front = directional ? glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) : lightPlane * 1.0e4f;
+        front.w += 0.5f;
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadMatrixf(glm::value_ptr(viewMatrix));
+        glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
+        glTexGenfv(GL_S, GL_EYE_PLANE, glm::value_ptr(front));
+        glEnable(GL_TEXTURE_GEN_S);
+        glPopMatrix();
+
+        GLfloat strength[4] = {0.0f, 0.0f, 0.0f, 1.0f - shadowStrength};
+        glTexEnvfv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, strength);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_PREVIOUS);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
+        glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_ADD);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_ALPHA, GL_TEXTURE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_ALPHA, GL_CONSTANT);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_ALPHA, GL_SRC_ALPHA);
+
+        // Unit 2: the comparison (1 where shadowed) picks between that and 1
+        gl.activeTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, depthTextures[map]);
+        glEnable(GL_TEXTURE_2D);
+        setTextureGeneration(map, viewMatrix);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_PREVIOUS);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
+        glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_INTERPOLATE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_ALPHA, GL_PREVIOUS);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_SRC_ALPHA);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_ALPHA, GL_TEXTURE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE2_ALPHA, GL_TEXTURE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND2_ALPHA, GL_SRC_ALPHA);
+
+        // Unit 3: color times the factor, alpha back to the lit one (its texture only keeps the unit enabled)
+        gl.activeTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_1D, frontTexture);
+        glEnable(GL_TEXTURE_1D);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_MODULATE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_PREVIOUS);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, GL_PREVIOUS);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_SRC_ALPHA);
+        glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_REPLACE);
+        glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_ALPHA, GL_PRIMARY_COLOR);
+        glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_SRC_ALPHA);
+
+        gl.activeTexture(GL_TEXTURE0);
+        return true;
+    }
+
+    void ShadowMap::endMainPass()
+    {
+        const GLenum units[3] = {GL_TEXTURE1, GL_TEXTURE2, GL_TEXTURE3};
+        for (GLenum unit : units)
+        {
+            gl.activeTexture(unit);
+            glDisable(GL_TEXTURE_GEN_S);
+            glDisable(GL_TEXTURE_GEN_T);
+            glDisable(GL_TEXTURE_GEN_R);
+            glDisable(GL_TEXTURE_GEN_Q);
+            glDisable(GL_TEXTURE_1D);
+            glDisable(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_1D, 0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        }
+        gl.activeTexture(GL_TEXTURE0);
+    }
+
+}; // end of namespace Eng::
@@ -0,0 +1,239 @@
+/**
+ * @file    shadowmap.h
+ * @brief   ShadowMap class
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief Depth maps rendered from a light, used to darken the shadowed parts of the scene.
+ *
+ * The class owns a framebuffer object and one depth texture per map, and computes the light
+ * matrices of the frame: a single perspective map for point and spot lights, or up to
+ * \c MAX_CASCADES orthographic cascades, each covering a depth slice of the camera frustum,
+ * for directional lights. Drawing is left to \c Eng::List: between \c beginDepthPass and
+ * \c endDepthPass casters write their depth; then the fixed pipeline compares every fragment against
+ * the map through eye linear texture coordinate generation (OpenGL 1.4 depth textures and 3.0
+ * framebuffer objects), either during the main pass, between \c beginMainPass and \c endMainPass,
+ * or in an extra pass darkening what is already drawn, between \c beginReceiverPass and \c endReceiverPass.
+ *
+ * The main pass can only take a single map: the texture stages have no per-fragment way to pick the
+ * cascade of a fragment, which the receiver passes do with a pair of clip planes each.
+ */
+class ENG_API ShadowMap final
+{
+public:
+    /** @brief Maximum number of cascades of a directional light. */
+    static constexpr unsigned int MAX_CASCADES = 4;
+
+    /**
+     * @brief Constructor; no OpenGL resource is created until the first depth pass.
+     * @param resolution The width and height of every depth map.
+     * @param cascades The number of cascades used for directional lights.
+     */
+    ShadowMap(unsigned int resolution = 1024, unsigned int cascades = 3);
+
+    /** @brief Destructor, releasing the framebuffer and the depth textures. */
+    ~ShadowMap();
+
+    /**
+     * @brief Deleted copy constructor.
+     * @param ShadowMap const & prevents sharing of the OpenGL resources.
+     */
+    ShadowMap(ShadowMap const&) = delete;
+
+    /**
+     * @brief Deleted assignment operator.
+     * @param ShadowMap const & prevents sharing of the OpenGL resources.
+     */
+    void operator=(ShadowMap const&) = delete;
+
+    /**
+     * @brief Sets the width and height of the depth maps; they are reallocated on the next depth pass.
+     * @param resolution The resolution in texels (at least 16).
+     */
+    void setResolution(unsigned int resolution);
+
+    /**
+     * @brief Gets the width and height of the depth maps.
+     * @return The resolution in texels.
+     */
+    unsigned int getResolution() const;
+
+    /**
+     * @brief Sets the number of cascades used for directional lights.
+     * @param cascades The number of cascades, clamped to [1, \c MAX_CASCADES].
+     */
+    void setNumberOfCascades(unsigned int cascades);
+
+    /**
+     * @brief Gets the number of cascades used for directional lights.
+     * @return The number of cascades.
+     */
+    unsigned int getNumberOfCascades() const;
+
+    /**
+     * @brief Prepares a single perspective map for a point or spot light.
+     * @param position The world position of the light.
+     * @param direction The world direction the light points to.
+     * @param fieldOfView The vertical field of view of the map, in degrees.
+     * @param farPlane The distance covered by the map.
+     */
+    void setupPerspective(const glm::vec3& position, const glm::vec3& direction, float fieldOfView, float farPlane);
+
+    /**
+     * @brief Prepares the cascades of a directional light.
+     *
+     * The camera depth range, limited to the visible scene, is split between the cascades; each is
+     * an orthographic map fitting its slice of the camera frustum and deep enough to include every
+     * caster, visible or not.
+     * @param direction The world direction the light points to.
+     * @param viewMatrix The view matrix of the camera.
+     * @param projectionMatrix The projection matrix of the camera.
+     * @param nearPlane The near plane distance of the camera.
+     * @param farPlane The far plane distance of the camera.
+     * @param sceneSphere The world bounding sphere (center xyz, radius w) of the visible meshes.
+     * @param casterSphere The world bounding sphere (center xyz, radius w) of every shadow caster.
+     */
+    void setupDirectional(const glm::vec3& direction, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+                          float nearPlane, float farPlane, const glm::vec4& sceneSphere, const glm::vec4& casterSphere);
+
+    /**
+     * @brief Gets the number of maps prepared by the last setup.
+     * @return 1 for perspective maps, the number of cascades for directional lights.
+     */
+    unsigned int getNumberOfMaps() const;
+
+    /**
+     * @brief Gets the light view-projection matrix of a map.
+     * @param map The map index.
+     * @return The matrix taking world coordinates into the clip space of the map.
+     */
+    const glm::mat4& getMatrix(unsigned int map) const;
+
+    /**
+     * @brief Gets the camera depth range covered by a map.
+     * @param map The map index.
+     * @param nearDepth Receives the view space distance where the map starts.
+     * @param farDepth Receives the view space distance where the map ends.
+     */
+    void getDepthRange(unsigned int map, float& nearDepth, float& farDepth) const;
+
+    /**
+     * @brief Splits a depth range between cascades, blending logarithmic and uniform splits.
+     * @param nearPlane The start of the range.
+     * @param farPlane The end of the range.
+     * @param cascades The number of cascades.
+     * @param lambda The weight of the logarithmic split (0 uniform, 1 logarithmic).
+     * @param splits Receives \c cascades + 1 increasing distances, from \c nearPlane to \c farPlane.
+     */
+    static void computeCascadeSplits(float nearPlane, float farPlane, unsigned int cascades, float lambda, float* splits);
+
+    /**
+     * @brief Tells whether shadow maps can be rendered; requires a current OpenGL context.
+     * @return \c true if framebuffer objects and depth textures are available.
+     */
+    static bool isSupported();
+
+    /**
+     * @brief Binds the framebuffer to a map and sets up depth only rendering from the light.
+     *
+     * The projection matrix becomes the light view-projection, so casters are drawn with their
+     * world matrix as modelview.
+     * @param map The map index.
+     * @return \c false if the map could not be created.
+     */
+    bool beginDepthPass(unsigned int map);
+
+    /** @brief Restores the framebuffer, viewport, projection and color writes. */
+    void endDepthPass();
+
+    /**
+     * @brief Binds a map on texture unit 1 and generates its texture coordinates from eye space.
+     *
+     * For directional lights, clip planes 0 and 1 limit the pass to the depth slice of the map;
+     * for perspective maps, clip plane 0 leaves out what is behind the light.
+     * @param map The map index.
+     * @param viewMatrix The view matrix of the camera.
+     */
+    void beginReceiverPass(unsigned int map, const glm::mat4& viewMatrix);
+
+    /** @brief Unbinds the map and disables texture coordinate generation and clip planes. */
+    void endReceiverPass();
+
+    /**
+     * @brief Tells whether a map can be applied during the main pass; requires a current OpenGL context.
+     * @return \c true if there are the four fixed pipeline texture units \c beginMainPass uses.
+     */
+    static bool isMainPassSupported();
+
+    /**
+     * @brief Sets up texture units 1 to 3 so that everything drawn until \c endMainPass is darkened where a map is shadowed.
+     *
+     * Unit 1 leaves out what is behind a perspective light, unit 2 compares against the map and unit 3
+     * scales the color of unit 0 (the lit, textured fragment) by the result. Only the fixed pipeline
+     * is shadowed: instanced draws must be disabled meanwhile.
+     * @param map The map index.
+     * @param viewMatrix The view matrix of the camera.
+     * @return \c false if the main pass is not supported.
+     */
+    bool beginMainPass(unsigned int map, const glm::mat4& viewMatrix);
+
+    /** @brief Restores texture units 1 to 3 to their defaults. */
+    void endMainPass();
+
+private:
+    /** @brief Width and height of the depth maps. */
+    unsigned int resolution;
+    /** @brief Number of cascades for directional lights. */
+    unsigned int cascades;
+    /** @brief Number of maps prepared by the last setup. */
+    unsigned int numberOfMaps;
+    /** @brief Whether the last setup was for a directional light. */
+    bool directional;
+
+    /** @brief Light view-projection of every map. */
+    glm::mat4 matrices[MAX_CASCADES];
+    /** @brief Camera depth at the start of every map, plus the end of the last one. */
+    float splits[MAX_CASCADES + 1];
+    /** @brief World plane through a perspective light, facing where it points. */
+    glm::vec4 lightPlane;
+
+    /** @brief Framebuffer object (0 if not created yet). */
+    unsigned int framebuffer;
+    /** @brief Depth texture of every map (0 if not created yet). */
+    unsigned int depthTextures[MAX_CASCADES];
+    /** @brief Resolution of every depth texture (0 if not created yet). */
+    unsigned int allocatedResolutions[MAX_CASCADES];
+    /** @brief Two texel alpha texture telling the front of a perspective light from its back (0 if not created yet). */
+    unsigned int frontTexture;
+
+    /** @brief Viewport saved by \c beginDepthPass. */
+    int savedViewport[4];
+    /** @brief Framebuffer bound before \c beginDepthPass. */
+    int savedFramebuffer;
+
+    /**
+     * @brief Creates the framebuffer and the depth texture of a map, at the current resolution.
+     * @param map The map index.
+     * @return \c false if shadow maps are not supported.
+     * @private
+     */
+    bool allocate(unsigned int map);
+
+    /**
+     * @brief Loads the texture generation planes of a map on the active texture unit.
+     * @param map The map index.
+     * @param viewMatrix The view matrix of the camera.
+     * @private
+     */
+    void setTextureGeneration(unsigned int map, const glm::mat4& viewMatrix);
+
+    /**
+     * @brief Releases the framebuffer and the depth textures.
+     * @private
+     */
+    void release();
+};
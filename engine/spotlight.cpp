@@ -20,6 +20,7 @@ namespace Eng
     SpotLight::SpotLight(std::string name, glm::mat4 matrix, float cutoff)
         : Eng::Light(name, matrix)
     {
+        setKind(Kind::SPOT_LIGHT);
         setCutoff(cutoff);
     }
 
@@ -24,7 +24,10 @@ namespace Eng
 
     Texture::Texture(std::string name, const std::string &filePath)
         : Object(name),
-          texId(0)
+          texId(0),
+          filePath(filePath),
+          residentBytes(0),
+          referenceCount(0)
     {
         if (!filePath.empty())
         {
@@ -34,6 +37,10 @@ namespace Eng
 
     Texture::~Texture()
     {
+        if (!cacheKey.empty())
+        {
+            TextureCache::getInstance().forget(cacheKey);
+        }
         glDeleteTextures(1, &texId);
     }
 
@@ -42,6 +49,34 @@ namespace Eng
         glBindTexture(GL_TEXTURE_2D, texId);
     }
 
+    const std::string &Texture::getFilePath() const
+    {
+        return filePath;
+    }
+
+    size_t Texture::getResidentBytes() const
+    {
+        return residentBytes;
+    }
+
+    void Texture::retain()
+    {
+        referenceCount++;
+    }
+
+    void Texture::release()
+    {
+        if (referenceCount > 0 && --referenceCount == 0)
+        {
+            delete this;
+        }
+    }
+
+    unsigned int Texture::getReferenceCount() const
+    {
+        return referenceCount;
+    }
+
     void Texture::loadTexture(const std::string &filePath)
     {
         // Load an image from file:
@@ -65,5 +100,9 @@ namespace Eng
         int height = FreeImage_GetHeight(bitmap);
 
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, (void *)FreeImage_GetBits(bitmap));
+        residentBytes = (size_t)width * height * 4;
+
+        // The image now lives on the GPU:
+        FreeImage_Unload(bitmap);
     }
 }; // end of namespace Eng::
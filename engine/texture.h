@@ -41,10 +41,52 @@ public:
      */
     void render(glm::mat4 modelview = glm::mat4(1.0f)) override;
 
+    /**
+     * @brief Gets the path of the image file the texture was loaded from.
+     * @return The file path given at construction (empty if none).
+     */
+    const std::string& getFilePath() const;
+
+    /**
+     * @brief Gets the GPU memory used by the texture image.
+     * @return The size in bytes of the uploaded image, or 0 if nothing was uploaded.
+     */
+    size_t getResidentBytes() const;
+
+    /**
+     * @brief Adds a reference to the texture (done by \c Material::setTexture and \c TextureCache::acquire).
+     */
+    void retain();
+
+    /**
+     * @brief Drops a reference to the texture, deleting it when the last one goes away.
+     */
+    void release();
+
+    /**
+     * @brief Gets the number of references held on the texture.
+     * @return The current reference count.
+     */
+    unsigned int getReferenceCount() const;
+
 private:
+    friend class TextureCache;
+
     /** @brief The unique identifier (handle) used by the graphics API (e.g., OpenGL texture ID) for the texture data on the GPU. */
     unsigned int texId;
 
+    /** @brief The file system path of the source image. */
+    std::string filePath;
+
+    /** @brief Size in bytes of the image uploaded to the GPU. */
+    size_t residentBytes;
+
+    /** @brief Number of references held by materials. */
+    unsigned int referenceCount;
+
+    /** @brief Key of the texture in the \c TextureCache, empty if it is not cached. */
+    std::string cacheKey;
+
     /**
      * @brief Internal method to load the image data from a file and upload it to the GPU.
      * @param filePath The file system path to the image file.
@@ -0,0 +1,82 @@
+/**
+ * @file    texturecache.cpp
+ * @brief   TextureCache class implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#include "engine.h"
+
+#include <filesystem>
+#include <iostream>
+
+namespace Eng
+{
+
+    ////////////////////////
+    // TextureCache CLASS //
+    ////////////////////////
+
+    TextureCache::TextureCache()
+    {
+    }
+
+    TextureCache &TextureCache::getInstance()
+    {
+        static TextureCache instance;
+        return instance;
+    }
+
+    std::string TextureCache::resolvePath(const std::string &filePath)
+    {
+        std::error_code error;
+        std::filesystem::path resolved = std::filesystem::weakly_canonical(filePath, error);
+        if (error)
+        {
+            resolved = std::filesystem::absolute(filePath, error).lexically_normal();
+        }
+        return resolved.string();
+    }
+
+    Texture *TextureCache::acquire(const std::string &name, const std::string &filePath)
+    {
+        std::string key = resolvePath(filePath);
+
+        auto it = textures.find(key);
+        if (it != textures.end())
+        {
+#if defined(DEBUG) || defined(_DEBUG)
+            std::cout << "Texture cache hit: " << key << std::endl;
+#endif
+            it->second->retain();
+            return it->second;
+        }
+
+        Texture *texture = new Texture(name, filePath);
+        texture->cacheKey = key;
+        textures[key] = texture;
+        texture->retain();
+        return texture;
+    }
+
+    unsigned int TextureCache::getNumberOfTextures() const
+    {
+        return (unsigned int)textures.size();
+    }
+
+    size_t TextureCache::getResidentBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &entry : textures)
+        {
+            bytes += entry.second->getResidentBytes();
+        }
+        return bytes;
+    }
+
+    void TextureCache::forget(const std::string &key)
+    {
+        textures.erase(key);
+    }
+
+}; // end of namespace Eng::
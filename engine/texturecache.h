@@ -0,0 +1,84 @@
+/**
+ * @file    texturecache.h
+ * @brief   TextureCache class
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief Process-wide cache of the textures loaded from image files. This class is a singleton.
+ *
+ * Textures are keyed by their resolved file path, so every material referring to the same image,
+ * across \c OvoReader instances and scene loads, shares one \c Eng::Texture and one GPU upload.
+ * The cache does not own its textures: they are reference counted by their users (the materials
+ * and the callers of \c acquire) and leave the cache when the last reference is released. Must be used from the rendering thread.
+ */
+class ENG_API TextureCache final
+{
+public:
+    /**
+     * @brief Deleted copy constructor.
+     * @param TextureCache const & prevents copying of the cache instance.
+     */
+    TextureCache(TextureCache const&) = delete;
+
+    /**
+     * @brief Deleted assignment operator.
+     * @param TextureCache const & prevents assignment of the cache instance.
+     */
+    void operator=(TextureCache const&) = delete;
+
+    /**
+     * @brief Gets the single instance of the texture cache.
+     * @return A reference to the cache instance.
+     */
+    static TextureCache& getInstance();
+
+    /**
+     * @brief Gets the texture loaded from an image file, loading it on first use.
+     *
+     * The returned texture is retained for the caller, who must \c Texture::release it once done,
+     * typically right after assigning it to a material.
+     * @param name The name given to the texture if it has to be created.
+     * @param filePath The path of the image file.
+     * @return A pointer to the shared \c Eng::Texture, holding one more reference.
+     */
+    Eng::Texture* acquire(const std::string& name, const std::string& filePath);
+
+    /**
+     * @brief Gets the number of textures currently in the cache.
+     * @return The number of cached textures.
+     */
+    unsigned int getNumberOfTextures() const;
+
+    /**
+     * @brief Gets the GPU memory used by the cached textures.
+     * @return The total size in bytes of the uploaded texture images.
+     */
+    size_t getResidentBytes() const;
+
+    /**
+     * @brief Resolves a file path into the key used by the cache.
+     * @param filePath The path of the image file.
+     * @return The canonical absolute path, so different spellings of a path map to the same texture.
+     */
+    static std::string resolvePath(const std::string& filePath);
+
+private:
+    friend class Texture;
+
+    /** @brief Cached textures, keyed by resolved path. */
+    std::map<std::string, Eng::Texture*> textures;
+
+    /** @brief Private default constructor (part of the Singleton pattern). */
+    TextureCache();
+
+    /**
+     * @brief Removes a texture being destroyed from the cache.
+     * @param key The resolved path of the texture.
+     * @private
+     */
+    void forget(const std::string& key);
+};
@@ -0,0 +1,256 @@
+/**
+ * @file    transformstore.cpp
+ * @brief   TransformStore class implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#include "engine.h"
+
+// C/C++:
+#include <algorithm>
+
+namespace Eng
+{
+
+    //////////////////////////
+    // TransformStore CLASS //
+    //////////////////////////
+
+    TransformStore::TransformStore()
+        : root(nullptr),
+          dirtyBegin(0),
+          dirtyEnd(0),
+          layoutDirty(false),
+          worldVersion(0)
+    {
+    }
+
+    TransformStore::~TransformStore()
+    {
+        clear();
+    }
+
+    void TransformStore::build(Node *newRoot)
+    {
+        release();
+        root = newRoot;
+        layout();
+    }
+
+    void TransformStore::clear()
+    {
+        release();
+        root = nullptr;
+    }
+
+    void TransformStore::update()
+    {
+        if (layoutDirty)
+        {
+            // Nodes moved out of the subtree become standalone, new ones join
+            release();
+            layout();
+        }
+        if (worldVersion != Node::worldRuleVersion && !nodes.empty())
+        {
+            std::fill(dirty.begin(), dirty.end(), (unsigned char)1);
+            dirtyBegin = 0;
+            dirtyEnd = (unsigned int)nodes.size();
+        }
+        if (dirtyBegin >= dirtyEnd)
+        {
+            return;
+        }
+        worldVersion = Node::worldRuleVersion;
+        bool translationOnly = Node::parentTranslationOnly;
+
+        // A stored subtree may hang below a standalone node
+        glm::mat4 rootParent(1.0f);
+        if (dirtyBegin == 0 && dirty[0] && nodes[0] && nodes[0]->getParent())
+        {
+            rootParent = nodes[0]->getParent()->getWorldCoordinateMatrix();
+        }
+
+        // Parents come first: a single sweep sees every parent up to date before its children;
+        // nodes outside the range have no flagged ancestor, so they are up to date already
+        for (unsigned int i = dirtyBegin; i < dirtyEnd; i++)
+        {
+            int parent = parents[i];
+            if (parent >= (int)dirtyBegin && dirty[parent])
+            {
+                dirty[i] = 1;
+            }
+            if (!dirty[i])
+            {
+                continue;
+            }
+
+            // Same rule as Node::getWorldCoordinateMatrix
+            const glm::mat4 &local = localMatrices[i];
+            const glm::mat4 &parentWorld = parent < 0 ? rootParent : worldMatrices[parent];
+            glm::mat4 &world = worldMatrices[i];
+            if (translationOnly)
+            {
+                glm::vec4 translation(glm::vec3(parentWorld[3]), 0.0f);
+                for (int c = 0; c < 4; c++)
+                {
+                    world[c] = local[c] + translation * local[c].w;
+                }
+            }
+            else
+            {
+                world = parentWorld * local;
+            }
+        }
+        std::fill(dirty.begin() + dirtyBegin, dirty.begin() + dirtyEnd, (unsigned char)0);
+        dirtyBegin = dirtyEnd = 0;
+    }
+
+    Node *TransformStore::getRoot() const
+    {
+        return root;
+    }
+
+    unsigned int TransformStore::getNumberOfNodes() const
+    {
+        return (unsigned int)nodes.size();
+    }
+
+    Node *TransformStore::getNode(unsigned int index) const
+    {
+        return index < nodes.size() ? nodes[index] : nullptr;
+    }
+
+    int TransformStore::getParentIndex(unsigned int index) const
+    {
+        return index < parents.size() ? parents[index] : -1;
+    }
+
+    bool TransformStore::isLayoutDirty() const
+    {
+        return layoutDirty;
+    }
+
+    void TransformStore::layout()
+    {
+        layoutDirty = false;
+        dirtyBegin = dirtyEnd = 0;
+        if (root == nullptr || (root->m_store && root->m_store != this))
+        {
+            root = nullptr;
+            return;
+        }
+
+        visitStack.clear();
+        visitStack.push_back({root, -1});
+        while (!visitStack.empty())
+        {
+            auto [node, parent] = visitStack.back();
+            visitStack.pop_back();
+            if (node->m_store)
+            {
+                continue;
+            }
+
+            unsigned int index = (unsigned int)nodes.size();
+            nodes.push_back(node);
+            parents.push_back(parent);
+            localMatrices.push_back(node->m_matrix);
+            worldMatrices.push_back(node->m_matrix);
+            dirty.push_back(1);
+            subtreeEnds.push_back(index + 1);
+            node->m_store = this;
+            node->m_storeIndex = index;
+
+            // Reversed, so the children are laid out in their scene graph order
+            const std::vector<Node *> &children = node->getChildren();
+            for (size_t c = children.size(); c > 0; c--)
+            {
+                visitStack.push_back({children[c - 1], (int)index});
+            }
+        }
+
+        // Children close before their parent in reverse order
+        for (size_t i = nodes.size(); i > 1; i--)
+        {
+            unsigned int &parentEnd = subtreeEnds[parents[i - 1]];
+            parentEnd = std::max(parentEnd, subtreeEnds[i - 1]);
+        }
+        dirtyEnd = (unsigned int)nodes.size();
+    }
+
+    void TransformStore::release()
+    {
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            Node *node = nodes[i];
+            if (node == nullptr)
+            {
+                continue;
+            }
+            node->m_matrix = localMatrices[i];
+            node->m_store = nullptr;
+            node->m_worldDirty = true;
+        }
+
+        // The capacity is kept for the next layout
+        nodes.clear();
+        parents.clear();
+        localMatrices.clear();
+        worldMatrices.clear();
+        dirty.clear();
+        subtreeEnds.clear();
+        dirtyBegin = dirtyEnd = 0;
+    }
+
+    void TransformStore::markDirty(unsigned int index)
+    {
+        dirty[index] = 1;
+        if (dirtyBegin >= dirtyEnd)
+        {
+            dirtyBegin = index;
+            dirtyEnd = subtreeEnds[index];
+            return;
+        }
+        dirtyBegin = std::min(dirtyBegin, index);
+        dirtyEnd = std::max(dirtyEnd, subtreeEnds[index]);
+    }
+
+    void TransformStore::setLocalMatrix(unsigned int index, const glm::mat4 &matrix)
+    {
+        localMatrices[index] = matrix;
+        markDirty(index);
+    }
+
+    bool TransformStore::isWorldMatrixDirty(unsigned int index) const
+    {
+        if (worldVersion != Node::worldRuleVersion)
+        {
+            return true;
+        }
+        if (index < dirtyBegin || index >= dirtyEnd)
+        {
+            return false;
+        }
+        for (int i = (int)index; i >= (int)dirtyBegin; i = parents[i])
+        {
+            if (dirty[i])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void TransformStore::forget(unsigned int index)
+    {
+        if (nodes[index] == root)
+        {
+            root = nullptr;
+        }
+        nodes[index] = nullptr;
+        layoutDirty = true;
+    }
+
+}; // end of namespace Eng::
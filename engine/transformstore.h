@@ -0,0 +1,168 @@
+/**
+ * @file    transformstore.h
+ * @brief   TransformStore class
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief Optional flattened storage of the transforms of a scene graph subtree.
+ *
+ * \c build lays the nodes of a subtree out in contiguous arrays of parent indices, local and
+ * world matrices, parents before their children. Stored nodes become handles: \c Eng::Node::getMatrix,
+ * \c setMatrix and \c getWorldCoordinateMatrix read and write the arrays, and the world matrices are
+ * refreshed by a linear sweep instead of a pointer walk over the heap, following the same parent
+ * transform rule as standalone nodes. Every subtree is a contiguous run of the arrays, so the sweep
+ * only covers the run of the nodes changed since the last one.
+ *
+ * Adding, removing or reparenting a stored node only flags the layout; the next \c update flattens
+ * the subtree again. Nodes keep their children and animations, only the transforms move here.
+ */
+class ENG_API TransformStore final
+{
+public:
+    /** @brief Constructor, for an empty store. */
+    TransformStore();
+
+    /** @brief Destructor; stored nodes get their local matrix back and become standalone again. */
+    ~TransformStore();
+
+    /**
+     * @brief Deleted copy constructor.
+     * @param TransformStore const & prevents two stores from claiming the same nodes.
+     */
+    TransformStore(TransformStore const&) = delete;
+
+    /**
+     * @brief Deleted assignment operator.
+     * @param TransformStore const & prevents two stores from claiming the same nodes.
+     */
+    void operator=(TransformStore const&) = delete;
+
+    /**
+     * @brief Flattens the subtree of a node, releasing the nodes stored before.
+     *
+     * Nodes already held by another store are skipped with their subtree; such nested stores only
+     * follow their standalone parent, not changes made through this store.
+     * @param root The root of the subtree, \c nullptr to empty the store.
+     */
+    void build(Eng::Node* root);
+
+    /** @brief Releases every node; they get their local matrix back. */
+    void clear();
+
+    /**
+     * @brief Flattens the subtree again if its layout changed, then recomputes the out of date world matrices.
+     *
+     * Called by \c Eng::Node::getWorldCoordinateMatrix. The sweep spans from the first to the last
+     * node below a change, so a node animated and queried right away only refreshes its own subtree.
+     */
+    void update();
+
+    /**
+     * @brief Gets the root of the stored subtree.
+     * @return The root node, \c nullptr if the store is empty.
+     */
+    Eng::Node* getRoot() const;
+
+    /**
+     * @brief Gets the number of stored nodes.
+     * @return The number of nodes.
+     */
+    unsigned int getNumberOfNodes() const;
+
+    /**
+     * @brief Gets a stored node.
+     * @param index The index of the node, from 0 (the root).
+     * @return The node, \c nullptr if it was deleted since the last layout.
+     */
+    Eng::Node* getNode(unsigned int index) const;
+
+    /**
+     * @brief Gets the parent of a stored node.
+     * @param index The index of the node.
+     * @return The index of the parent (always lower than \c index), -1 for the root.
+     */
+    int getParentIndex(unsigned int index) const;
+
+    /**
+     * @brief Tells whether the layout must be rebuilt by the next \c update.
+     * @return \c true if a stored node was added, removed, reparented or deleted.
+     */
+    bool isLayoutDirty() const;
+
+private:
+    /** @brief Root of the stored subtree. */
+    Eng::Node* root;
+
+    /** @brief Stored nodes, parents first. */
+    std::vector<Eng::Node*> nodes;
+    /** @brief Index of the parent of every node, -1 for the root. */
+    std::vector<int> parents;
+    /** @brief Local matrix of every node. */
+    std::vector<glm::mat4> localMatrices;
+    /** @brief World matrix of every node, valid for nodes not flagged in \c dirty. */
+    std::vector<glm::mat4> worldMatrices;
+    /** @brief Whether the local matrix of a node changed since the last sweep. */
+    std::vector<unsigned char> dirty;
+    /** @brief One past the index of the last descendant of every node. */
+    std::vector<unsigned int> subtreeEnds;
+
+    /** @brief First index the next sweep covers; every flagged node lies in [\c dirtyBegin, \c dirtyEnd). */
+    unsigned int dirtyBegin;
+    /** @brief One past the last index the next sweep covers, the end of the subtrees of the flagged nodes. */
+    unsigned int dirtyEnd;
+    /** @brief Whether the subtree must be flattened again. */
+    bool layoutDirty;
+    /** @brief Value of \c Eng::Node::worldRuleVersion the world matrices were computed with. */
+    unsigned int worldVersion;
+
+    /** @brief Depth-first visit stack of \c layout, kept to avoid per rebuild allocations. */
+    std::vector<std::pair<Eng::Node*, int>> visitStack;
+
+    /**
+     * @brief Flattens the subtree of \c root into the arrays.
+     * @private
+     */
+    void layout();
+
+    /**
+     * @brief Hands their local matrix back to the stored nodes and empties the arrays.
+     * @private
+     */
+    void release();
+
+    /**
+     * @brief Flags a stored node, so the next sweep refreshes it and its descendants.
+     * @param index The index of the node.
+     * @private
+     */
+    void markDirty(unsigned int index);
+
+    /**
+     * @brief Changes the local matrix of a stored node; called by \c Eng::Node::setMatrix.
+     * @param index The index of the node.
+     * @param matrix The new local matrix.
+     * @private
+     */
+    void setLocalMatrix(unsigned int index, const glm::mat4& matrix);
+
+    /**
+     * @brief Tells whether the world matrix of a stored node is out of date.
+     * @param index The index of the node.
+     * @return \c true if the node or one of its ancestors changed since the last sweep.
+     * @private
+     */
+    bool isWorldMatrixDirty(unsigned int index) const;
+
+    /**
+     * @brief Forgets a node being deleted; called by \c Eng::Node::~Node.
+     * @param index The index of the node.
+     * @private
+     */
+    void forget(unsigned int index);
+
+    friend class Eng::Node;
+};
@@ -0,0 +1,338 @@
+/**
+ * @file    vertexunpack.cpp
+ * @brief   VertexUnpack class implementation
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+//////////////
+// #INCLUDE //
+//////////////
+
+// Main include:
+#include "engine.h"
+
+// C/C++:
+#include <algorithm>
+#include <cstring>
+
+// GLM:
+#include <glm/gtc/packing.hpp>
+
+// SIMD (SSE2 is part of the x86-64 baseline, AVX2 is checked at runtime):
+#if defined(__x86_64__) || defined(_M_X64)
+#define ENG_UNPACK_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ENG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ENG_TARGET_AVX2
+#endif
+
+/////////////
+// HELPERS //
+/////////////
+
+// Byte offsets inside a packed record:
+#define RECORD_POSITION 0
+#define RECORD_NORMAL 12
+#define RECORD_TEXTURE 16
+#define RECORD_TANGENT 20
+
+static void UnpackScalar(const char* records, unsigned int begin, unsigned int count, const Eng::VertexUnpack::Streams& s)
+{
+    for (unsigned int i = begin; i < count; ++i)
+    {
+        const char* record = records + (size_t)i * Eng::VertexUnpack::RECORD_SIZE;
+
+        float position[3];
+        unsigned int normalData, textureData, tangentData;
+        memcpy(position, record + RECORD_POSITION, sizeof(position));
+        memcpy(&normalData, record + RECORD_NORMAL, sizeof(unsigned int));
+        memcpy(&textureData, record + RECORD_TEXTURE, sizeof(unsigned int));
+        memcpy(&tangentData, record + RECORD_TANGENT, sizeof(unsigned int));
+
+        glm::vec4 normal = glm::unpackSnorm3x10_1x2(normalData);
+        glm::vec2 texture = glm::unpackHalf2x16(textureData);
+        glm::vec4 tangent = glm::unpackSnorm3x10_1x2(tangentData);
+
+        if (s.positionX) s.positionX[i] = position[0];
+        if (s.positionY) s.positionY[i] = position[1];
+        if (s.positionZ) s.positionZ[i] = position[2];
+        if (s.normalX) s.normalX[i] = normal.x;
+        if (s.normalY) s.normalY[i] = normal.y;
+        if (s.normalZ) s.normalZ[i] = normal.z;
+        if (s.normalW) s.normalW[i] = normal.w;
+        if (s.textureS) s.textureS[i] = texture.s;
+        if (s.textureT) s.textureT[i] = texture.t;
+        if (s.tangentX) s.tangentX[i] = tangent.x;
+        if (s.tangentY) s.tangentY[i] = tangent.y;
+        if (s.tangentZ) s.tangentZ[i] = tangent.z;
+        if (s.tangentW) s.tangentW[i] = tangent.w;
+    }
+}
+
+#ifdef ENG_UNPACK_X86
+
+//////////
+// SSE2 //
+//////////
+
+static inline __m128i LoadWords4(const char* records, unsigned int offset)
+{
+    unsigned int w[4];
+    for (int k = 0; k < 4; ++k)
+        memcpy(&w[k], records + k * Eng::VertexUnpack::RECORD_SIZE + offset, sizeof(unsigned int));
+    return _mm_set_epi32((int)w[3], (int)w[2], (int)w[1], (int)w[0]);
+}
+
+static inline void Store4(float* destination, unsigned int i, __m128 value)
+{
+    if (destination)
+        _mm_storeu_ps(destination + i, value);
+}
+
+// Same arithmetic as glm: clamp(float(signed field) / 511, -1, 1)
+static inline __m128 Snorm10ToFloat4(__m128i packed, int shift)
+{
+    __m128i field = _mm_srai_epi32(_mm_slli_epi32(packed, 22 - shift), 22);
+    __m128 value = _mm_div_ps(_mm_cvtepi32_ps(field), _mm_set1_ps(511.0f));
+    return _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+
+static inline __m128 Snorm2ToFloat4(__m128i packed)
+{
+    __m128 value = _mm_cvtepi32_ps(_mm_srai_epi32(packed, 30));
+    return _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+
+// Bit-exact half to float, including denormals, infinities and NaN payloads
+static inline __m128 HalfToFloat4(__m128i half)
+{
+    const __m128i exponentMask = _mm_set1_epi32(0x7c00 << 13);
+
+    __m128i bits = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7fff)), 13);
+    __m128i exponent = _mm_and_si128(bits, exponentMask);
+    bits = _mm_add_epi32(bits, _mm_set1_epi32((127 - 15) << 23));
+
+    // Inf / NaN: move the exponent up to 255
+    __m128i infNan = _mm_cmpeq_epi32(exponent, exponentMask);
+    bits = _mm_add_epi32(bits, _mm_and_si128(infNan, _mm_set1_epi32((128 - 16) << 23)));
+
+    // Zero / denormal: renormalize with an exact float subtraction
+    __m128i denormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+    __m128i renormalized = _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(1 << 23))), _mm_castsi128_ps(_mm_set1_epi32(113 << 23))));
+    bits = _mm_or_si128(_mm_and_si128(denormal, renormalized), _mm_andnot_si128(denormal, bits));
+
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16);
+    return _mm_castsi128_ps(_mm_or_si128(bits, sign));
+}
+
+static unsigned int UnpackSse2(const char* records, unsigned int begin, unsigned int count, const Eng::VertexUnpack::Streams& s)
+{
+    unsigned int i = begin;
+    for (; i + 4 <= count; i += 4)
+    {
+        const char* block = records + (size_t)i * Eng::VertexUnpack::RECORD_SIZE;
+
+        Store4(s.positionX, i, _mm_castsi128_ps(LoadWords4(block, RECORD_POSITION)));
+        Store4(s.positionY, i, _mm_castsi128_ps(LoadWords4(block, RECORD_POSITION + 4)));
+        Store4(s.positionZ, i, _mm_castsi128_ps(LoadWords4(block, RECORD_POSITION + 8)));
+
+        __m128i normal = LoadWords4(block, RECORD_NORMAL);
+        Store4(s.normalX, i, Snorm10ToFloat4(normal, 0));
+        Store4(s.normalY, i, Snorm10ToFloat4(normal, 10));
+        Store4(s.normalZ, i, Snorm10ToFloat4(normal, 20));
+        Store4(s.normalW, i, Snorm2ToFloat4(normal));
+
+        __m128i texture = LoadWords4(block, RECORD_TEXTURE);
+        Store4(s.textureS, i, HalfToFloat4(_mm_and_si128(texture, _mm_set1_epi32(0xffff))));
+        Store4(s.textureT, i, HalfToFloat4(_mm_srli_epi32(texture, 16)));
+
+        __m128i tangent = LoadWords4(block, RECORD_TANGENT);
+        Store4(s.tangentX, i, Snorm10ToFloat4(tangent, 0));
+        Store4(s.tangentY, i, Snorm10ToFloat4(tangent, 10));
+        Store4(s.tangentZ, i, Snorm10ToFloat4(tangent, 20));
+        Store4(s.tangentW, i, Snorm2ToFloat4(tangent));
+    }
+    return i;
+}
+
+//////////
+// AVX2 //
+//////////
+
+ENG_TARGET_AVX2 static inline __m256i LoadWords8(const char* records, unsigned int offset)
+{
+    // Records are 6 words apart
+    const __m256i index = _mm256_setr_epi32(0, 6, 12, 18, 24, 30, 36, 42);
+    return _mm256_i32gather_epi32((const int*)(records + offset), index, 4);
+}
+
+ENG_TARGET_AVX2 static inline void Store8(float* destination, unsigned int i, __m256 value)
+{
+    if (destination)
+        _mm256_storeu_ps(destination + i, value);
+}
+
+ENG_TARGET_AVX2 static inline __m256 Snorm10ToFloat8(__m256i packed, int shift)
+{
+    __m256i field = _mm256_srai_epi32(_mm256_slli_epi32(packed, 22 - shift), 22);
+    __m256 value = _mm256_div_ps(_mm256_cvtepi32_ps(field), _mm256_set1_ps(511.0f));
+    return _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+}
+
+ENG_TARGET_AVX2 static inline __m256 Snorm2ToFloat8(__m256i packed)
+{
+    __m256 value = _mm256_cvtepi32_ps(_mm256_srai_epi32(packed, 30));
+    return _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+}
+
+ENG_TARGET_AVX2 static inline __m256 HalfToFloat8(__m256i half)
+{
+    const __m256i exponentMask = _mm256_set1_epi32(0x7c00 << 13);
+
+    __m256i bits = _mm256_slli_epi32(_mm256_and_si256(half, _mm256_set1_epi32(0x7fff)), 13);
+    __m256i exponent = _mm256_and_si256(bits, exponentMask);
+    bits = _mm256_add_epi32(bits, _mm256_set1_epi32((127 - 15) << 23));
+
+    __m256i infNan = _mm256_cmpeq_epi32(exponent, exponentMask);
+    bits = _mm256_add_epi32(bits, _mm256_and_si256(infNan, _mm256_set1_epi32((128 - 16) << 23)));
+
+    __m256i denormal = _mm256_cmpeq_epi32(exponent, _mm256_setzero_si256());
+    __m256i renormalized = _mm256_castps_si256(_mm256_sub_ps(_mm256_castsi256_ps(_mm256_add_epi32(bits, _mm256_set1_epi32(1 << 23))), _mm256_castsi256_ps(_mm256_set1_epi32(113 << 23))));
+    bits = _mm256_blendv_epi8(bits, renormalized, denormal);
+
+    __m256i sign = _mm256_slli_epi32(_mm256_and_si256(half, _mm256_set1_epi32(0x8000)), 16);
+    return _mm256_castsi256_ps(_mm256_or_si256(bits, sign));
+}
+
+ENG_TARGET_AVX2 static unsigned int UnpackAvx2(const char* records, unsigned int begin, unsigned int count, const Eng::VertexUnpack::Streams& s)
+{
+    unsigned int i = begin;
+    for (; i + 8 <= count; i += 8)
+    {
+        const char* block = records + (size_t)i * Eng::VertexUnpack::RECORD_SIZE;
+
+        Store8(s.positionX, i, _mm256_castsi256_ps(LoadWords8(block, RECORD_POSITION)));
+        Store8(s.positionY, i, _mm256_castsi256_ps(LoadWords8(block, RECORD_POSITION + 4)));
+        Store8(s.positionZ, i, _mm256_castsi256_ps(LoadWords8(block, RECORD_POSITION + 8)));
+
+        __m256i normal = LoadWords8(block, RECORD_NORMAL);
+        Store8(s.normalX, i, Snorm10ToFloat8(normal, 0));
+        Store8(s.normalY, i, Snorm10ToFloat8(normal, 10));
+        Store8(s.normalZ, i, Snorm10ToFloat8(normal, 20));
+        Store8(s.normalW, i, Snorm2ToFloat8(normal));
+
+        __m256i texture = LoadWords8(block, RECORD_TEXTURE);
+        Store8(s.textureS, i, HalfToFloat8(_mm256_and_si256(texture, _mm256_set1_epi32(0xffff))));
+        Store8(s.textureT, i, HalfToFloat8(_mm256_srli_epi32(texture, 16)));
+
+        __m256i tangent = LoadWords8(block, RECORD_TANGENT);
+        Store8(s.tangentX, i, Snorm10ToFloat8(tangent, 0));
+        Store8(s.tangentY, i, Snorm10ToFloat8(tangent, 10));
+        Store8(s.tangentZ, i, Snorm10ToFloat8(tangent, 20));
+        Store8(s.tangentW, i, Snorm2ToFloat8(tangent));
+    }
+    return i;
+}
+
+static bool CpuHasAvx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#else
+    return false;
+#endif
+}
+
+#endif
+
+namespace Eng
+{
+
+    /////////////////////////
+    // VERTEXUNPACK CLASS //
+    /////////////////////////
+
+    void VertexUnpack::unpack(const char* records, unsigned int count, const Streams& streams)
+    {
+        unpack(records, count, streams, getBestPath());
+    }
+
+    void VertexUnpack::unpack(const char* records, unsigned int count, const Streams& streams, Path path)
+    {
+        path = std::min(path, getBestPath());
+        unsigned int done = 0;
+
+#ifdef ENG_UNPACK_X86
+        if (path == Path::AVX2)
+            done = UnpackAvx2(records, done, count, streams);
+        if (path >= Path::SSE2)
+            done = UnpackSse2(records, done, count, streams);
+#endif
+
+        // Remaining records (or everything on the scalar path):
+        UnpackScalar(records, done, count, streams);
+    }
+
+    void VertexUnpack::unpack(const char* records, unsigned int count, glm::vec3* positions, glm::vec4* normals, glm::vec2* textureCoordinates, glm::vec4* tangents, Path path)
+    {
+        // Small enough to stay in L1 between the decode and the scatter
+        const unsigned int blockSize = 64;
+        float block[13][blockSize];
+
+        Streams streams = { block[0], block[1], block[2],
+                            block[3], block[4], block[5], block[6],
+                            block[7], block[8],
+                            nullptr, nullptr, nullptr, nullptr };
+        if (tangents)
+        {
+            streams.tangentX = block[9];
+            streams.tangentY = block[10];
+            streams.tangentZ = block[11];
+            streams.tangentW = block[12];
+        }
+
+        for (unsigned int begin = 0; begin < count; begin += blockSize)
+        {
+            unsigned int size = std::min(blockSize, count - begin);
+            unpack(records + (size_t)begin * RECORD_SIZE, size, streams, path);
+
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                positions[begin + i] = glm::vec3(block[0][i], block[1][i], block[2][i]);
+                normals[begin + i] = glm::vec4(block[3][i], block[4][i], block[5][i], block[6][i]);
+                textureCoordinates[begin + i] = glm::vec2(block[7][i], block[8][i]);
+            }
+
+            if (tangents)
+            {
+                for (unsigned int i = 0; i < size; ++i)
+                    tangents[begin + i] = glm::vec4(block[9][i], block[10][i], block[11][i], block[12][i]);
+            }
+        }
+    }
+
+    VertexUnpack::Path VertexUnpack::getBestPath()
+    {
+#ifdef ENG_UNPACK_X86
+        static const Path best = CpuHasAvx2() ? Path::AVX2 : Path::SSE2;
+        return best;
+#else
+        return Path::SCALAR;
+#endif
+    }
+
+}; // end of namespace Eng::
@@ -0,0 +1,92 @@
+/**
+ * @file    vertexunpack.h
+ * @brief   VertexUnpack class header file
+ *
+ * @author  Giona Valsecchi (C) SUPSI [giona.valsecchi@supsi.ch] , Pietro Brusadelli (C) SUPSI [pietro.brusadelli@supsi.ch], Filippo De Simoni (C) SUPSI [filippo.desimoni@supsi.ch]
+ */
+
+#pragma once
+
+/**
+ * @brief Batch decoders for the packed vertex records stored in OVO mesh chunks.
+ *
+ * Each record is \c RECORD_SIZE bytes: a \c glm::vec3 position followed by a normal and a tangent
+ * packed as snorm 10-10-10-2 and texture coordinates packed as two halfs. The decoders process a
+ * contiguous run of records at once using AVX2 or SSE2 when available, and produce exactly the same
+ * bits as \c glm::unpackSnorm3x10_1x2 and \c glm::unpackHalf2x16.
+ */
+class ENG_API VertexUnpack final
+{
+public:
+    /** @brief Size in bytes of one packed vertex record. */
+    static constexpr unsigned int RECORD_SIZE = 24;
+
+    /**
+     * @brief Instruction set used by the decoders.
+     */
+    enum class Path : int
+    {
+        SCALAR = 0,     ///< Per-vertex glm calls.
+        SSE2,           ///< 4 records per iteration.
+        AVX2,           ///< 8 records per iteration.
+    };
+
+    /**
+     * @brief Destination arrays (structure of arrays) of a batch decode, each holding at least \c count floats.
+     *
+     * Any pointer may be \c nullptr to skip that component.
+     */
+    struct Streams
+    {
+        float* positionX;   ///< Position x.
+        float* positionY;   ///< Position y.
+        float* positionZ;   ///< Position z.
+        float* normalX;     ///< Normal x.
+        float* normalY;     ///< Normal y.
+        float* normalZ;     ///< Normal z.
+        float* normalW;     ///< Normal w (2-bit component).
+        float* textureS;    ///< Texture coordinate s.
+        float* textureT;    ///< Texture coordinate t.
+        float* tangentX;    ///< Tangent x.
+        float* tangentY;    ///< Tangent y.
+        float* tangentZ;    ///< Tangent z.
+        float* tangentW;    ///< Tangent handedness sign.
+    };
+
+    /**
+     * @brief Decodes a run of packed records into separate float arrays using the best available path.
+     * @param records Pointer to the first packed record (no alignment required).
+     * @param count Number of records to decode.
+     * @param streams The destination arrays.
+     */
+    static void unpack(const char* records, unsigned int count, const Streams& streams);
+
+    /**
+     * @brief Decodes a run of packed records into separate float arrays using the given path.
+     * @param records Pointer to the first packed record (no alignment required).
+     * @param count Number of records to decode.
+     * @param streams The destination arrays.
+     * @param path The requested path; downgraded to the best one supported by the CPU.
+     */
+    static void unpack(const char* records, unsigned int count, const Streams& streams, Path path);
+
+    /**
+     * @brief Decodes a run of packed records straight into the engine vertex attribute layout.
+     *
+     * Records are decoded block by block into small float arrays and scattered, so the whole run is touched once.
+     * @param records Pointer to the first packed record.
+     * @param count Number of records to decode.
+     * @param positions Receives \c count positions.
+     * @param normals Receives \c count normals.
+     * @param textureCoordinates Receives \c count texture coordinates.
+     * @param tangents Receives \c count tangents, or \c nullptr to skip them.
+     * @param path The requested path.
+     */
+    static void unpack(const char* records, unsigned int count, glm::vec3* positions, glm::vec4* normals, glm::vec2* textureCoordinates, glm::vec4* tangents, Path path);
+
+    /**
+     * @brief Gets the fastest path supported by the running CPU.
+     * @return The best available \c Path.
+     */
+    static Path getBestPath();
+};
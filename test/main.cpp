@@ -5,16 +5,34 @@
  * @author  Group 10 (C) SUPSI
  */
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <new>
 #include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "engine.h"
 
 // GLM
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+// OpenGL, offscreen contexts through EGL on Linux (Mesa llvmpipe when there is no GPU)
+#include <GL/gl.h>
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 // Test counters
 static int totalTests = 0;
@@ -31,6 +49,31 @@ static int passedTests = 0;
 #define TEST_FAIL(msg) \
 	std::cout << "  ✗ FAILED: " << msg << std::endl;
 
+// Allocation counter: counts heap allocations of at least allocationThreshold bytes while enabled
+static std::atomic<bool> countAllocations{false};
+static std::atomic<size_t> allocationThreshold{0};
+static std::atomic<unsigned int> largeAllocations{0};
+
+void *operator new(std::size_t size)
+{
+	if (countAllocations.load(std::memory_order_relaxed) && size >= allocationThreshold.load(std::memory_order_relaxed))
+		largeAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *pointer = std::malloc(size ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
 // Helper functions
 bool floatEqual(float a, float b, float epsilon = 0.0001f)
 {
@@ -57,6 +100,134 @@ bool mat4Equal(const glm::mat4 &a, const glm::mat4 &b, float epsilon = 0.0001f)
 	return true;
 }
 
+// Synthetic OVO writer: a root node with meshCount quad meshes as children
+void appendBytes(std::vector<char> &buffer, const void *data, size_t size)
+{
+	const char *bytes = static_cast<const char *>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void appendString(std::vector<char> &buffer, const std::string &text)
+{
+	appendBytes(buffer, text.c_str(), text.size() + 1);
+}
+
+void writeChunk(FILE *file, unsigned int chunkId, const std::vector<char> &payload)
+{
+	unsigned int chunkSize = (unsigned int)payload.size();
+	fwrite(&chunkId, sizeof(unsigned int), 1, file);
+	fwrite(&chunkSize, sizeof(unsigned int), 1, file);
+	fwrite(payload.data(), 1, payload.size(), file);
+}
+
+void appendNodeHeader(std::vector<char> &payload, const std::string &name, const glm::mat4 &matrix, unsigned int children)
+{
+	appendString(payload, name);
+	appendBytes(payload, &matrix, sizeof(glm::mat4));
+	appendBytes(payload, &children, sizeof(unsigned int));
+	appendString(payload, "[none]");
+}
+
+std::string writeSyntheticOvo(const std::string &fileName, unsigned int meshCount)
+{
+	std::string path = (std::filesystem::temp_directory_path() / fileName).string();
+	FILE *file = fopen(path.c_str(), "wb");
+	assert(file != nullptr);
+
+	std::vector<char> payload;
+	unsigned int version = 8;
+	appendBytes(payload, &version, sizeof(unsigned int));
+	writeChunk(file, 0, payload);
+
+	payload.clear();
+	appendNodeHeader(payload, "[root]", glm::mat4(1.0f), meshCount);
+	writeChunk(file, 1, payload);
+
+	const glm::vec3 corners[4] = {
+		glm::vec3(-1.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, -1.0f),
+		glm::vec3(1.0f, 0.0f, 1.0f), glm::vec3(-1.0f, 0.0f, 1.0f)};
+
+	for (unsigned int m = 0; m < meshCount; m++)
+	{
+		payload.clear();
+		glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3((float)m, 0.0f, 0.0f));
+		appendNodeHeader(payload, "Mesh" + std::to_string(m), matrix, 0);
+
+		unsigned char subtype = 0;
+		float radius = 1.5f;
+		glm::vec3 boxMin(-1.0f, 0.0f, -1.0f), boxMax(1.0f, 0.0f, 1.0f);
+		unsigned char physics = 0;
+		unsigned int lods = 1, vertexes = 4, faces = 2;
+		appendBytes(payload, &subtype, sizeof(unsigned char));
+		appendString(payload, "[none]");
+		appendBytes(payload, &radius, sizeof(float));
+		appendBytes(payload, &boxMin, sizeof(glm::vec3));
+		appendBytes(payload, &boxMax, sizeof(glm::vec3));
+		appendBytes(payload, &physics, sizeof(unsigned char));
+		appendBytes(payload, &lods, sizeof(unsigned int));
+		appendBytes(payload, &vertexes, sizeof(unsigned int));
+		appendBytes(payload, &faces, sizeof(unsigned int));
+
+		for (unsigned int v = 0; v < vertexes; v++)
+		{
+			unsigned int normal = 0x1FF << 10; // +Y
+			unsigned int uv = (v & 1) ? 0x3C00 : 0; // u = 1.0 on odd corners
+			unsigned int tangent = 0x1FF;		  // +X
+			appendBytes(payload, &corners[v], sizeof(glm::vec3));
+			appendBytes(payload, &normal, sizeof(unsigned int));
+			appendBytes(payload, &uv, sizeof(unsigned int));
+			appendBytes(payload, &tangent, sizeof(unsigned int));
+		}
+
+		unsigned int indexes[6] = {0, 2, 1, 0, 3, 2};
+		appendBytes(payload, indexes, sizeof(indexes));
+		writeChunk(file, 18, payload);
+	}
+
+	fclose(file);
+	return path;
+}
+
+// Offscreen OpenGL context, created once and kept current for the rest of the run
+bool makeOffscreenContext(int width = 64, int height = 64)
+{
+#ifdef __linux__
+	static bool tried = false, created = false;
+	if (tried)
+		return created;
+	tried = true;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : EGL_NO_DISPLAY;
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API))
+		return false;
+
+	const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+									   EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_NONE};
+	EGLConfig config;
+	EGLint numberOfConfigs = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &numberOfConfigs) || numberOfConfigs == 0)
+		return false;
+
+	const EGLint surfaceAttributes[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+	EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+	if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+		return false;
+
+	glViewport(0, 0, width, height);
+	std::cout << "  Offscreen context: " << glGetString(GL_RENDERER) << ", OpenGL " << glGetString(GL_VERSION) << std::endl;
+	created = true;
+	return true;
+#else
+	(void)width;
+	(void)height;
+	return false;
+#endif
+}
+
 // ============================================================================
 // OBJECT TESTS
 // ============================================================================
@@ -172,6 +343,275 @@ void testNodeWorldCoordinates()
 	TEST_PASS();
 }
 
+void testNodeWorldMatrixCache()
+{
+	TEST("Node cached world matrices");
+
+	Eng::Node *root = new Eng::Node("Root", glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+	Eng::Node *arm = new Eng::Node("Arm", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 2.0f, 0.0f)));
+	Eng::Node *hand = new Eng::Node("Hand", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 3.0f)));
+	Eng::Node *other = new Eng::Node("Other");
+	root->addChild(arm);
+	arm->addChild(hand);
+	root->addChild(other);
+
+	// Computed on demand, then cached for the whole chain
+	assert(hand->isWorldMatrixDirty());
+	assert(vec3Equal(glm::vec3(hand->getWorldCoordinateMatrix()[3]), glm::vec3(1.0f, 2.0f, 3.0f)));
+	assert(!hand->isWorldMatrixDirty() && !arm->isWorldMatrixDirty() && !root->isWorldMatrixDirty());
+	assert(other->isWorldMatrixDirty());
+
+	// Moving a node invalidates its subtree only
+	assert(vec3Equal(glm::vec3(other->getWorldCoordinateMatrix()[3]), glm::vec3(1.0f, 0.0f, 0.0f)));
+	arm->setMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 5.0f, 0.0f)));
+	assert(arm->isWorldMatrixDirty() && hand->isWorldMatrixDirty());
+	assert(!root->isWorldMatrixDirty() && !other->isWorldMatrixDirty());
+	assert(vec3Equal(glm::vec3(hand->getWorldCoordinateMatrix()[3]), glm::vec3(1.0f, 5.0f, 3.0f)));
+
+	// Reparenting invalidates too
+	other->addChild(hand);
+	assert(hand->isWorldMatrixDirty());
+	assert(vec3Equal(glm::vec3(hand->getWorldCoordinateMatrix()[3]), glm::vec3(1.0f, 0.0f, 3.0f)));
+
+	// One top-down pass over a deep chain leaves every node up to date and matches the parent walk
+	const int depth = 2000;
+	Eng::Node *chain = new Eng::Node("Chain");
+	Eng::Node *tail = chain;
+	for (int i = 0; i < depth; i++)
+	{
+		Eng::Node *link = new Eng::Node("Link", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		tail->addChild(link);
+		tail = link;
+	}
+
+	Eng::List *list = new Eng::List("ChainList");
+	auto start = std::chrono::high_resolution_clock::now();
+	list->pass(chain, glm::mat4(1.0f));
+	double firstPass = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	list->clear();
+	assert(!tail->isWorldMatrixDirty());
+	assert(vec3Equal(glm::vec3(tail->getWorldCoordinateMatrix()[3]), glm::vec3(0.0f, (float)depth, 0.0f)));
+
+	// Moving the top of the chain shifts every link on the next pass
+	chain->setMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(4.0f, 0.0f, 0.0f)));
+	assert(tail->isWorldMatrixDirty());
+	list->pass(chain, glm::mat4(1.0f));
+	list->clear();
+	assert(vec3Equal(glm::vec3(tail->getWorldCoordinateMatrix()[3]), glm::vec3(4.0f, (float)depth, 0.0f)));
+	std::cout << "  Pass over a " << depth << " deep chain: " << firstPass << " ms" << std::endl;
+
+	delete list;
+	delete chain;
+	delete root;
+
+	TEST_PASS();
+}
+
+void testNodeParentTransform()
+{
+	TEST("Node full parent transform and translation only compatibility");
+
+	// Parent turned 90 degrees about Y and scaled by 2: the child's offset follows both
+	glm::mat4 parentMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(5.0f, 0.0f, 0.0f)) *
+							 glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+							 glm::scale(glm::mat4(1.0f), glm::vec3(2.0f));
+	Eng::Node *parent = new Eng::Node("Parent", parentMatrix);
+	Eng::Node *child = new Eng::Node("Child", glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+	Eng::Node *grandChild = new Eng::Node("GrandChild", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	parent->addChild(child);
+	child->addChild(grandChild);
+
+	assert(!Eng::Node::isParentTranslationOnly());
+	assert(mat4Equal(grandChild->getWorldCoordinateMatrix(), parentMatrix * child->getMatrix() * grandChild->getMatrix()));
+	assert(vec3Equal(glm::vec3(child->getWorldCoordinateMatrix()[3]), glm::vec3(5.0f, 0.0f, -2.0f)));
+	assert(vec3Equal(glm::vec3(grandChild->getWorldCoordinateMatrix()[3]), glm::vec3(5.0f, 2.0f, -2.0f)));
+
+	// Repeated queries hit the cache until an ancestor changes
+	assert(!grandChild->isWorldMatrixDirty());
+	const int queries = 1000000;
+	glm::vec3 sum(0.0f);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < queries; i++)
+		sum += glm::vec3(grandChild->getWorldCoordinateMatrix()[3]);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "  " << queries << " cached queries: " << elapsed << " ms" << std::endl;
+	assert(sum.y > 0.0f);
+	parent->setMatrix(glm::mat4(1.0f));
+	assert(grandChild->isWorldMatrixDirty());
+	assert(vec3Equal(glm::vec3(grandChild->getWorldCoordinateMatrix()[3]), glm::vec3(1.0f, 1.0f, 0.0f)));
+	parent->setMatrix(parentMatrix);
+
+	// Compatibility: only the parent translation is kept, switching invalidates every cache
+	grandChild->getWorldCoordinateMatrix();
+	Eng::Node::setParentTranslationOnly(true);
+	assert(grandChild->isWorldMatrixDirty() && parent->isWorldMatrixDirty());
+	assert(vec3Equal(glm::vec3(child->getWorldCoordinateMatrix()[3]), glm::vec3(6.0f, 0.0f, 0.0f)));
+	assert(vec3Equal(glm::vec3(grandChild->getWorldCoordinateMatrix()[3]), glm::vec3(6.0f, 1.0f, 0.0f)));
+	assert(mat4Equal(child->getWorldCoordinateMatrix(), glm::translate(glm::mat4(1.0f), glm::vec3(6.0f, 0.0f, 0.0f))));
+
+	// The flattened store follows the same rule
+	Eng::TransformStore *store = new Eng::TransformStore();
+	store->build(parent);
+	assert(vec3Equal(glm::vec3(grandChild->getWorldCoordinateMatrix()[3]), glm::vec3(6.0f, 1.0f, 0.0f)));
+	Eng::Node::setParentTranslationOnly(false);
+	assert(grandChild->isWorldMatrixDirty());
+	assert(vec3Equal(glm::vec3(grandChild->getWorldCoordinateMatrix()[3]), glm::vec3(5.0f, 2.0f, -2.0f)));
+	delete store;
+	assert(vec3Equal(glm::vec3(grandChild->getWorldCoordinateMatrix()[3]), glm::vec3(5.0f, 2.0f, -2.0f)));
+
+	delete parent;
+
+	TEST_PASS();
+}
+
+void testNodeTransformStore()
+{
+	TEST("Node flattened transform store (100k nodes)");
+
+	// Rotated and translated locals, so the parent rotations are exercised
+	auto localMatrix = [](int i)
+	{
+		glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians((float)(i % 7) * 10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		return glm::translate(glm::mat4(1.0f), glm::vec3((float)(i % 3), 1.0f, (float)(i % 5) * 0.5f)) * rotation;
+	};
+
+	// Four children per node, allocated in order like a loader would
+	const int count = 100000;
+	std::vector<Eng::Node *> nodes(count);
+	for (int i = 0; i < count; i++)
+	{
+		nodes[i] = new Eng::Node("Node", localMatrix(i));
+		if (i > 0)
+			nodes[(i - 1) / 4]->addChild(nodes[i]);
+	}
+	Eng::Node *root = nodes[0];
+
+	auto sumWorlds = [&]()
+	{
+		glm::vec3 sum(0.0f);
+		for (Eng::Node *node : nodes)
+			sum += glm::vec3(node->getWorldCoordinateMatrix()[3]);
+		return sum;
+	};
+
+	// Reference: every node keeps its own matrices, the root moves and the whole tree is queried
+	std::vector<glm::mat4> reference(count);
+	root->setMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+	auto start = std::chrono::steady_clock::now();
+	sumWorlds();
+	double pointerWalk = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	for (int i = 0; i < count; i++)
+		reference[i] = nodes[i]->getWorldCoordinateMatrix();
+
+	// Flattened: parents first, the nodes become handles into the store
+	Eng::TransformStore *store = new Eng::TransformStore();
+	store->build(root);
+	assert(store->getNumberOfNodes() == count);
+	assert(store->getRoot() == root && store->getNode(0) == root);
+	assert(store->getParentIndex(0) == -1);
+	for (unsigned int i = 1; i < store->getNumberOfNodes(); i += 997)
+	{
+		assert(store->getParentIndex(i) < (int)i);
+		assert(store->getNode(store->getParentIndex(i)) == store->getNode(i)->getParent());
+	}
+	assert(nodes[count - 1]->getTransformStore() == store);
+	assert(mat4Equal(nodes[42]->getMatrix(), localMatrix(42)));
+	for (int i = 0; i < count; i += 101)
+		assert(mat4Equal(nodes[i]->getWorldCoordinateMatrix(), reference[i]));
+
+	// Same move, one linear sweep
+	root->setMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f)));
+	assert(nodes[count - 1]->isWorldMatrixDirty());
+	start = std::chrono::steady_clock::now();
+	store->update();
+	double sweep = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	assert(!nodes[count - 1]->isWorldMatrixDirty());
+	for (int i = 0; i < count; i += 101)
+	{
+		glm::vec3 expected = glm::vec3(reference[i][3]) + glm::vec3(1.0f, 0.0f, 0.0f);
+		assert(vec3Equal(glm::vec3(nodes[i]->getWorldCoordinateMatrix()[3]), expected));
+	}
+	std::cout << "  World update after moving the root, pointer walk: " << pointerWalk << " ms, store sweep: " << sweep << " ms" << std::endl;
+
+	// A node deep in the tree: only its subtree changes
+	Eng::Node *middle = nodes[5];
+	glm::mat4 before = nodes[1]->getWorldCoordinateMatrix();
+	middle->setMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 10.0f, 0.0f)) * middle->getMatrix());
+	assert(middle->isWorldMatrixDirty() && nodes[21]->isWorldMatrixDirty());
+	assert(!nodes[1]->isWorldMatrixDirty());
+	assert(vec3Equal(glm::vec3(nodes[21]->getWorldCoordinateMatrix()[3]) - glm::vec3(reference[21][3]), glm::vec3(1.0f, 10.0f, 0.0f)));
+	assert(mat4Equal(nodes[1]->getWorldCoordinateMatrix(), before));
+
+	// Leaves moved and queried one at a time, as List::visit steps animations: each query refreshes one leaf, not the store
+	glm::mat4 lift = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	start = std::chrono::steady_clock::now();
+	for (int i = count - 2000; i < count; i++)
+	{
+		nodes[i]->setMatrix(lift * nodes[i]->getMatrix());
+		nodes[i]->getWorldCoordinateMatrix();
+	}
+	double leaves = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	for (int i = count - 2000; i < count; i += 101)
+		assert(mat4Equal(nodes[i]->getWorldCoordinateMatrix(), nodes[i]->getParent()->getWorldCoordinateMatrix() * lift * localMatrix(i)));
+	std::cout << "  2000 leaves moved and queried one by one: " << leaves << " ms" << std::endl;
+	assert(leaves < sweep * 100.0);
+
+	// Layout changes: a new child joins, a removed subtree leaves with its matrices
+	Eng::Node *added = new Eng::Node("Added", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+	nodes[7]->addChild(added);
+	assert(store->isLayoutDirty());
+	assert(vec3Equal(glm::vec3(added->getWorldCoordinateMatrix()[3]), glm::vec3(nodes[7]->getWorldCoordinateMatrix() * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f))));
+	assert(added->getTransformStore() == store);
+	assert(store->getNumberOfNodes() == count + 1);
+
+	Eng::Node *removed = nodes[2];
+	glm::mat4 removedLocal = removed->getMatrix();
+	root->removeChild(removed);
+	removed->setParent(nullptr);
+	store->update();
+	assert(removed->getTransformStore() == nullptr && nodes[9]->getTransformStore() == nullptr);
+	assert(mat4Equal(removed->getMatrix(), removedLocal));
+	assert(mat4Equal(removed->getWorldCoordinateMatrix(), removedLocal));
+
+	// Deleting a stored leaf only flags the layout
+	unsigned int stored = store->getNumberOfNodes();
+	nodes[24999]->removeChild(nodes[count - 1]);
+	delete nodes[count - 1];
+	assert(store->isLayoutDirty());
+	store->update();
+	assert(store->getNumberOfNodes() == stored - 1);
+
+	// A subtree stored below a standalone node follows its parent's translation
+	Eng::Node *holder = new Eng::Node("Holder", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f)));
+	Eng::Node *inner = new Eng::Node("Inner", glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+	holder->addChild(inner);
+	Eng::TransformStore *subtree = new Eng::TransformStore();
+	subtree->build(inner);
+	assert(vec3Equal(glm::vec3(inner->getWorldCoordinateMatrix()[3]), glm::vec3(1.0f, 0.0f, -3.0f)));
+	holder->setMatrix(glm::mat4(1.0f));
+	assert(vec3Equal(glm::vec3(inner->getWorldCoordinateMatrix()[3]), glm::vec3(1.0f, 0.0f, 0.0f)));
+	delete subtree;
+	delete holder;
+
+	// The list traversal reads the stored matrices
+	Eng::List *list = new Eng::List("StoreList");
+	list->pass(root, glm::mat4(1.0f));
+	assert(list->getNumberOfTraversedNodes() == store->getNumberOfNodes());
+	list->clear();
+	delete list;
+
+	// Destroying the store hands the matrices back
+	glm::mat4 world = nodes[21]->getWorldCoordinateMatrix();
+	delete store;
+	assert(nodes[21]->getTransformStore() == nullptr);
+	assert(mat4Equal(nodes[21]->getWorldCoordinateMatrix(), world));
+
+	delete root;
+	delete removed;
+
+	TEST_PASS();
+}
+
 void testNodeMovement()
 {
 	TEST("Node animation movement");
@@ -241,8 +681,273 @@ void testNodeRemoval()
 	// Remove non-existent
 	assert(parent->removeChild(child2) == false);
 
+	// Subtree sizes follow the moves, up to the root
+	Eng::Node *root = new Eng::Node("Root");
+	root->addChild(parent);
+	child2->addChild(child3);
+	parent->addChild(child2);
+	assert(root->getSubtreeSize() == 5 && parent->getSubtreeSize() == 4 && child2->getSubtreeSize() == 2);
+	child1->addChild(child3);
+	assert(root->getSubtreeSize() == 5 && child1->getSubtreeSize() == 2 && child2->getSubtreeSize() == 1);
+	root->removeChild(parent);
+	assert(root->getSubtreeSize() == 1 && parent->getSubtreeSize() == 4);
+
+	delete root;
 	delete parent;
-	delete child2; // Not deleted by parent
+
+	TEST_PASS();
+}
+
+void testNodeNameIndex()
+{
+	TEST("Node name index and path queries");
+
+	// The linear search getChild used to run
+	auto reference = [](const Eng::Node *node, const std::string &name, auto &&self) -> Eng::Node *
+	{
+		for (Eng::Node *child : node->getChildren())
+			if (child->getName() == name)
+				return child;
+		for (Eng::Node *child : node->getChildren())
+			if (Eng::Node *found = self(child, name, self))
+				return found;
+		return nullptr;
+	};
+	auto collect = [](Eng::Node *node, std::vector<Eng::Node *> &nodes, auto &&self) -> void
+	{
+		nodes.push_back(node);
+		for (Eng::Node *child : node->getChildren())
+			self(child, nodes, self);
+	};
+
+	// 2000 nodes named from a pool of 40, so most names repeat across the graph and among siblings
+	unsigned int seed = 12345;
+	auto random = [&seed](unsigned int range)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) % range;
+	};
+	auto randomName = [&]()
+	{ return "N" + std::to_string(random(40)); };
+	Eng::Node *root = new Eng::Node("Root");
+	std::vector<Eng::Node *> nodes = {root};
+	for (int i = 1; i < 2000; i++)
+	{
+		Eng::Node *node = new Eng::Node(randomName());
+		nodes[random((unsigned int)nodes.size())]->addChild(node);
+		nodes.push_back(node);
+	}
+
+	auto check = [&]()
+	{
+		std::vector<Eng::Node *> current;
+		collect(root, current, collect);
+		for (int q = 0; q < 200; q++)
+		{
+			Eng::Node *from = current[random((unsigned int)current.size())];
+			std::string name = randomName();
+			assert(from->getChild(name) == reference(from, name, reference));
+		}
+		for (int q = 0; q < 50; q++)
+		{
+			// Names repeat among siblings: the path leads through the first child of each name
+			Eng::Node *node = current[1 + random((unsigned int)current.size() - 1)];
+			std::string path = node->getPath();
+			Eng::Node *expected = root;
+			for (size_t start = 0, end; expected && start <= path.size(); start = end + 1)
+			{
+				end = std::min(path.find('/', start), path.size());
+				Eng::Node *next = nullptr;
+				for (Eng::Node *child : expected->getChildren())
+					if (!next && child->getName() == path.substr(start, end - start))
+						next = child;
+				expected = next;
+			}
+			assert(root->getChildByPath(path) == expected);
+			assert(expected == nullptr || expected->getPath() == path);
+		}
+		return current;
+	};
+	check();
+
+	// Edits after the index exists: reparenting, renaming, removing and deleting subtrees
+	for (int step = 0; step < 300; step++)
+	{
+		std::vector<Eng::Node *> current;
+		collect(root, current, collect);
+		Eng::Node *node = current[1 + random((unsigned int)current.size() - 1)];
+		switch (step % 4)
+		{
+		case 0:
+		{
+			// Not below itself
+			Eng::Node *parent = current[random((unsigned int)current.size())];
+			Eng::Node *ancestor = parent;
+			while (ancestor && ancestor != node)
+				ancestor = ancestor->getParent();
+			if (ancestor == nullptr)
+				parent->addChild(node);
+			break;
+		}
+		case 1:
+			node->setName(randomName());
+			break;
+		case 2:
+		{
+			// A detached subtree is a graph of its own, then it comes back
+			Eng::Node *parent = node->getParent();
+			assert(parent->removeChild(node));
+			assert(node->getParent() == nullptr && node->getPath().empty());
+			std::string name = randomName();
+			assert(node->getChild(name) == reference(node, name, reference));
+			assert(root->getChild(node->getName()) != node);
+			parent->addChild(node);
+			break;
+		}
+		case 3:
+			if (node->getNumberOfChildren() < 20)
+			{
+				node->getParent()->removeChild(node);
+				delete node;
+			}
+			break;
+		}
+		if (step % 30 == 0)
+			check();
+	}
+	check();
+
+	// Paths: direct children only, first one in order, empty names skipped
+	Eng::Node *table = new Eng::Node("Table");
+	Eng::Node *stick = new Eng::Node("Stick1");
+	Eng::Node *disk = new Eng::Node("Disk3");
+	Eng::Node *twin = new Eng::Node("Disk3");
+	root->addChild(table);
+	table->addChild(stick);
+	stick->addChild(disk);
+	stick->addChild(twin);
+	assert(root->getChildByPath("Table/Stick1/Disk3") == disk);
+	assert(root->getChildByPath("/Table//Stick1/Disk3/") == disk);
+	assert(table->getChildByPath("Stick1/Disk3") == disk);
+	assert(root->getChildByPath("Table/Disk3") == nullptr);
+	assert(root->getChildByPath("Table/Stick1/Missing") == nullptr);
+	assert(root->getChildByPath("") == nullptr);
+	assert(disk->getPath() == "Table/Stick1/Disk3");
+	stick->removeChild(disk);
+	assert(root->getChildByPath("Table/Stick1/Disk3") == twin);
+	stick->setName("Stick2");
+	assert(root->getChildByPath("Table/Stick2/Disk3") == twin && root->getChildByPath("Table/Stick1") == nullptr);
+	delete disk;
+
+	// 100k uniquely named nodes: hashed lookups against the linear search
+	Eng::Node *large = new Eng::Node("Large");
+	std::vector<Eng::Node *> levels = {large};
+	for (int i = 1; i < 100000; i++)
+	{
+		Eng::Node *node = new Eng::Node("Node" + std::to_string(i));
+		levels[(i - 1) / 4]->addChild(node);
+		levels.push_back(node);
+	}
+	auto start = std::chrono::steady_clock::now();
+	assert(large->getChild("Node99999") == levels[99999]);
+	double build = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 100; i++)
+		assert(reference(large, "Node" + std::to_string(99900 + i), reference) == levels[99900 + i]);
+	double linear = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / 100.0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 100; i++)
+		assert(large->getChild("Node" + std::to_string(99900 + i)) == levels[99900 + i]);
+	double hashed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / 100.0;
+	std::cout << "  Lookup in 100k nodes, linear: " << linear << " ms, indexed: " << hashed * 1000.0 << " us (index built in " << build << " ms)" << std::endl;
+
+	delete large;
+	delete root;
+
+	TEST_PASS();
+}
+
+void testNodeKinds()
+{
+	TEST("Node kind tags replace dynamic_cast (deep scene benchmark)");
+
+	Eng::Node plain("Plain");
+	Eng::Mesh mesh("Mesh");
+	Eng::OmniLight omni("Omni");
+	Eng::SpotLight spot("Spot");
+	Eng::InfiniteLight sun("Sun");
+	Eng::PerspectiveCamera perspective("Perspective");
+	Eng::OrthoCamera ortho("Ortho");
+	assert(plain.getKind() == Eng::Node::Kind::NODE && !plain.isLight() && !plain.isCamera());
+	assert(mesh.getKind() == Eng::Node::Kind::MESH && !mesh.isLight());
+	assert(omni.getKind() == Eng::Node::Kind::OMNI_LIGHT && omni.isLight());
+	assert(spot.getKind() == Eng::Node::Kind::SPOT_LIGHT && spot.isLight() && !spot.isCamera());
+	assert(sun.getKind() == Eng::Node::Kind::INFINITE_LIGHT && sun.isLight());
+	assert(perspective.getKind() == Eng::Node::Kind::PERSPECTIVE_CAMERA && perspective.isCamera() && !perspective.isLight());
+	assert(ortho.getKind() == Eng::Node::Kind::ORTHO_CAMERA && ortho.isCamera());
+	Eng::Mesh *instance = mesh.createInstance("Instance", glm::mat4(1.0f));
+	assert(instance->getKind() == Eng::Node::Kind::MESH);
+	delete instance;
+
+	// 64 chains 512 levels deep; every level holds a mesh, every eighth a light too
+	Eng::Node *root = new Eng::Node("Root");
+	for (int c = 0; c < 64; c++)
+	{
+		Eng::Node *level = root;
+		for (int d = 0; d < 512; d++)
+		{
+			Eng::Node *next = new Eng::Node("Level", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -0.01f)));
+			level->addChild(new Eng::Mesh("Leaf"));
+			if (d % 8 == 0)
+				level->addChild(new Eng::InfiniteLight("Light"));
+			level->addChild(next);
+			level = next;
+		}
+	}
+
+	// The classification List::pass does per node, before (two casts) and after (one tag read)
+	std::vector<Eng::Node *> stack;
+	auto classify = [&](bool tags, unsigned int &lights, unsigned int &meshes)
+	{
+		lights = meshes = 0;
+		stack.assign(1, root);
+		auto start = std::chrono::steady_clock::now();
+		while (!stack.empty())
+		{
+			Eng::Node *node = stack.back();
+			stack.pop_back();
+			if (tags ? node->isLight() : dynamic_cast<Eng::Light *>(node) != nullptr)
+				lights++;
+			else if (tags ? node->getKind() == Eng::Node::Kind::MESH : dynamic_cast<Eng::Mesh *>(node) != nullptr)
+				meshes++;
+			for (Eng::Node *child : node->getChildren())
+				stack.push_back(child);
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+	unsigned int castLights, castMeshes, tagLights, tagMeshes;
+	double casts = 1e30, tags = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		casts = std::min(casts, classify(false, castLights, castMeshes));
+		tags = std::min(tags, classify(true, tagLights, tagMeshes));
+	}
+	assert(castLights == 64 * 64 && castMeshes == 64 * 512);
+	assert(tagLights == castLights && tagMeshes == castMeshes);
+
+	// The whole pass, culling disabled so every mesh reaches the list
+	Eng::List *list = new Eng::List("KindList");
+	list->setFrustumCulling(false);
+	auto start = std::chrono::steady_clock::now();
+	list->pass(root, glm::mat4(1.0f));
+	double pass = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	assert(list->getNumberOfVisibleMeshes() == 64 * 512);
+	list->clear();
+	std::cout << "  Traversal of " << list->getNumberOfTraversedNodes() << " nodes, dynamic_cast: " << casts << " ms, kind tags: " << tags
+			  << " ms, List::pass: " << pass << " ms" << std::endl;
+
+	delete list;
+	delete root;
 
 	TEST_PASS();
 }
@@ -397,116 +1102,2093 @@ void testMeshCreation()
 	TEST_PASS();
 }
 
-// ============================================================================
-// LIGHT TESTS
-// ============================================================================
-
-void testOmniLight()
+void testMeshGeometryAllocations()
 {
-	TEST("Omni light creation and properties");
+	TEST("Mesh geometry loads without reallocations or copies");
+
+	// One large mesh: every geometry buffer is at least as big as the texture coordinates
+	const unsigned int vertexes = 4096, faces = 4096;
+	std::string path = (std::filesystem::temp_directory_path() / "engine_test_geometry.ovo").string();
+	FILE *file = fopen(path.c_str(), "wb");
+	assert(file != nullptr);
+
+	std::vector<char> payload;
+	appendNodeHeader(payload, "Big", glm::mat4(1.0f), 0);
+	unsigned char subtype = 0, physics = 0;
+	float radius = 1.0f;
+	glm::vec3 boxMin(0.0f), boxMax(1.0f);
+	unsigned int lods = 1;
+	appendBytes(payload, &subtype, sizeof(unsigned char));
+	appendString(payload, "[none]");
+	appendBytes(payload, &radius, sizeof(float));
+	appendBytes(payload, &boxMin, sizeof(glm::vec3));
+	appendBytes(payload, &boxMax, sizeof(glm::vec3));
+	appendBytes(payload, &physics, sizeof(unsigned char));
+	appendBytes(payload, &lods, sizeof(unsigned int));
+	appendBytes(payload, &vertexes, sizeof(unsigned int));
+	appendBytes(payload, &faces, sizeof(unsigned int));
+	for (unsigned int v = 0; v < vertexes; v++)
+	{
+		glm::vec3 position((float)(v % 64), 0.0f, (float)(v / 64));
+		unsigned int packed[3] = {0x1FF << 10, 0, 0x1FF};
+		appendBytes(payload, &position, sizeof(glm::vec3));
+		appendBytes(payload, packed, sizeof(packed));
+	}
+	for (unsigned int f = 0; f < faces; f++)
+	{
+		glm::uvec3 face(f, (f + 1) % vertexes, (f + 64) % vertexes);
+		appendBytes(payload, &face, sizeof(glm::uvec3));
+	}
+	writeChunk(file, 18, payload);
+	fclose(file);
 
-	glm::mat4 pos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 10.0f, 0.0f));
-	Eng::OmniLight *light = new Eng::OmniLight("OmniLight1", pos);
+	allocationThreshold = vertexes * sizeof(glm::vec2);
 
-	// Test default values
-	assert(light->getName() == "OmniLight1");
+	for (unsigned int workers : {1u, 4u})
+	{
+		Eng::OvoReader reader;
+		reader.setWorkerThreads(workers);
+
+		// Exactly one allocation per buffer, none while moving them into the Mesh
+		largeAllocations = 0;
+		countAllocations = true;
+		Eng::Node *node = reader.load(path);
+		countAllocations = false;
+
+		assert(reader.wasMemoryMapped());
+		Eng::Mesh *mesh = dynamic_cast<Eng::Mesh *>(node);
+		assert(mesh != nullptr);
+		assert(largeAllocations == 5);
+		assert(mesh->getVertexes().size() == vertexes && mesh->getVertexes().capacity() == vertexes);
+		assert(mesh->getFaces().size() == faces && mesh->getFaces().capacity() == faces);
+		assert(mesh->getTangents().capacity() == vertexes);
+		assert(mesh->getFaces()[1] == glm::uvec3(1, 2, 65));
+		delete node;
+	}
 
-	// Test color properties
-	glm::vec4 color(1.0f, 0.8f, 0.6f, 1.0f);
-	light->setAmbient(color);
-	light->setDiffuse(color);
-	light->setSpecular(color);
+	// Geometry built in code changes owner without being copied
+	Eng::MeshGeometry geometry;
+	geometry.allocate(vertexes, faces, false);
+	const glm::vec3 *data = geometry.vertexes.data();
 
-	assert(light->getAmbient() == color);
-	assert(light->getDiffuse() == color);
-	assert(light->getSpecular() == color);
+	largeAllocations = 0;
+	countAllocations = true;
+	Eng::Mesh *mesh = new Eng::Mesh("Moved", glm::mat4(1.0f), std::move(geometry));
+	countAllocations = false;
 
-	// Test attenuation
-	light->setAttenuaton(1.0f, 0.1f, 0.01f);
+	assert(largeAllocations == 0);
+	assert(mesh->getVertexes().data() == data);
+	assert(mesh->getTangents().empty());
+	assert(geometry.vertexes.empty());
 
-	delete light;
+	delete mesh;
+	std::filesystem::remove(path);
 
 	TEST_PASS();
 }
 
-void testSpotLight()
+void testMeshLods()
 {
-	TEST("Spot light with cutoff angle");
-
-	glm::mat4 pos = glm::mat4(1.0f);
-	float cutoff = 30.0f;
-	Eng::SpotLight *light = new Eng::SpotLight("SpotLight1", pos, cutoff);
-
-	assert(light->getName() == "SpotLight1");
-	assert(floatEqual(light->getCutoff(), cutoff));
-
-	// Test cutoff modification
-	light->setCutoff(45.0f);
-	assert(floatEqual(light->getCutoff(), 45.0f));
+	TEST("Mesh levels of detail and selection hysteresis");
+
+	// One mesh with three LODs of decreasing density
+	const unsigned int lodVertexes[3] = {400, 100, 25};
+	std::string path = (std::filesystem::temp_directory_path() / "engine_test_lods.ovo").string();
+	FILE *file = fopen(path.c_str(), "wb");
+	assert(file != nullptr);
+
+	std::vector<char> payload;
+	appendNodeHeader(payload, "[root]", glm::mat4(1.0f), 1);
+	writeChunk(file, 1, payload);
+
+	payload.clear();
+	appendNodeHeader(payload, "Terrain", glm::mat4(1.0f), 0);
+	unsigned char subtype = 0, physics = 0;
+	float radius = 2.5f;
+	glm::vec3 boxMin(-1.0f), boxMax(1.0f);
+	unsigned int lods = 3;
+	appendBytes(payload, &subtype, sizeof(unsigned char));
+	appendString(payload, "[none]");
+	appendBytes(payload, &radius, sizeof(float));
+	appendBytes(payload, &boxMin, sizeof(glm::vec3));
+	appendBytes(payload, &boxMax, sizeof(glm::vec3));
+	appendBytes(payload, &physics, sizeof(unsigned char));
+	appendBytes(payload, &lods, sizeof(unsigned int));
+	for (unsigned int l = 0; l < lods; l++)
+	{
+		unsigned int vertexes = lodVertexes[l], faces = vertexes - 2;
+		appendBytes(payload, &vertexes, sizeof(unsigned int));
+		appendBytes(payload, &faces, sizeof(unsigned int));
+		for (unsigned int v = 0; v < vertexes; v++)
+		{
+			glm::vec3 position((float)v, (float)l, 0.0f);
+			unsigned int packed[3] = {0x1FF << 10, 0, 0x1FF};
+			appendBytes(payload, &position, sizeof(glm::vec3));
+			appendBytes(payload, packed, sizeof(packed));
+		}
+		for (unsigned int f = 0; f < faces; f++)
+		{
+			glm::uvec3 face(f, f + 1, f + 2);
+			appendBytes(payload, &face, sizeof(glm::uvec3));
+		}
+	}
+	writeChunk(file, 18, payload);
+	fclose(file);
 
-	// Test invalid cutoff (negative)
-	light->setCutoff(-10.0f);
-	assert(floatEqual(light->getCutoff(), 0.0f));
+	// Serial and parallel loaders keep every LOD
+	for (unsigned int workers : {1u, 4u})
+	{
+		Eng::OvoReader reader;
+		reader.setWorkerThreads(workers);
+		Eng::Node *root = reader.load(path);
+		assert(root != nullptr && root->getNumberOfChildren() == 1);
+
+		Eng::Mesh *mesh = dynamic_cast<Eng::Mesh *>(root->getChild(0));
+		assert(mesh != nullptr);
+		assert(mesh->getNumberOfLods() == 3);
+		assert(floatEqual(mesh->getBoundingRadius(), 2.5f));
+		for (unsigned int l = 0; l < 3; l++)
+		{
+			assert(mesh->getLod(l).vertexes.size() == lodVertexes[l]);
+			assert(mesh->getLod(l).faces.size() == lodVertexes[l] - 2);
+			assert(mesh->getLod(l).vertexes[1] == glm::vec3(1.0f, (float)l, 0.0f));
+		}
+		assert(mesh->getVertexes().size() == lodVertexes[0]);
+
+		// Selection is clamped to the available levels
+		mesh->setCurrentLod(7);
+		assert(mesh->getCurrentLod() == 2);
+
+		// The scene cache keeps the LODs too
+		std::string cachePath = Eng::OvoCache::getCachePath(path);
+		assert(Eng::OvoCache::save(path, root));
+		Eng::Node *cached = Eng::OvoCache::load(path);
+		assert(cached != nullptr);
+		Eng::Mesh *cachedMesh = dynamic_cast<Eng::Mesh *>(cached->getChild(0));
+		assert(cachedMesh->getNumberOfLods() == 3);
+		assert(floatEqual(cachedMesh->getBoundingRadius(), 2.5f));
+		assert(cachedMesh->getLod(2).vertexes == mesh->getLod(2).vertexes);
+		std::filesystem::remove(cachePath);
+
+		delete cached;
+		delete root;
+	}
 
-	delete light;
+	// Hysteresis: thresholds 0.3 / 0.1 with a 20% margin
+	Eng::List list;
+	list.setLodThresholds({0.3f, 0.1f});
+	list.setLodHysteresis(0.2f);
+	assert(list.selectLod(0.5f, 0, 3) == 0);
+	assert(list.selectLod(0.26f, 0, 3) == 0); // within the margin: stays
+	assert(list.selectLod(0.2f, 0, 3) == 1);
+	assert(list.selectLod(0.34f, 1, 3) == 1); // within the margin: stays
+	assert(list.selectLod(0.4f, 1, 3) == 0);
+	assert(list.selectLod(0.01f, 0, 3) == 2); // several levels at once
+	assert(list.selectLod(0.01f, 0, 2) == 1); // never past the coarsest level
+	assert(list.selectLod(0.9f, 2, 3) == 0);
+
+	std::filesystem::remove(path);
 
 	TEST_PASS();
 }
 
-void testInfiniteLight()
+void testMeshBounds()
 {
-	TEST("Infinite (directional) light");
-
-	glm::mat4 dir = glm::rotate(glm::mat4(1.0f), glm::radians(45.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	Eng::InfiniteLight *light = new Eng::InfiniteLight("DirLight", dir);
-
-	assert(light->getName() == "DirLight");
+	TEST("Mesh bounding sphere and box");
+
+	// Built in code: computed from the vertexes on first use
+	Eng::Mesh *mesh = new Eng::Mesh("Box", glm::mat4(1.0f),
+									{glm::vec3(-1.0f, 0.0f, -2.0f), glm::vec3(3.0f, 4.0f, 0.0f), glm::vec3(0.0f, -1.0f, 1.0f)},
+									{glm::uvec3(0, 1, 2)});
+	assert(vec3Equal(mesh->getBoundingBoxMin(), glm::vec3(-1.0f, -1.0f, -2.0f)));
+	assert(vec3Equal(mesh->getBoundingBoxMax(), glm::vec3(3.0f, 4.0f, 1.0f)));
+	assert(floatEqual(mesh->getBoundingRadius(), 5.0f));
+
+	// World space: translation moves the sphere, the largest scale grows it
+	glm::mat4 world = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, 0.0f, 0.0f)), glm::vec3(1.0f, 2.0f, 1.0f));
+	glm::vec4 sphere = mesh->getBoundingSphere(world);
+	assert(vec3Equal(glm::vec3(sphere), glm::vec3(10.0f, 0.0f, 0.0f)));
+	assert(floatEqual(sphere.w, 10.0f));
+
+	glm::vec3 boxMin, boxMax;
+	mesh->getBoundingBox(world, boxMin, boxMax);
+	assert(vec3Equal(boxMin, glm::vec3(9.0f, -2.0f, -2.0f)));
+	assert(vec3Equal(boxMax, glm::vec3(13.0f, 8.0f, 1.0f)));
+
+	// A quarter turn around Y swaps the X and Z extents
+	glm::mat4 turned = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	mesh->getBoundingBox(turned, boxMin, boxMax);
+	assert(vec3Equal(boxMin, glm::vec3(-2.0f, -1.0f, -3.0f), 0.001f));
+	assert(vec3Equal(boxMax, glm::vec3(1.0f, 4.0f, 1.0f), 0.001f));
+
+	// Bounds provided by a loader win over the vertexes
+	mesh->setBounds(8.0f, glm::vec3(-4.0f), glm::vec3(4.0f));
+	assert(floatEqual(mesh->getBoundingRadius(), 8.0f));
+	mesh->invalidateBounds();
+	assert(floatEqual(mesh->getBoundingRadius(), 5.0f));
+	delete mesh;
 
-	glm::vec4 color(0.9f, 0.9f, 1.0f, 1.0f);
-	light->setDiffuse(color);
-	assert(light->getDiffuse() == color);
+	// OVO files: sphere and box are read from the mesh chunk and survive the scene cache
+	std::string path = writeSyntheticOvo("engine_test_bounds.ovo", 3);
+	Eng::OvoReader reader;
+	Eng::Node *root = reader.load(path);
+	assert(root != nullptr);
+	assert(Eng::OvoCache::save(path, root));
+	Eng::Node *cached = Eng::OvoCache::load(path);
+	assert(cached != nullptr);
+	for (Eng::Node *scene : {root, cached})
+	{
+		Eng::Mesh *loaded = dynamic_cast<Eng::Mesh *>(scene->getChild(2));
+		assert(floatEqual(loaded->getBoundingRadius(), 1.5f));
+		assert(vec3Equal(loaded->getBoundingBoxMin(), glm::vec3(-1.0f, 0.0f, -1.0f)));
+		assert(vec3Equal(loaded->getBoundingBoxMax(), glm::vec3(1.0f, 0.0f, 1.0f)));
+	}
 
-	delete light;
+	delete root;
+	delete cached;
+	std::filesystem::remove(Eng::OvoCache::getCachePath(path));
+	std::filesystem::remove(path);
 
 	TEST_PASS();
 }
 
-// ============================================================================
-// LIST TESTS
-// ============================================================================
+// Lit grid of (cells + 1)^2 vertexes covering [-1, 1]^2, with normals bent outwards
+Eng::MeshGeometry makeGridGeometry(unsigned int cells, float size = 1.0f)
+{
+	Eng::MeshGeometry geometry;
+	unsigned int side = cells + 1;
+	geometry.allocate(side * side, cells * cells * 2, false);
+	for (unsigned int y = 0; y < side; y++)
+	{
+		for (unsigned int x = 0; x < side; x++)
+		{
+			glm::vec3 position(size * (2.0f * x / cells - 1.0f), size * (2.0f * y / cells - 1.0f), 0.0f);
+			geometry.vertexes[y * side + x] = position;
+			geometry.normals[y * side + x] = glm::vec4(glm::normalize(glm::vec3(position.x, position.y, 1.0f)), 0.0f);
+			geometry.textureCoordinates[y * side + x] = glm::vec2((float)x / cells, (float)y / cells);
+		}
+	}
+	for (unsigned int y = 0, f = 0; y < cells; y++)
+	{
+		for (unsigned int x = 0; x < cells; x++)
+		{
+			unsigned int corner = y * side + x;
+			geometry.faces[f++] = glm::uvec3(corner, corner + 1, corner + side + 1);
+			geometry.faces[f++] = glm::uvec3(corner, corner + side + 1, corner + side);
+		}
+	}
+	return geometry;
+}
 
-void testListManagement()
+std::vector<unsigned char> renderMeshPixels(Eng::Mesh *mesh)
 {
-	TEST("Scene list management");
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	mesh->render(glm::mat4(1.0f));
+	glFinish();
+
+	std::vector<unsigned char> pixels(64 * 64 * 4);
+	glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	return pixels;
+}
 
-	Eng::List *list = new Eng::List("SceneList");
+void testMeshVertexBuffers()
+{
+	TEST("Mesh vertex buffer objects");
 
-	// Create test scene
-	Eng::Node *root = new Eng::Node("Root");
-	Eng::Mesh *mesh1 = new Eng::Mesh("Mesh1");
-	Eng::OmniLight *light1 = new Eng::OmniLight("Light1");
+	if (!makeOffscreenContext())
+	{
+		std::cout << "  No offscreen OpenGL context, skipped" << std::endl;
+		TEST_PASS();
+		return;
+	}
 
-	root->addChild(mesh1);
-	root->addChild(light1);
+	// Fixed pipeline lighting, so normals show up in the pixels
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
+	glEnable(GL_LIGHT0);
+	GLfloat lightPosition[] = {0.0f, 0.0f, 1.0f, 0.0f};
+	glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+
+	Eng::Mesh *mesh = new Eng::Mesh("Grid", glm::mat4(1.0f), makeGridGeometry(32));
+	assert(Eng::Mesh::areVertexBuffersEnabled());
+	assert(!mesh->isUploaded(0));
+
+	// Lazy upload on first render, then both paths draw the same pixels
+	std::vector<unsigned char> retained = renderMeshPixels(mesh);
+	assert(mesh->isUploaded(0));
+
+	Eng::Mesh::setVertexBuffersEnabled(false);
+	std::vector<unsigned char> immediate = renderMeshPixels(mesh);
+	Eng::Mesh::setVertexBuffersEnabled(true);
+
+	int differences = 0;
+	for (size_t p = 0; p < retained.size(); p++)
+	{
+		if (std::abs((int)retained[p] - (int)immediate[p]) > 1)
+			differences++;
+	}
+	assert(differences == 0);
+	assert(retained[(32 * 64 + 32) * 4] > 0);
+
+	// Replacing the geometry marks it dirty until the next render uploads it again
+	mesh->setLod(0, makeGridGeometry(4, 0.5f));
+	assert(!mesh->isUploaded(0));
+	std::vector<unsigned char> smaller = renderMeshPixels(mesh);
+	assert(mesh->isUploaded(0));
+	assert(smaller[(2 * 64 + 2) * 4] == 0);
+	assert(smaller[(32 * 64 + 32) * 4] > 0);
+	delete mesh;
 
-	// Create and set camera
-	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
-	camera->setCameraParams(45.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
-	list->setCamera(camera);
+	// Benchmark: the same dense grid drawn in immediate mode and from buffer objects
+	Eng::Mesh *dense = new Eng::Mesh("Dense", glm::mat4(1.0f), makeGridGeometry(256));
+	const int frames = 20;
+	double milliseconds[2];
+	for (int path = 0; path < 2; path++)
+	{
+		Eng::Mesh::setVertexBuffersEnabled(path == 1);
+		renderMeshPixels(dense); // warm up, uploads the buffers
 
-	// Pass through scene
-	list->pass(root, glm::mat4(1.0f));
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			dense->render(glm::mat4(1.0f));
+		}
+		glFinish();
+		milliseconds[path] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+	}
+	Eng::Mesh::setVertexBuffersEnabled(true);
+	std::cout << "  " << dense->getFaces().size() << " triangles, per frame: immediate " << milliseconds[0]
+			  << " ms, buffer objects " << milliseconds[1] << " ms (" << milliseconds[0] / milliseconds[1] << "x)" << std::endl;
+	delete dense;
 
-	// Clear list
-	list->clear();
+	glDisable(GL_LIGHTING);
+	glDisable(GL_LIGHT0);
+	glDisable(GL_DEPTH_TEST);
 
-	delete list;
-	delete root;
+	TEST_PASS();
+}
+
+void testMeshInstancing()
+{
+	TEST("Mesh instances and instanced draws");
+
+	// Instances share geometry, bounds and buffers
+	Eng::Mesh *source = new Eng::Mesh("Tile", glm::mat4(1.0f), makeGridGeometry(4, 0.5f));
+	Eng::Mesh *copy = source->createInstance("Tile copy", glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+	assert(copy->sharesGeometry(source) && source->sharesGeometry(copy));
+	assert(copy->getGeometryId() == source->getGeometryId());
+	assert(copy->getFaces().size() == 32);
+	assert(floatEqual(copy->getBoundingRadius(), source->getBoundingRadius()));
+	copy->setLod(0, makeGridGeometry(2, 0.5f));
+	assert(source->getFaces().size() == 8);
+	delete copy;
+	assert(source->getFaces().size() == 8); // the geometry lives while one mesh uses it
+
+	if (!makeOffscreenContext())
+	{
+		std::cout << "  No offscreen OpenGL context, draws not checked" << std::endl;
+		delete source;
+		TEST_PASS();
+		return;
+	}
+	std::cout << "  Instanced draws " << (Eng::Mesh::isInstancingSupported() ? "supported" : "not supported, fallback only") << std::endl;
+
+	// 7x7 rotated and stretched copies in front of the camera, lit by a directional and a spot light
+	Eng::Material *material = new Eng::Material("Shiny", glm::vec4(0.05f, 0.0f, 0.0f, 1.0f), glm::vec4(0.2f), glm::vec4(0.2f, 0.6f, 0.9f, 1.0f), glm::vec4(0.8f), 16.0f);
+	source->setMaterial(material);
+	Eng::Node *root = new Eng::Node("Root");
+	for (int y = 0; y < 7; y++)
+	{
+		for (int x = 0; x < 7; x++)
+		{
+			glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(x - 3.0f, y - 3.0f, -12.0f));
+			matrix = glm::rotate(matrix, glm::radians(x * 12.0f - 36.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			matrix = glm::scale(matrix, glm::vec3(1.0f, 1.0f + y * 0.1f, 1.0f));
+			root->addChild(source->createInstance("Tile", matrix));
+		}
+	}
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_NORMALIZE); // as set up by Eng::Base::init
+	glEnable(GL_LIGHTING);
+	for (int l = 0; l < 8; l++)
+		glDisable(GL_LIGHT0 + l);
+	GLfloat directional[] = {0.3f, 0.5f, 1.0f, 0.0f};
+	GLfloat spotPosition[] = {0.0f, 0.0f, -6.0f, 1.0f};
+	GLfloat spotDirection[] = {0.0f, 0.0f, -1.0f};
+	GLfloat spotCutoff = 30.0f;
+	GLfloat white[] = {1.0f, 1.0f, 1.0f, 1.0f};
+	glEnable(GL_LIGHT0);
+	glLightfv(GL_LIGHT0, GL_POSITION, directional);
+	glEnable(GL_LIGHT1);
+	glLightfv(GL_LIGHT1, GL_DIFFUSE, white);
+	glLightfv(GL_LIGHT1, GL_SPECULAR, white);
+	glLightfv(GL_LIGHT1, GL_POSITION, spotPosition);
+	glLightfv(GL_LIGHT1, GL_SPOT_DIRECTION, spotDirection);
+	glLightfv(GL_LIGHT1, GL_SPOT_CUTOFF, &spotCutoff);
+	glLightf(GL_LIGHT1, GL_LINEAR_ATTENUATION, 0.1f);
+
+	// Lighting on, a directional light (type 1) and a spot light (type 3)
+	assert(Eng::Mesh::getLightingState() == ((1u << 16) | 1u | (3u << 2)));
+
+	Eng::List *list = new Eng::List("InstancedList");
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(45.0f, 1.0f, 0.1f, 100.0f);
+	list->setCamera(camera);
+
+	auto drawFrame = [&](std::vector<unsigned char> *pixels)
+	{
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		list->pass(root, glm::mat4(1.0f));
+		list->render();
+		list->clear();
+		if (pixels)
+		{
+			pixels->resize(64 * 64 * 4);
+			glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+		}
+	};
+
+	// Both paths light the copies alike; the batch sets the material once
+	assert(!Eng::Mesh::isInstancingEnabled());
+	std::vector<unsigned char> instanced, separate;
+	Eng::Mesh::setInstancingEnabled(true);
+	drawFrame(&instanced);
+	Eng::Material::StateCacheStats stats = Eng::Material::getStateCacheStats();
+	assert(stats.materialChanges == 1);
+
+	Eng::Mesh::setInstancingEnabled(false);
+	drawFrame(&separate);
+
+	int maxDifference = 0, lit = 0;
+	for (size_t p = 0; p < instanced.size(); p++)
+	{
+		maxDifference = std::max(maxDifference, std::abs((int)instanced[p] - (int)separate[p]));
+		lit += (p % 4 != 3 && instanced[p] > 0) ? 1 : 0;
+	}
+	std::cout << "  Largest channel difference between instanced and separate draws: " << maxDifference << std::endl;
+	assert(lit > 0);
+	assert(maxDifference <= 4);
+
+	delete list;
+	delete root;
+
+	// Benchmark: 10k copies of one small mesh, visible all at once
+	Eng::Node *crowd = new Eng::Node("Crowd");
+	for (int i = 0; i < 10000; i++)
+	{
+		glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3((i % 100) * 0.5f - 25.0f, (i / 100) * 0.5f - 25.0f, -70.0f));
+		crowd->addChild(source->createInstance("Copy", glm::scale(matrix, glm::vec3(0.4f))));
+	}
+	list = new Eng::List("CrowdList");
+	list->setCamera(camera);
+	root = crowd;
+
+	// Lit frames also measure the shading cost, unlit ones mostly the submission cost
+	const int frames = 10;
+	for (int lighting = 1; lighting >= 0; lighting--)
+	{
+		if (lighting)
+			glEnable(GL_LIGHTING);
+		else
+			glDisable(GL_LIGHTING);
+
+		double milliseconds[2];
+		for (int path = 0; path < 2; path++)
+		{
+			Eng::Mesh::setInstancingEnabled(path == 1);
+			drawFrame(nullptr);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < frames; frame++)
+				drawFrame(nullptr);
+			glFinish();
+			milliseconds[path] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+		}
+		std::cout << "  10000 copies " << (lighting ? "lit" : "unlit") << ", per frame: one draw per copy " << milliseconds[0]
+				  << " ms, instanced " << milliseconds[1] << " ms (" << milliseconds[0] / milliseconds[1] << "x)" << std::endl;
+	}
+	Eng::Mesh::setInstancingEnabled(false);
+
+	glDisable(GL_LIGHT1);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_NORMALIZE);
+	glDisable(GL_DEPTH_TEST);
+
+	delete list;
+	delete crowd;
+	delete camera;
+	delete source;
+	delete material;
+
+	TEST_PASS();
+}
+
+// ============================================================================
+// LIGHT TESTS
+// ============================================================================
+
+void testOmniLight()
+{
+	TEST("Omni light creation and properties");
+
+	glm::mat4 pos = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 10.0f, 0.0f));
+	Eng::OmniLight *light = new Eng::OmniLight("OmniLight1", pos);
+
+	// Test default values
+	assert(light->getName() == "OmniLight1");
+
+	// Test color properties
+	glm::vec4 color(1.0f, 0.8f, 0.6f, 1.0f);
+	light->setAmbient(color);
+	light->setDiffuse(color);
+	light->setSpecular(color);
+
+	assert(light->getAmbient() == color);
+	assert(light->getDiffuse() == color);
+	assert(light->getSpecular() == color);
+
+	// Test attenuation
+	light->setAttenuaton(1.0f, 0.1f, 0.01f);
+
+	delete light;
+
+	TEST_PASS();
+}
+
+void testSpotLight()
+{
+	TEST("Spot light with cutoff angle");
+
+	glm::mat4 pos = glm::mat4(1.0f);
+	float cutoff = 30.0f;
+	Eng::SpotLight *light = new Eng::SpotLight("SpotLight1", pos, cutoff);
+
+	assert(light->getName() == "SpotLight1");
+	assert(floatEqual(light->getCutoff(), cutoff));
+
+	// Test cutoff modification
+	light->setCutoff(45.0f);
+	assert(floatEqual(light->getCutoff(), 45.0f));
+
+	// Test invalid cutoff (negative)
+	light->setCutoff(-10.0f);
+	assert(floatEqual(light->getCutoff(), 0.0f));
+
+	delete light;
+
+	TEST_PASS();
+}
+
+void testInfiniteLight()
+{
+	TEST("Infinite (directional) light");
+
+	glm::mat4 dir = glm::rotate(glm::mat4(1.0f), glm::radians(45.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	Eng::InfiniteLight *light = new Eng::InfiniteLight("DirLight", dir);
+
+	assert(light->getName() == "DirLight");
+
+	glm::vec4 color(0.9f, 0.9f, 1.0f, 1.0f);
+	light->setDiffuse(color);
+	assert(light->getDiffuse() == color);
+
+	delete light;
+
+	TEST_PASS();
+}
+
+// ============================================================================
+// LIST TESTS
+// ============================================================================
+
+void testListManagement()
+{
+	TEST("Scene list management");
+
+	Eng::List *list = new Eng::List("SceneList");
+
+	// Create test scene
+	Eng::Node *root = new Eng::Node("Root");
+	Eng::Mesh *mesh1 = new Eng::Mesh("Mesh1");
+	Eng::OmniLight *light1 = new Eng::OmniLight("Light1");
+
+	root->addChild(mesh1);
+	root->addChild(light1);
+
+	// Create and set camera
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(45.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+	list->setCamera(camera);
+
+	// Pass through scene
+	list->pass(root, glm::mat4(1.0f));
+
+	// Clear list
+	list->clear();
+
+	delete list;
+	delete root;
+	delete camera;
+
+	TEST_PASS();
+}
+
+void testListFrustumCulling()
+{
+	TEST("List frustum culling");
+
+	// A row of 100 unit cubes (corner vertexes only) 20 units in front of the camera
+	Eng::Node *root = new Eng::Node("Root");
+	for (int i = 0; i < 100; i++)
+	{
+		glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(i * 10.0f - 495.0f, 0.0f, -20.0f));
+		root->addChild(new Eng::Mesh("Cube", matrix, {glm::vec3(-0.5f), glm::vec3(0.5f)}, {glm::uvec3(0, 1, 0)}));
+	}
+	Eng::Mesh *behind = new Eng::Mesh("Behind", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 20.0f)),
+									  {glm::vec3(-0.5f), glm::vec3(0.5f)}, {glm::uvec3(0, 1, 0)});
+	root->addChild(behind);
+	root->addChild(new Eng::OmniLight("Light"));
+
+	// Perspective: half-width of the view is tan(22.5 deg) * 20 = 8.3, only x = -5 and 5 are in
+	Eng::List *list = new Eng::List("CulledList");
+	Eng::PerspectiveCamera *perspective = new Eng::PerspectiveCamera("Perspective");
+	perspective->setCameraParams(45.0f, 1.0f, 0.1f, 100.0f);
+	list->setCamera(perspective);
+	list->pass(root, glm::mat4(1.0f));
+	assert(list->getNumberOfVisibleMeshes() == 2);
+	assert(list->getNumberOfCulledMeshes() == 99);
+	list->clear();
+	assert(list->getNumberOfVisibleMeshes() == 2); // readable after the frame
+
+	// Ortho: the [-20, 20] box keeps x = -15, -5, 5, 15 and also culls behind the camera
+	Eng::OrthoCamera *ortho = new Eng::OrthoCamera("Ortho");
+	ortho->setCameraParams(-20.0f, 20.0f, -20.0f, 20.0f, 0.1f, 100.0f);
+	list->setCamera(ortho);
+	list->pass(root, glm::mat4(1.0f));
+	assert(list->getNumberOfVisibleMeshes() == 4);
+	assert(list->getNumberOfCulledMeshes() == 97);
+	list->clear();
+
+	// A camera turned around sees the mesh behind the origin only
+	perspective->setMatrix(glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	list->setCamera(perspective);
+	list->pass(root, glm::mat4(1.0f));
+	assert(list->getNumberOfVisibleMeshes() == 1);
+	list->clear();
+
+	// Disabled: every mesh is kept
+	list->setFrustumCulling(false);
+	list->pass(root, glm::mat4(1.0f));
+	assert(list->getNumberOfVisibleMeshes() == 101);
+	assert(list->getNumberOfCulledMeshes() == 0);
+	list->clear();
+
+	delete list;
+	delete root;
+	delete perspective;
+	delete ortho;
+
+	TEST_PASS();
+}
+
+void testListSteadyStateAllocations()
+{
+	TEST("List steady-state frames do not allocate");
+
+	// 20 groups of 10 meshes each, plus two lights (omni lights need glutInit to draw their sphere)
+	Eng::Node *root = new Eng::Node("Root");
+	for (int g = 0; g < 20; g++)
+	{
+		Eng::Node *group = new Eng::Node("Group", glm::translate(glm::mat4(1.0f), glm::vec3(g - 10.0f, 0.0f, -30.0f)));
+		for (int m = 0; m < 10; m++)
+		{
+			group->addChild(new Eng::Mesh("Mesh", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, m - 5.0f, 0.0f)),
+										  {glm::vec3(-0.4f), glm::vec3(0.4f, -0.4f, 0.0f), glm::vec3(0.4f)}, {glm::uvec3(0, 1, 2)},
+										  std::vector<glm::vec4>(3, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)), std::vector<glm::vec2>(3)));
+		}
+		root->addChild(group);
+	}
+	root->addChild(new Eng::SpotLight("Light1"));
+	root->addChild(new Eng::InfiniteLight("Light2"));
+
+	Eng::List *list = new Eng::List("FrameList");
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(45.0f, 1.0f, 0.1f, 100.0f);
+	list->setCamera(camera);
+
+	// Draws too when an offscreen context is available
+	bool draw = makeOffscreenContext();
+	auto frame = [&]()
+	{
+		list->pass(root, glm::mat4(1.0f));
+		if (draw)
+			list->render();
+		list->clear();
+	};
+
+	// Warm-up frames size the queues (and upload the vertex buffers)
+	frame();
+	frame();
+	assert(list->getNumberOfVisibleMeshes() + list->getNumberOfCulledMeshes() == 200);
+	assert(list->getNumberOfVisibleMeshes() > 0);
+
+	allocationThreshold = 1;
+	largeAllocations = 0;
+	countAllocations = true;
+	for (int f = 0; f < 50; f++)
+		frame();
+	countAllocations = false;
+	std::cout << "  Heap allocations in 50 frames" << (draw ? " (with rendering)" : "") << ": " << largeAllocations << std::endl;
+	assert(largeAllocations == 0);
+
+	delete list;
+	delete root;
+	delete camera;
+
+	TEST_PASS();
+}
+
+void testListStateSorting()
+{
+	TEST("List sort keys and material state cache");
+
+	// Opaque: texture, then material, then front to back
+	unsigned long long nearKey = Eng::List::makeSortKey(0, false, 1, 1, 1, 2.0f);
+	unsigned long long farKey = Eng::List::makeSortKey(0, false, 1, 1, 1, 50.0f);
+	unsigned long long otherMaterialKey = Eng::List::makeSortKey(0, false, 1, 2, 1, 0.5f);
+	unsigned long long otherTextureKey = Eng::List::makeSortKey(0, false, 2, 1, 1, 0.5f);
+	assert(nearKey < farKey);
+	assert(farKey < otherMaterialKey);
+	assert(otherMaterialKey < otherTextureKey);
+	assert(farKey < Eng::List::makeSortKey(0, false, 1, 1, 2, 0.5f)); // instances of one geometry stay together
+
+	// Transparent: after every opaque draw, back to front regardless of state
+	unsigned long long transparentNear = Eng::List::makeSortKey(0, true, 1, 1, 1, 2.0f);
+	unsigned long long transparentFar = Eng::List::makeSortKey(0, true, 9, 9, 1, 50.0f);
+	assert(otherTextureKey < transparentFar);
+	assert(transparentFar < transparentNear);
+	assert(transparentNear < Eng::List::makeSortKey(1, false, 0, 0, 1, 0.0f));
+
+	if (!makeOffscreenContext())
+	{
+		std::cout << "  No offscreen OpenGL context, state cache not checked" << std::endl;
+		TEST_PASS();
+		return;
+	}
+
+	// 30 meshes cycling through 3 materials in scene graph order
+	Eng::Material *materials[3] = {new Eng::Material("Red"), new Eng::Material("Green"), new Eng::Material("Blue")};
+	Eng::Node *root = new Eng::Node("Root");
+	for (int i = 0; i < 30; i++)
+	{
+		Eng::Mesh *mesh = new Eng::Mesh("Mesh", glm::translate(glm::mat4(1.0f), glm::vec3(i * 0.1f - 1.5f, 0.0f, -10.0f - i)),
+										{glm::vec3(-0.1f), glm::vec3(0.1f, -0.1f, 0.0f), glm::vec3(0.1f)}, {glm::uvec3(0, 1, 2)},
+										std::vector<glm::vec4>(3, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)), std::vector<glm::vec2>(3));
+		mesh->setMaterial(materials[i % 3]);
+		root->addChild(mesh);
+	}
+
+	Eng::List *list = new Eng::List("SortedList");
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(45.0f, 1.0f, 0.1f, 100.0f);
+	list->setCamera(camera);
+	list->pass(root, glm::mat4(1.0f));
+	assert(list->getNumberOfVisibleMeshes() == 30);
+	list->render();
+	list->clear();
+
+	// Each material is sent once, the texture stays disabled after the first draw
+	Eng::Material::StateCacheStats stats = Eng::Material::getStateCacheStats();
+	std::cout << "  Material changes: " << stats.materialChanges << " (saved " << stats.materialChangesSaved
+			  << "), texture changes: " << stats.textureChanges << " (saved " << stats.textureChangesSaved << ")" << std::endl;
+	assert(stats.materialChanges == 3);
+	assert(stats.materialChangesSaved == 27);
+	assert(stats.textureChanges == 1);
+	assert(stats.textureChangesSaved == 2);
+
+	// Two materials whose identifiers agree in the low 12 bits still get separate groups
+	Eng::Material *aliased = new Eng::Material("Aliased");
+	while ((aliased->getId() & 0xFFF) != (materials[0]->getId() & 0xFFF))
+	{
+		delete aliased;
+		aliased = new Eng::Material("Aliased");
+	}
+	for (unsigned int i = 1; i < root->getNumberOfChildren(); i += 2)
+		dynamic_cast<Eng::Mesh *>(root->getChild(i))->setMaterial(aliased);
+	for (unsigned int i = 0; i < root->getNumberOfChildren(); i += 2)
+		dynamic_cast<Eng::Mesh *>(root->getChild(i))->setMaterial(materials[0]);
+	list->pass(root, glm::mat4(1.0f));
+	list->render();
+	list->clear();
+	assert(Eng::Material::getStateCacheStats().materialChanges == 2);
+
+	delete list;
+	delete root;
+	delete camera;
+	delete aliased;
+	for (Eng::Material *material : materials)
+		delete material;
+
+	TEST_PASS();
+}
+
+void testListShadowPass()
+{
+	TEST("List batched planar shadow pass");
+
+	if (!makeOffscreenContext())
+	{
+		std::cout << "  No offscreen OpenGL context, skipped" << std::endl;
+		TEST_PASS();
+		return;
+	}
+
+	// 20 flat copies of one tile 10 units above the ground, lit from straight above
+	Eng::Mesh *source = new Eng::Mesh("Tile", glm::mat4(1.0f), makeGridGeometry(4, 0.5f));
+	glm::mat4 flat = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	Eng::Node *root = new Eng::Node("Root");
+	for (int i = 0; i < 20; i++)
+	{
+		glm::vec3 position((i % 5) * 1.5f - 3.0f, 10.0f, (i / 5) * 1.5f - 2.25f);
+		root->addChild(source->createInstance("Copy", glm::translate(glm::mat4(1.0f), position) * flat));
+	}
+
+	// Visible, but its shadow lands 15 units from the center, outside the view
+	root->addChild(new Eng::Mesh("Wide", glm::translate(glm::mat4(1.0f), glm::vec3(3.5f, 20.0f, 0.0f)) * flat, makeGridGeometry(2, 0.5f)));
+	// Visible, but below the ground plane
+	root->addChild(new Eng::Mesh("Buried", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -3.0f, 0.0f)) * flat, makeGridGeometry(2, 0.5f)));
+
+	Eng::SpotLight *light = new Eng::SpotLight("Sun");
+	light->setMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 25.0f, 0.0f)));
+	root->addChild(light);
+
+	// Looking straight down from 30 units: the ground is visible up to 12.4 units from the center
+	Eng::List *list = new Eng::List("ShadowList");
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(45.0f, 1.0f, 0.1f, 100.0f);
+	camera->setMatrix(glm::inverse(glm::lookAt(glm::vec3(0.0f, 30.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f))));
+	list->setCamera(camera);
+
+	glMatrixMode(GL_MODELVIEW);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_NORMALIZE);
+	glEnable(GL_LIGHTING);
+
+	auto drawFrame = [&]()
+	{
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		list->pass(root, glm::mat4(1.0f));
+		list->render();
+		list->clear();
+
+		std::vector<unsigned char> pixels(64 * 64 * 4);
+		glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		return pixels;
+	};
+
+	Eng::Mesh::setInstancingEnabled(true);
+	std::vector<unsigned char> instanced = drawFrame();
+	assert(list->getNumberOfVisibleMeshes() == 22);
+	assert(list->getNumberOfShadowCasters() == 20);
+	assert(list->getNumberOfCulledShadowCasters() == 2);
+
+	// The shadows around the tiles have the flat shadow color
+	int shadowPixels = 0;
+	for (size_t p = 0; p < instanced.size(); p += 4)
+		shadowPixels += (instanced[p] == 166 && instanced[p + 1] == 166 && instanced[p + 2] == 166) ? 1 : 0;
+	std::cout << "  Shadow casters: " << list->getNumberOfShadowCasters() << " (skipped " << list->getNumberOfCulledShadowCasters()
+			  << "), shadow pixels: " << shadowPixels << std::endl;
+	assert(shadowPixels > 0);
+
+	// Batched and one draw per copy give the same picture
+	Eng::Mesh::setInstancingEnabled(false);
+	std::vector<unsigned char> separate = drawFrame();
+	int maxDifference = 0;
+	for (size_t p = 0; p < instanced.size(); p++)
+		maxDifference = std::max(maxDifference, std::abs((int)instanced[p] - (int)separate[p]));
+	assert(maxDifference <= 4);
+
+	for (int l = 0; l < 8; l++)
+		glDisable(GL_LIGHT0 + l);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_NORMALIZE);
+	glDisable(GL_DEPTH_TEST);
+
+	delete list;
+	delete root;
+	delete camera;
+	delete source;
+
+	TEST_PASS();
+}
+
+void testListMultiLightShadows()
+{
+	TEST("List multi-light shadows with influence radius");
+
+	Eng::SpotLight probe("Probe");
+	assert(probe.getInfluenceRadius() == 0.0f);
+	probe.setInfluenceRadius(-3.0f);
+	assert(probe.getInfluenceRadius() == 0.0f);
+
+	if (!makeOffscreenContext())
+	{
+		std::cout << "  No offscreen OpenGL context, skipped" << std::endl;
+		TEST_PASS();
+		return;
+	}
+
+	// 40 x 40 tiles 2 units above the ground, every 2 units across [-39, 39]^2
+	Eng::Mesh *source = new Eng::Mesh("Tile", glm::mat4(1.0f), makeGridGeometry(1, 0.4f));
+	glm::mat4 flat = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	Eng::Node *root = new Eng::Node("Root");
+	std::vector<Eng::Mesh *> tiles;
+	for (int i = 0; i < 1600; i++)
+	{
+		glm::vec3 position((i % 40) * 2.0f - 39.0f, 2.0f, (i / 40) * 2.0f - 39.0f);
+		tiles.push_back(source->createInstance("Tile", glm::translate(glm::mat4(1.0f), position) * flat));
+		root->addChild(tiles.back());
+	}
+
+	// Two local lights and one unlimited light, in this order in the scene graph
+	glm::vec3 lightPositions[2] = {glm::vec3(-20.0f, 8.0f, 0.0f), glm::vec3(15.0f, 6.0f, 10.0f)};
+	float radii[2] = {7.0f, 4.0f};
+	for (int l = 0; l < 2; l++)
+	{
+		Eng::SpotLight *light = new Eng::SpotLight("Local");
+		light->setMatrix(glm::translate(glm::mat4(1.0f), lightPositions[l]));
+		light->setInfluenceRadius(radii[l]);
+		root->addChild(light);
+	}
+	root->addChild(new Eng::SpotLight("Unlimited", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 50.0f, 0.0f))));
+
+	// Ground and a wall at x = -45, everything in view from high above
+	Eng::List *list = new Eng::List("MultiShadowList");
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(90.0f, 1.0f, 1.0f, 500.0f);
+	camera->setMatrix(glm::inverse(glm::lookAt(glm::vec3(0.0f, 100.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f))));
+	list->setCamera(camera);
+	list->setShadowPlanes({glm::vec4(0.0f, 1.0f, 0.0f, 0.0f), glm::vec4(1.0f, 0.0f, 0.0f, 45.0f)});
+	list->setMaxShadowLights(2);
+	assert(list->getShadowPlanes().size() == 2);
+	assert(list->getMaxShadowLights() == 2);
+
+	// Brute force reference: tiles whose bounds reach each local light
+	unsigned int reached = 0;
+	for (int l = 0; l < 2; l++)
+	{
+		for (Eng::Mesh *tile : tiles)
+		{
+			glm::vec4 sphere = tile->getBoundingSphere(tile->getWorldCoordinateMatrix());
+			reached += glm::distance(glm::vec3(sphere), lightPositions[l]) <= radii[l] + sphere.w ? 1 : 0;
+		}
+	}
+
+	auto drawFrame = [&]()
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		list->pass(root, glm::mat4(1.0f));
+		list->render();
+		list->clear();
+		return list->getNumberOfShadowCasters() + list->getNumberOfCulledShadowCasters();
+	};
+
+	// Only the tiles near each light are considered, once per plane
+	glEnable(GL_DEPTH_TEST);
+	unsigned int considered = drawFrame();
+	std::cout << "  Tiles: " << tiles.size() << ", within reach of the local lights: " << reached
+			  << ", shadows drawn: " << list->getNumberOfShadowCasters() << std::endl;
+	assert(reached > 0 && reached < 200);
+	assert(considered == reached * 2);
+	assert(list->getNumberOfShadowCasters() > 0);
+
+	// The third light reaches every tile
+	list->setMaxShadowLights(3);
+	assert(drawFrame() == reached * 2 + tiles.size() * 2);
+
+	// No planes, no shadows
+	list->setShadowPlanes({});
+	assert(drawFrame() == 0);
+
+	glDisable(GL_DEPTH_TEST);
+	for (int l = 0; l < 8; l++)
+		glDisable(GL_LIGHT0 + l);
+	glDisable(GL_LIGHTING);
+
+	delete list;
+	delete root;
+	delete camera;
+	delete source;
+
+	TEST_PASS();
+}
+
+void testListOffscreenShadowCasters()
+{
+	TEST("List planar shadows of casters outside the view");
+
+	if (!makeOffscreenContext())
+	{
+		std::cout << "  No offscreen OpenGL context, skipped" << std::endl;
+		TEST_PASS();
+		return;
+	}
+
+	// A tile above the camera, lit from higher up: the tile is culled, its shadow is in the middle of the view
+	glm::mat4 flat = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	Eng::Node *root = new Eng::Node("Root");
+	root->addChild(new Eng::Mesh("Overhead", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 35.0f, 0.0f)) * flat, makeGridGeometry(2, 2.0f)));
+	// Off to the side: both the tile and its shadow (around x = 31) are outside the view
+	root->addChild(new Eng::Mesh("Aside", glm::translate(glm::mat4(1.0f), glm::vec3(20.0f, 35.0f, 0.0f)) * flat, makeGridGeometry(2, 2.0f)));
+	Eng::SpotLight *light = new Eng::SpotLight("Sun", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 100.0f, 0.0f)));
+	root->addChild(light);
+
+	Eng::List *list = new Eng::List("OffscreenShadowList");
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(45.0f, 1.0f, 0.1f, 100.0f);
+	camera->setMatrix(glm::inverse(glm::lookAt(glm::vec3(0.0f, 30.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f))));
+	list->setCamera(camera);
+
+	glMatrixMode(GL_MODELVIEW);
+	glEnable(GL_DEPTH_TEST);
+	auto drawFrame = [&]()
+	{
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		list->pass(root, glm::mat4(1.0f));
+		list->render();
+		list->clear();
+
+		std::vector<unsigned char> pixels(64 * 64 * 4);
+		glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		return pixels;
+	};
+
+	std::vector<unsigned char> pixels = drawFrame();
+	assert(list->getNumberOfVisibleMeshes() == 0 && list->getNumberOfCulledMeshes() == 2);
+	assert(list->getNumberOfShadowCasters() == 1 && list->getNumberOfCulledShadowCasters() == 1);
+	std::cout << "  Center pixel: " << (int)pixels[(32 * 64 + 32) * 4] << std::endl;
+	assert(pixels[(32 * 64 + 32) * 4] == 166);
+
+	// Without shadows no caster is kept
+	list->setShadowTechnique(Eng::List::ShadowTechnique::NONE);
+	pixels = drawFrame();
+	assert(pixels[(32 * 64 + 32) * 4] == 0);
+	list->setShadowTechnique(Eng::List::ShadowTechnique::PLANAR);
+
+	for (int l = 0; l < 8; l++)
+		glDisable(GL_LIGHT0 + l);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+
+	delete list;
+	delete root;
+	delete camera;
+
+	TEST_PASS();
+}
+
+void testListShadowMaps()
+{
+	TEST("List shadow maps with cascades");
+
+	// Splits blend logarithmic and uniform, from the near to the far plane
+	float splits[Eng::ShadowMap::MAX_CASCADES + 1];
+	Eng::ShadowMap::computeCascadeSplits(0.5f, 100.0f, 4, 0.75f, splits);
+	assert(splits[0] == 0.5f && splits[4] == 100.0f);
+	for (int i = 0; i < 4; i++)
+		assert(splits[i] < splits[i + 1]);
+	assert(splits[1] < 25.0f);
+
+	Eng::ShadowMap settings;
+	settings.setResolution(4);
+	assert(settings.getResolution() == 16);
+	settings.setNumberOfCascades(9);
+	assert(settings.getNumberOfCascades() == Eng::ShadowMap::MAX_CASCADES);
+
+	if (!makeOffscreenContext() || !Eng::ShadowMap::isSupported())
+	{
+		std::cout << "  No offscreen OpenGL context, skipped" << std::endl;
+		TEST_PASS();
+		return;
+	}
+
+	// An emissive ground and a tile 2 units above it; no diffuse term, so only shadows change the picture
+	Eng::Material *material = new Eng::Material("Emissive", glm::vec4(0.8f, 0.8f, 0.8f, 1.0f), glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f), 1.0f);
+	glm::mat4 flat = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	Eng::Node *root = new Eng::Node("Root");
+	Eng::Mesh *ground = new Eng::Mesh("Ground", flat, makeGridGeometry(8, 10.0f));
+	Eng::Mesh *tile = new Eng::Mesh("Tile", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 2.0f, 0.0f)) * flat, makeGridGeometry(2, 1.0f));
+	ground->setMaterial(material);
+	tile->setMaterial(material);
+	root->addChild(ground);
+	root->addChild(tile);
+
+	// Tilted 30 degrees towards +x: the shadow covers x in [0.15, 2.15]
+	Eng::InfiniteLight *sun = new Eng::InfiniteLight("Sun", glm::rotate(glm::mat4(1.0f), glm::radians(30.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+	root->addChild(sun);
+
+	// Looking straight down from 10 units: 3.2 pixels per unit on the ground, the tile hides |x| < 1.25
+	Eng::List *list = new Eng::List("ShadowMapList");
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(90.0f, 1.0f, 1.0f, 50.0f);
+	camera->setMatrix(glm::inverse(glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f))));
+	list->setCamera(camera);
+	assert(list->getShadowTechnique() == Eng::List::ShadowTechnique::PLANAR);
+
+	glMatrixMode(GL_MODELVIEW);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
+
+	auto drawFrame = [&]()
+	{
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		list->pass(root, glm::mat4(1.0f));
+		list->render();
+		list->clear();
+
+		std::vector<unsigned char> pixels(64 * 64 * 4);
+		glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		return pixels;
+	};
+	// Ground at x = 1.8 (in the shadow) and x = -5 (lit), on the z = 0 row
+	auto red = [](const std::vector<unsigned char> &pixels, float x)
+	{
+		int column = (int)(32.0f + x * 3.2f);
+		return (int)pixels[(32 * 64 + column) * 4];
+	};
+
+	list->setShadowTechnique(Eng::List::ShadowTechnique::NONE);
+	std::vector<unsigned char> unshadowed = drawFrame();
+	list->setShadowTechnique(Eng::List::ShadowTechnique::SHADOW_MAP);
+	std::vector<unsigned char> shadowed = drawFrame();
+	assert(list->getShadowMap().getNumberOfMaps() == 3);
+	std::cout << "  Directional: lit " << red(unshadowed, 1.8f) << ", shadowed " << red(shadowed, 1.8f) << std::endl;
+	assert(red(shadowed, 1.8f) < red(unshadowed, 1.8f) - 40);
+	assert(std::abs(red(shadowed, -5.0f) - red(unshadowed, -5.0f)) <= 2);
+	assert(std::abs(red(shadowed, 5.0f) - red(unshadowed, 5.0f)) <= 2);
+
+	// Lower resolution, same result
+	list->getShadowMap().setResolution(256);
+	shadowed = drawFrame();
+	assert(red(shadowed, 1.8f) < red(unshadowed, 1.8f) - 40);
+	list->getShadowMap().setResolution(1024);
+
+	// A single cascade is compared during the main pass: the meshes are drawn once, plus the two casters into the map
+	if (Eng::ShadowMap::isMainPassSupported())
+	{
+		auto timeFrames = [&]()
+		{
+			Eng::Mesh::resetDrawStats();
+			auto start = std::chrono::steady_clock::now();
+			for (int f = 0; f < 50; f++)
+				drawFrame();
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / 50.0;
+		};
+
+		list->setShadowTechnique(Eng::List::ShadowTechnique::NONE);
+		double plainTime = timeFrames();
+		unsigned int plainDraws = Eng::Mesh::getDrawStats().drawCalls / 50;
+		list->setShadowTechnique(Eng::List::ShadowTechnique::SHADOW_MAP);
+		double receiverTime = timeFrames();
+		unsigned int receiverDraws = Eng::Mesh::getDrawStats().drawCalls / 50;
+
+		list->getShadowMap().setNumberOfCascades(1);
+		double mainPassTime = timeFrames();
+		unsigned int mainPassDraws = Eng::Mesh::getDrawStats().drawCalls / 50;
+		std::cout << "  No shadows: " << plainTime << " ms, " << plainDraws << " draws; 3 cascades in receiver passes: "
+				  << receiverTime << " ms, " << receiverDraws << " draws; 1 map in the main pass: "
+				  << mainPassTime << " ms, " << mainPassDraws << " draws" << std::endl;
+		assert(mainPassDraws == plainDraws + 2);
+		assert(receiverDraws > mainPassDraws);
+
+		shadowed = drawFrame();
+		assert(red(shadowed, 1.8f) < red(unshadowed, 1.8f) - 40);
+		assert(std::abs(red(shadowed, -5.0f) - red(unshadowed, -5.0f)) <= 2);
+		assert(std::abs(red(shadowed, 5.0f) - red(unshadowed, 5.0f)) <= 2);
+		list->getShadowMap().setNumberOfCascades(3);
+	}
+
+	// A spot light to the left: one perspective map, the shadow covers x in [-0.33, 2.33]
+	root->removeChild(sun);
+	delete sun;
+	Eng::SpotLight *spot = new Eng::SpotLight("Spot", glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, 8.0f, 0.0f)));
+	root->addChild(spot);
+	shadowed = drawFrame();
+	assert(list->getShadowMap().getNumberOfMaps() == 1);
+	std::cout << "  Spot: lit " << red(unshadowed, 1.8f) << ", shadowed " << red(shadowed, 1.8f) << std::endl;
+	assert(red(shadowed, 1.8f) < red(unshadowed, 1.8f) - 40);
+	assert(std::abs(red(shadowed, -5.0f) - red(unshadowed, -5.0f)) <= 2);
+	assert(list->getNumberOfShadowCasters() == 0);
+
+	// An omni light needs no map: its shadows are flattened onto the shadow planes instead
+	struct BareOmniLight : Eng::OmniLight
+	{
+		using Eng::OmniLight::OmniLight;
+		void render(glm::mat4 modelview) override { Eng::Light::render(modelview); }
+	};
+	root->removeChild(spot);
+	delete spot;
+	BareOmniLight *omni = new BareOmniLight("Omni", glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, 8.0f, 0.0f)));
+	root->addChild(omni);
+	Eng::Mesh::resetDrawStats();
+	drawFrame();
+	assert(list->getNumberOfShadowCasters() == 2);
+	assert(Eng::Mesh::getDrawStats().drawCalls == 2 + 2);
+
+	// A sun straight down and a tile above the camera: the tile is culled, its shadow covers x in [-7, -3]
+	root->removeChild(omni);
+	delete omni;
+	Eng::Mesh *overhead = new Eng::Mesh("Overhead", glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f, 12.0f, 0.0f)) * flat, makeGridGeometry(2, 2.0f));
+	overhead->setMaterial(material);
+	root->addChild(overhead);
+	root->addChild(new Eng::InfiniteLight("Sun", glm::mat4(1.0f)));
+	list->setShadowTechnique(Eng::List::ShadowTechnique::NONE);
+	unshadowed = drawFrame();
+	list->setShadowTechnique(Eng::List::ShadowTechnique::SHADOW_MAP);
+	shadowed = drawFrame();
+	assert(list->getNumberOfVisibleMeshes() == 2 && list->getNumberOfCulledMeshes() == 1);
+	std::cout << "  Off-screen caster: lit " << red(unshadowed, -5.0f) << ", shadowed " << red(shadowed, -5.0f) << std::endl;
+	assert(red(shadowed, -5.0f) < red(unshadowed, -5.0f) - 40);
+	assert(std::abs(red(shadowed, 5.0f) - red(unshadowed, 5.0f)) <= 2);
+
+	for (int l = 0; l < 8; l++)
+		glDisable(GL_LIGHT0 + l);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+
+	delete list;
+	delete root;
+	delete camera;
+	delete material;
+
+	TEST_PASS();
+}
+
+void testFrameStats()
+{
+	TEST("Frame statistics phases, counters and summaries");
+
+	auto spin = [](double milliseconds)
+	{
+		auto start = std::chrono::steady_clock::now();
+		while (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < milliseconds)
+			;
+	};
+
+	// Nested phases are exclusive: the shadows are not counted in the rendering
+	Eng::FrameStats stats(100);
+	assert(stats.getNumberOfFrames() == 0);
+	assert(stats.getFrameTimeSummary().p99 == 0.0f);
+	stats.beginFrame();
+	stats.beginPhase(Eng::FrameStats::Phase::RENDER);
+	spin(1.0);
+	stats.beginPhase(Eng::FrameStats::Phase::SHADOWS);
+	spin(3.0);
+	stats.endPhase();
+	spin(1.0);
+	stats.endPhase();
+	stats.endFrame();
+
+	const Eng::FrameStats::Frame &frame = stats.getLastFrame();
+	float phases = 0.0f;
+	for (float time : frame.phaseTimes)
+		phases += time;
+	std::cout << "  Render " << frame.phaseTimes[(int)Eng::FrameStats::Phase::RENDER] << " ms, shadows "
+			  << frame.phaseTimes[(int)Eng::FrameStats::Phase::SHADOWS] << " ms, frame " << frame.frameTime << " ms" << std::endl;
+	assert(frame.phaseTimes[(int)Eng::FrameStats::Phase::SHADOWS] >= 3.0f);
+	assert(frame.phaseTimes[(int)Eng::FrameStats::Phase::RENDER] >= 2.0f);
+	assert(frame.phaseTimes[(int)Eng::FrameStats::Phase::RENDER] < frame.phaseTimes[(int)Eng::FrameStats::Phase::SHADOWS]);
+	assert(phases <= frame.frameTime + 0.01f && phases > frame.frameTime * 0.9f);
+
+	// Counters 1 to 100 over a window of 100 frames, after 50 older frames left the window
+	for (unsigned int f = 0; f < 150; f++)
+	{
+		stats.beginFrame();
+		stats.addCounter(Eng::FrameStats::Counter::DRAW_CALLS, f < 50 ? 1000 : f - 49);
+		stats.endFrame();
+	}
+	assert(stats.getNumberOfFrames() == 100);
+	Eng::FrameStats::Summary summary = stats.getSummary(Eng::FrameStats::Counter::DRAW_CALLS);
+	assert(summary.min == 1.0f);
+	assert(summary.average == 50.5f);
+	assert(summary.p99 == 99.0f);
+	assert(stats.getLastFrame().counters[(int)Eng::FrameStats::Counter::DRAW_CALLS] == 100);
+	assert(std::string(Eng::FrameStats::getName(Eng::FrameStats::Phase::SWAP)) == "Swap");
+
+	stats.setWindow(0);
+	assert(stats.getWindow() == 1 && stats.getNumberOfFrames() == 0);
+
+	if (!makeOffscreenContext())
+	{
+		std::cout << "  No offscreen OpenGL context, skipped" << std::endl;
+		TEST_PASS();
+		return;
+	}
+
+	// Draw and traversal counters of one list frame
+	Eng::Mesh *source = new Eng::Mesh("Tile", glm::mat4(1.0f), makeGridGeometry(2));
+	Eng::Node *root = new Eng::Node("Root");
+	Eng::Node *group = new Eng::Node("Group");
+	root->addChild(group);
+	for (int i = 0; i < 5; i++)
+		group->addChild(source->createInstance("Copy", glm::translate(glm::mat4(1.0f), glm::vec3(i * 2.0f - 4.0f, 0.0f, -20.0f))));
+
+	Eng::List *list = new Eng::List("StatsList");
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(45.0f, 1.0f, 0.1f, 100.0f);
+	list->setCamera(camera);
+	list->setShadowTechnique(Eng::List::ShadowTechnique::NONE);
+	list->setFrameStats(&stats);
+
+	bool instancing = Eng::Mesh::isInstancingEnabled();
+	Eng::Mesh::setInstancingEnabled(false);
+	stats.beginFrame();
+	Eng::Mesh::resetDrawStats();
+	list->pass(root, glm::mat4(1.0f));
+	list->render();
+	list->clear();
+	stats.endFrame();
+	Eng::Mesh::setInstancingEnabled(instancing);
+
+	assert(list->getNumberOfTraversedNodes() == 7);
+	assert(Eng::Mesh::getDrawStats().drawCalls == 5);
+	assert(Eng::Mesh::getDrawStats().triangles == 5 * 8);
+
+	delete list;
+	delete root;
+	delete camera;
+	delete source;
+
+	TEST_PASS();
+}
+
+void testJobSystem()
+{
+	TEST("Job system runs every job exactly once");
+
+	Eng::JobSystem serial(1);
+	assert(serial.getNumberOfThreads() == 1);
+
+	// Uneven jobs: the first ones are much longer, so the other threads must steal
+	Eng::JobSystem jobs(4);
+	assert(jobs.getNumberOfThreads() == 4);
+	const unsigned int count = 1000;
+	std::vector<std::atomic<int>> runs(count);
+	auto job = [](void *context, unsigned int index)
+	{
+		std::vector<std::atomic<int>> &runs = *static_cast<std::vector<std::atomic<int>> *>(context);
+		volatile double sink = 0.0;
+		for (unsigned int i = 0; i < (index < 50 ? 20000u : 100u); i++)
+			sink = sink + std::sqrt((double)i);
+		runs[index]++;
+	};
+	for (int batch = 0; batch < 20; batch++)
+		jobs.run(count, job, &runs);
+	jobs.run(0, job, &runs);
+	for (std::atomic<int> &run : runs)
+		assert(run == 20);
+
+	serial.run(count, job, &runs);
+	assert(runs[count - 1] == 21 && serial.getNumberOfStolenJobs() == 0);
+	std::cout << "  Stolen jobs over 20 batches: " << jobs.getNumberOfStolenJobs() << std::endl;
+
+	TEST_PASS();
+}
+
+void testListParallelPass()
+{
+	TEST("List parallel pass matches the serial pass");
+
+	// Two identical scenes of 8 groups x 16 subgroups x 24 meshes, spinning, with a light per group
+	auto buildScene = []()
+	{
+		Eng::Node *root = new Eng::Node("Root");
+		for (int g = 0; g < 8; g++)
+		{
+			Eng::Node *group = new Eng::Node("Group", glm::translate(glm::mat4(1.0f), glm::vec3(g * 8.0f - 28.0f, 0.0f, -40.0f)));
+			group->move(glm::rotate(glm::mat4(1.0f), glm::radians(0.5f), glm::vec3(0.0f, 1.0f, 0.0f)), -1);
+			root->addChild(group);
+			group->addChild(new Eng::InfiniteLight("Light"));
+			for (int s = 0; s < 16; s++)
+			{
+				Eng::Node *subgroup = new Eng::Node("Subgroup", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, s - 8.0f, (float)(s % 4))));
+				subgroup->move(glm::rotate(glm::mat4(1.0f), glm::radians(5.0f), glm::vec3(0.0f, 0.0f, 1.0f)), 30);
+				group->addChild(subgroup);
+				for (int m = 0; m < 24; m++)
+				{
+					glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3((m % 6) * 0.6f - 1.5f, (m / 6) * 0.2f, m * 0.5f - 6.0f));
+					subgroup->addChild(new Eng::Mesh("Mesh", matrix, {glm::vec3(-0.2f), glm::vec3(0.2f, -0.2f, 0.0f), glm::vec3(0.2f)}, {glm::uvec3(0, 1, 2)},
+													 std::vector<glm::vec4>(3, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)), std::vector<glm::vec2>(3)));
+				}
+			}
+		}
+		return root;
+	};
+	auto collect = [](Eng::Node *node, std::vector<Eng::Node *> &nodes, auto &&self) -> void
+	{
+		nodes.push_back(node);
+		for (Eng::Node *child : node->getChildren())
+			self(child, nodes, self);
+	};
+	Eng::Node *serialRoot = buildScene();
+	Eng::Node *parallelRoot = buildScene();
+	std::vector<Eng::Node *> serialNodes, parallelNodes;
+	collect(serialRoot, serialNodes, collect);
+	collect(parallelRoot, parallelNodes, collect);
+	assert(serialNodes.size() == 1 + 8 * (2 + 16 * 25));
+	assert(serialRoot->getSubtreeSize() == serialNodes.size());
+
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	camera->setCameraParams(45.0f, 1.0f, 0.1f, 100.0f);
+	Eng::List *serialList = new Eng::List("SerialList");
+	Eng::List *parallelList = new Eng::List("ParallelList");
+	serialList->setCamera(camera);
+	parallelList->setCamera(camera);
+	Eng::JobSystem jobs(4);
+	parallelList->setJobSystem(&jobs);
+
+	bool context = makeOffscreenContext();
+	auto frame = [&](Eng::List *list, Eng::Node *root, double &time)
+	{
+		auto start = std::chrono::steady_clock::now();
+		list->pass(root, glm::mat4(1.0f));
+		time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<unsigned char> pixels;
+		if (context)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			list->render();
+			pixels.resize(64 * 64 * 4);
+			glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		}
+		list->clear();
+		return pixels;
+	};
+
+	// The scene size is known before it is visited: the first frame is parallel too
+	double serialTime = 0.0, parallelTime = 0.0;
+	const int frames = 40;
+	glEnable(GL_DEPTH_TEST);
+	for (int f = 0; f < frames; f++)
+	{
+		std::vector<unsigned char> expected = frame(serialList, serialRoot, serialTime);
+		std::vector<unsigned char> pixels = frame(parallelList, parallelRoot, parallelTime);
+		assert(pixels == expected);
+		assert(parallelList->getNumberOfPassJobs() == 128u);
+		assert(serialList->getNumberOfPassJobs() == 0);
+		assert(parallelList->getNumberOfTraversedNodes() == serialList->getNumberOfTraversedNodes());
+		assert(parallelList->getNumberOfVisibleMeshes() == serialList->getNumberOfVisibleMeshes());
+		assert(parallelList->getNumberOfCulledMeshes() == serialList->getNumberOfCulledMeshes());
+	}
+	assert(serialList->getNumberOfCulledMeshes() > 0 && serialList->getNumberOfVisibleMeshes() > 0);
+
+	// Every animation stepped once per frame, on whichever thread
+	for (size_t i = 0; i < serialNodes.size(); i++)
+		assert(mat4Equal(parallelNodes[i]->getWorldCoordinateMatrix(), serialNodes[i]->getWorldCoordinateMatrix()));
+	std::cout << "  Pass of " << serialNodes.size() << " nodes, serial: " << serialTime / frames << " ms, 4 threads: "
+			  << parallelTime / frames << " ms (" << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+
+	// A small scene stays serial
+	assert(parallelNodes[3]->getSubtreeSize() < 512);
+	parallelList->pass(parallelNodes[3], glm::mat4(1.0f));
+	assert(parallelList->getNumberOfPassJobs() == 0);
+	parallelList->clear();
+	glDisable(GL_DEPTH_TEST);
+	for (int l = 0; l < 8; l++)
+		glDisable(GL_LIGHT0 + l);
+	glDisable(GL_LIGHTING);
+
+	delete serialList;
+	delete parallelList;
+	delete serialRoot;
+	delete parallelRoot;
 	delete camera;
 
 	TEST_PASS();
 }
 
+// ============================================================================
+// OVO READER TESTS
+// ============================================================================
+
+void testOvoReaderLoadModes()
+{
+	TEST("OvoReader memory-mapped vs stream load (10k meshes)");
+
+	const unsigned int meshCount = 10000;
+	std::string path = writeSyntheticOvo("engine_test_10k.ovo", meshCount);
+
+	double elapsed[2];
+	Eng::Node *roots[2];
+	Eng::OvoReader::LoadMode modes[2] = {Eng::OvoReader::LoadMode::STREAM, Eng::OvoReader::LoadMode::MEMORY_MAPPED};
+
+	for (int i = 0; i < 2; i++)
+	{
+		Eng::OvoReader reader;
+		reader.setLoadMode(modes[i]);
+
+		auto start = std::chrono::steady_clock::now();
+		roots[i] = reader.load(path);
+		elapsed[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		assert(roots[i] != nullptr);
+		assert(reader.wasMemoryMapped() == (modes[i] == Eng::OvoReader::LoadMode::MEMORY_MAPPED));
+	}
+
+	// Both paths must build the same tree
+	assert(roots[0]->getNumberOfChildren() == meshCount);
+	assert(roots[1]->getNumberOfChildren() == meshCount);
+	for (unsigned int m = 0; m < meshCount; m += 997)
+	{
+		Eng::Node *a = roots[0]->getChild(m);
+		Eng::Node *b = roots[1]->getChild(m);
+		assert(a->getName() == b->getName());
+		assert(mat4Equal(a->getMatrix(), b->getMatrix()));
+		assert(dynamic_cast<Eng::Mesh *>(b) != nullptr);
+	}
+
+	// Identical meshes keep their own geometry unless sharing is requested
+	Eng::Mesh *first = dynamic_cast<Eng::Mesh *>(roots[1]->getChild(0));
+	assert(!first->sharesGeometry(dynamic_cast<Eng::Mesh *>(roots[1]->getChild(meshCount - 1))));
+
+	std::cout << "  stream: " << elapsed[0] << " ms, memory-mapped: " << elapsed[1] << " ms" << std::endl;
+
+	delete roots[0];
+	delete roots[1];
+	std::filesystem::remove(path);
+
+	TEST_PASS();
+}
+
+void testOvoReaderParallelDecode()
+{
+	TEST("OvoReader parallel vs serial mesh decoding (10k meshes)");
+
+	const unsigned int meshCount = 10000;
+	std::string path = writeSyntheticOvo("engine_test_parallel.ovo", meshCount);
+
+	double elapsed[2];
+	Eng::Node *roots[2];
+	unsigned int threads[2] = {1, 4};
+
+	for (int i = 0; i < 2; i++)
+	{
+		Eng::OvoReader reader;
+		reader.setWorkerThreads(threads[i]);
+		assert(reader.getWorkerThreads() == threads[i]);
+
+		auto start = std::chrono::steady_clock::now();
+		roots[i] = reader.load(path);
+		elapsed[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		assert(roots[i] != nullptr);
+	}
+
+	// Same tree, same object order: uids must advance identically
+	assert(roots[0]->getName() == roots[1]->getName());
+	assert(roots[1]->getNumberOfChildren() == meshCount);
+	for (unsigned int m = 0; m < meshCount; m++)
+	{
+		Eng::Node *a = roots[0]->getChild(m);
+		Eng::Node *b = roots[1]->getChild(m);
+		assert(a->getName() == b->getName());
+		assert(mat4Equal(a->getMatrix(), b->getMatrix()));
+		assert(a->getId() - roots[0]->getId() == b->getId() - roots[1]->getId());
+		assert(dynamic_cast<Eng::Mesh *>(b) != nullptr);
+	}
+
+	// Decoded geometry keeps the packed tangents
+	Eng::Mesh *mesh = dynamic_cast<Eng::Mesh *>(roots[1]->getChild(0));
+	assert(mesh->getVertexes().size() == 4 && mesh->getFaces().size() == 2);
+	assert(mesh->getTangents().size() == 4);
+	assert(floatEqual(mesh->getTangents()[0].x, 1.0f));
+	assert(floatEqual(mesh->getNormals()[0].y, 1.0f));
+
+	// A reader keeps its decoding threads: the next load hands them a new batch
+	{
+		Eng::OvoReader reader;
+		reader.setWorkerThreads(4);
+		Eng::Node *again[2] = {reader.load(path), reader.load(path)};
+		for (Eng::Node *root : again)
+		{
+			assert(root != nullptr && root->getNumberOfChildren() == meshCount);
+			Eng::Mesh *last = dynamic_cast<Eng::Mesh *>(root->getChild(meshCount - 1));
+			assert(last->getVertexes() == dynamic_cast<Eng::Mesh *>(roots[0]->getChild(meshCount - 1))->getVertexes());
+			delete root;
+		}
+	}
+
+	std::cout << "  serial: " << elapsed[0] << " ms, 4 workers: " << elapsed[1] << " ms" << std::endl;
+
+	delete roots[0];
+	delete roots[1];
+	std::filesystem::remove(path);
+
+	TEST_PASS();
+}
+
+void testOvoReaderCorruptMesh()
+{
+	TEST("OvoReader mesh counts past the end of the chunk");
+
+	const unsigned int meshCount = 3;
+	std::string path = writeSyntheticOvo("engine_test_corrupt.ovo", meshCount);
+
+	// The last chunk ends the file: its LOD count, vertex count and face count precede 4 vertex records and 2 triangles
+	std::uintmax_t countsOffset = std::filesystem::file_size(path) - 2 * sizeof(glm::uvec3) - 4 * Eng::VertexUnpack::RECORD_SIZE - 2 * sizeof(unsigned int);
+	auto patch = [&](std::uintmax_t offset, unsigned int value)
+	{
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		unsigned int previous = 0;
+		file.seekg(offset);
+		file.read(reinterpret_cast<char *>(&previous), sizeof(previous));
+		file.seekp(offset);
+		file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+		return previous;
+	};
+
+	// Vertexes reaching 24 MB past the file mapping, then more LODs than bytes left: the mesh is kept empty
+	const std::uintmax_t offsets[2] = {countsOffset, countsOffset - sizeof(unsigned int)};
+	for (std::uintmax_t offset : offsets)
+	{
+		unsigned int previous = patch(offset, 1000000);
+		for (unsigned int threads : {1u, 4u})
+		{
+			Eng::OvoReader reader;
+			reader.setWorkerThreads(threads);
+			Eng::Node *root = reader.load(path);
+			assert(root != nullptr && root->getNumberOfChildren() == meshCount);
+			assert(dynamic_cast<Eng::Mesh *>(root->getChild(0))->getVertexes().size() == 4);
+			assert(dynamic_cast<Eng::Mesh *>(root->getChild(meshCount - 1))->getVertexes().empty());
+			delete root;
+		}
+		patch(offset, previous);
+	}
+
+	std::filesystem::remove(path);
+
+	TEST_PASS();
+}
+
+void testOvoCache()
+{
+	TEST("OvoCache round trip and invalidation");
+
+	const unsigned int meshCount = 10000;
+	std::string path = writeSyntheticOvo("engine_test_cache.ovo", meshCount);
+	std::string cachePath = Eng::OvoCache::getCachePath(path);
+	std::filesystem::remove(cachePath);
+
+	// No cache yet
+	assert(Eng::OvoCache::load(path) == nullptr);
+
+	Eng::OvoReader reader;
+	assert(!reader.isGeometrySharingEnabled());
+	reader.setGeometrySharing(true);
+	auto start = std::chrono::steady_clock::now();
+	Eng::Node *parsed = reader.load(path);
+	double parseTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	assert(parsed != nullptr);
+
+	assert(Eng::OvoCache::save(path, parsed));
+	assert(std::filesystem::exists(cachePath));
+
+	start = std::chrono::steady_clock::now();
+	Eng::Node *cached = Eng::OvoCache::load(path);
+	double cacheTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	assert(cached != nullptr);
+
+	// Cached meshes upload straight from the packed file and only unpack when their arrays are read
+	Eng::Mesh *packedMesh = dynamic_cast<Eng::Mesh *>(cached->getChild(0));
+	assert(packedMesh->isPacked(0));
+	if (makeOffscreenContext())
+	{
+		// The synthetic quads lie on the XZ plane: turn them towards the viewer
+		glm::mat4 facing = glm::scale(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(0.5f));
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(glm::value_ptr(facing));
+		glMatrixMode(GL_MODELVIEW);
+
+		std::vector<unsigned char> expected = renderMeshPixels(dynamic_cast<Eng::Mesh *>(parsed->getChild(0)));
+		std::vector<unsigned char> drawn = renderMeshPixels(packedMesh);
+		assert(std::count(expected.begin(), expected.end(), 255) > 0);
+		assert(drawn == expected);
+		assert(packedMesh->isUploaded(0) && packedMesh->isPacked(0));
+
+		glMatrixMode(GL_PROJECTION);
+		glLoadIdentity();
+		glMatrixMode(GL_MODELVIEW);
+	}
+
+	// Same tree, same decoded geometry
+	assert(cached->getName() == parsed->getName());
+	assert(cached->getNumberOfChildren() == meshCount);
+	for (unsigned int m = 0; m < meshCount; m += 331)
+	{
+		Eng::Mesh *a = dynamic_cast<Eng::Mesh *>(parsed->getChild(m));
+		Eng::Mesh *b = dynamic_cast<Eng::Mesh *>(cached->getChild(m));
+		assert(b != nullptr);
+		assert(a->getName() == b->getName());
+		assert(mat4Equal(a->getMatrix(), b->getMatrix()));
+		assert(a->getVertexes() == b->getVertexes());
+		assert(a->getFaces() == b->getFaces());
+		assert(a->getNormals() == b->getNormals());
+		assert(a->getTextureCoordinates() == b->getTextureCoordinates());
+		assert(a->getTangents() == b->getTangents());
+	}
+	assert(!packedMesh->isPacked(0));
+
+	// The synthetic meshes are identical: with sharing enabled both loaders build them on one shared geometry
+	Eng::Mesh *firstParsed = dynamic_cast<Eng::Mesh *>(parsed->getChild(0));
+	Eng::Mesh *firstCached = dynamic_cast<Eng::Mesh *>(cached->getChild(0));
+	assert(firstParsed->sharesGeometry(dynamic_cast<Eng::Mesh *>(parsed->getChild(meshCount - 1))));
+	assert(firstCached->sharesGeometry(dynamic_cast<Eng::Mesh *>(cached->getChild(meshCount - 1))));
+	assert(!firstParsed->sharesGeometry(firstCached));
+
+	std::cout << "  parse: " << parseTime << " ms, cache: " << cacheTime << " ms" << std::endl;
+
+	// Touching the source invalidates the cache
+	std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(5));
+	assert(Eng::OvoCache::load(path) == nullptr);
+
+	// Scenes built in code: lights and shared materials survive the round trip
+	Eng::Node *root = new Eng::Node("Root");
+	Eng::Material *material = new Eng::Material("Shared", glm::vec4(0.1f), glm::vec4(0.2f), glm::vec4(0.3f), glm::vec4(0.4f), 32.0f);
+	Eng::Mesh *first = new Eng::Mesh("First", glm::mat4(1.0f), {glm::vec3(1.0f)}, {glm::uvec3(0, 0, 0)});
+	Eng::Mesh *second = new Eng::Mesh("Second");
+	Eng::SpotLight *spot = new Eng::SpotLight("Spot", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 5.0f, 0.0f)), 30.0f);
+	first->setMaterial(material);
+	second->setMaterial(material);
+	spot->setDiffuse(glm::vec4(0.5f, 0.6f, 0.7f, 1.0f));
+	spot->setInfluenceRadius(12.5f);
+	root->addChild(first);
+	first->addChild(second);
+	root->addChild(spot);
+
+	assert(Eng::OvoCache::save(path, root));
+	Eng::Node *restored = Eng::OvoCache::load(path);
+	assert(restored != nullptr && restored->getNumberOfChildren() == 2);
+
+	Eng::Mesh *restoredFirst = dynamic_cast<Eng::Mesh *>(restored->getChild("First"));
+	Eng::Mesh *restoredSecond = dynamic_cast<Eng::Mesh *>(restored->getChild("Second"));
+	Eng::SpotLight *restoredSpot = dynamic_cast<Eng::SpotLight *>(restored->getChild("Spot"));
+	assert(restoredFirst && restoredSecond && restoredSpot);
+	assert(restoredFirst->getMaterial() == restoredSecond->getMaterial());
+	assert(!restoredFirst->sharesGeometry(restoredSecond));
+	assert(floatEqual(restoredFirst->getMaterial()->getShininess(), 32.0f));
+	assert(floatEqual(restoredSpot->getCutoff(), 30.0f));
+	assert(floatEqual(restoredSpot->getInfluenceRadius(), 12.5f));
+	assert(vec3Equal(glm::vec3(restoredSpot->getDiffuse()), glm::vec3(0.5f, 0.6f, 0.7f)));
+	assert(mat4Equal(restoredSpot->getMatrix(), spot->getMatrix()));
+
+	// A material name pointing past the string table is refused (material table offset at byte 48 of the header)
+	{
+		std::fstream file(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+		uint64_t materialOffset = 0;
+		file.seekg(48);
+		file.read(reinterpret_cast<char *>(&materialOffset), sizeof(materialOffset));
+		uint32_t badName = 0x7FFFFFFF;
+		file.seekp(materialOffset);
+		file.write(reinterpret_cast<const char *>(&badName), sizeof(badName));
+	}
+	assert(Eng::OvoCache::load(path) == nullptr);
+
+	// So is a face naming a vertex its LOD doesn't have (index table offset at byte 88)
+	assert(Eng::OvoCache::save(path, root));
+	{
+		std::fstream file(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+		uint64_t indexOffset = 0;
+		file.seekg(88);
+		file.read(reinterpret_cast<char *>(&indexOffset), sizeof(indexOffset));
+		uint32_t badIndex = 1;
+		file.seekp(indexOffset);
+		file.write(reinterpret_cast<const char *>(&badIndex), sizeof(badIndex));
+	}
+	assert(Eng::OvoCache::load(path) == nullptr);
+
+	// Nodes the cache can't describe are refused
+	Eng::PerspectiveCamera *camera = new Eng::PerspectiveCamera("Camera");
+	root->addChild(camera);
+	assert(!Eng::OvoCache::save(path, root));
+
+	delete parsed;
+	delete cached;
+	delete root;
+	delete restored;
+	delete material;
+	std::filesystem::remove(cachePath);
+	std::filesystem::remove(path);
+
+	TEST_PASS();
+}
+
+void testOvoReaderAsyncLoad()
+{
+	TEST("OvoReader asynchronous streaming load");
+
+	const unsigned int meshCount = 10000;
+	std::string path = writeSyntheticOvo("engine_test_async.ovo", meshCount);
+
+	Eng::OvoReader serialReader;
+	Eng::Node *expected = serialReader.load(path);
+	assert(expected != nullptr);
+
+	// The root is usable while the scene streams in
+	Eng::Node *root = new Eng::Node("Loading");
+	Eng::OvoReader reader;
+	assert(reader.loadAsync(path, root));
+	assert(!reader.loadAsync(path, root));
+
+	float lastProgress = 0.0f;
+	unsigned int updates = 0;
+	while (!reader.update())
+	{
+		float progress = reader.getProgress();
+		assert(progress >= lastProgress && progress <= 1.0f);
+		lastProgress = progress;
+		updates++;
+	}
+	assert(reader.hasAsyncSucceeded());
+	assert(reader.getProgress() == 1.0f);
+
+	// Same scene as a blocking load, merged into the caller's root
+	assert(root->getName() == expected->getName());
+	assert(root->getNumberOfChildren() == meshCount);
+	for (unsigned int m = 0; m < meshCount; m += 499)
+	{
+		Eng::Mesh *a = dynamic_cast<Eng::Mesh *>(expected->getChild(m));
+		Eng::Mesh *b = dynamic_cast<Eng::Mesh *>(root->getChild(m));
+		assert(b != nullptr);
+		assert(a->getName() == b->getName());
+		assert(mat4Equal(a->getMatrix(), b->getMatrix()));
+		assert(a->getVertexes() == b->getVertexes());
+	}
+	std::cout << "  completed after " << updates << " pending updates" << std::endl;
+
+	// Missing files fail without blocking
+	Eng::Node *missingRoot = new Eng::Node("Missing");
+	Eng::OvoReader missingReader;
+	assert(missingReader.loadAsync(path + ".missing", missingRoot));
+	while (!missingReader.update())
+	{
+	}
+	assert(!missingReader.hasAsyncSucceeded());
+	assert(missingRoot->getNumberOfChildren() == 0);
+
+	delete expected;
+	delete root;
+	delete missingRoot;
+	std::filesystem::remove(path);
+
+	TEST_PASS();
+}
+
+void testOvoReaderProfiler()
+{
+	TEST("OvoReader load profiler");
+
+	const unsigned int meshCount = 200;
+	std::string path = writeSyntheticOvo("engine_test_profile.ovo", meshCount);
+	std::string tracePath = path + ".trace.json";
+	std::filesystem::remove(tracePath);
+
+	// Disabled by default: nothing is recorded
+	Eng::OvoReader quietReader;
+	quietReader.setProfilingEnabled(false);
+	Eng::Node *quiet = quietReader.load(path);
+	assert(quiet != nullptr);
+	assert(quietReader.getProfiler().getNumberOfEvents() == 0);
+	assert(!std::filesystem::exists(tracePath));
+
+	for (unsigned int workers : {1u, 4u})
+	{
+		Eng::OvoReader reader;
+		reader.setWorkerThreads(workers);
+		reader.setProfilingEnabled(true, tracePath);
+		assert(reader.isProfilingEnabled());
+
+		Eng::Node *root = reader.load(path);
+		assert(root != nullptr);
+
+		// Every chunk is counted once, payload bytes add up to the file size
+		const Eng::LoadProfiler &profiler = reader.getProfiler();
+		Eng::LoadProfiler::CategoryStats objects = profiler.getCategoryStats(Eng::LoadProfiler::Category::OBJECT);
+		Eng::LoadProfiler::CategoryStats nodes = profiler.getCategoryStats(Eng::LoadProfiler::Category::NODE);
+		Eng::LoadProfiler::CategoryStats meshes = profiler.getCategoryStats(Eng::LoadProfiler::Category::MESH);
+		assert(objects.chunks == 1);
+		assert(nodes.chunks == 1);
+		assert(meshes.chunks == meshCount);
+		assert(objects.bytes + nodes.bytes + meshes.bytes + (meshCount + 2) * 2 * sizeof(unsigned int) == std::filesystem::file_size(path));
+
+		// Exclusive times: on a single thread the phases never add up to more than the wall time
+		double phases = 0.0;
+		for (int p = 0; p < (int)Eng::LoadProfiler::Phase::COUNT; p++)
+		{
+			phases += profiler.getPhaseTime((Eng::LoadProfiler::Phase)p);
+		}
+		assert(profiler.getPhaseTime(Eng::LoadProfiler::Phase::DECODE) > 0.0);
+		assert(workers > 1 || phases <= profiler.getTotalTime());
+		assert(profiler.getNumberOfEvents() >= meshCount * 3);
+
+		// Chrome trace
+		std::ifstream trace(tracePath);
+		std::string header;
+		std::getline(trace, header);
+		assert(header == "{\"traceEvents\":[");
+		trace.close();
+		std::filesystem::remove(tracePath);
+
+		delete root;
+	}
+
+	delete quiet;
+	std::filesystem::remove(path);
+
+	TEST_PASS();
+}
+
+// ============================================================================
+// VERTEX UNPACK TESTS
+// ============================================================================
+
+bool bitEqual(float a, float b)
+{
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+std::vector<char> makePackedVertexes(unsigned int count)
+{
+	std::vector<char> records;
+	records.reserve((size_t)count * Eng::VertexUnpack::RECORD_SIZE);
+
+	unsigned int seed = 12345;
+	for (unsigned int v = 0; v < count; v++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		glm::vec3 position((float)(seed & 0xffff), (float)v * 0.5f, -(float)(seed >> 16));
+		unsigned int normal = seed ^ (v * 2654435761u);
+		unsigned int uv = (v & 0xffff) | ((seed & 0xffff) << 16); // every half value appears in s
+		unsigned int tangent = seed * 2246822519u;
+		appendBytes(records, &position, sizeof(glm::vec3));
+		appendBytes(records, &normal, sizeof(unsigned int));
+		appendBytes(records, &uv, sizeof(unsigned int));
+		appendBytes(records, &tangent, sizeof(unsigned int));
+	}
+	return records;
+}
+
+void testVertexUnpackExactness()
+{
+	TEST("VertexUnpack SIMD paths are bit-exact with glm");
+
+	// Not a multiple of 8, so the SIMD tails are exercised too
+	const unsigned int count = 65536 + 13;
+	std::vector<char> records = makePackedVertexes(count);
+
+	Eng::VertexUnpack::Path paths[3] = {Eng::VertexUnpack::Path::SCALAR, Eng::VertexUnpack::Path::SSE2, Eng::VertexUnpack::Path::AVX2};
+	for (Eng::VertexUnpack::Path path : paths)
+	{
+		std::vector<float> out[13];
+		for (auto &stream : out)
+			stream.assign(count, 0.0f);
+
+		Eng::VertexUnpack::Streams streams = {out[0].data(), out[1].data(), out[2].data(),
+											  out[3].data(), out[4].data(), out[5].data(), out[6].data(),
+											  out[7].data(), out[8].data(),
+											  out[9].data(), out[10].data(), out[11].data(), out[12].data()};
+		Eng::VertexUnpack::unpack(records.data(), count, streams, path);
+
+		for (unsigned int v = 0; v < count; v++)
+		{
+			const char *record = records.data() + (size_t)v * Eng::VertexUnpack::RECORD_SIZE;
+			glm::vec3 position;
+			unsigned int normalData, uvData, tangentData;
+			memcpy(&position, record, sizeof(glm::vec3));
+			memcpy(&normalData, record + 12, sizeof(unsigned int));
+			memcpy(&uvData, record + 16, sizeof(unsigned int));
+			memcpy(&tangentData, record + 20, sizeof(unsigned int));
+
+			glm::vec4 normal = glm::unpackSnorm3x10_1x2(normalData);
+			glm::vec2 uv = glm::unpackHalf2x16(uvData);
+			glm::vec4 tangent = glm::unpackSnorm3x10_1x2(tangentData);
+
+			assert(bitEqual(out[0][v], position.x) && bitEqual(out[1][v], position.y) && bitEqual(out[2][v], position.z));
+			assert(bitEqual(out[3][v], normal.x) && bitEqual(out[4][v], normal.y) && bitEqual(out[5][v], normal.z) && bitEqual(out[6][v], normal.w));
+			assert(bitEqual(out[7][v], uv.s) && bitEqual(out[8][v], uv.t));
+			assert(bitEqual(out[9][v], tangent.x) && bitEqual(out[10][v], tangent.y) && bitEqual(out[11][v], tangent.z) && bitEqual(out[12][v], tangent.w));
+		}
+	}
+
+	// AoS overload keeps the tangents
+	std::vector<glm::vec3> positions(count);
+	std::vector<glm::vec4> normals(count), tangents(count);
+	std::vector<glm::vec2> uvs(count);
+	Eng::VertexUnpack::unpack(records.data(), count, positions.data(), normals.data(), uvs.data(), tangents.data(), Eng::VertexUnpack::getBestPath());
+	unsigned int tangentData;
+	memcpy(&tangentData, records.data() + 20, sizeof(unsigned int));
+	assert(bitEqual(tangents[0].x, glm::unpackSnorm3x10_1x2(tangentData).x));
+
+	std::cout << "  best path: " << (int)Eng::VertexUnpack::getBestPath() << " (0 scalar, 1 SSE2, 2 AVX2)" << std::endl;
+
+	TEST_PASS();
+}
+
+void testVertexUnpackBenchmark()
+{
+	TEST("VertexUnpack microbenchmark (1M vertexes)");
+
+	const unsigned int count = 1000000;
+	std::vector<char> records = makePackedVertexes(count);
+
+	// Reference: the per-vertex push_back loop the loader used to run
+	auto start = std::chrono::steady_clock::now();
+	std::vector<glm::vec4> referenceNormals;
+	std::vector<glm::vec2> referenceUvs;
+	for (unsigned int v = 0; v < count; v++)
+	{
+		unsigned int normalData, uvData;
+		memcpy(&normalData, records.data() + (size_t)v * Eng::VertexUnpack::RECORD_SIZE + 12, sizeof(unsigned int));
+		memcpy(&uvData, records.data() + (size_t)v * Eng::VertexUnpack::RECORD_SIZE + 16, sizeof(unsigned int));
+		referenceNormals.push_back(glm::unpackSnorm3x10_1x2(normalData));
+		referenceUvs.push_back(glm::unpackHalf2x16(uvData));
+	}
+	double reference = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "  glm loop: " << reference << " ms" << std::endl;
+
+	std::vector<glm::vec3> positions(count);
+	std::vector<glm::vec4> normals(count), tangents(count);
+	std::vector<glm::vec2> uvs(count);
+
+	const char *names[3] = {"scalar", "SSE2", "AVX2"};
+	Eng::VertexUnpack::Path paths[3] = {Eng::VertexUnpack::Path::SCALAR, Eng::VertexUnpack::Path::SSE2, Eng::VertexUnpack::Path::AVX2};
+	for (int p = 0; p < 3; p++)
+	{
+		if (paths[p] > Eng::VertexUnpack::getBestPath())
+			continue;
+
+		start = std::chrono::steady_clock::now();
+		Eng::VertexUnpack::unpack(records.data(), count, positions.data(), normals.data(), uvs.data(), tangents.data(), paths[p]);
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "  " << names[p] << " batch (with tangents): " << elapsed << " ms" << std::endl;
+
+		assert(bitEqual(normals[count - 1].y, referenceNormals[count - 1].y));
+		assert(bitEqual(uvs[count - 1].t, referenceUvs[count - 1].t));
+	}
+
+	TEST_PASS();
+}
+
 // ============================================================================
 // COMPLEX INTEGRATION TESTS
 // ============================================================================
@@ -614,6 +3296,55 @@ void testAnimatedHierarchy()
 	TEST_PASS();
 }
 
+void testTextureCache()
+{
+	TEST("Texture cache shares textures by resolved path");
+
+	Eng::TextureCache &cache = Eng::TextureCache::getInstance();
+	unsigned int before = cache.getNumberOfTextures();
+
+	std::string directory = std::filesystem::temp_directory_path().string();
+	Eng::Texture *first = cache.acquire("wood", directory + "/engine_test_wood.png");
+	Eng::Texture *second = cache.acquire("wood", directory + "/./engine_test_wood.png");
+	assert(first == second);
+	assert(cache.getNumberOfTextures() == before + 1);
+	assert(first->getFilePath() == directory + "/engine_test_wood.png");
+	assert(first->getReferenceCount() == 2);
+
+	// Materials hold the references; the texture outlives the first one
+	Eng::Material *a = new Eng::Material("A");
+	Eng::Material *b = new Eng::Material("B");
+	a->setTexture(first);
+	b->setTexture(second);
+	first->release();
+	second->release();
+	assert(first->getReferenceCount() == 2);
+
+	delete a;
+	assert(first->getReferenceCount() == 1);
+	assert(cache.getNumberOfTextures() == before + 1);
+
+	// The last release removes it from the cache
+	delete b;
+	assert(cache.getNumberOfTextures() == before);
+
+	// A texture acquired but never used goes away with the caller's reference
+	Eng::Texture *unused = cache.acquire("stone", directory + "/engine_test_stone.png");
+	assert(unused->getReferenceCount() == 1 && cache.getNumberOfTextures() == before + 1);
+	unused->release();
+	assert(cache.getNumberOfTextures() == before);
+
+	// Textures created outside the cache keep the old ownership: the material frees them
+	Eng::Material *owner = new Eng::Material("Owner");
+	owner->setTexture(new Eng::Texture("Private"));
+	assert(owner->getTexture()->getReferenceCount() == 1);
+	delete owner;
+
+	std::cout << "  resident texture bytes: " << cache.getResidentBytes() << std::endl;
+
+	TEST_PASS();
+}
+
 void testMaterialTextureAssignment()
 {
 	TEST("Material and texture assignment to mesh");
@@ -725,8 +3456,13 @@ int main(int argc, char *argv[])
 	testNodeHierarchy();
 	testNodeTransformation();
 	testNodeWorldCoordinates();
+	testNodeWorldMatrixCache();
+	testNodeParentTransform();
+	testNodeTransformStore();
 	testNodeMovement();
 	testNodeRemoval();
+	testNodeNameIndex();
+	testNodeKinds();
 
 	// Camera tests
 	testPerspectiveCamera();
@@ -734,9 +3470,15 @@ int main(int argc, char *argv[])
 
 	// Material tests
 	testMaterial();
+	testTextureCache();
 
 	// Mesh tests
 	testMeshCreation();
+	testMeshGeometryAllocations();
+	testMeshLods();
+	testMeshBounds();
+	testMeshVertexBuffers();
+	testMeshInstancing();
 
 	// Light tests
 	testOmniLight();
@@ -745,6 +3487,28 @@ int main(int argc, char *argv[])
 
 	// List tests
 	testListManagement();
+	testListFrustumCulling();
+	testListSteadyStateAllocations();
+	testListStateSorting();
+	testListShadowPass();
+	testListMultiLightShadows();
+	testListOffscreenShadowCasters();
+	testListShadowMaps();
+	testFrameStats();
+	testJobSystem();
+	testListParallelPass();
+
+	// OVO reader tests
+	testOvoReaderLoadModes();
+	testOvoReaderParallelDecode();
+	testOvoReaderCorruptMesh();
+	testOvoCache();
+	testOvoReaderAsyncLoad();
+	testOvoReaderProfiler();
+
+	// Vertex unpack tests
+	testVertexUnpackExactness();
+	testVertexUnpackBenchmark();
 
 	// Complex integration tests
 	testComplexSceneGraph();